@@ -75,6 +75,9 @@ ssize_t recvmsg(int fd, struct msghdr *msg, int flags)
         case WSAEWOULDBLOCK:
             errno = EAGAIN;
             break;
+        case WSAEMSGSIZE:
+            errno = EMSGSIZE;
+            break;
     }
     return -1;
 }
@@ -283,6 +283,11 @@ typedef enum libvlc_media_parse_flag_t
      * when the input is asking for credentials.
      */
     libvlc_media_do_interact    = 0x08,
+    /**
+     * Parse and fetch this media before the media requested without this
+     * flag, for example because it is visible to the user
+     */
+    libvlc_media_parse_priority = 0x10,
 } libvlc_media_parse_flag_t;
 
 /**
@@ -712,6 +717,35 @@ libvlc_media_parse_with_options( libvlc_media_t *p_md,
 LIBVLC_API void
 libvlc_media_parse_stop( libvlc_media_t *p_md );
 
+/**
+ * Parsing statistics of a libvlc instance
+ *
+ * \see libvlc_media_parse_get_stats
+ */
+typedef struct libvlc_media_parse_stats_t
+{
+    uint64_t i_parsed;        /**< media parsed so far */
+    unsigned i_parse_pending; /**< media waiting or being parsed */
+    uint64_t i_fetched;       /**< media for which meta and art were fetched */
+    unsigned i_fetch_pending; /**< media waiting or being fetched */
+} libvlc_media_parse_stats_t;
+
+/**
+ * Get the parsing statistics of a libvlc instance
+ *
+ * The throughput of the parsing can be computed from the number of media
+ * parsed at different times.
+ *
+ * \see libvlc_media_parse_with_options
+ *
+ * \param p_instance libvlc instance
+ * \param p_stats structure that will hold the statistics [OUT]
+ * \version LibVLC 3.0.0 or later
+ */
+LIBVLC_API void
+libvlc_media_parse_get_stats( libvlc_instance_t *p_instance,
+                              libvlc_media_parse_stats_t *p_stats );
+
 /**
  * Get Parsed status for media descriptor object.
  *
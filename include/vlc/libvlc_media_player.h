@@ -359,6 +359,10 @@ typedef unsigned (*libvlc_video_format_cb)(void **opaque, char *chroma,
 /**
  * Callback prototype to configure picture buffers format.
  *
+ * With libvlc_video_set_pool_callbacks(), this callback is only invoked once
+ * all the picture buffers are released, possibly from another thread and after
+ * the media player stopped.
+ *
  * \param opaque private pointer as passed to libvlc_video_set_callbacks()
  *               (and possibly modified by @ref libvlc_video_format_cb) [IN]
  */
@@ -393,7 +397,8 @@ typedef void (*libvlc_video_cleanup_cb)(void *opaque);
  *   cropping and/or picture re-orientation, must be performed by the CPU
  *   instead of the GPU.
  * - Memory copying is required between LibVLC reference picture buffers and
- *   application buffers (between lock and unlock callbacks).
+ *   application buffers (between lock and unlock callbacks), unless
+ *   libvlc_video_set_pool_callbacks() is used.
  *
  * \param mp the media player
  * \param lock callback to lock video memory (must not be NULL)
@@ -444,6 +449,70 @@ void libvlc_video_set_format_callbacks( libvlc_media_player_t *mp,
                                         libvlc_video_format_cb setup,
                                         libvlc_video_cleanup_cb cleanup );
 
+/**
+ * Callback prototype to get a picture buffer to render into directly.
+ *
+ * Whenever LibVLC needs a picture buffer to decode or convert a video frame
+ * into, the get callback is invoked. The pixel planes must have the pitches
+ * and lines set by @ref libvlc_video_format_cb or libvlc_video_set_format(),
+ * and be aligned on 32-bytes boundaries.
+ *
+ * LibVLC uses several picture buffers at the same time, some of them for the
+ * whole playback, and this callback may be invoked from any thread.
+ *
+ * \param opaque private pointer as passed to libvlc_video_set_callbacks() [IN]
+ * \param planes start address of the pixel planes (LibVLC allocates the array
+ *             of void pointers, this callback must initialize the array,
+ *             or leave it to NULL if no buffer is available, in which case
+ *             the video frame is dropped) [OUT]
+ * \return a private pointer for the unlock, display and release callbacks
+ *         to identify the picture buffer
+ */
+typedef void *(*libvlc_video_get_cb)(void *opaque, void **planes);
+
+/**
+ * Callback prototype to release a picture buffer.
+ *
+ * When LibVLC no longer references a picture buffer obtained from the
+ * @ref libvlc_video_get_cb callback, the release callback is invoked. The
+ * buffer then belongs to the application again: it can keep on reading it
+ * after the display callback returned, and hand it out again once it is done.
+ * This callback may be invoked from any thread, and even after the media
+ * player stopped, but always before the @ref libvlc_video_cleanup_cb callback.
+ *
+ * \param opaque private pointer as passed to libvlc_video_set_callbacks() [IN]
+ * \param picture private pointer returned from the @ref libvlc_video_get_cb
+ *                callback [IN]
+ */
+typedef void (*libvlc_video_release_cb)(void *opaque, void *picture);
+
+/**
+ * Set callbacks to render video directly into application buffers. This only
+ * works in combination with libvlc_video_set_callbacks().
+ *
+ * Instead of being copied into the buffer returned by the lock callback,
+ * pictures are decoded (or converted) into buffers returned by the get
+ * callback, and the unlock and display callbacks receive the private pointer
+ * of those buffers. This saves a copy of every picture.
+ *
+ * If the pitches or lines of the picture buffers are too small for the video
+ * format, LibVLC falls back to copying pictures with the lock callback.
+ *
+ * \warning With a get callback, the @ref libvlc_video_cleanup_cb callback
+ * set with libvlc_video_set_format_callbacks() is deferred until all the
+ * picture buffers are released: it may be invoked from another thread, after
+ * the media player stopped.
+ *
+ * \param mp the media player
+ * \param get callback to get a picture buffer (or NULL to always copy)
+ * \param release callback to release a picture buffer (or NULL if not needed)
+ * \version LibVLC 4.0.0 or later
+ */
+LIBVLC_API
+void libvlc_video_set_pool_callbacks( libvlc_media_player_t *mp,
+                                      libvlc_video_get_cb get,
+                                      libvlc_video_release_cb release );
+
 /**
  * Set the NSView handler where the media player should render its video output.
  *
@@ -144,6 +144,27 @@ VLC_API void block_Init( block_t *, void *, size_t );
  */
 VLC_API block_t *block_Alloc(size_t size) VLC_USED VLC_MALLOC;
 
+/**
+ * Block recycling statistics.
+ *
+ * block_Alloc() recycles released blocks of common sizes rather than
+ * returning them to the heap.
+ */
+typedef struct block_pool_stats_t
+{
+    uint64_t allocs; /**< allocations of recyclable sizes */
+    uint64_t hits; /**< allocations served with a recycled block */
+    uint64_t releases; /**< recyclable blocks released */
+    uint64_t discards; /**< released blocks freed as the caches were full */
+} block_pool_stats_t;
+
+/**
+ * Gets the block recycling statistics.
+ *
+ * Other threads report their figures periodically, so those may lag behind.
+ */
+VLC_API void block_pool_GetStats(block_pool_stats_t *);
+
 block_t *block_TryRealloc(block_t *, ssize_t pre, size_t body) VLC_USED;
 
 /**
@@ -623,6 +644,93 @@ static inline void vlc_fifo_Cleanup(void *fifo)
 
 /** @} */
 
+/**
+ * \defgroup lffifo Lock-free block FIFO
+ * \ingroup block
+ *
+ * Thread-safe block queue for hot paths with a single consumer thread.
+ *
+ * Any number of threads can queue blocks concurrently without locking.
+ * Only one thread at a time may dequeue blocks: vlc_lffifo_Dequeue(),
+ * vlc_lffifo_DequeueAll(), vlc_lffifo_Get(), vlc_lffifo_Empty() and
+ * vlc_lffifo_Release() must not be called concurrently with each other.
+ *
+ * Unlike \ref vlc_fifo_t, the queue has no lock to group several operations.
+ * A block may also be visible to the consumer only shortly after
+ * vlc_lffifo_Queue() returned in another thread.
+ * @{
+ */
+
+typedef struct vlc_lffifo_t vlc_lffifo_t;
+
+/**
+ * Creates a lock-free FIFO.
+ *
+ * The created queue must be released with vlc_lffifo_Release().
+ *
+ * @return the FIFO or NULL on memory error
+ */
+VLC_API vlc_lffifo_t *vlc_lffifo_New(void) VLC_USED VLC_MALLOC;
+
+/**
+ * Destroys a lock-free FIFO, releasing all the blocks it still contains.
+ */
+VLC_API void vlc_lffifo_Release(vlc_lffifo_t *);
+
+/**
+ * Queues a linked-list of blocks.
+ *
+ * This function can be called from any thread, and wakes up the consumer if
+ * it is waiting in vlc_lffifo_Get().
+ */
+VLC_API void vlc_lffifo_Queue(vlc_lffifo_t *, block_t *);
+
+/**
+ * Dequeues the first block, without waiting.
+ *
+ * @return the first block, or NULL if none is available
+ */
+VLC_API block_t *vlc_lffifo_Dequeue(vlc_lffifo_t *) VLC_USED;
+
+/**
+ * Dequeues all available blocks.
+ *
+ * @return a linked-list of the blocks, or NULL if none is available
+ */
+VLC_API block_t *vlc_lffifo_DequeueAll(vlc_lffifo_t *) VLC_USED;
+
+/**
+ * Dequeues the first block, waiting for one if needed.
+ *
+ * @note This function is a cancellation point.
+ */
+VLC_API block_t *vlc_lffifo_Get(vlc_lffifo_t *) VLC_USED;
+
+/**
+ * Counts blocks in a lock-free FIFO.
+ *
+ * While blocks are being queued or dequeued concurrently, the count may
+ * include blocks not yet available to the consumer.
+ */
+VLC_API size_t vlc_lffifo_GetCount(vlc_lffifo_t *) VLC_USED;
+
+/**
+ * Counts bytes in a lock-free FIFO, see vlc_lffifo_GetCount().
+ */
+VLC_API size_t vlc_lffifo_GetBytes(vlc_lffifo_t *) VLC_USED;
+
+VLC_USED static inline bool vlc_lffifo_IsEmpty(vlc_lffifo_t *fifo)
+{
+    return vlc_lffifo_GetCount(fifo) == 0;
+}
+
+/**
+ * Releases all available blocks.
+ */
+VLC_API void vlc_lffifo_Empty(vlc_lffifo_t *);
+
+/** @} */
+
 /** @} */
 
 #endif /* VLC_BLOCK_H */
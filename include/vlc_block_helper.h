@@ -439,89 +439,126 @@ static inline int block_PeekOffsetBytes( block_bytestream_t *p_bytestream,
 
 typedef const uint8_t * (*block_startcode_helper_t)( const uint8_t *, const uint8_t * );
 
+/**
+ * Compares a startcode with the bytestream data at the given offset of a
+ * block, continuing into the next blocks as needed.
+ *
+ * \return the startcode length if it matches, 0 if it does not, or -1 if
+ * all the available data matches the beginning of the startcode
+ */
+static inline int block_MatchStartcodeAt( const block_t *p_block, size_t i_offset,
+                                          const uint8_t *p_startcode,
+                                          int i_startcode_length )
+{
+    for( int i_match = 0; i_match < i_startcode_length; i_match++ )
+    {
+        while( i_offset >= p_block->i_buffer )
+        {
+            i_offset -= p_block->i_buffer;
+            p_block = p_block->p_next;
+            if( p_block == NULL )
+                return -1;
+        }
+
+        if( p_block->p_buffer[i_offset++] != p_startcode[i_match] )
+            return 0;
+    }
+    return i_startcode_length;
+}
+
+/**
+ * Looks for a startcode from the given offset of a bytestream.
+ *
+ * Each block is searched as a whole, with the optional helper when the
+ * startcode is 0x00 0x00 0x01, or memchr() otherwise. Only the last
+ * i_startcode_length - 1 offsets of a block, where the startcode may span
+ * over the next blocks, are compared one by one.
+ *
+ * On success, *pi_offset is the offset of the startcode. Otherwise it is
+ * the end of the data, minus the bytes matching the beginning of the
+ * startcode, so that the search can resume from there with more data.
+ */
 static inline int block_FindStartcodeFromOffset(
     block_bytestream_t *p_bytestream, size_t *pi_offset,
     const uint8_t *p_startcode, int i_startcode_length,
     block_startcode_helper_t p_startcode_helper )
 {
-    block_t *p_block, *p_block_backup = 0;
-    int i_size = 0;
-    size_t i_offset, i_offset_backup = 0;
-    int i_caller_offset_backup = 0, i_match;
+    block_t *p_block;
+    size_t i_size, i_base;
 
     /* Find the right place */
     i_size = *pi_offset + p_bytestream->i_offset;
     for( p_block = p_bytestream->p_block;
          p_block != NULL; p_block = p_block->p_next )
     {
+        if( i_size < p_block->i_buffer )
+            break;
         i_size -= p_block->i_buffer;
-        if( i_size < 0 ) break;
     }
 
-    if( unlikely( i_size >= 0 ) )
+    if( unlikely( p_block == NULL ) )
     {
         /* Not enough data, bail out */
         return VLC_EGENERIC;
     }
 
-    /* Begin the search.
-     * We first look for an occurrence of the 1st startcode byte and
-     * if found, we do a more thorough check. */
-    i_size += p_block->i_buffer;
-    *pi_offset -= i_size;
-    i_match = 0;
+    /* Caller offset of the start of the current block */
+    i_base = *pi_offset - i_size;
+
     for( ; p_block != NULL; p_block = p_block->p_next )
     {
-        for( i_offset = i_size; i_offset < p_block->i_buffer; i_offset++ )
+        const uint8_t *p_buffer = p_block->p_buffer;
+        const size_t i_buffer = p_block->i_buffer;
+
+        if( i_size + i_startcode_length <= i_buffer )
         {
-            /* Use optimized helper when possible */
-            if( p_startcode_helper && !i_match &&
-               (p_block->i_buffer - i_offset) > ((size_t)i_startcode_length - 1) )
+            const uint8_t *p_res = NULL;
+
+            if( p_startcode_helper )
+                p_res = p_startcode_helper( &p_buffer[i_size], &p_buffer[i_buffer] );
+            else
             {
-                const uint8_t *p_res = p_startcode_helper( &p_block->p_buffer[i_offset],
-                                                           &p_block->p_buffer[p_block->i_buffer] );
-                if( p_res )
+                const uint8_t *p_last = &p_buffer[i_buffer - i_startcode_length];
+
+                for( const uint8_t *p = &p_buffer[i_size]; p <= p_last; p++ )
                 {
-                    *pi_offset += i_offset + (p_res - &p_block->p_buffer[i_offset]);
-                    return VLC_SUCCESS;
+                    p = (const uint8_t *)memchr( p, p_startcode[0], p_last - p + 1 );
+                    if( p == NULL )
+                        break;
+                    if( !memcmp( p, p_startcode, i_startcode_length ) )
+                    {
+                        p_res = p;
+                        break;
+                    }
                 }
-                /* Then parsing boundary with legacy code */
-                i_offset = p_block->i_buffer - (i_startcode_length - 1);
             }
 
-            if( p_block->p_buffer[i_offset] == p_startcode[i_match] )
+            if( p_res )
             {
-                if( !i_match )
-                {
-                    p_block_backup = p_block;
-                    i_offset_backup = i_offset;
-                    i_caller_offset_backup = *pi_offset;
-                }
+                *pi_offset = i_base + (p_res - p_buffer);
+                return VLC_SUCCESS;
+            }
 
-                if( i_match + 1 == i_startcode_length )
-                {
-                    /* We have it */
-                    *pi_offset += i_offset - i_match;
-                    return VLC_SUCCESS;
-                }
+            /* Then only the offsets spanning over the block boundary */
+            i_size = i_buffer - (i_startcode_length - 1);
+        }
 
-                i_match++;
-            }
-            else if ( i_match )
+        for( ; i_size < i_buffer; i_size++ )
+        {
+            int i_match = block_MatchStartcodeAt( p_block, i_size, p_startcode,
+                                                  i_startcode_length );
+            if( i_match )
             {
-                /* False positive */
-                p_block = p_block_backup;
-                i_offset = i_offset_backup;
-                *pi_offset = i_caller_offset_backup;
-                i_match = 0;
+                *pi_offset = i_base + i_size;
+                return i_match > 0 ? VLC_SUCCESS : VLC_EGENERIC;
             }
-
         }
+
+        i_base += i_buffer;
         i_size = 0;
-        *pi_offset += i_offset;
     }
 
-    *pi_offset -= i_match;
+    *pi_offset = i_base;
     return VLC_EGENERIC;
 }
 
@@ -378,7 +378,8 @@ typedef enum input_item_meta_request_option_t
     META_REQUEST_OPTION_SCOPE_LOCAL   = 0x01,
     META_REQUEST_OPTION_SCOPE_NETWORK = 0x02,
     META_REQUEST_OPTION_SCOPE_ANY     = 0x03,
-    META_REQUEST_OPTION_DO_INTERACT   = 0x04
+    META_REQUEST_OPTION_DO_INTERACT   = 0x04,
+    META_REQUEST_OPTION_PRIORITY      = 0x08  /* visible or playing soon */
 } input_item_meta_request_option_t;
 
 /* status of the vlc_InputItemPreparseEnded event */
@@ -396,6 +397,9 @@ VLC_API int libvlc_MetadataRequest( libvlc_int_t *, input_item_t *,
 VLC_API int libvlc_ArtRequest(libvlc_int_t *, input_item_t *,
                               input_item_meta_request_option_t );
 VLC_API void libvlc_MetadataCancel( libvlc_int_t *, void * );
+VLC_API void libvlc_MetadataStats( libvlc_int_t *, uint64_t *parsed,
+                                   unsigned *parse_pending, uint64_t *fetched,
+                                   unsigned *fetch_pending );
 
 /******************
  * Input stats
@@ -0,0 +1,117 @@
+/*****************************************************************************
+ * vlc_seekindex.h: persistent seek index cache
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef VLC_SEEKINDEX_H
+#define VLC_SEEKINDEX_H 1
+
+/**
+ * \defgroup seekindex Seek index cache
+ * \ingroup input
+ * Persistent time to byte offset indexes
+ *
+ * Demuxers can store the seek points they found by scanning or bisecting a
+ * stream, and find them again the next time the same stream is opened.
+ *
+ * Indexes are stored in the user cache directory. They are keyed by the
+ * stream identity (size, modification time if known, and a digest of its
+ * first bytes), so that moved or renamed files keep their index, and by the
+ * demuxer name and index version, so that demuxers can change the meaning of
+ * the entries.
+ * @{
+ * \file
+ * Seek index cache interface
+ */
+
+/**
+ * Seek index entry.
+ *
+ * Except for the ordering, the meaning of the fields is defined by the
+ * demuxer.
+ */
+typedef struct
+{
+    int64_t  i_time;  /**< timestamp */
+    uint64_t i_pos;   /**< byte offset */
+    uint32_t i_track; /**< track identifier */
+    uint32_t i_flags; /**< flags */
+    uint32_t i_size;  /**< size of the data at i_pos, or 0 */
+} vlc_seekindex_entry_t;
+
+typedef struct vlc_seekindex_t vlc_seekindex_t;
+
+/**
+ * Opens the seek index of a stream.
+ *
+ * The stored index, if any, is loaded. The stream position is preserved.
+ *
+ * \param s stream to index (must be seekable and have a known size)
+ * \param name demuxer name
+ * \param version demuxer index version
+ * \return an index, possibly empty, or NULL if the stream cannot be indexed
+ * or if indexes are disabled.
+ */
+VLC_API vlc_seekindex_t *vlc_seekindex_New(vlc_object_t *, stream_t *s,
+                                           const char *name,
+                                           uint32_t version) VLC_USED;
+#define vlc_seekindex_New(o, s, n, v) \
+    vlc_seekindex_New(VLC_OBJECT(o), s, n, v)
+
+/**
+ * Stores the index if entries were added, and destroys it.
+ */
+VLC_API void vlc_seekindex_Delete(vlc_seekindex_t *);
+
+/**
+ * Stores the index now if entries were added.
+ */
+VLC_API int vlc_seekindex_Save(vlc_seekindex_t *);
+
+/**
+ * Adds an entry. Entries identical to an existing one are ignored.
+ */
+VLC_API int vlc_seekindex_Add(vlc_seekindex_t *,
+                              const vlc_seekindex_entry_t *);
+
+/**
+ * Gets all the entries of a track, sorted by time then offset.
+ *
+ * \param entries pointer to the first entry [OUT]
+ * \return the number of entries
+ * \note Entries are valid until the next call to vlc_seekindex_Add().
+ */
+VLC_API size_t vlc_seekindex_Get(vlc_seekindex_t *, uint32_t track,
+                                 const vlc_seekindex_entry_t **entries);
+
+/**
+ * Finds the entries of a track surrounding a time.
+ *
+ * \param lower last entry at or before the time, or NULL [OUT]
+ * \param upper first entry after the time, or NULL [OUT]
+ * \return true if any entry was found
+ * \note Entries are valid until the next call to vlc_seekindex_Add().
+ */
+VLC_API bool vlc_seekindex_Lookup(vlc_seekindex_t *, uint32_t track,
+                                  int64_t time,
+                                  const vlc_seekindex_entry_t **lower,
+                                  const vlc_seekindex_entry_t **upper);
+
+/** @} */
+
+#endif
@@ -779,6 +779,8 @@ static int media_parse(libvlc_media_t *media, bool b_async,
         if (parse_flag & libvlc_media_fetch_network)
             art_scope |= META_REQUEST_OPTION_SCOPE_NETWORK;
         if (art_scope != META_REQUEST_OPTION_NONE) {
+            if (parse_flag & libvlc_media_parse_priority)
+                art_scope |= META_REQUEST_OPTION_PRIORITY;
             ret = libvlc_ArtRequest(libvlc, item, art_scope);
             if (ret != VLC_SUCCESS)
                 return ret;
@@ -788,6 +790,8 @@ static int media_parse(libvlc_media_t *media, bool b_async,
             parse_scope |= META_REQUEST_OPTION_SCOPE_NETWORK;
         if (parse_flag & libvlc_media_do_interact)
             parse_scope |= META_REQUEST_OPTION_DO_INTERACT;
+        if (parse_flag & libvlc_media_parse_priority)
+            parse_scope |= META_REQUEST_OPTION_PRIORITY;
         ret = libvlc_MetadataRequest(libvlc, item, parse_scope, timeout, media);
         if (ret != VLC_SUCCESS)
             return ret;
@@ -840,6 +844,18 @@ libvlc_media_parse_stop( libvlc_media_t *media )
     libvlc_MetadataCancel( media->p_libvlc_instance->p_libvlc_int, media );
 }
 
+/**************************************************************************
+ * Get the parsing statistics of a libvlc instance.
+ **************************************************************************/
+void
+libvlc_media_parse_get_stats( libvlc_instance_t *p_instance,
+                              libvlc_media_parse_stats_t *p_stats )
+{
+    libvlc_MetadataStats( p_instance->p_libvlc_int,
+                          &p_stats->i_parsed, &p_stats->i_parse_pending,
+                          &p_stats->i_fetched, &p_stats->i_fetch_pending );
+}
+
 /**************************************************************************
  * Get parsed status for media object.
  **************************************************************************/
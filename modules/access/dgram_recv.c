@@ -0,0 +1,352 @@
+/*****************************************************************************
+ * dgram_recv.c: batched datagram receiver
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vlc_common.h>
+#include <vlc_block.h>
+#include <vlc_atomic.h>
+#include <vlc_network.h>
+#ifdef HAVE_POLL
+# include <poll.h>
+#endif
+
+#include "dgram_recv.h"
+
+#define DGRAM_RECV_BATCH 64
+#define DGRAM_ALIGN      32
+
+typedef struct
+{
+    block_t       self;
+    dgram_recv_t *owner;
+} dgram_block_t;
+
+struct dgram_recv_t
+{
+    int            fd;
+    unsigned       count;
+    size_t         mru;
+    size_t         stride;
+    atomic_uint    refs; /* receiver + blocks in use */
+
+    vlc_mutex_t    lock;
+    dgram_block_t **free_blocks; /* LIFO of available blocks */
+    unsigned       free_count;
+    dgram_block_t *blocks;
+    uint8_t       *buffers;
+
+    uint32_t       kernel_drops; /* last SO_RXQ_OVFL value */
+    bool           discontinuity;
+    dgram_recv_stats_t stats;
+};
+
+static void dgram_recv_Unref(dgram_recv_t *rcv)
+{
+    if (atomic_fetch_sub(&rcv->refs, 1) != 1)
+        return;
+
+    vlc_mutex_destroy(&rcv->lock);
+    vlc_free(rcv->buffers);
+    free(rcv->blocks);
+    free(rcv->free_blocks);
+    free(rcv);
+}
+
+static void dgram_block_Release(block_t *block)
+{
+    dgram_block_t *db = (dgram_block_t *)block;
+    dgram_recv_t *rcv = db->owner;
+
+    vlc_mutex_lock(&rcv->lock);
+    assert(rcv->free_count < rcv->count);
+    rcv->free_blocks[rcv->free_count++] = db;
+    vlc_mutex_unlock(&rcv->lock);
+
+    dgram_recv_Unref(rcv);
+}
+
+static block_t *dgram_recv_GetBlock(dgram_recv_t *rcv)
+{
+    dgram_block_t *db = NULL;
+
+    vlc_mutex_lock(&rcv->lock);
+    if (likely(rcv->free_count > 0))
+        db = rcv->free_blocks[--rcv->free_count];
+    vlc_mutex_unlock(&rcv->lock);
+
+    if (unlikely(db == NULL))
+        return NULL;
+
+    atomic_fetch_add(&rcv->refs, 1);
+    block_Init(&db->self, rcv->buffers + (db - rcv->blocks) * rcv->stride,
+               rcv->mru);
+    db->self.pf_release = dgram_block_Release;
+    return &db->self;
+}
+
+dgram_recv_t *dgram_recv_New(int fd, unsigned count, size_t mru)
+{
+    dgram_recv_t *rcv = malloc(sizeof (*rcv));
+    if (unlikely(rcv == NULL))
+        return NULL;
+
+    rcv->fd = fd;
+    rcv->count = count;
+    rcv->mru = mru;
+    rcv->stride = (mru + DGRAM_ALIGN - 1) & ~(DGRAM_ALIGN - 1);
+    rcv->free_blocks = calloc(count, sizeof (*rcv->free_blocks));
+    rcv->blocks = calloc(count, sizeof (*rcv->blocks));
+    rcv->buffers = vlc_memalign(DGRAM_ALIGN, count * rcv->stride);
+    if (unlikely(rcv->free_blocks == NULL || rcv->blocks == NULL
+              || rcv->buffers == NULL))
+    {
+        vlc_free(rcv->buffers);
+        free(rcv->blocks);
+        free(rcv->free_blocks);
+        free(rcv);
+        return NULL;
+    }
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        rcv->blocks[i].owner = rcv;
+        rcv->free_blocks[i] = &rcv->blocks[i];
+    }
+    rcv->free_count = count;
+    atomic_init(&rcv->refs, 1);
+    vlc_mutex_init(&rcv->lock);
+    rcv->kernel_drops = 0;
+    rcv->discontinuity = false;
+    memset(&rcv->stats, 0, sizeof (rcv->stats));
+
+#ifdef SO_RXQ_OVFL
+    /* Ask the kernel to report socket buffer overflows */
+    setsockopt(fd, SOL_SOCKET, SO_RXQ_OVFL, &(int){ 1 }, sizeof (int));
+#endif
+    return rcv;
+}
+
+void dgram_recv_Delete(dgram_recv_t *rcv)
+{
+    dgram_recv_Unref(rcv);
+}
+
+size_t dgram_recv_GetMRU(const dgram_recv_t *rcv)
+{
+    return rcv->mru;
+}
+
+void dgram_recv_GetStats(const dgram_recv_t *rcv, dgram_recv_stats_t *stats)
+{
+    *stats = rcv->stats;
+}
+
+#ifdef SO_RXQ_OVFL
+static void dgram_recv_CheckDrops(dgram_recv_t *rcv, struct msghdr *msg)
+{
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(msg);
+         cmsg != NULL;
+         cmsg = CMSG_NXTHDR(msg, cmsg))
+    {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SO_RXQ_OVFL)
+            continue;
+
+        uint32_t drops;
+        memcpy(&drops, CMSG_DATA(cmsg), sizeof (drops));
+        if (drops != rcv->kernel_drops)
+        {
+            rcv->stats.dropped += (uint32_t)(drops - rcv->kernel_drops);
+            rcv->kernel_drops = drops;
+            rcv->discontinuity = true;
+        }
+    }
+}
+
+# define DGRAM_CONTROL_SIZE CMSG_SPACE(sizeof (uint32_t))
+#else
+# define DGRAM_CONTROL_SIZE 0
+#endif
+
+static void dgram_recv_Fill(dgram_recv_t *rcv, block_t *block,
+                            size_t len, bool truncated, size_t *needed)
+{
+    if (truncated || len > rcv->mru)
+    {   /* Without the real length, try with twice the size */
+        const size_t want = (len > rcv->mru) ? len : 2 * rcv->mru;
+
+        block->i_flags |= BLOCK_FLAG_CORRUPTED;
+        block->i_buffer = rcv->mru;
+        rcv->stats.truncated++;
+        if (want > *needed)
+            *needed = want;
+    }
+    else
+        block->i_buffer = len;
+
+    if (rcv->discontinuity)
+    {
+        block->i_flags |= BLOCK_FLAG_DISCONTINUITY;
+        rcv->discontinuity = false;
+    }
+}
+
+ssize_t dgram_recv_Receive(dgram_recv_t *rcv, block_t **blocks, unsigned max,
+                           size_t *needed)
+{
+    *needed = 0;
+
+#ifdef HAVE_RECVMMSG
+    struct mmsghdr msgs[DGRAM_RECV_BATCH];
+    struct iovec iovecs[DGRAM_RECV_BATCH];
+    union
+    {
+        char buf[DGRAM_CONTROL_SIZE ? DGRAM_CONTROL_SIZE : 1];
+        struct cmsghdr align;
+    } control[DGRAM_RECV_BATCH];
+
+    if (max > DGRAM_RECV_BATCH)
+        max = DGRAM_RECV_BATCH;
+
+    bool overrun = false;
+
+    for (unsigned i = 0; i < max; i++)
+    {
+        blocks[i] = dgram_recv_GetBlock(rcv);
+        if (unlikely(blocks[i] == NULL))
+        {
+            if (i == 0)
+            {   /* Blocks are held downstream, do not drop datagrams for that */
+                blocks[0] = block_Alloc(rcv->mru);
+                overrun = true;
+            }
+            if (blocks[i] == NULL)
+            {
+                max = i;
+                break;
+            }
+            max = 1;
+        }
+        iovecs[i].iov_base = blocks[i]->p_buffer;
+        iovecs[i].iov_len = rcv->mru;
+        memset(&msgs[i], 0, sizeof (msgs[i]));
+        msgs[i].msg_hdr.msg_iov = &iovecs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_hdr.msg_control = DGRAM_CONTROL_SIZE ? control[i].buf : NULL;
+        msgs[i].msg_hdr.msg_controllen = DGRAM_CONTROL_SIZE;
+    }
+    if (unlikely(max == 0))
+    {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    /* MSG_TRUNC reports the real length of oversized datagrams */
+    int n = recvmmsg(rcv->fd, msgs, max, MSG_DONTWAIT | MSG_TRUNC, NULL);
+    rcv->stats.calls++;
+
+    for (unsigned i = (n > 0) ? n : 0; i < max; i++)
+        block_Release(blocks[i]);
+    if (n <= 0)
+        return -1;
+    if (overrun)
+        rcv->stats.overruns++;
+
+    for (int i = 0; i < n; i++)
+    {
+# ifdef SO_RXQ_OVFL
+        dgram_recv_CheckDrops(rcv, &msgs[i].msg_hdr);
+# endif
+        dgram_recv_Fill(rcv, blocks[i], msgs[i].msg_len,
+                        msgs[i].msg_hdr.msg_flags & MSG_TRUNC, needed);
+    }
+#else
+    if (unlikely(max == 0))
+        return 0;
+
+# ifndef MSG_DONTWAIT
+    /* Do not block if there is nothing (left) to receive */
+    struct pollfd ufd = { .fd = rcv->fd, .events = POLLIN };
+    if (poll(&ufd, 1, 0) <= 0)
+    {
+        errno = EAGAIN;
+        return -1;
+    }
+#  define MSG_DONTWAIT 0
+# endif
+
+    bool overrun = false;
+    block_t *block = dgram_recv_GetBlock(rcv);
+    if (unlikely(block == NULL))
+    {   /* Blocks are held downstream, do not drop datagrams for that */
+        block = block_Alloc(rcv->mru);
+        if (unlikely(block == NULL))
+        {
+            errno = ENOMEM;
+            return -1;
+        }
+        overrun = true;
+    }
+
+    struct iovec iov = {
+        .iov_base = block->p_buffer,
+        .iov_len = rcv->mru,
+    };
+    struct msghdr msg = {
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+    };
+
+    ssize_t len = recvmsg(rcv->fd, &msg, MSG_DONTWAIT);
+    bool truncated = false;
+
+    rcv->stats.calls++;
+    if (len < 0 && errno == EMSGSIZE)
+    {   /* Some systems fail instead of flagging truncated datagrams */
+        len = rcv->mru;
+        truncated = true;
+    }
+    if (len < 0)
+    {
+        block_Release(block);
+        return -1;
+    }
+# ifdef MSG_TRUNC
+    if (msg.msg_flags & MSG_TRUNC)
+        truncated = true;
+# endif
+
+    if (overrun)
+        rcv->stats.overruns++;
+    dgram_recv_Fill(rcv, block, len, truncated, needed);
+    blocks[0] = block;
+    const int n = 1;
+#endif
+
+    rcv->stats.datagrams += n;
+    return n;
+}
@@ -0,0 +1,76 @@
+/*****************************************************************************
+ * dgram_recv.h: batched datagram receiver
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef VLC_ACCESS_DGRAM_RECV_H
+#define VLC_ACCESS_DGRAM_RECV_H 1
+
+/**
+ * \file
+ * Receives several datagrams per system call (with recvmmsg() where
+ * available) into blocks taken from a preallocated ring.
+ *
+ * Blocks go back to the ring when released. If the ring is exhausted,
+ * blocks are allocated from the heap instead. The ring memory is freed
+ * once the receiver is deleted and all its blocks are released, so blocks
+ * can safely outlive the module that received them.
+ */
+
+typedef struct dgram_recv_t dgram_recv_t;
+
+typedef struct
+{
+    uint64_t datagrams; /**< received datagrams */
+    uint64_t calls;     /**< receive system calls */
+    uint64_t dropped;   /**< datagrams dropped by the kernel (Linux only) */
+    uint64_t overruns;  /**< heap allocations due to an exhausted ring */
+    uint64_t truncated; /**< datagrams larger than the MRU */
+} dgram_recv_stats_t;
+
+/**
+ * Creates a receiver.
+ * \param fd datagram socket to receive from
+ * \param count number of preallocated blocks
+ * \param mru maximum receive unit (size of each block)
+ */
+dgram_recv_t *dgram_recv_New(int fd, unsigned count, size_t mru);
+
+/**
+ * Deletes a receiver. Blocks still in use remain valid.
+ */
+void dgram_recv_Delete(dgram_recv_t *);
+
+/**
+ * Receives all pending datagrams, up to max, without blocking.
+ *
+ * Datagrams larger than the MRU are truncated and flagged with
+ * BLOCK_FLAG_CORRUPTED. Blocks following a kernel drop are flagged with
+ * BLOCK_FLAG_DISCONTINUITY.
+ *
+ * \param blocks array to store the received blocks into [OUT]
+ * \param needed MRU large enough for the truncated datagrams, or 0 [OUT]
+ * \return the number of blocks, or -1 on error (see errno)
+ */
+ssize_t dgram_recv_Receive(dgram_recv_t *, block_t **blocks, unsigned max,
+                           size_t *needed);
+
+size_t dgram_recv_GetMRU(const dgram_recv_t *);
+void dgram_recv_GetStats(const dgram_recv_t *, dgram_recv_stats_t *);
+
+#endif
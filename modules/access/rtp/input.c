@@ -37,11 +37,45 @@
 #endif
 
 #include "rtp.h"
+#include "../dgram_recv.h"
 #ifdef HAVE_SRTP
 # include <srtp.h>
 #endif
 
 #define DEFAULT_MRU (1500u - (20 + 8))
+#define RTP_RING_SIZE  256 /* preallocated packets */
+#define RTP_BATCH_SIZE 32  /* maximum packets per receive call */
+
+/**
+ * Allocates the receive ring of the RTP datagram socket.
+ */
+int rtp_dgram_init (demux_t *demux)
+{
+    demux_sys_t *sys = demux->p_sys;
+
+    sys->rcv = dgram_recv_New (sys->fd, RTP_RING_SIZE, DEFAULT_MRU);
+    return (sys->rcv != NULL) ? VLC_SUCCESS : VLC_ENOMEM;
+}
+
+/**
+ * Releases the receive ring of the RTP datagram socket.
+ */
+void rtp_dgram_deinit (demux_t *demux)
+{
+    demux_sys_t *sys = demux->p_sys;
+    dgram_recv_stats_t stats;
+
+    if (sys->rcv == NULL)
+        return;
+
+    dgram_recv_GetStats (sys->rcv, &stats);
+    msg_Dbg (demux, "received %"PRIu64" packets in %"PRIu64" calls, "
+             "%"PRIu64" dropped, %"PRIu64" overruns, %"PRIu64" truncated",
+             stats.datagrams, stats.calls, stats.dropped, stats.overruns,
+             stats.truncated);
+    dgram_recv_Delete (sys->rcv);
+    sys->rcv = NULL;
+}
 
 /**
  * Processes a packet received from the RTP socket.
@@ -106,15 +140,6 @@ void *rtp_dgram_thread (void *opaque)
     demux_sys_t *sys = demux->p_sys;
     mtime_t deadline = VLC_TS_INVALID;
     int rtp_fd = sys->fd;
-    struct iovec iov =
-    {
-        .iov_len = DEFAULT_MRU,
-    };
-    struct msghdr msg =
-    {
-        .msg_iov = &iov,
-        .msg_iovlen = 1,
-    };
 
     struct pollfd ufd[1];
     ufd[0].fd = rtp_fd;
@@ -136,45 +161,35 @@ void *rtp_dgram_thread (void *opaque)
             if (unlikely(ufd[0].revents & POLLHUP))
                 break; /* RTP socket dead (DCCP only) */
 
-            block_t *block = block_Alloc (iov.iov_len);
-            if (unlikely(block == NULL))
+            block_t *blocks[RTP_BATCH_SIZE];
+            size_t needed;
+            ssize_t count = dgram_recv_Receive (sys->rcv, blocks,
+                                                RTP_BATCH_SIZE, &needed);
+            if (count == -1)
             {
-                if (iov.iov_len == DEFAULT_MRU)
+                if (errno == ENOMEM)
                     break; /* we are totallly screwed */
-                iov.iov_len = DEFAULT_MRU;
-                continue; /* retry with shrunk MRU */
+                if (errno != EAGAIN)
+                    msg_Warn (demux, "RTP network error: %s",
+                              vlc_strerror_c(errno));
             }
 
-            iov.iov_base = block->p_buffer;
-#ifdef __linux__
-            msg.msg_flags = MSG_TRUNC;
-#else
-            msg.msg_flags = 0;
-#endif
-
-            ssize_t len = recvmsg (rtp_fd, &msg, 0);
-            if (len != -1)
+            if (unlikely(needed > 0))
             {
-#ifdef MSG_TRUNC
-                if (msg.msg_flags & MSG_TRUNC)
+                msg_Err (demux, "%zu bytes packet truncated (MRU was %zu)",
+                         needed, dgram_recv_GetMRU (sys->rcv));
+
+                dgram_recv_t *rcv = dgram_recv_New (rtp_fd, RTP_RING_SIZE,
+                                                    needed);
+                if (rcv != NULL)
                 {
-                    msg_Err(demux, "%zd bytes packet truncated (MRU was %zu)",
-                            len, iov.iov_len);
-                    block->i_flags |= BLOCK_FLAG_CORRUPTED;
-                    iov.iov_len = len;
+                    dgram_recv_Delete (sys->rcv);
+                    sys->rcv = rcv;
                 }
-                else
-#endif
-                    block->i_buffer = len;
-
-                rtp_process (demux, block);
-            }
-            else
-            {
-                msg_Warn (demux, "RTP network error: %s",
-                          vlc_strerror_c(errno));
-                block_Release (block);
             }
+
+            for (ssize_t i = 0; i < count; i++)
+                rtp_process (demux, blocks[i]);
         }
 
     dequeue:
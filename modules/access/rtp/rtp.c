@@ -259,6 +259,7 @@ static int Open (vlc_object_t *obj)
 #endif
     p_sys->fd           = fd;
     p_sys->rtcp_fd      = rtcp_fd;
+    p_sys->rcv          = NULL;
     p_sys->max_src      = var_CreateGetInteger (obj, "rtp-max-src");
     p_sys->timeout      = var_CreateGetInteger (obj, "rtp-timeout")
                         * CLOCK_FREQ;
@@ -301,6 +302,9 @@ static int Open (vlc_object_t *obj)
     }
 #endif
 
+    if (tp != IPPROTO_TCP && rtp_dgram_init (demux))
+        goto error;
+
     if (vlc_clone (&p_sys->thread,
                    (tp != IPPROTO_TCP) ? rtp_dgram_thread : rtp_stream_thread,
                    demux, VLC_THREAD_PRIORITY_INPUT))
@@ -327,6 +331,7 @@ static void Close (vlc_object_t *obj)
         vlc_cancel (p_sys->thread);
         vlc_join (p_sys->thread, NULL);
     }
+    rtp_dgram_deinit (demux);
 
 #ifdef HAVE_SRTP
     if (p_sys->srtp)
@@ -57,6 +57,8 @@ bool rtp_dequeue (demux_t *, const rtp_session_t *, mtime_t *);
 void rtp_dequeue_force (demux_t *, const rtp_session_t *);
 int rtp_add_type (demux_t *demux, rtp_session_t *ses, const rtp_pt_t *pt);
 
+int rtp_dgram_init (demux_t *demux);
+void rtp_dgram_deinit (demux_t *demux);
 void *rtp_dgram_thread (void *data);
 void *rtp_stream_thread (void *data);
 
@@ -71,6 +73,7 @@ struct demux_sys_t
     int           fd;
     int           rtcp_fd;
     vlc_thread_t  thread;
+    struct dgram_recv_t *rcv; /**< Datagrams receive ring */
 
     mtime_t       timeout;
     uint16_t      max_dropout; /**< Max packet forward misordering */
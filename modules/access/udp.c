@@ -47,6 +47,11 @@
 # include <poll.h>
 #endif
 
+#include "dgram_recv.h"
+
+#define UDP_RING_SIZE  256 /* preallocated packets */
+#define UDP_BATCH_SIZE 32  /* maximum packets per receive call */
+
 /*****************************************************************************
  * Module descriptor
  *****************************************************************************/
@@ -77,7 +82,12 @@ struct access_sys_t
 {
     int fd;
     int timeout;
-    size_t mtu;
+    dgram_recv_t *rcv;
+
+    /* packets received but not returned yet */
+    block_t *pending[UDP_BATCH_SIZE];
+    unsigned pending_pos;
+    unsigned pending_count;
 };
 
 /*****************************************************************************
@@ -167,7 +177,14 @@ error:
         return VLC_EGENERIC;
     }
 
-    sys->mtu = 7 * 188;
+    sys->rcv = dgram_recv_New( sys->fd, UDP_RING_SIZE, 7 * 188 );
+    if( unlikely(sys->rcv == NULL) )
+    {
+        net_Close( sys->fd );
+        free( sys );
+        return VLC_ENOMEM;
+    }
+    sys->pending_pos = sys->pending_count = 0;
 
     sys->timeout = var_InheritInteger( p_access, "udp-timeout");
     if( sys->timeout > 0)
@@ -183,6 +200,17 @@ static void Close( vlc_object_t *p_this )
 {
     access_t     *p_access = (access_t*)p_this;
     access_sys_t *sys = p_access->p_sys;
+    dgram_recv_stats_t stats;
+
+    while( sys->pending_pos < sys->pending_count )
+        block_Release( sys->pending[sys->pending_pos++] );
+
+    dgram_recv_GetStats( sys->rcv, &stats );
+    msg_Dbg( p_access, "received %"PRIu64" packets in %"PRIu64" calls, "
+             "%"PRIu64" dropped, %"PRIu64" overruns, %"PRIu64" truncated",
+             stats.datagrams, stats.calls, stats.dropped, stats.overruns,
+             stats.truncated );
+    dgram_recv_Delete( sys->rcv );
 
     net_Close( sys->fd );
     free( sys );
@@ -225,25 +253,8 @@ static block_t *BlockUDP(access_t *access, bool *restrict eof)
 {
     access_sys_t *sys = access->p_sys;
 
-    block_t *pkt = block_Alloc(sys->mtu);
-    if (unlikely(pkt == NULL))
-    {   /* OOM - dequeue and discard one packet */
-        char dummy;
-        recv(sys->fd, &dummy, 1, 0);
-        return NULL;
-    }
-
-    struct iovec iov = {
-        .iov_base = pkt->p_buffer,
-        .iov_len = sys->mtu,
-    };
-    struct msghdr msg = {
-        .msg_iov = &iov,
-        .msg_iovlen = 1,
-#ifdef __linux__
-        .msg_flags = MSG_TRUNC,
-#endif
-    };
+    if (sys->pending_pos < sys->pending_count)
+        return sys->pending[sys->pending_pos++];
 
     struct pollfd ufd[1];
 
@@ -257,28 +268,38 @@ static block_t *BlockUDP(access_t *access, bool *restrict eof)
             *eof = true;
             /* fall through */
         case -1:
-            goto skip;
+            return NULL;
      }
 
-    ssize_t len = recvmsg(sys->fd, &msg, 0);
-    if (len < 0)
+    size_t needed;
+    ssize_t count = dgram_recv_Receive(sys->rcv, sys->pending,
+                                       UDP_BATCH_SIZE, &needed);
+    if (count <= 0)
     {
-skip:
-        block_Release(pkt);
+        if (count < 0 && errno == ENOMEM)
+        {   /* OOM - dequeue and discard one packet */
+            char dummy;
+            recv(sys->fd, &dummy, 1, 0);
+        }
         return NULL;
     }
 
-#ifdef MSG_TRUNC
-    if (msg.msg_flags & MSG_TRUNC)
+    if (unlikely(needed > 0))
     {
-        msg_Err(access, "%zd bytes packet truncated (MTU was %zu)",
-                len, sys->mtu);
-        pkt->i_flags |= BLOCK_FLAG_CORRUPTED;
-        sys->mtu = len;
+        size_t mtu = dgram_recv_GetMRU(sys->rcv);
+        msg_Err(access, "%zu bytes packet truncated (MTU was %zu)",
+                needed, mtu);
+
+        /* Blocks from the previous ring remain valid until released */
+        dgram_recv_t *rcv = dgram_recv_New(sys->fd, UDP_RING_SIZE, needed);
+        if (rcv != NULL)
+        {
+            dgram_recv_Delete(sys->rcv);
+            sys->rcv = rcv;
+        }
     }
-    else
-#endif
-        pkt->i_buffer = len;
 
-    return pkt;
+    sys->pending_count = count;
+    sys->pending_pos = 1;
+    return sys->pending[0];
 }
@@ -45,11 +45,15 @@
 #   include <ws2tcpip.h>
 #else
 #   include <sys/socket.h>
+#   include <sys/uio.h>
+#   include <netinet/in.h>
+#   include <netinet/udp.h>
 #endif
 
 #include <vlc_network.h>
 
 #define MAX_EMPTY_BLOCKS 200
+#define MAX_BATCH_PACKETS 64 /* also the kernel limit of UDP GSO segments */
 
 /*****************************************************************************
  * Module descriptor
@@ -70,6 +74,12 @@ static void Close( vlc_object_t * );
                           "of packets that will be sent at a time. It " \
                           "helps reducing the scheduling load on " \
                           "heavily-loaded systems." )
+#define BATCH_TEXT N_("Batch packets")
+#define BATCH_LONGTEXT N_("Maximum number of packets, already due for " \
+                          "sending, that are passed to the kernel with a " \
+                          "single system call (using UDP segmentation " \
+                          "offload when available). This is most useful " \
+                          "with packets grouping." )
 
 vlc_module_begin ()
     set_description( N_("UDP stream output") )
@@ -79,6 +89,8 @@ vlc_module_begin ()
     add_integer( SOUT_CFG_PREFIX "caching", DEFAULT_PTS_DELAY / 1000, CACHING_TEXT, CACHING_LONGTEXT, true )
     add_integer( SOUT_CFG_PREFIX "group", 1, GROUP_TEXT, GROUP_LONGTEXT,
                                  true )
+    add_integer_with_range( SOUT_CFG_PREFIX "batch", 1, 1, MAX_BATCH_PACKETS,
+                            BATCH_TEXT, BATCH_LONGTEXT, true )
 
     set_capability( "sout access", 0 )
     add_shortcut( "udp" )
@@ -92,6 +104,7 @@ vlc_module_end ()
 static const char *const ppsz_sout_options[] = {
     "caching",
     "group",
+    "batch",
     NULL
 };
 
@@ -117,13 +130,32 @@ struct sout_access_out_sys_t
     bool          b_mtu_warning;
     size_t        i_mtu;
 
-    block_fifo_t *p_fifo;
-    block_fifo_t *p_empty_blocks;
+    vlc_lffifo_t *p_fifo;
+    vlc_lffifo_t *p_empty_blocks;
     block_t      *p_buffer;
 
     vlc_thread_t  thread;
+
+    /* Batched sending, owned by the writer thread */
+    unsigned      i_batch;
+    bool          b_gso;
+    struct
+    {
+        uint64_t  i_packets;
+        uint64_t  i_syscalls;
+        uint64_t  i_late_packets;
+        mtime_t   i_late_total;
+        mtime_t   i_late_max;
+    } stats;
 };
 
+typedef struct
+{
+    block_t      *p_blocks[MAX_BATCH_PACKETS];
+    unsigned      i_count;
+    block_t      *p_next; /* packet to batch once the due ones are sent */
+} udp_batch_t;
+
 #define DEFAULT_PORT 1234
 
 /*****************************************************************************
@@ -210,16 +242,35 @@ static int Open( vlc_object_t *p_this )
     p_sys->i_handle = i_handle;
     p_sys->i_mtu = var_CreateGetInteger( p_this, "mtu" );
     p_sys->b_mtu_warning = false;
-    p_sys->p_fifo = block_FifoNew();
-    p_sys->p_empty_blocks = block_FifoNew();
+    p_sys->p_fifo = vlc_lffifo_New();
+    p_sys->p_empty_blocks = vlc_lffifo_New();
+    if( unlikely(p_sys->p_fifo == NULL || p_sys->p_empty_blocks == NULL) )
+    {
+        if( p_sys->p_fifo != NULL )
+            vlc_lffifo_Release( p_sys->p_fifo );
+        if( p_sys->p_empty_blocks != NULL )
+            vlc_lffifo_Release( p_sys->p_empty_blocks );
+        net_Close (i_handle);
+        free (p_sys);
+        return VLC_ENOMEM;
+    }
     p_sys->p_buffer = NULL;
+    p_sys->i_batch = var_GetInteger( p_access, SOUT_CFG_PREFIX "batch" );
+    if( p_sys->i_batch < 1 || p_sys->i_batch > MAX_BATCH_PACKETS )
+        p_sys->i_batch = 1;
+#if defined(UDP_SEGMENT) && defined(SOL_UDP)
+    p_sys->b_gso = true;
+#else
+    p_sys->b_gso = false;
+#endif
+    memset( &p_sys->stats, 0, sizeof(p_sys->stats) );
 
     if( vlc_clone( &p_sys->thread, ThreadWrite, p_access,
                            VLC_THREAD_PRIORITY_HIGHEST ) )
     {
         msg_Err( p_access, "cannot spawn sout access thread" );
-        block_FifoRelease( p_sys->p_fifo );
-        block_FifoRelease( p_sys->p_empty_blocks );
+        vlc_lffifo_Release( p_sys->p_fifo );
+        vlc_lffifo_Release( p_sys->p_empty_blocks );
         net_Close (i_handle);
         free (p_sys);
         return VLC_EGENERIC;
@@ -242,8 +293,20 @@ static void Close( vlc_object_t * p_this )
 
     vlc_cancel( p_sys->thread );
     vlc_join( p_sys->thread, NULL );
-    block_FifoRelease( p_sys->p_fifo );
-    block_FifoRelease( p_sys->p_empty_blocks );
+
+    if( p_sys->stats.i_syscalls )
+        msg_Dbg( p_access, "sent %"PRIu64" packets in %"PRIu64" calls "
+                 "(%.2f per call), %"PRIu64" late (average %"PRId64
+                 " us, max %"PRId64" us)",
+                 p_sys->stats.i_packets, p_sys->stats.i_syscalls,
+                 (double)p_sys->stats.i_packets / p_sys->stats.i_syscalls,
+                 p_sys->stats.i_late_packets,
+                 p_sys->stats.i_late_packets ?
+                    p_sys->stats.i_late_total / (mtime_t)p_sys->stats.i_late_packets : 0,
+                 p_sys->stats.i_late_max );
+
+    vlc_lffifo_Release( p_sys->p_fifo );
+    vlc_lffifo_Release( p_sys->p_empty_blocks );
 
     if( p_sys->p_buffer ) block_Release( p_sys->p_buffer );
 
@@ -298,7 +361,7 @@ static ssize_t Write( sout_access_out_t *p_access, block_t *p_buffer )
                          now - p_sys->p_buffer->i_dts
                           - p_sys->i_caching );
             }
-            block_FifoPut( p_sys->p_fifo, p_sys->p_buffer );
+            vlc_lffifo_Queue( p_sys->p_fifo, p_sys->p_buffer );
             p_sys->p_buffer = NULL;
         }
 
@@ -338,7 +401,7 @@ static ssize_t Write( sout_access_out_t *p_access, block_t *p_buffer )
                              mdate() - p_sys->p_buffer->i_dts
                               - p_sys->i_caching );
                 }
-                block_FifoPut( p_sys->p_fifo, p_sys->p_buffer );
+                vlc_lffifo_Queue( p_sys->p_fifo, p_sys->p_buffer );
                 p_sys->p_buffer = NULL;
             }
         }
@@ -369,22 +432,26 @@ static block_t *NewUDPPacket( sout_access_out_t *p_access, mtime_t i_dts)
     sout_access_out_sys_t *p_sys = p_access->p_sys;
     block_t *p_buffer;
 
-    while ( block_FifoCount( p_sys->p_empty_blocks ) > MAX_EMPTY_BLOCKS )
+    while ( vlc_lffifo_GetCount( p_sys->p_empty_blocks ) > MAX_EMPTY_BLOCKS )
     {
-        p_buffer = block_FifoGet( p_sys->p_empty_blocks );
+        p_buffer = vlc_lffifo_Dequeue( p_sys->p_empty_blocks );
+        if( p_buffer == NULL )
+            break;
         block_Release( p_buffer );
     }
 
-    if( block_FifoCount( p_sys->p_empty_blocks ) == 0 )
+    p_buffer = vlc_lffifo_Dequeue( p_sys->p_empty_blocks );
+    if( p_buffer == NULL )
     {
         p_buffer = block_Alloc( p_sys->i_mtu );
     }
     else
     {
-        p_buffer = block_FifoGet(p_sys->p_empty_blocks );
         p_buffer->i_flags = 0;
         p_buffer = block_Realloc( p_buffer, 0, p_sys->i_mtu );
     }
+    if( unlikely(p_buffer == NULL) )
+        return NULL;
 
     p_buffer->i_dts = i_dts;
     p_buffer->i_buffer = 0;
@@ -393,11 +460,163 @@ static block_t *NewUDPPacket( sout_access_out_t *p_access, mtime_t i_dts)
 }
 
 /*****************************************************************************
- * ThreadWrite: Write a packet on the network at the good time.
+ * SendBatch: send all the batched packets, with as few calls as possible
  *****************************************************************************/
-static void* ThreadWrite( void *data )
+#if defined(UDP_SEGMENT) && defined(SOL_UDP)
+static int SendSegmented( sout_access_out_t *p_access, udp_batch_t *p_batch )
+{
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+    struct iovec iov[MAX_BATCH_PACKETS];
+    const size_t i_segment = p_batch->p_blocks[0]->i_buffer;
+    size_t i_total = 0;
+
+    /* All segments but the last one must have the same size */
+    for( unsigned i = 0; i < p_batch->i_count; i++ )
+    {
+        const block_t *p_pk = p_batch->p_blocks[i];
+        if( p_pk->i_buffer > i_segment ||
+           (p_pk->i_buffer < i_segment && i + 1 < p_batch->i_count) )
+            return VLC_EGENERIC;
+        iov[i].iov_base = p_pk->p_buffer;
+        iov[i].iov_len = p_pk->i_buffer;
+        i_total += p_pk->i_buffer;
+    }
+    if( i_segment == 0 || i_total > UINT16_MAX - 8 - 40 /* UDP + IPv6 headers */ )
+        return VLC_EGENERIC;
+
+    union
+    {
+        char buf[CMSG_SPACE(sizeof(uint16_t))];
+        struct cmsghdr align;
+    } control;
+    struct msghdr msg = {
+        .msg_iov = iov,
+        .msg_iovlen = p_batch->i_count,
+        .msg_control = control.buf,
+        .msg_controllen = sizeof(control.buf),
+    };
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_UDP;
+    cmsg->cmsg_type = UDP_SEGMENT;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+    uint16_t i_gso_size = i_segment;
+    memcpy( CMSG_DATA(cmsg), &i_gso_size, sizeof(i_gso_size) );
+
+    if( sendmsg( p_sys->i_handle, &msg, 0 ) == -1 )
+    {
+        if( errno == EIO || errno == EINVAL || errno == ENOPROTOOPT ||
+            errno == EOPNOTSUPP )
+        {
+            msg_Dbg( p_access, "UDP segmentation offload unavailable: %s",
+                     vlc_strerror_c(errno) );
+            p_sys->b_gso = false;
+            return VLC_EGENERIC;
+        }
+        msg_Warn( p_access, "send error: %s", vlc_strerror_c(errno) );
+    }
+    p_sys->stats.i_syscalls++;
+    return VLC_SUCCESS;
+}
+#endif
+
+static void SendBatch( sout_access_out_t *p_access, udp_batch_t *p_batch )
+{
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+
+    if( p_batch->i_count == 0 )
+        return;
+
+#if defined(UDP_SEGMENT) && defined(SOL_UDP)
+    if( p_batch->i_count > 1 && p_sys->b_gso &&
+        SendSegmented( p_access, p_batch ) == VLC_SUCCESS )
+        goto sent;
+#endif
+#ifdef HAVE_SENDMMSG
+    if( p_batch->i_count > 1 )
+    {
+        struct mmsghdr msgs[MAX_BATCH_PACKETS];
+        struct iovec iov[MAX_BATCH_PACKETS];
+
+        memset( msgs, 0, sizeof(msgs[0]) * p_batch->i_count );
+        for( unsigned i = 0; i < p_batch->i_count; i++ )
+        {
+            iov[i].iov_base = p_batch->p_blocks[i]->p_buffer;
+            iov[i].iov_len = p_batch->p_blocks[i]->i_buffer;
+            msgs[i].msg_hdr.msg_iov = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        for( unsigned i_sent = 0; i_sent < p_batch->i_count; )
+        {
+            int i_ret = sendmmsg( p_sys->i_handle, &msgs[i_sent],
+                                  p_batch->i_count - i_sent, 0 );
+            p_sys->stats.i_syscalls++;
+            if( i_ret == -1 )
+            {
+                /* skip the failing packet, as send() does */
+                msg_Warn( p_access, "send error: %s", vlc_strerror_c(errno) );
+                i_ret = 1;
+            }
+            i_sent += i_ret;
+        }
+        goto sent;
+    }
+#endif
+    for( unsigned i = 0; i < p_batch->i_count; i++ )
+    {
+        const block_t *p_pk = p_batch->p_blocks[i];
+        if ( send( p_sys->i_handle, p_pk->p_buffer, p_pk->i_buffer, 0 ) == -1 )
+            msg_Warn( p_access, "send error: %s", vlc_strerror_c(errno) );
+        p_sys->stats.i_syscalls++;
+    }
+
+#if defined(HAVE_SENDMMSG) || (defined(UDP_SEGMENT) && defined(SOL_UDP))
+sent:
+#endif
+    {
+        const mtime_t i_sent = mdate();
+        mtime_t i_late_max = 0;
+
+        for( unsigned i = 0; i < p_batch->i_count; i++ )
+        {
+            block_t *p_pk = p_batch->p_blocks[i];
+            const mtime_t i_late = i_sent - (p_sys->i_caching + p_pk->i_dts);
+
+            if( i_late > 0 )
+            {
+                p_sys->stats.i_late_packets++;
+                p_sys->stats.i_late_total += i_late;
+                if( i_late > i_late_max )
+                    i_late_max = i_late;
+            }
+            vlc_lffifo_Queue( p_sys->p_empty_blocks, p_pk );
+        }
+        p_sys->stats.i_packets += p_batch->i_count;
+        p_batch->i_count = 0;
+
+        if( i_late_max > p_sys->stats.i_late_max )
+            p_sys->stats.i_late_max = i_late_max;
+        if( i_late_max > 20000 )
+            msg_Dbg( p_access, "packet has been sent too late (%"PRId64 ")",
+                     i_late_max );
+    }
+}
+
+static void BatchCleanup( void *data )
+{
+    udp_batch_t *p_batch = data;
+
+    for( unsigned i = 0; i < p_batch->i_count; i++ )
+        block_Release( p_batch->p_blocks[i] );
+    if( p_batch->p_next != NULL )
+        block_Release( p_batch->p_next );
+}
+
+/*****************************************************************************
+ * WriteLoop: Write packets on the network at the good time, until cancelled.
+ *****************************************************************************/
+static void WriteLoop( sout_access_out_t *p_access, udp_batch_t *p_batch )
 {
-    sout_access_out_t *p_access = data;
     sout_access_out_sys_t *p_sys = p_access->p_sys;
     mtime_t i_date_last = -1;
     const unsigned i_group = var_GetInteger( p_access,
@@ -407,8 +626,8 @@ static void* ThreadWrite( void *data )
 
     for (;;)
     {
-        block_t *p_pk = block_FifoGet( p_sys->p_fifo );
-        mtime_t       i_date, i_sent;
+        block_t *p_pk = vlc_lffifo_Get( p_sys->p_fifo );
+        mtime_t       i_date;
 
         i_date = p_sys->i_caching + p_pk->i_dts;
         if( i_date_last > 0 )
@@ -419,7 +638,7 @@ static void* ThreadWrite( void *data )
                     msg_Dbg( p_access, "mmh, hole (%"PRId64" > 2s) -> drop",
                              i_date - i_date_last );
 
-                block_FifoPut( p_sys->p_empty_blocks, p_pk );
+                vlc_lffifo_Queue( p_sys->p_empty_blocks, p_pk );
 
                 i_date_last = i_date;
                 i_dropped_packets++;
@@ -433,16 +652,24 @@ static void* ThreadWrite( void *data )
             }
         }
 
-        block_cleanup_push( p_pk );
         i_to_send--;
-        if( !i_to_send || (p_pk->i_flags & BLOCK_FLAG_CLOCK) )
+        const bool b_wait = !i_to_send || (p_pk->i_flags & BLOCK_FLAG_CLOCK);
+        /* Packets already due must not wait for this one */
+        p_batch->p_next = p_pk;
+        if( b_wait )
+            SendBatch( p_access, p_batch );
+        p_batch->p_blocks[p_batch->i_count++] = p_pk;
+        p_batch->p_next = NULL;
+        if( b_wait )
         {
             mwait( i_date );
             i_to_send = i_group;
         }
-        if ( send( p_sys->i_handle, p_pk->p_buffer, p_pk->i_buffer, 0 ) == -1 )
-            msg_Warn( p_access, "send error: %s", vlc_strerror_c(errno) );
-        vlc_cleanup_pop();
+
+        /* Send once nothing else is ready to go out along */
+        const bool b_flush = p_batch->i_count >= p_sys->i_batch;
+        if( b_flush || vlc_lffifo_IsEmpty( p_sys->p_fifo ) )
+            SendBatch( p_access, p_batch );
 
         if( i_dropped_packets )
         {
@@ -450,18 +677,20 @@ static void* ThreadWrite( void *data )
             i_dropped_packets = 0;
         }
 
-#if 1
-        i_sent = mdate();
-        if ( i_sent > i_date + 20000 )
-        {
-            msg_Dbg( p_access, "packet has been sent too late (%"PRId64 ")",
-                     i_sent - i_date );
-        }
-#endif
-
-        block_FifoPut( p_sys->p_empty_blocks, p_pk );
-
         i_date_last = i_date;
     }
+}
+
+/*****************************************************************************
+ * ThreadWrite: Write a packet on the network at the good time.
+ *****************************************************************************/
+static void* ThreadWrite( void *data )
+{
+    sout_access_out_t *p_access = data;
+    udp_batch_t batch = { .i_count = 0, .p_next = NULL };
+
+    vlc_cleanup_push( BatchCleanup, &batch );
+    WriteLoop( p_access, &batch );
+    vlc_cleanup_pop();
     return NULL;
 }
@@ -0,0 +1,844 @@
+/*****************************************************************************
+ * format.h: PCM format conversion kernels
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifndef VLC_AUDIO_FORMAT_H
+#define VLC_AUDIO_FORMAT_H 1
+
+#include <math.h>
+#include <vlc_common.h>
+#include <vlc_cpu.h>
+#include <vlc_fourcc.h>
+
+/* A conversion kernel converts a number of samples. The destination may be
+ * the source if the output samples are not larger than the input ones. The
+ * SIMD kernels return the same results as the C ones, bit for bit. */
+typedef void (*pcm_convert_t)(void *dst, const void *src, size_t samples);
+
+/*** from U8 ***/
+static void U8toS16(void *d, const void *s, size_t n)
+{
+    const uint8_t *src = s;
+    int16_t *dst = d;
+    while (n--)
+        *dst++ = ((*src++) << 8) - 0x8000;
+}
+
+static void U8toFl32(void *d, const void *s, size_t n)
+{
+    const uint8_t *src = s;
+    float *dst = d;
+    while (n--)
+        *dst++ = ((float)((*src++) - 128)) / 128.f;
+}
+
+static void U8toS32(void *d, const void *s, size_t n)
+{
+    const uint8_t *src = s;
+    int32_t *dst = d;
+    while (n--)
+        *dst++ = ((*src++) << 24) - 0x80000000;
+}
+
+static void U8toFl64(void *d, const void *s, size_t n)
+{
+    const uint8_t *src = s;
+    double *dst = d;
+    while (n--)
+        *dst++ = ((double)((*src++) - 128)) / 128.;
+}
+
+/*** from S16N ***/
+static void S16toU8(void *d, const void *s, size_t n)
+{
+    const int16_t *src = s;
+    uint8_t *dst = d;
+    while (n--)
+        *dst++ = ((*src++) + 32768) >> 8;
+}
+
+static void S16toFl32(void *d, const void *s, size_t n)
+{
+    const int16_t *src = s;
+    float *dst = d;
+    while (n--)
+    {   /* This is Walken's trick based on IEEE float format. On my PIII
+         * this takes 16 seconds to perform one billion conversions, instead
+         * of 19 seconds for the division. */
+        union { float f; int32_t i; } u;
+        u.i = *src++ + 0x43c00000;
+        *dst++ = u.f - 384.f;
+    }
+}
+
+static void S16toS32(void *d, const void *s, size_t n)
+{
+    const int16_t *src = s;
+    int32_t *dst = d;
+    while (n--)
+        *dst++ = *src++ << 16;
+}
+
+static void S16toFl64(void *d, const void *s, size_t n)
+{
+    const int16_t *src = s;
+    double *dst = d;
+    while (n--)
+        *dst++ = (double)*src++ / 32768.;
+}
+
+/*** from FL32 ***/
+static void Fl32toU8(void *d, const void *s, size_t n)
+{
+    const float *src = s;
+    uint8_t *dst = d;
+    while (n--)
+    {
+        float v = *(src++) * 128.f;
+        if (v >= 127.f)
+            *(dst++) = 255;
+        else
+        if (v <= -128.f)
+            *(dst++) = 0;
+        else
+            *(dst++) = lroundf(v) + 128;
+    }
+}
+
+static void Fl32toS16(void *d, const void *s, size_t n)
+{
+    const float *src = s;
+    int16_t *dst = d;
+    while (n--)
+    {   /* This is Walken's trick based on IEEE float format. */
+        union { float f; int32_t i; } u;
+        u.f = *src++ + 384.f;
+        if (u.i > 0x43c07fff)
+            *dst++ = 32767;
+        else if (u.i < 0x43bf8000)
+            *dst++ = -32768;
+        else
+            *dst++ = u.i - 0x43c00000;
+    }
+}
+
+static void Fl32toS32(void *d, const void *s, size_t n)
+{
+    const float *src = s;
+    int32_t *dst = d;
+    while (n--)
+    {
+        float v = *(src++) * 2147483648.f;
+        if (v >= 2147483647.f)
+            *(dst++) = 2147483647;
+        else
+        if (v <= -2147483648.f)
+            *(dst++) = -2147483648;
+        else
+            *(dst++) = lroundf(v);
+    }
+}
+
+static void Fl32toFl64(void *d, const void *s, size_t n)
+{
+    const float *src = s;
+    double *dst = d;
+    while (n--)
+        *(dst++) = *(src++);
+}
+
+/*** from S32N ***/
+static void S32toU8(void *d, const void *s, size_t n)
+{
+    const int32_t *src = s;
+    uint8_t *dst = d;
+    while (n--)
+        *dst++ = ((*src++) >> 24) + 128;
+}
+
+static void S32toS16(void *d, const void *s, size_t n)
+{
+    const int32_t *src = s;
+    int16_t *dst = d;
+    while (n--)
+        *dst++ = (*src++) >> 16;
+}
+
+static void S32toFl32(void *d, const void *s, size_t n)
+{
+    const int32_t *src = s;
+    float *dst = d;
+    while (n--)
+        *dst++ = (float)(*src++) / 2147483648.f;
+}
+
+static void S32toFl64(void *d, const void *s, size_t n)
+{
+    const int32_t *src = s;
+    double *dst = d;
+    while (n--)
+        *dst++ = (double)(*src++) / 2147483648.;
+}
+
+/*** from FL64 ***/
+static void Fl64toU8(void *d, const void *s, size_t n)
+{
+    const double *src = s;
+    uint8_t *dst = d;
+    while (n--)
+    {
+        float v = *(src++) * 128.;
+        if (v >= 127.f)
+            *(dst++) = 255;
+        else
+        if (v <= -128.f)
+            *(dst++) = 0;
+        else
+            *(dst++) = lround(v) + 128;
+    }
+}
+
+static void Fl64toS16(void *d, const void *s, size_t n)
+{
+    const double *src = s;
+    int16_t *dst = d;
+    while (n--)
+    {
+        const double v = *src++ * 32768.;
+        if (v >= 32767.)
+            *dst++ = 32767;
+        else if (v < -32768.)
+            *dst++ = -32768;
+        else
+            *dst++ = lround(v);
+    }
+}
+
+static void Fl64toFl32(void *d, const void *s, size_t n)
+{
+    const double *src = s;
+    float *dst = d;
+    while (n--)
+        *(dst++) = *(src++);
+}
+
+static void Fl64toS32(void *d, const void *s, size_t n)
+{
+    const double *src = s;
+    int32_t *dst = d;
+    while (n--)
+    {
+        float v = *(src++) * 2147483648.;
+        if (v >= 2147483647.f)
+            *(dst++) = 2147483647;
+        else
+        if (v <= -2147483648.f)
+            *(dst++) = -2147483648;
+        else
+            *(dst++) = lround(v);
+    }
+}
+
+#if (defined (__i386__) || defined (__x86_64__)) && \
+    (VLC_GCC_VERSION(4, 9) || defined (__clang__))
+# define PCM_CONVERT_X86 1
+# include <immintrin.h>
+
+/* The x86 kernels load a whole vector before storing the converted samples,
+ * and convert the remaining samples with the C kernel. As the destination
+ * moves no faster than the source, they work in place too.
+ *
+ * Float to integer conversions round to the nearest like lround(), that is
+ * halfway cases away from zero, except Fl32toS16 which rounds them to even
+ * like Walken's trick. */
+
+# define PCM_SSE2 __attribute__ ((__target__ ("sse2")))
+# define PCM_AVX2 __attribute__ ((__target__ ("avx2")))
+
+/* Rounds to the nearest integer, halfway cases away from zero. The input
+ * must fit in an int32_t. */
+PCM_SSE2 static inline __m128i lround_ps_sse2(__m128 v)
+{
+    __m128i i = _mm_cvttps_epi32(v);
+    __m128 diff = _mm_sub_ps(v, _mm_cvtepi32_ps(i));
+    __m128 one = _mm_set1_ps(1.f);
+    __m128 up = _mm_and_ps(_mm_cmpge_ps(diff, _mm_set1_ps(.5f)), one);
+    __m128 down = _mm_and_ps(_mm_cmple_ps(diff, _mm_set1_ps(-.5f)), one);
+
+    /* The adjusted value is below 2^23, hence exact. */
+    return _mm_cvttps_epi32(_mm_add_ps(_mm_cvtepi32_ps(i),
+                                       _mm_sub_ps(up, down)));
+}
+
+PCM_SSE2 static inline __m128i lround_pd_sse2(__m128d v)
+{
+    __m128i i = _mm_cvttpd_epi32(v);
+    __m128d diff = _mm_sub_pd(v, _mm_cvtepi32_pd(i));
+    __m128d one = _mm_set1_pd(1.);
+    __m128d up = _mm_and_pd(_mm_cmpge_pd(diff, _mm_set1_pd(.5)), one);
+    __m128d down = _mm_and_pd(_mm_cmple_pd(diff, _mm_set1_pd(-.5)), one);
+
+    return _mm_cvttpd_epi32(_mm_add_pd(_mm_cvtepi32_pd(i),
+                                       _mm_sub_pd(up, down)));
+}
+
+/* Fl32toS32 on samples already scaled to the int32_t range */
+PCM_SSE2 static inline __m128i Fl32toS32_sse2_scaled(__m128 v)
+{
+    __m128 max = _mm_cmpge_ps(v, _mm_set1_ps(2147483648.f));
+    __m128 min = _mm_cmple_ps(v, _mm_set1_ps(-2147483648.f));
+    __m128i i = lround_ps_sse2(_mm_andnot_ps(_mm_or_ps(max, min), v));
+
+    i = _mm_andnot_si128(_mm_castps_si128(_mm_or_ps(max, min)), i);
+    i = _mm_or_si128(i, _mm_and_si128(_mm_castps_si128(max),
+                                      _mm_set1_epi32(INT32_MAX)));
+    return _mm_or_si128(i, _mm_and_si128(_mm_castps_si128(min),
+                                         _mm_set1_epi32(INT32_MIN)));
+}
+
+PCM_SSE2 static void S16toFl32_sse2(void *d, const void *s, size_t n)
+{
+    const int16_t *src = s;
+    float *dst = d;
+    const __m128 scale = _mm_set1_ps(1.f / 32768.f);
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8)
+    {
+        __m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+        _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+    }
+    S16toFl32(dst + i, src + i, n - i);
+}
+
+PCM_SSE2 static void S16toS32_sse2(void *d, const void *s, size_t n)
+{
+    const int16_t *src = s;
+    int32_t *dst = d;
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8)
+    {
+        __m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_unpacklo_epi16(zero, x));
+        _mm_storeu_si128((__m128i *)(dst + i + 4),
+                         _mm_unpackhi_epi16(zero, x));
+    }
+    S16toS32(dst + i, src + i, n - i);
+}
+
+PCM_SSE2 static void S16toFl64_sse2(void *d, const void *s, size_t n)
+{
+    const int16_t *src = s;
+    double *dst = d;
+    const __m128d scale = _mm_set1_pd(1. / 32768.);
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128i x = _mm_loadl_epi64((const __m128i *)(src + i));
+        x = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+        _mm_storeu_pd(dst + i, _mm_mul_pd(_mm_cvtepi32_pd(x), scale));
+        x = _mm_shuffle_epi32(x, _MM_SHUFFLE(1, 0, 3, 2));
+        _mm_storeu_pd(dst + i + 2, _mm_mul_pd(_mm_cvtepi32_pd(x), scale));
+    }
+    S16toFl64(dst + i, src + i, n - i);
+}
+
+PCM_SSE2 static void Fl32toS16_sse2(void *d, const void *s, size_t n)
+{
+    const float *src = s;
+    int16_t *dst = d;
+    const __m128 scale = _mm_set1_ps(32768.f);
+    const __m128 max = _mm_set1_ps(32767.f), min = _mm_set1_ps(-32768.f);
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8)
+    {
+        __m128 a = _mm_mul_ps(_mm_loadu_ps(src + i), scale);
+        __m128 b = _mm_mul_ps(_mm_loadu_ps(src + i + 4), scale);
+        a = _mm_max_ps(_mm_min_ps(a, max), min);
+        b = _mm_max_ps(_mm_min_ps(b, max), min);
+        _mm_storeu_si128((__m128i *)(dst + i),
+                         _mm_packs_epi32(_mm_cvtps_epi32(a),
+                                         _mm_cvtps_epi32(b)));
+    }
+    Fl32toS16(dst + i, src + i, n - i);
+}
+
+PCM_SSE2 static void Fl32toS32_sse2(void *d, const void *s, size_t n)
+{
+    const float *src = s;
+    int32_t *dst = d;
+    const __m128 scale = _mm_set1_ps(2147483648.f);
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128 v = _mm_mul_ps(_mm_loadu_ps(src + i), scale);
+        _mm_storeu_si128((__m128i *)(dst + i), Fl32toS32_sse2_scaled(v));
+    }
+    Fl32toS32(dst + i, src + i, n - i);
+}
+
+PCM_SSE2 static void Fl32toFl64_sse2(void *d, const void *s, size_t n)
+{
+    const float *src = s;
+    double *dst = d;
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128 v = _mm_loadu_ps(src + i);
+        _mm_storeu_pd(dst + i, _mm_cvtps_pd(v));
+        _mm_storeu_pd(dst + i + 2, _mm_cvtps_pd(_mm_movehl_ps(v, v)));
+    }
+    Fl32toFl64(dst + i, src + i, n - i);
+}
+
+PCM_SSE2 static void S32toS16_sse2(void *d, const void *s, size_t n)
+{
+    const int32_t *src = s;
+    int16_t *dst = d;
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(src + i + 4));
+        _mm_storeu_si128((__m128i *)(dst + i),
+                         _mm_packs_epi32(_mm_srai_epi32(a, 16),
+                                         _mm_srai_epi32(b, 16)));
+    }
+    S32toS16(dst + i, src + i, n - i);
+}
+
+PCM_SSE2 static void S32toFl32_sse2(void *d, const void *s, size_t n)
+{
+    const int32_t *src = s;
+    float *dst = d;
+    const __m128 scale = _mm_set1_ps(1.f / 2147483648.f);
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(x), scale));
+    }
+    S32toFl32(dst + i, src + i, n - i);
+}
+
+PCM_SSE2 static void S32toFl64_sse2(void *d, const void *s, size_t n)
+{
+    const int32_t *src = s;
+    double *dst = d;
+    const __m128d scale = _mm_set1_pd(1. / 2147483648.);
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+        _mm_storeu_pd(dst + i, _mm_mul_pd(_mm_cvtepi32_pd(x), scale));
+        x = _mm_shuffle_epi32(x, _MM_SHUFFLE(1, 0, 3, 2));
+        _mm_storeu_pd(dst + i + 2, _mm_mul_pd(_mm_cvtepi32_pd(x), scale));
+    }
+    S32toFl64(dst + i, src + i, n - i);
+}
+
+PCM_SSE2 static void Fl64toS16_sse2(void *d, const void *s, size_t n)
+{
+    const double *src = s;
+    int16_t *dst = d;
+    const __m128d scale = _mm_set1_pd(32768.);
+    const __m128d max = _mm_set1_pd(32767.), min = _mm_set1_pd(-32768.);
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8)
+    {
+        __m128i v[4];
+
+        for (unsigned j = 0; j < 4; j++)
+        {
+            __m128d x = _mm_mul_pd(_mm_loadu_pd(src + i + 2 * j), scale);
+            v[j] = lround_pd_sse2(_mm_max_pd(_mm_min_pd(x, max), min));
+        }
+        __m128i a = _mm_unpacklo_epi64(v[0], v[1]);
+        __m128i b = _mm_unpacklo_epi64(v[2], v[3]);
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_packs_epi32(a, b));
+    }
+    Fl64toS16(dst + i, src + i, n - i);
+}
+
+PCM_SSE2 static void Fl64toFl32_sse2(void *d, const void *s, size_t n)
+{
+    const double *src = s;
+    float *dst = d;
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128 a = _mm_cvtpd_ps(_mm_loadu_pd(src + i));
+        __m128 b = _mm_cvtpd_ps(_mm_loadu_pd(src + i + 2));
+        _mm_storeu_ps(dst + i, _mm_movelh_ps(a, b));
+    }
+    Fl64toFl32(dst + i, src + i, n - i);
+}
+
+PCM_SSE2 static void Fl64toS32_sse2(void *d, const void *s, size_t n)
+{
+    const double *src = s;
+    int32_t *dst = d;
+    const __m128d scale = _mm_set1_pd(2147483648.);
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128 a = _mm_cvtpd_ps(_mm_mul_pd(_mm_loadu_pd(src + i), scale));
+        __m128 b = _mm_cvtpd_ps(_mm_mul_pd(_mm_loadu_pd(src + i + 2), scale));
+        _mm_storeu_si128((__m128i *)(dst + i),
+                         Fl32toS32_sse2_scaled(_mm_movelh_ps(a, b)));
+    }
+    Fl64toS32(dst + i, src + i, n - i);
+}
+
+PCM_AVX2 static inline __m256i lround_ps_avx2(__m256 v)
+{
+    __m256i i = _mm256_cvttps_epi32(v);
+    __m256 diff = _mm256_sub_ps(v, _mm256_cvtepi32_ps(i));
+    __m256 one = _mm256_set1_ps(1.f);
+    __m256 up = _mm256_and_ps(_mm256_cmp_ps(diff, _mm256_set1_ps(.5f),
+                                            _CMP_GE_OQ), one);
+    __m256 down = _mm256_and_ps(_mm256_cmp_ps(diff, _mm256_set1_ps(-.5f),
+                                              _CMP_LE_OQ), one);
+
+    return _mm256_cvttps_epi32(_mm256_add_ps(_mm256_cvtepi32_ps(i),
+                                             _mm256_sub_ps(up, down)));
+}
+
+PCM_AVX2 static inline __m128i lround_pd_avx2(__m256d v)
+{
+    __m128i i = _mm256_cvttpd_epi32(v);
+    __m256d diff = _mm256_sub_pd(v, _mm256_cvtepi32_pd(i));
+    __m256d one = _mm256_set1_pd(1.);
+    __m256d up = _mm256_and_pd(_mm256_cmp_pd(diff, _mm256_set1_pd(.5),
+                                             _CMP_GE_OQ), one);
+    __m256d down = _mm256_and_pd(_mm256_cmp_pd(diff, _mm256_set1_pd(-.5),
+                                               _CMP_LE_OQ), one);
+
+    return _mm256_cvttpd_epi32(_mm256_add_pd(_mm256_cvtepi32_pd(i),
+                                             _mm256_sub_pd(up, down)));
+}
+
+PCM_AVX2 static inline __m256i Fl32toS32_avx2_scaled(__m256 v)
+{
+    __m256 max = _mm256_cmp_ps(v, _mm256_set1_ps(2147483648.f), _CMP_GE_OQ);
+    __m256 min = _mm256_cmp_ps(v, _mm256_set1_ps(-2147483648.f), _CMP_LE_OQ);
+    __m256i i = lround_ps_avx2(_mm256_andnot_ps(_mm256_or_ps(max, min), v));
+
+    i = _mm256_blendv_epi8(i, _mm256_set1_epi32(INT32_MAX),
+                           _mm256_castps_si256(max));
+    return _mm256_blendv_epi8(i, _mm256_set1_epi32(INT32_MIN),
+                              _mm256_castps_si256(min));
+}
+
+PCM_AVX2 static void S16toFl32_avx2(void *d, const void *s, size_t n)
+{
+    const int16_t *src = s;
+    float *dst = d;
+    const __m256 scale = _mm256_set1_ps(1.f / 32768.f);
+    size_t i = 0;
+
+    for (; i + 16 <= n; i += 16)
+    {
+        __m256i a = _mm256_cvtepi16_epi32(
+                        _mm_loadu_si128((const __m128i *)(src + i)));
+        __m256i b = _mm256_cvtepi16_epi32(
+                        _mm_loadu_si128((const __m128i *)(src + i + 8)));
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(a),
+                                                scale));
+        _mm256_storeu_ps(dst + i + 8, _mm256_mul_ps(_mm256_cvtepi32_ps(b),
+                                                    scale));
+    }
+    S16toFl32(dst + i, src + i, n - i);
+}
+
+PCM_AVX2 static void S16toS32_avx2(void *d, const void *s, size_t n)
+{
+    const int16_t *src = s;
+    int32_t *dst = d;
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256i x = _mm256_cvtepi16_epi32(
+                        _mm_loadu_si128((const __m128i *)(src + i)));
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_slli_epi32(x, 16));
+    }
+    S16toS32(dst + i, src + i, n - i);
+}
+
+PCM_AVX2 static void S16toFl64_avx2(void *d, const void *s, size_t n)
+{
+    const int16_t *src = s;
+    double *dst = d;
+    const __m256d scale = _mm256_set1_pd(1. / 32768.);
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128i x = _mm_cvtepi16_epi32(
+                        _mm_loadl_epi64((const __m128i *)(src + i)));
+        _mm256_storeu_pd(dst + i, _mm256_mul_pd(_mm256_cvtepi32_pd(x),
+                                                scale));
+    }
+    S16toFl64(dst + i, src + i, n - i);
+}
+
+PCM_AVX2 static void Fl32toS16_avx2(void *d, const void *s, size_t n)
+{
+    const float *src = s;
+    int16_t *dst = d;
+    const __m256 scale = _mm256_set1_ps(32768.f);
+    const __m256 max = _mm256_set1_ps(32767.f);
+    const __m256 min = _mm256_set1_ps(-32768.f);
+    size_t i = 0;
+
+    for (; i + 16 <= n; i += 16)
+    {
+        __m256 a = _mm256_mul_ps(_mm256_loadu_ps(src + i), scale);
+        __m256 b = _mm256_mul_ps(_mm256_loadu_ps(src + i + 8), scale);
+        a = _mm256_max_ps(_mm256_min_ps(a, max), min);
+        b = _mm256_max_ps(_mm256_min_ps(b, max), min);
+
+        __m256i v = _mm256_packs_epi32(_mm256_cvtps_epi32(a),
+                                       _mm256_cvtps_epi32(b));
+        _mm256_storeu_si256((__m256i *)(dst + i),
+                            _mm256_permute4x64_epi64(v, 0xD8));
+    }
+    Fl32toS16(dst + i, src + i, n - i);
+}
+
+PCM_AVX2 static void Fl32toS32_avx2(void *d, const void *s, size_t n)
+{
+    const float *src = s;
+    int32_t *dst = d;
+    const __m256 scale = _mm256_set1_ps(2147483648.f);
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256 v = _mm256_mul_ps(_mm256_loadu_ps(src + i), scale);
+        _mm256_storeu_si256((__m256i *)(dst + i), Fl32toS32_avx2_scaled(v));
+    }
+    Fl32toS32(dst + i, src + i, n - i);
+}
+
+PCM_AVX2 static void Fl32toFl64_avx2(void *d, const void *s, size_t n)
+{
+    const float *src = s;
+    double *dst = d;
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4)
+        _mm256_storeu_pd(dst + i, _mm256_cvtps_pd(_mm_loadu_ps(src + i)));
+    Fl32toFl64(dst + i, src + i, n - i);
+}
+
+PCM_AVX2 static void S32toS16_avx2(void *d, const void *s, size_t n)
+{
+    const int32_t *src = s;
+    int16_t *dst = d;
+    size_t i = 0;
+
+    for (; i + 16 <= n; i += 16)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(src + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(src + i + 8));
+        __m256i v = _mm256_packs_epi32(_mm256_srai_epi32(a, 16),
+                                       _mm256_srai_epi32(b, 16));
+        _mm256_storeu_si256((__m256i *)(dst + i),
+                            _mm256_permute4x64_epi64(v, 0xD8));
+    }
+    S32toS16(dst + i, src + i, n - i);
+}
+
+PCM_AVX2 static void S32toFl32_avx2(void *d, const void *s, size_t n)
+{
+    const int32_t *src = s;
+    float *dst = d;
+    const __m256 scale = _mm256_set1_ps(1.f / 2147483648.f);
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(src + i));
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(x),
+                                                scale));
+    }
+    S32toFl32(dst + i, src + i, n - i);
+}
+
+PCM_AVX2 static void S32toFl64_avx2(void *d, const void *s, size_t n)
+{
+    const int32_t *src = s;
+    double *dst = d;
+    const __m256d scale = _mm256_set1_pd(1. / 2147483648.);
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+        _mm256_storeu_pd(dst + i, _mm256_mul_pd(_mm256_cvtepi32_pd(x),
+                                                scale));
+    }
+    S32toFl64(dst + i, src + i, n - i);
+}
+
+PCM_AVX2 static void Fl64toS16_avx2(void *d, const void *s, size_t n)
+{
+    const double *src = s;
+    int16_t *dst = d;
+    const __m256d scale = _mm256_set1_pd(32768.);
+    const __m256d max = _mm256_set1_pd(32767.);
+    const __m256d min = _mm256_set1_pd(-32768.);
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256d a = _mm256_mul_pd(_mm256_loadu_pd(src + i), scale);
+        __m256d b = _mm256_mul_pd(_mm256_loadu_pd(src + i + 4), scale);
+        a = _mm256_max_pd(_mm256_min_pd(a, max), min);
+        b = _mm256_max_pd(_mm256_min_pd(b, max), min);
+        _mm_storeu_si128((__m128i *)(dst + i),
+                         _mm_packs_epi32(lround_pd_avx2(a),
+                                         lround_pd_avx2(b)));
+    }
+    Fl64toS16(dst + i, src + i, n - i);
+}
+
+PCM_AVX2 static void Fl64toFl32_avx2(void *d, const void *s, size_t n)
+{
+    const double *src = s;
+    float *dst = d;
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4)
+        _mm_storeu_ps(dst + i, _mm256_cvtpd_ps(_mm256_loadu_pd(src + i)));
+    Fl64toFl32(dst + i, src + i, n - i);
+}
+
+PCM_AVX2 static void Fl64toS32_avx2(void *d, const void *s, size_t n)
+{
+    const double *src = s;
+    int32_t *dst = d;
+    const __m256d scale = _mm256_set1_pd(2147483648.);
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8)
+    {
+        __m128 a = _mm256_cvtpd_ps(_mm256_mul_pd(_mm256_loadu_pd(src + i),
+                                                 scale));
+        __m128 b = _mm256_cvtpd_ps(_mm256_mul_pd(_mm256_loadu_pd(src + i + 4),
+                                                 scale));
+        __m256 v = _mm256_insertf128_ps(_mm256_castps128_ps256(a), b, 1);
+        _mm256_storeu_si256((__m256i *)(dst + i), Fl32toS32_avx2_scaled(v));
+    }
+    Fl64toS32(dst + i, src + i, n - i);
+}
+
+# define PCM_CVT(s, d, c) { s, d, c, c##_sse2, c##_avx2 }
+#else
+# define PCM_CVT(s, d, c) { s, d, c }
+#endif
+
+/* U8 conversions are too rare to be worth vectorizing */
+#define PCM_CVT_C(s, d, c) { s, d, c, PCM_CVT_NONE }
+#ifdef PCM_CONVERT_X86
+# define PCM_CVT_NONE NULL, NULL
+#else
+# define PCM_CVT_NONE
+#endif
+
+static const struct pcm_conversion
+{
+    vlc_fourcc_t src;
+    vlc_fourcc_t dst;
+    pcm_convert_t convert;
+#ifdef PCM_CONVERT_X86
+    pcm_convert_t convert_sse2;
+    pcm_convert_t convert_avx2;
+#endif
+} pcm_conversions[] = {
+    PCM_CVT_C(VLC_CODEC_U8,   VLC_CODEC_S16N, U8toS16),
+    PCM_CVT_C(VLC_CODEC_U8,   VLC_CODEC_FL32, U8toFl32),
+    PCM_CVT_C(VLC_CODEC_U8,   VLC_CODEC_S32N, U8toS32),
+    PCM_CVT_C(VLC_CODEC_U8,   VLC_CODEC_FL64, U8toFl64),
+
+    PCM_CVT_C(VLC_CODEC_S16N, VLC_CODEC_U8,   S16toU8),
+    PCM_CVT(  VLC_CODEC_S16N, VLC_CODEC_FL32, S16toFl32),
+    PCM_CVT(  VLC_CODEC_S16N, VLC_CODEC_S32N, S16toS32),
+    PCM_CVT(  VLC_CODEC_S16N, VLC_CODEC_FL64, S16toFl64),
+
+    PCM_CVT_C(VLC_CODEC_FL32, VLC_CODEC_U8,   Fl32toU8),
+    PCM_CVT(  VLC_CODEC_FL32, VLC_CODEC_S16N, Fl32toS16),
+    PCM_CVT(  VLC_CODEC_FL32, VLC_CODEC_S32N, Fl32toS32),
+    PCM_CVT(  VLC_CODEC_FL32, VLC_CODEC_FL64, Fl32toFl64),
+
+    PCM_CVT_C(VLC_CODEC_S32N, VLC_CODEC_U8,   S32toU8),
+    PCM_CVT(  VLC_CODEC_S32N, VLC_CODEC_S16N, S32toS16),
+    PCM_CVT(  VLC_CODEC_S32N, VLC_CODEC_FL32, S32toFl32),
+    PCM_CVT(  VLC_CODEC_S32N, VLC_CODEC_FL64, S32toFl64),
+
+    PCM_CVT_C(VLC_CODEC_FL64, VLC_CODEC_U8,   Fl64toU8),
+    PCM_CVT(  VLC_CODEC_FL64, VLC_CODEC_S16N, Fl64toS16),
+    PCM_CVT(  VLC_CODEC_FL64, VLC_CODEC_FL32, Fl64toFl32),
+    PCM_CVT(  VLC_CODEC_FL64, VLC_CODEC_S32N, Fl64toS32),
+};
+
+#undef PCM_CVT_NONE
+#undef PCM_CVT_C
+#undef PCM_CVT
+
+static inline const struct pcm_conversion *
+pcm_FindConversion(vlc_fourcc_t src, vlc_fourcc_t dst)
+{
+    for (size_t i = 0; i < ARRAY_SIZE(pcm_conversions); i++)
+        if (pcm_conversions[i].src == src && pcm_conversions[i].dst == dst)
+            return &pcm_conversions[i];
+    return NULL;
+}
+
+/**
+ * Returns the fastest kernel of a conversion for the running CPU.
+ */
+static inline pcm_convert_t pcm_GetConvert(const struct pcm_conversion *cvt)
+{
+#ifdef PCM_CONVERT_X86
+    if (cvt->convert_avx2 != NULL && vlc_CPU_AVX2())
+        return cvt->convert_avx2;
+    if (cvt->convert_sse2 != NULL && vlc_CPU_SSE2())
+        return cvt->convert_sse2;
+#endif
+    return cvt->convert;
+}
+
+#endif
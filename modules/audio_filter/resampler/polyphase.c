@@ -0,0 +1,329 @@
+/*****************************************************************************
+ * polyphase.c : polyphase audio resampler
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*
+ * Each output sample is the dot product of the input around its position
+ * with a Kaiser-windowed sinc filter. The filter is tabulated for
+ * POLYPHASE_PHASES positions between two input samples, and interpolated in
+ * between, so that the resampling ratio can change at any time.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc_common.h>
+#include <vlc_plugin.h>
+#include <vlc_aout.h>
+#include <vlc_filter.h>
+
+#include "polyphase.h"
+
+static int Open (vlc_object_t *);
+static int OpenResampler (vlc_object_t *);
+static void Close (vlc_object_t *);
+
+vlc_module_begin ()
+    set_shortname (N_("Polyphase"))
+    set_description (N_("Polyphase audio resampler"))
+    set_category (CAT_AUDIO)
+    set_subcategory (SUBCAT_AUDIO_RESAMPLER)
+    set_capability ("audio converter", 30)
+    set_callbacks (Open, Close)
+
+    add_submodule ()
+    set_capability ("audio resampler", 30)
+    set_callbacks (OpenResampler, Close)
+vlc_module_end ()
+
+/* Taps per phase without down-sampling */
+#define TAPS 64
+#define MAX_TAPS 512
+/* Cut-off frequency, relative to the lowest Nyquist frequency */
+#define CUTOFF .92
+
+struct filter_sys_t
+{
+    struct polyphase_kernels kernels;
+    float *coeffs; /**< filter bank, (POLYPHASE_PHASES + 1) * taps */
+    float *deltas; /**< differences between phases */
+    float *taps_buf; /**< taps of the current output sample */
+    unsigned taps;
+    double cutoff;
+
+    float *history; /**< planar input, capacity frames per channel */
+    size_t capacity;
+    size_t frames; /**< frames in history */
+    double pos; /**< position of the next output sample in history */
+    unsigned channels;
+};
+
+static void Design (filter_t *filter, double step)
+{
+    filter_sys_t *sys = filter->p_sys;
+    double cutoff = CUTOFF * ((step > 1.) ? 1. / step : 1.);
+
+    /* Small rate changes, such as for synchronization, keep the filter */
+    if (fabs (cutoff - sys->cutoff) <= sys->cutoff * .01)
+        return;
+
+    msg_Dbg (filter, "cut-off at %.3f of the input Nyquist frequency", cutoff);
+    polyphase_Design (sys->coeffs, sys->deltas, sys->taps, cutoff);
+    sys->cutoff = cutoff;
+}
+
+static void Reset (filter_sys_t *sys)
+{
+    const unsigned half = sys->taps / 2;
+
+    /* Start with silence before the first input sample */
+    for (unsigned c = 0; c < sys->channels; c++)
+        memset (sys->history + c * sys->capacity, 0,
+                (half - 1) * sizeof (float));
+    sys->frames = half - 1;
+    sys->pos = half - 1;
+}
+
+/**
+ * Appends interleaved frames to the planar history, or silence if in is NULL.
+ */
+static int Feed (filter_sys_t *sys, const float *in, size_t count)
+{
+    if (sys->frames + count > sys->capacity)
+    {
+        size_t capacity = sys->frames + count + sys->taps;
+        float *history = malloc (capacity * sys->channels
+                                 * sizeof (*history));
+        if (unlikely(history == NULL))
+            return VLC_ENOMEM;
+
+        for (unsigned c = 0; c < sys->channels; c++)
+            memcpy (history + c * capacity, sys->history + c * sys->capacity,
+                    sys->frames * sizeof (*history));
+        free (sys->history);
+        sys->history = history;
+        sys->capacity = capacity;
+    }
+
+    for (unsigned c = 0; c < sys->channels; c++)
+    {
+        float *h = sys->history + c * sys->capacity + sys->frames;
+
+        if (in != NULL)
+            for (size_t i = 0; i < count; i++)
+                h[i] = in[i * sys->channels + c];
+        else
+            memset (h, 0, count * sizeof (*h));
+    }
+    sys->frames += count;
+    return VLC_SUCCESS;
+}
+
+/**
+ * Computes all the output frames for which there is enough input.
+ */
+static block_t *Produce (filter_t *filter, double step)
+{
+    filter_sys_t *sys = filter->p_sys;
+    const unsigned half = sys->taps / 2;
+    const unsigned channels = sys->channels;
+    size_t count = 0;
+
+    if (sys->frames > half + (size_t)sys->pos)
+        count = (sys->frames - half - sys->pos) / step + 2;
+
+    block_t *out = block_Alloc (count * channels * sizeof (float));
+    if (unlikely(out == NULL))
+        return NULL;
+
+    float *dst = (float *)out->p_buffer;
+    size_t done = 0;
+
+    while (done < count && (size_t)sys->pos + half < sys->frames)
+    {
+        size_t idx = sys->pos;
+        double phase = (sys->pos - idx) * POLYPHASE_PHASES;
+        unsigned p = phase;
+
+        if (phase == 0. && step == 1.)
+        {   /* Nothing to interpolate */
+            for (unsigned c = 0; c < channels; c++)
+                *(dst++) = sys->history[c * sys->capacity + idx];
+        }
+        else
+        {
+            const float *src = sys->history + idx - half + 1;
+
+            sys->kernels.interp (sys->taps_buf,
+                                 sys->coeffs + p * sys->taps,
+                                 sys->deltas + p * sys->taps,
+                                 phase - p, sys->taps);
+            for (unsigned c = 0; c < channels; c++)
+                *(dst++) = sys->kernels.dot (sys->taps_buf,
+                                             src + c * sys->capacity,
+                                             sys->taps);
+        }
+        sys->pos += step;
+        done++;
+    }
+
+    /* Drop the input that no output sample needs anymore */
+    size_t drop = (size_t)sys->pos - (half - 1);
+    if (drop > sys->frames)
+        drop = sys->frames;
+    for (unsigned c = 0; c < channels; c++)
+    {
+        float *h = sys->history + c * sys->capacity;
+        memmove (h, h + drop, (sys->frames - drop) * sizeof (*h));
+    }
+    sys->frames -= drop;
+    sys->pos -= drop;
+
+    out->i_buffer = done * channels * sizeof (float);
+    out->i_nb_samples = done;
+    out->i_length = done * CLOCK_FREQ / filter->fmt_out.audio.i_rate;
+    return out;
+}
+
+static void Flush (filter_t *filter)
+{
+    Reset (filter->p_sys);
+}
+
+static block_t *Resample (filter_t *filter, block_t *in)
+{
+    filter_sys_t *sys = filter->p_sys;
+    const double step = filter->fmt_in.audio.i_rate
+                      / (double)filter->fmt_out.audio.i_rate;
+    const mtime_t pts = in->i_pts;
+    block_t *out = NULL;
+
+    if (in->i_flags & BLOCK_FLAG_DISCONTINUITY)
+        Reset (sys);
+
+    Design (filter, step);
+    if (Feed (sys, (const float *)in->p_buffer, in->i_nb_samples))
+        goto out;
+
+    out = Produce (filter, step);
+    if (out != NULL)
+    {
+        out->i_pts = pts;
+        out->i_flags = in->i_flags & BLOCK_FLAG_DISCONTINUITY;
+    }
+out:
+    block_Release (in);
+    return out;
+}
+
+static block_t *Drain (filter_t *filter)
+{
+    filter_sys_t *sys = filter->p_sys;
+    const double step = filter->fmt_in.audio.i_rate
+                      / (double)filter->fmt_out.audio.i_rate;
+    const unsigned half = sys->taps / 2;
+    block_t *out = NULL;
+
+    /* Flush out the last input samples with silence */
+    if (sys->frames > half - 1 && Feed (sys, NULL, half) == VLC_SUCCESS)
+        out = Produce (filter, step);
+    Reset (sys);
+    return out;
+}
+
+static int OpenResampler (vlc_object_t *obj)
+{
+    filter_t *filter = (filter_t *)obj;
+
+    /* Cannot convert format */
+    if (filter->fmt_in.audio.i_format != VLC_CODEC_FL32
+     || filter->fmt_out.audio.i_format != VLC_CODEC_FL32
+    /* Cannot remix */
+     || filter->fmt_in.audio.i_physical_channels
+                                  != filter->fmt_out.audio.i_physical_channels
+     || filter->fmt_in.audio.i_original_channels
+                                  != filter->fmt_out.audio.i_original_channels)
+        return VLC_EGENERIC;
+
+    filter_sys_t *sys = malloc (sizeof (*sys));
+    if (unlikely(sys == NULL))
+        return VLC_ENOMEM;
+
+    /* Widen the filter for down-sampling to keep the transition band */
+    double step = filter->fmt_in.audio.i_rate
+                / (double)filter->fmt_out.audio.i_rate;
+    unsigned taps = TAPS;
+    if (step > 1.)
+        taps = __MIN((unsigned)(TAPS * step + 7.) & ~7u, MAX_TAPS);
+
+    sys->kernels = polyphase_GetKernels ();
+    sys->taps = taps;
+    sys->cutoff = 0.;
+    sys->channels = aout_FormatNbChannels (&filter->fmt_in.audio);
+    sys->capacity = taps + 4096;
+    sys->coeffs = malloc ((POLYPHASE_PHASES + 1) * taps * sizeof (float));
+    sys->deltas = malloc (POLYPHASE_PHASES * taps * sizeof (float));
+    sys->taps_buf = malloc (taps * sizeof (float));
+    sys->history = malloc (sys->capacity * sys->channels * sizeof (float));
+    if (unlikely(sys->coeffs == NULL || sys->deltas == NULL
+              || sys->taps_buf == NULL || sys->history == NULL))
+    {
+        free (sys->history);
+        free (sys->taps_buf);
+        free (sys->deltas);
+        free (sys->coeffs);
+        free (sys);
+        return VLC_ENOMEM;
+    }
+
+    filter->p_sys = sys;
+    Design (filter, step);
+    Reset (sys);
+
+    msg_Dbg (obj, "%u Hz to %u Hz, %u taps per phase",
+             filter->fmt_in.audio.i_rate, filter->fmt_out.audio.i_rate, taps);
+
+    filter->pf_audio_filter = Resample;
+    filter->pf_audio_drain = Drain;
+    filter->pf_flush = Flush;
+    return VLC_SUCCESS;
+}
+
+static int Open (vlc_object_t *obj)
+{
+    filter_t *filter = (filter_t *)obj;
+
+    /* Will change rate */
+    if (filter->fmt_in.audio.i_rate == filter->fmt_out.audio.i_rate)
+        return VLC_EGENERIC;
+    return OpenResampler (obj);
+}
+
+static void Close (vlc_object_t *obj)
+{
+    filter_t *filter = (filter_t *)obj;
+    filter_sys_t *sys = filter->p_sys;
+
+    free (sys->history);
+    free (sys->taps_buf);
+    free (sys->deltas);
+    free (sys->coeffs);
+    free (sys);
+}
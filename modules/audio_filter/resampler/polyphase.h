@@ -0,0 +1,210 @@
+/*****************************************************************************
+ * polyphase.h : polyphase resampler kernels
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifndef VLC_POLYPHASE_H
+#define VLC_POLYPHASE_H 1
+
+#include <math.h>
+#include <vlc_common.h>
+#include <vlc_cpu.h>
+
+/* Number of filter phases between two input samples. The coefficients of
+ * intermediate phases are linearly interpolated. */
+#define POLYPHASE_PHASES 256
+
+/* Kaiser window shape, for about 80 dB of stop-band attenuation */
+#define POLYPHASE_BETA 8.
+
+/* Modified Bessel function of the first kind, order 0 */
+static inline double polyphase_i0(double x)
+{
+    double sum = 1., term = 1.;
+
+    x = x * x / 4.;
+    for (unsigned k = 1; term > sum * 1e-12; k++)
+    {
+        term *= x / ((double)k * k);
+        sum += term;
+    }
+    return sum;
+}
+
+/**
+ * Computes the Kaiser-windowed sinc filter bank.
+ *
+ * Row p of coeffs holds the taps for an output sample p/POLYPHASE_PHASES of
+ * an input sample after the middle of the taps. There are
+ * POLYPHASE_PHASES + 1 rows so that every phase can be interpolated with the
+ * next one, and deltas holds the differences between consecutive rows.
+ *
+ * \param taps number of taps per phase (even)
+ * \param cutoff cut-off frequency relative to the input Nyquist frequency
+ */
+static inline void polyphase_Design(float *coeffs, float *deltas,
+                                    unsigned taps, double cutoff)
+{
+    const int half = taps / 2;
+    const double norm = polyphase_i0(POLYPHASE_BETA);
+
+    for (unsigned p = 0; p <= POLYPHASE_PHASES; p++)
+    {
+        double frac = (double)p / POLYPHASE_PHASES;
+
+        for (unsigned k = 0; k < taps; k++)
+        {
+            double x = (int)k + 1 - half - frac; /* distance in input samples */
+            double w = x / half;
+            double v = 0.;
+
+            if (w > -1. && w < 1.)
+            {
+                double s = (x != 0.) ? sin(M_PI * cutoff * x)
+                                       / (M_PI * cutoff * x) : 1.;
+                v = cutoff * s
+                  * polyphase_i0(POLYPHASE_BETA * sqrt(1. - w * w)) / norm;
+            }
+            coeffs[p * taps + k] = v;
+        }
+    }
+
+    for (unsigned p = 0; p < POLYPHASE_PHASES; p++)
+        for (unsigned k = 0; k < taps; k++)
+            deltas[p * taps + k] = coeffs[(p + 1) * taps + k]
+                                 - coeffs[p * taps + k];
+}
+
+/* Dot product of two vectors of n floats */
+static inline float polyphase_dot_c(const float *a, const float *b, size_t n)
+{
+    float sum = 0.f;
+    for (; n > 0; n--)
+        sum += *a++ * *b++;
+    return sum;
+}
+
+/* Interpolates the taps of a fractional phase: out = coeffs + frac * deltas */
+static inline void polyphase_interp_c(float *out, const float *coeffs,
+                                      const float *deltas, float frac,
+                                      size_t n)
+{
+    for (; n > 0; n--)
+        *out++ = *coeffs++ + frac * *deltas++;
+}
+
+#if (defined (__i386__) || defined (__x86_64__)) && \
+    (VLC_GCC_VERSION(4, 9) || defined (__clang__))
+# define POLYPHASE_X86 1
+# include <immintrin.h>
+
+__attribute__ ((__target__ ("sse2")))
+static inline float polyphase_dot_sse2(const float *a, const float *b,
+                                       size_t n)
+{
+    __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+
+    for (; n >= 8; n -= 8, a += 8, b += 8)
+    {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a),
+                                           _mm_loadu_ps(b)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + 4),
+                                           _mm_loadu_ps(b + 4)));
+    }
+    acc0 = _mm_add_ps(acc0, acc1);
+    acc0 = _mm_add_ps(acc0, _mm_movehl_ps(acc0, acc0));
+    acc0 = _mm_add_ss(acc0, _mm_shuffle_ps(acc0, acc0, 1));
+    return _mm_cvtss_f32(acc0) + polyphase_dot_c(a, b, n);
+}
+
+__attribute__ ((__target__ ("sse2")))
+static inline void polyphase_interp_sse2(float *out, const float *coeffs,
+                                         const float *deltas, float frac,
+                                         size_t n)
+{
+    const __m128 f = _mm_set1_ps(frac);
+
+    for (; n >= 4; n -= 4, out += 4, coeffs += 4, deltas += 4)
+        _mm_storeu_ps(out, _mm_add_ps(_mm_loadu_ps(coeffs),
+                                      _mm_mul_ps(f, _mm_loadu_ps(deltas))));
+    polyphase_interp_c(out, coeffs, deltas, frac, n);
+}
+
+__attribute__ ((__target__ ("avx2")))
+static inline float polyphase_dot_avx2(const float *a, const float *b,
+                                       size_t n)
+{
+    __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+
+    for (; n >= 16; n -= 16, a += 16, b += 16)
+    {
+        acc0 = _mm256_add_ps(acc0, _mm256_mul_ps(_mm256_loadu_ps(a),
+                                                 _mm256_loadu_ps(b)));
+        acc1 = _mm256_add_ps(acc1, _mm256_mul_ps(_mm256_loadu_ps(a + 8),
+                                                 _mm256_loadu_ps(b + 8)));
+    }
+    for (; n >= 8; n -= 8, a += 8, b += 8)
+        acc0 = _mm256_add_ps(acc0, _mm256_mul_ps(_mm256_loadu_ps(a),
+                                                 _mm256_loadu_ps(b)));
+    acc0 = _mm256_add_ps(acc0, acc1);
+
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(acc0),
+                            _mm256_extractf128_ps(acc0, 1));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    return _mm_cvtss_f32(sum) + polyphase_dot_c(a, b, n);
+}
+
+__attribute__ ((__target__ ("avx2")))
+static inline void polyphase_interp_avx2(float *out, const float *coeffs,
+                                         const float *deltas, float frac,
+                                         size_t n)
+{
+    const __m256 f = _mm256_set1_ps(frac);
+
+    for (; n >= 8; n -= 8, out += 8, coeffs += 8, deltas += 8)
+        _mm256_storeu_ps(out, _mm256_add_ps(_mm256_loadu_ps(coeffs),
+                                   _mm256_mul_ps(f, _mm256_loadu_ps(deltas))));
+    polyphase_interp_c(out, coeffs, deltas, frac, n);
+}
+#endif
+
+struct polyphase_kernels
+{
+    float (*dot)(const float *, const float *, size_t);
+    void (*interp)(float *, const float *, const float *, float, size_t);
+};
+
+static inline struct polyphase_kernels polyphase_GetKernels(void)
+{
+    struct polyphase_kernels k = { polyphase_dot_c, polyphase_interp_c };
+#ifdef POLYPHASE_X86
+    if (vlc_CPU_AVX2())
+    {
+        k.dot = polyphase_dot_avx2;
+        k.interp = polyphase_interp_avx2;
+    }
+    else if (vlc_CPU_SSE2())
+    {
+        k.dot = polyphase_dot_sse2;
+        k.interp = polyphase_interp_sse2;
+    }
+#endif
+    return k;
+}
+
+#endif
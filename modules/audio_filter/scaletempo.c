@@ -34,7 +34,8 @@
 #include <vlc_filter.h>
 
 #include <string.h> /* for memset */
-#include <limits.h> /* form INT_MIN */
+
+#include "scaletempo.h"
 
 /*****************************************************************************
  * Module descriptor
@@ -56,6 +57,9 @@ vlc_module_begin ()
         N_("Overlap Length"), N_("Percentage of stride to overlap"), true )
     add_integer_with_range( "scaletempo-search", 14, 0, 200,
         N_("Search Length"), N_("Length in milliseconds to search for best overlap position"), true )
+    add_bool( "scaletempo-coarse-search", false,
+        N_("Coarse search"), N_("Search the best overlap position on a coarse grid first, then refine it. "
+           "This is faster, but can miss the best position with high-pitched audio."), true )
 
     set_callbacks( Open, Close )
 vlc_module_end ()
@@ -108,6 +112,8 @@ struct filter_sys_t
     void    (*output_overlap)( filter_t *p_filter, void *p_out_buf, unsigned bytes_off );
     /* best overlap */
     unsigned  frames_search;
+    unsigned  search_step;
+    scaletempo_dot_t dot;
     void     *buf_pre_corr;
     void     *table_window;
     unsigned(*best_overlap_offset)( filter_t *p_filter );
@@ -119,10 +125,8 @@ struct filter_sys_t
 static unsigned best_overlap_offset_float( filter_t *p_filter )
 {
     filter_sys_t *p = p_filter->p_sys;
-    float *pw, *po, *ppc, *search_start;
-    float best_corr = INT_MIN;
-    unsigned best_off = 0;
-    unsigned i, off;
+    float *pw, *po, *ppc;
+    unsigned i, best_off;
 
     pw  = p->table_window;
     po  = p->buf_overlap;
@@ -132,20 +136,11 @@ static unsigned best_overlap_offset_float( filter_t *p_filter )
       *ppc++ = *pw++ * *po++;
     }
 
-    search_start = (float *)p->buf_queue + p->samples_per_frame;
-    for( off = 0; off < p->frames_search; off++ ) {
-      float corr = 0;
-      float *ps = search_start;
-      ppc = p->buf_pre_corr;
-      for( i = p->samples_per_frame; i < p->samples_overlap; i++ ) {
-        corr += *ppc++ * *ps++;
-      }
-      if( corr > best_corr ) {
-        best_corr = corr;
-        best_off  = off;
-      }
-      search_start += p->samples_per_frame;
-    }
+    best_off = scaletempo_search( p->dot, p->buf_pre_corr,
+                                  (float *)p->buf_queue + p->samples_per_frame,
+                                  p->samples_overlap - p->samples_per_frame,
+                                  p->samples_per_frame, p->frames_search,
+                                  p->search_step );
 
     return best_off * p->bytes_per_frame;
 }
@@ -408,8 +403,15 @@ static int Open( vlc_object_t *p_this )
     p_sys->percent_overlap = var_InheritFloat( p_this, "scaletempo-overlap" );
     p_sys->ms_search       = var_InheritInteger( p_this, "scaletempo-search" );
 
-    msg_Dbg( p_this, "params: %i stride, %.3f overlap, %i search",
-             p_sys->ms_stride, p_sys->percent_overlap, p_sys->ms_search );
+    p_sys->dot             = scaletempo_GetDot();
+    p_sys->search_step     = 1;
+    if( var_InheritBool( p_this, "scaletempo-coarse-search" ) )
+        /* keep at least 4 steps per period up to 3 kHz */
+        p_sys->search_step = __MAX( p_sys->sample_rate / 12000, 1 );
+
+    msg_Dbg( p_this, "params: %i stride, %.3f overlap, %i search, %u step",
+             p_sys->ms_stride, p_sys->percent_overlap, p_sys->ms_search,
+             p_sys->search_step );
 
     p_sys->buf_queue      = NULL;
     p_sys->buf_overlap    = NULL;
@@ -0,0 +1,168 @@
+/*****************************************************************************
+ * scaletempo.h: scaletempo overlap search kernels
+ *****************************************************************************
+ * Copyright © 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifndef VLC_SCALETEMPO_H
+#define VLC_SCALETEMPO_H 1
+
+#include <limits.h>
+#include <vlc_common.h>
+#include <vlc_cpu.h>
+
+/* Dot product of two float vectors of n samples */
+typedef float (*scaletempo_dot_t)(const float *a, const float *b, size_t n);
+
+static inline float scaletempo_dot_c(const float *a, const float *b, size_t n)
+{
+    float corr = 0;
+    for (; n > 0; n--)
+        corr += *a++ * *b++;
+    return corr;
+}
+
+#if (defined (__i386__) || defined (__x86_64__)) && \
+    (VLC_GCC_VERSION(4, 9) || defined (__clang__))
+# define SCALETEMPO_X86 1
+# include <immintrin.h>
+
+/* The vector kernels sum in a different order than the C one, so their
+ * results differ in the last bits. */
+__attribute__ ((__target__ ("sse2")))
+static inline float scaletempo_dot_sse2(const float *a, const float *b,
+                                        size_t n)
+{
+    __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+    __m128 acc2 = _mm_setzero_ps(), acc3 = _mm_setzero_ps();
+
+    for (; n >= 16; n -= 16, a += 16, b += 16)
+    {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a),
+                                           _mm_loadu_ps(b)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + 4),
+                                           _mm_loadu_ps(b + 4)));
+        acc2 = _mm_add_ps(acc2, _mm_mul_ps(_mm_loadu_ps(a + 8),
+                                           _mm_loadu_ps(b + 8)));
+        acc3 = _mm_add_ps(acc3, _mm_mul_ps(_mm_loadu_ps(a + 12),
+                                           _mm_loadu_ps(b + 12)));
+    }
+    for (; n >= 4; n -= 4, a += 4, b += 4)
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a),
+                                           _mm_loadu_ps(b)));
+
+    acc0 = _mm_add_ps(_mm_add_ps(acc0, acc1), _mm_add_ps(acc2, acc3));
+    acc0 = _mm_add_ps(acc0, _mm_movehl_ps(acc0, acc0));
+    acc0 = _mm_add_ss(acc0, _mm_shuffle_ps(acc0, acc0, 1));
+    return _mm_cvtss_f32(acc0) + scaletempo_dot_c(a, b, n);
+}
+
+__attribute__ ((__target__ ("avx2")))
+static inline float scaletempo_dot_avx2(const float *a, const float *b,
+                                        size_t n)
+{
+    __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+    __m256 acc2 = _mm256_setzero_ps(), acc3 = _mm256_setzero_ps();
+
+    for (; n >= 32; n -= 32, a += 32, b += 32)
+    {
+        acc0 = _mm256_add_ps(acc0, _mm256_mul_ps(_mm256_loadu_ps(a),
+                                                 _mm256_loadu_ps(b)));
+        acc1 = _mm256_add_ps(acc1, _mm256_mul_ps(_mm256_loadu_ps(a + 8),
+                                                 _mm256_loadu_ps(b + 8)));
+        acc2 = _mm256_add_ps(acc2, _mm256_mul_ps(_mm256_loadu_ps(a + 16),
+                                                 _mm256_loadu_ps(b + 16)));
+        acc3 = _mm256_add_ps(acc3, _mm256_mul_ps(_mm256_loadu_ps(a + 24),
+                                                 _mm256_loadu_ps(b + 24)));
+    }
+    for (; n >= 8; n -= 8, a += 8, b += 8)
+        acc0 = _mm256_add_ps(acc0, _mm256_mul_ps(_mm256_loadu_ps(a),
+                                                 _mm256_loadu_ps(b)));
+
+    acc0 = _mm256_add_ps(_mm256_add_ps(acc0, acc1), _mm256_add_ps(acc2, acc3));
+
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(acc0),
+                            _mm256_extractf128_ps(acc0, 1));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    return _mm_cvtss_f32(sum) + scaletempo_dot_c(a, b, n);
+}
+#endif
+
+static inline scaletempo_dot_t scaletempo_GetDot(void)
+{
+#ifdef SCALETEMPO_X86
+    if (vlc_CPU_AVX2())
+        return scaletempo_dot_avx2;
+    if (vlc_CPU_SSE2())
+        return scaletempo_dot_sse2;
+#endif
+    return scaletempo_dot_c;
+}
+
+/* Finds the offset in frames, out of frames_search, where the pre-computed
+ * overlap correlates best with the input. Each offset correlates samples
+ * samples.
+ *
+ * If step is more than one, only every step-th offset is tried first, then
+ * the neighbours of the best one. This is about step times faster, but can
+ * miss the best offset for signals with content above sample_rate/(4*step).
+ */
+static inline unsigned scaletempo_search(scaletempo_dot_t dot,
+                                         const float *pre_corr,
+                                         const float *search_start,
+                                         size_t samples,
+                                         unsigned samples_per_frame,
+                                         unsigned frames_search,
+                                         unsigned step)
+{
+    float best_corr = INT_MIN;
+    unsigned best_off = 0;
+    unsigned off = 0, end = frames_search;
+
+    if (step > 1)
+    {
+        for (; off < frames_search; off += step)
+        {
+            float corr = dot(pre_corr,
+                             search_start + off * samples_per_frame, samples);
+            if (corr > best_corr)
+            {
+                best_corr = corr;
+                best_off = off;
+            }
+        }
+
+        /* Refine around the best coarse offset */
+        off = (best_off >= step) ? best_off - step + 1 : 0;
+        end = __MIN(best_off + step, frames_search);
+        best_corr = INT_MIN;
+    }
+
+    for (; off < end; off++)
+    {
+        float corr = dot(pre_corr,
+                         search_start + off * samples_per_frame, samples);
+        if (corr > best_corr)
+        {
+            best_corr = corr;
+            best_off = off;
+        }
+    }
+    return best_off;
+}
+
+#endif
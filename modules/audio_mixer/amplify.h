@@ -0,0 +1,142 @@
+/*****************************************************************************
+ * amplify.h: integer audio volume kernels
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifndef VLC_AUDIO_AMPLIFY_H
+#define VLC_AUDIO_AMPLIFY_H 1
+
+#include <vlc_common.h>
+#include <vlc_cpu.h>
+
+/* Integer volume kernels scale samples in place. They take a fixed point
+ * multiplier (8 fractional bits for S16N, 24 for S32N) and saturate. The SIMD
+ * kernels return the same results as the C ones, bit for bit.
+ * There are no float kernels: the compiler vectorizes the float mixer loops
+ * just as well. */
+
+static inline void amplify_s16_c(int16_t *p, size_t n, int_fast16_t mult)
+{
+    for (; n > 0; n--)
+    {
+        int_fast32_t s = (*p * (int_fast32_t)mult) >> 8;
+        if (s > INT16_MAX)
+            s = INT16_MAX;
+        else
+        if (s < INT16_MIN)
+            s = INT16_MIN;
+        *(p++) = s;
+    }
+}
+
+static inline void amplify_s32_c(int32_t *p, size_t n, int_fast32_t mult)
+{
+    for (; n > 0; n--)
+    {
+        int_fast64_t s = (*p * (int_fast64_t)mult) >> INT64_C(24);
+        if (s > INT32_MAX)
+            s = INT32_MAX;
+        else
+        if (s < INT32_MIN)
+            s = INT32_MIN;
+        *(p++) = s;
+    }
+}
+
+#if (defined (__i386__) || defined (__x86_64__)) && \
+    (VLC_GCC_VERSION(4, 9) || defined (__clang__))
+# define AMPLIFY_X86 1
+# include <immintrin.h>
+
+# define AMPLIFY_SSE2 __attribute__ ((__target__ ("sse2")))
+# define AMPLIFY_AVX2 __attribute__ ((__target__ ("avx2")))
+
+/* The multiplier must fit in 16 bits. */
+AMPLIFY_SSE2
+static inline void amplify_s16_sse2(int16_t *p, size_t n, int_fast16_t mult)
+{
+    const __m128i m = _mm_set1_epi16(mult);
+
+    for (; n >= 8; n -= 8, p += 8)
+    {
+        __m128i x = _mm_loadu_si128((const __m128i *)p);
+        __m128i lo = _mm_mullo_epi16(x, m), hi = _mm_mulhi_epi16(x, m);
+        __m128i a = _mm_srai_epi32(_mm_unpacklo_epi16(lo, hi), 8);
+        __m128i b = _mm_srai_epi32(_mm_unpackhi_epi16(lo, hi), 8);
+        _mm_storeu_si128((__m128i *)p, _mm_packs_epi32(a, b));
+    }
+    amplify_s16_c(p, n, mult);
+}
+
+AMPLIFY_AVX2
+static inline void amplify_s16_avx2(int16_t *p, size_t n, int_fast16_t mult)
+{
+    const __m256i m = _mm256_set1_epi16(mult);
+
+    for (; n >= 16; n -= 16, p += 16)
+    {
+        __m256i x = _mm256_loadu_si256((const __m256i *)p);
+        __m256i lo = _mm256_mullo_epi16(x, m), hi = _mm256_mulhi_epi16(x, m);
+        /* Unpacking and packing both work within 128-bits lanes */
+        __m256i a = _mm256_srai_epi32(_mm256_unpacklo_epi16(lo, hi), 8);
+        __m256i b = _mm256_srai_epi32(_mm256_unpackhi_epi16(lo, hi), 8);
+        _mm256_storeu_si256((__m256i *)p, _mm256_packs_epi32(a, b));
+    }
+    amplify_s16_c(p, n, mult);
+}
+
+/* The multiplier must fit in 32 bits. There is no signed 32x32 bits
+ * multiplication before SSE4.1, hence no SSE2 version. */
+AMPLIFY_AVX2
+static inline void amplify_s32_avx2(int32_t *p, size_t n, int_fast32_t mult)
+{
+    const __m256i m = _mm256_set1_epi32(mult);
+    const __m256i max = _mm256_set1_epi32(INT32_MAX);
+
+    for (; n >= 8; n -= 8, p += 8)
+    {
+        __m256i x = _mm256_loadu_si256((const __m256i *)p);
+        /* 64-bits products of the even and odd samples */
+        __m256i even = _mm256_mul_epi32(x, m);
+        __m256i odd = _mm256_mul_epi32(_mm256_srli_epi64(x, 32), m);
+
+        /* Bits 24 to 55 are the result if bits 55 to 63 are all equal.
+         * Otherwise, the result saturates according to the sign. The checks
+         * are computed in the odd 32-bits lanes (high halves). */
+        __m256i even_res = _mm256_srli_epi64(even, 24);
+        __m256i odd_res = _mm256_slli_epi64(_mm256_srli_epi64(odd, 24), 32);
+        __m256i even_sign = _mm256_srai_epi32(even, 31);
+        __m256i odd_sign = _mm256_srai_epi32(odd, 31);
+        __m256i even_ok = _mm256_cmpeq_epi32(_mm256_srai_epi32(even, 23),
+                                             even_sign);
+        __m256i odd_ok = _mm256_cmpeq_epi32(_mm256_srai_epi32(odd, 23),
+                                            odd_sign);
+        __m256i even_sat = _mm256_xor_si256(even_sign, max);
+        __m256i odd_sat = _mm256_xor_si256(odd_sign, max);
+
+        even_res = _mm256_blendv_epi8(_mm256_srli_epi64(even_sat, 32),
+                                      even_res,
+                                      _mm256_srli_epi64(even_ok, 32));
+        odd_res = _mm256_blendv_epi8(odd_sat, odd_res, odd_ok);
+        _mm256_storeu_si256((__m256i *)p,
+                            _mm256_blend_epi32(even_res, odd_res, 0xAA));
+    }
+    amplify_s32_c(p, n, mult);
+}
+#endif
+
+#endif
@@ -30,6 +30,8 @@
 #include <vlc_aout.h>
 #include <vlc_aout_volume.h>
 
+#include "amplify.h"
+
 static int Activate (vlc_object_t *);
 
 vlc_module_begin ()
@@ -40,48 +42,62 @@ vlc_module_begin ()
     set_callbacks (Activate, NULL)
 vlc_module_end ()
 
-static void FilterS32N (audio_volume_t *vol, block_t *block, float volume)
-{
-    int32_t *p = (int32_t *)block->p_buffer;
-
-    int_fast32_t mult = lroundf (volume * 0x1.p24f);
-    if (mult == (1 << 24))
-        return;
+#define FILTER_S32N(name, amplify) \
+static void name (audio_volume_t *vol, block_t *block, float volume) \
+{ \
+    int_fast32_t mult = lroundf (volume * 0x1.p24f); \
+    if (mult == (1 << 24)) \
+        return; \
+ \
+    amplify ((int32_t *)block->p_buffer, block->i_buffer / 4, mult); \
+    (void) vol; \
+}
 
-    for (size_t n = block->i_buffer / sizeof (*p); n > 0; n--)
-    {
-        int_fast64_t s = (*p * (int_fast64_t)mult) >> INT64_C(24);
-        if (s > INT32_MAX)
-            s = INT32_MAX;
-        else
-        if (s < INT32_MIN)
-            s = INT32_MIN;
-        *(p++) = s;
-    }
-    (void) vol;
+#define FILTER_S16N(name, amplify) \
+static void name (audio_volume_t *vol, block_t *block, float volume) \
+{ \
+    int_fast16_t mult = lroundf (volume * 0x1.p8f); \
+    if (mult == (1 << 8)) \
+        return; \
+ \
+    amplify ((int16_t *)block->p_buffer, block->i_buffer / 2, mult); \
+    (void) vol; \
 }
 
-static void FilterS16N (audio_volume_t *vol, block_t *block, float volume)
+FILTER_S32N(FilterS32N, amplify_s32_c)
+FILTER_S16N(FilterS16N, amplify_s16_c)
+
+#ifdef AMPLIFY_X86
+/* The vector multipliers are narrower: fall back for very large volumes */
+static void amplify_s32_avx2_safe (int32_t *p, size_t n, int_fast32_t mult)
 {
-    int16_t *p = (int16_t *)block->p_buffer;
+    if (mult <= INT32_MAX)
+        amplify_s32_avx2 (p, n, mult);
+    else
+        amplify_s32_c (p, n, mult);
+}
 
-    int_fast16_t mult = lroundf (volume * 0x1.p8f);
-    if (mult == (1 << 8))
-        return;
+static void amplify_s16_sse2_safe (int16_t *p, size_t n, int_fast16_t mult)
+{
+    if (mult <= INT16_MAX)
+        amplify_s16_sse2 (p, n, mult);
+    else
+        amplify_s16_c (p, n, mult);
+}
 
-    for (size_t n = block->i_buffer / sizeof (*p); n > 0; n--)
-    {
-        int_fast32_t s = (*p * (int_fast32_t)mult) >> 8;
-        if (s > INT16_MAX)
-            s = INT16_MAX;
-        else
-        if (s < INT16_MIN)
-            s = INT16_MIN;
-        *(p++) = s;
-    }
-    (void) vol;
+static void amplify_s16_avx2_safe (int16_t *p, size_t n, int_fast16_t mult)
+{
+    if (mult <= INT16_MAX)
+        amplify_s16_avx2 (p, n, mult);
+    else
+        amplify_s16_c (p, n, mult);
 }
 
+FILTER_S32N(FilterS32N_AVX2, amplify_s32_avx2_safe)
+FILTER_S16N(FilterS16N_SSE2, amplify_s16_sse2_safe)
+FILTER_S16N(FilterS16N_AVX2, amplify_s16_avx2_safe)
+#endif
+
 static void FilterU8 (audio_volume_t *vol, block_t *block, float volume)
 {
     uint8_t *p = (uint8_t *)block->p_buffer;
@@ -111,9 +127,19 @@ static int Activate (vlc_object_t *obj)
     {
         case VLC_CODEC_S32N:
             vol->amplify = FilterS32N;
+#ifdef AMPLIFY_X86
+            if (vlc_CPU_AVX2 ())
+                vol->amplify = FilterS32N_AVX2;
+#endif
             break;
         case VLC_CODEC_S16N:
             vol->amplify = FilterS16N;
+#ifdef AMPLIFY_X86
+            if (vlc_CPU_AVX2 ())
+                vol->amplify = FilterS16N_AVX2;
+            else if (vlc_CPU_SSE2 ())
+                vol->amplify = FilterS16N_SSE2;
+#endif
             break;
         case VLC_CODEC_U8:
             vol->amplify = FilterU8;
@@ -116,6 +116,11 @@ void ffmpeg_CloseCodec( decoder_t *p_dec );
 #define THREADS_TEXT N_( "Threads" )
 #define THREADS_LONGTEXT N_( "Number of threads used for decoding, 0 meaning auto" )
 
+#define THREADS_BUDGET_TEXT N_( "Threads budget" )
+#define THREADS_BUDGET_LONGTEXT N_( "Number of threads shared by all the " \
+    "video decoders with an automatic thread count, 0 meaning the number " \
+    "of CPUs plus one" )
+
 /*
  * Encoder options
  */
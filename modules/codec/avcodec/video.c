@@ -43,6 +43,10 @@
 #include "avcodec.h"
 #include "va.h"
 
+#include "../../packetizer/hxxx_nal.h"
+#include "../../packetizer/h264_nal.h"
+#include "../../packetizer/hevc_nal.h"
+
 /*****************************************************************************
  * decoder_sys_t : decoder descriptor
  *****************************************************************************/
@@ -79,6 +83,22 @@ struct decoder_sys_t
     int level;
 
     vlc_sem_t sem_mt;
+
+#ifdef HAVE_AVCODEC_MT
+    /* Decoding threads governor */
+    struct
+    {
+        bool     b_auto;     /* adapt the thread count to the load */
+        int      i_budget;   /* threads of all the decoders */
+        int      i_max;      /* most threads this decoder may use */
+        int      i_reserved; /* threads taken from the global budget */
+        int      i_wanted;   /* thread count to switch to at an IDR frame,
+                                not reserved until then */
+        bool     b_drain;    /* waiting for the frames of the old threads */
+        mtime_t  i_busy;     /* time spent in libavcodec this period */
+        unsigned i_frames;   /* frames decoded this period */
+    } threads;
+#endif
 };
 
 #ifdef HAVE_AVCODEC_MT
@@ -96,6 +116,60 @@ static inline void post_mt(decoder_sys_t *sys)
 # define post_mt(s) ((void)s)
 #endif
 
+#ifdef HAVE_AVCODEC_MT
+/* Decoding threads of all the video decoders of the process */
+static vlc_mutex_t threads_lock = VLC_STATIC_MUTEX;
+static int threads_used = 0;
+
+/* Frames per load measurement */
+#define THREADS_PERIOD 48
+
+/**
+ * Takes up to count threads from the global budget of budget threads, and
+ * at least min of them even if that exceeds the budget.
+ */
+static int lavc_ThreadsReserve( int budget, int count, int min )
+{
+    vlc_mutex_lock( &threads_lock );
+    if( count > budget - threads_used )
+        count = __MAX( budget - threads_used, min );
+    threads_used += count;
+    vlc_mutex_unlock( &threads_lock );
+    return count;
+}
+
+/* Returns the number of threads left in the global budget */
+static int lavc_ThreadsAvailable( int budget )
+{
+    vlc_mutex_lock( &threads_lock );
+    int count = budget - threads_used;
+    vlc_mutex_unlock( &threads_lock );
+    return count;
+}
+
+static void lavc_ThreadsRelease( int count )
+{
+    vlc_mutex_lock( &threads_lock );
+    threads_used -= count;
+    assert( threads_used >= 0 );
+    vlc_mutex_unlock( &threads_lock );
+}
+
+/* Gives back the threads reserved beyond the current count */
+static void lavc_ThreadsSettle( decoder_sys_t *p_sys )
+{
+    int i_count = p_sys->p_context->thread_count;
+
+    p_sys->threads.b_drain = false;
+    p_sys->threads.i_wanted = i_count;
+    if( p_sys->threads.b_auto && p_sys->threads.i_reserved > i_count )
+    {
+        lavc_ThreadsRelease( p_sys->threads.i_reserved - i_count );
+        p_sys->threads.i_reserved = i_count;
+    }
+}
+#endif
+
 /*****************************************************************************
  * Local prototypes
  *****************************************************************************/
@@ -105,6 +179,9 @@ static enum PixelFormat ffmpeg_GetFormat( AVCodecContext *,
                                           const enum PixelFormat * );
 static picture_t *DecodeVideo( decoder_t *, block_t ** );
 static void Flush( decoder_t * );
+#ifdef HAVE_AVCODEC_MT
+static int lavc_ThreadsSwitch( decoder_t * );
+#endif
 
 static uint32_t ffmpeg_CodecTag( vlc_fourcc_t fcc )
 {
@@ -479,17 +556,28 @@ int InitVideoDec( decoder_t *p_dec, AVCodecContext *p_context,
 
 #ifdef HAVE_AVCODEC_MT
     int i_thread_count = var_InheritInteger( p_dec, "avcodec-threads" );
-    if( i_thread_count <= 0 )
+    p_sys->threads.b_auto = i_thread_count <= 0;
+    if( p_sys->threads.b_auto )
     {
+        int i_budget = var_InheritInteger( p_dec, "avcodec-threads-budget" );
+        if( i_budget <= 0 )
+            i_budget = vlc_GetCPUCount() + 1;
+
+        /* Start with a few threads, the load decides afterwards */
         i_thread_count = vlc_GetCPUCount();
         if( i_thread_count > 1 )
             i_thread_count++;
-
-        //FIXME: take in count the decoding time
         i_thread_count = __MIN( i_thread_count, 4 );
+
+        p_sys->threads.i_budget = i_budget;
+        p_sys->threads.i_max = __MIN( i_budget, 16 );
+        i_thread_count = lavc_ThreadsReserve( i_budget,
+                                    __MIN( i_thread_count, 16 ), 1 );
+        p_sys->threads.i_reserved = i_thread_count;
     }
     i_thread_count = __MIN( i_thread_count, 16 );
     msg_Dbg( p_dec, "allowing %d thread(s) for decoding", i_thread_count );
+    var_Create( p_dec, "avcodec-threads-active", VLC_VAR_INTEGER );
     p_context->thread_count = i_thread_count;
     p_context->thread_safe_callbacks = true;
 
@@ -547,11 +635,21 @@ int InitVideoDec( decoder_t *p_dec, AVCodecContext *p_context,
     /* ***** Open the codec ***** */
     if( OpenVideoCodec( p_dec ) < 0 )
     {
+#ifdef HAVE_AVCODEC_MT
+        lavc_ThreadsRelease( p_sys->threads.i_reserved );
+        var_Destroy( p_dec, "avcodec-threads-active" );
+#endif
         vlc_sem_destroy( &p_sys->sem_mt );
         free( p_sys );
         return VLC_EGENERIC;
     }
 
+#ifdef HAVE_AVCODEC_MT
+    /* libavcodec lowers the count for codecs without threading */
+    lavc_ThreadsSettle( p_sys );
+    var_SetInteger( p_dec, "avcodec-threads-active", p_context->thread_count );
+#endif
+
     p_dec->pf_decode_video = DecodeVideo;
     p_dec->pf_flush        = Flush;
 
@@ -582,6 +680,20 @@ static void Flush( decoder_t *p_dec )
 
     /* Reset cancel state to false */
     decoder_AbortPictures( p_dec, false );
+
+#ifdef HAVE_AVCODEC_MT
+    /* The frames to drain are gone: switch now if wanted */
+    if( p_sys->threads.b_auto && avcodec_is_open( p_context )
+     && p_sys->threads.i_wanted != p_context->thread_count )
+    {
+        if( lavc_ThreadsSwitch( p_dec ) )
+            p_dec->b_error = true;
+    }
+    else
+        lavc_ThreadsSettle( p_sys );
+    p_sys->threads.i_busy = 0;
+    p_sys->threads.i_frames = 0;
+#endif
 }
 
 static bool check_block_validity( decoder_sys_t *p_sys, block_t *block )
@@ -703,6 +815,168 @@ static void update_late_frame_count( decoder_t *p_dec, block_t *p_block, mtime_t
 }
 
 
+#ifdef HAVE_AVCODEC_MT
+/* Returns the duration of a frame, or 0 if unknown */
+static mtime_t lavc_FrameDuration( decoder_t *p_dec )
+{
+    AVCodecContext *p_context = p_dec->p_sys->p_context;
+
+    if( p_dec->fmt_in.video.i_frame_rate > 0 &&
+        p_dec->fmt_in.video.i_frame_rate_base > 0 )
+        return CLOCK_FREQ * p_dec->fmt_in.video.i_frame_rate_base /
+               p_dec->fmt_in.video.i_frame_rate;
+
+    if( p_context->time_base.den > 0 )
+        return CLOCK_FREQ * __MAX( p_context->ticks_per_frame, 1 ) *
+               p_context->time_base.num / p_context->time_base.den;
+    return 0;
+}
+
+/**
+ * Compares the time spent in libavcodec with the duration of the decoded
+ * frames, and picks the thread count for the next IDR frame: more threads
+ * when falling behind, fewer when most of the time is spare, so that other
+ * decoders can use them.
+ * The next IDR frame may be far away, or never come (open GOP streams and
+ * codecs other than H.264 and HEVC switch on flush only): the threads are
+ * not reserved until the switch, and a pending decision is reconsidered on
+ * every period.
+ */
+static void lavc_ThreadsUpdate( decoder_t *p_dec )
+{
+    decoder_sys_t *p_sys = p_dec->p_sys;
+    AVCodecContext *p_context = p_sys->p_context;
+
+    if( ++p_sys->threads.i_frames < THREADS_PERIOD )
+        return;
+
+    mtime_t i_duration = lavc_FrameDuration( p_dec ) * p_sys->threads.i_frames;
+    mtime_t i_busy = p_sys->threads.i_busy;
+
+    p_sys->threads.i_busy = 0;
+    p_sys->threads.i_frames = 0;
+
+    if( i_duration <= 0 || p_sys->p_va != NULL
+     || p_context->active_thread_type == 0 || p_sys->threads.b_drain )
+        return;
+
+    int i_count = p_context->thread_count;
+    int i_wanted = i_count;
+
+    if( i_busy > i_duration * 3 / 4 || p_sys->i_late_frames > 0 )
+    {
+        int i_more = __MIN( __MAX( i_count / 2, 1 ),
+                            p_sys->threads.i_max - i_count );
+        i_more = __MIN( i_more, p_sys->threads.i_reserved - i_count +
+                        lavc_ThreadsAvailable( p_sys->threads.i_budget ) );
+        if( i_more > 0 )
+            i_wanted += i_more;
+    }
+    else if( i_busy < i_duration / 4 && i_count > 1 )
+        i_wanted -= __MAX( i_count / 4, 1 );
+
+    if( i_wanted == p_sys->threads.i_wanted )
+        return;
+
+    p_sys->threads.i_wanted = i_wanted;
+    msg_Dbg( p_dec, "decoding load %"PRId64"%%: %d thread(s) from the next "
+             "IDR frame", 100 * i_busy / i_duration, i_wanted );
+}
+
+/**
+ * Tells whether the block starts an access unit that does not reference any
+ * previous one (IDR), so that a reopened codec can decode it and the next
+ * ones. Other I-frames may be followed by frames referencing the previous
+ * group of pictures (open GOP).
+ */
+static bool lavc_ThreadsCanSwitchAt( decoder_t *p_dec, const block_t *p_block )
+{
+    vlc_fourcc_t i_codec = p_dec->fmt_in.i_codec;
+
+    if( !(p_block->i_flags & BLOCK_FLAG_TYPE_I)
+     || (i_codec != VLC_CODEC_H264 && i_codec != VLC_CODEC_HEVC) )
+        return false;
+
+    hxxx_iterator_ctx_t it;
+    const uint8_t *p_nal;
+    size_t i_nal;
+
+    hxxx_iterator_init( &it, p_block->p_buffer, p_block->i_buffer, 0 );
+    while( hxxx_annexb_iterate_next( &it, &p_nal, &i_nal ) )
+    {
+        if( i_nal < 1 )
+            continue;
+        if( i_codec == VLC_CODEC_H264 )
+        {
+            if( (p_nal[0] & 0x1f) == H264_NAL_SLICE_IDR )
+                return true;
+        }
+        else
+        {
+            uint8_t i_type = (p_nal[0] & 0x7e) >> 1;
+            if( i_type == HEVC_NAL_IDR_W_RADL || i_type == HEVC_NAL_IDR_N_LP )
+                return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Reopens the codec with the wanted thread count. libavcodec cannot change
+ * it on an open codec, so this must be done at an IDR frame, once all the
+ * frames have been drained, or on flush.
+ */
+static int lavc_ThreadsSwitch( decoder_t *p_dec )
+{
+    decoder_sys_t *p_sys = p_dec->p_sys;
+    AVCodecContext *p_context = p_sys->p_context;
+    int i_old = p_context->thread_count;
+    int i_new = p_sys->threads.i_wanted;
+
+    /* Take the extra threads now, other decoders may have taken them since
+     * the decision */
+    if( i_new > p_sys->threads.i_reserved )
+        p_sys->threads.i_reserved +=
+            lavc_ThreadsReserve( p_sys->threads.i_budget,
+                                 i_new - p_sys->threads.i_reserved, 0 );
+    i_new = __MIN( i_new, p_sys->threads.i_reserved );
+
+    if( i_new == i_old )
+    {   /* None left: keep the threads, resume from the drained state */
+        if( p_sys->threads.b_drain )
+        {
+            post_mt( p_sys );
+            avcodec_flush_buffers( p_context );
+            wait_mt( p_sys );
+        }
+        lavc_ThreadsSettle( p_sys );
+        return VLC_SUCCESS;
+    }
+
+    /* Frame threads hold pictures: past the count the output pictures were
+     * allocated for, do not decode directly into them anymore */
+    if( (p_context->thread_type & FF_THREAD_FRAME)
+     && 2 * i_new > p_dec->i_extra_picture_buffers )
+        p_sys->b_direct_rendering = false;
+
+    msg_Dbg( p_dec, "switching from %d to %d decoding thread(s)",
+             i_old, i_new );
+    ffmpeg_CloseCodec( p_dec );
+    p_context->thread_count = i_new;
+    int ret = OpenVideoCodec( p_dec );
+    if( ret != 0 )
+    {
+        p_context->thread_count = i_old;
+        ret = OpenVideoCodec( p_dec );
+    }
+
+    lavc_ThreadsSettle( p_sys );
+    var_SetInteger( p_dec, "avcodec-threads-active",
+                    p_context->thread_count );
+    return ret == 0 ? VLC_SUCCESS : VLC_EGENERIC;
+}
+#endif
+
 /*****************************************************************************
  * DecodeVideo: Called to decode one or more frames
  *****************************************************************************/
@@ -716,6 +990,9 @@ static picture_t *DecodeVideo( decoder_t *p_dec, block_t **pp_block )
     /* Boolean for END_OF_SEQUENCE */
     bool eos_spotted = false;
 
+    /* Boolean if the frames are drained before the block is decoded */
+    bool b_drain = false;
+
 
     block_t *p_block;
     mtime_t current_time = VLC_TS_INVALID;
@@ -741,8 +1018,16 @@ static picture_t *DecodeVideo( decoder_t *p_dec, block_t **pp_block )
     if( !check_block_validity( p_sys, p_block ) )
         return NULL;
 
+    bool b_drop_allowed = p_dec->b_frame_drop_allowed;
+#ifdef HAVE_AVCODEC_MT
+    /* The frames were drained for this IDR frame, the threads switch at it:
+     * the next frames would not decode without it */
+    if( p_sys->threads.b_drain )
+        b_drop_allowed = false;
+#endif
+
     current_time = mdate();
-    if( p_dec->b_frame_drop_allowed &&  check_block_being_late( p_sys, p_block, current_time) )
+    if( b_drop_allowed && check_block_being_late( p_sys, p_block, current_time) )
     {
         msg_Err( p_dec, "more than 5 seconds of late video -> "
                  "dropping frame (computer too slow ?)" );
@@ -766,7 +1051,7 @@ static picture_t *DecodeVideo( decoder_t *p_dec, block_t **pp_block )
 
         /* Check also if we should/can drop the block and move to next block
             as trying to catchup the speed*/
-        if( p_dec->b_frame_drop_allowed &&
+        if( b_drop_allowed &&
             check_frame_should_be_dropped( p_sys, p_context, &b_need_output_picture ) )
         {
             if( p_block )
@@ -781,6 +1066,17 @@ static picture_t *DecodeVideo( decoder_t *p_dec, block_t **pp_block )
                                               AVDISCARD_NONREF );
     }
 
+#ifdef HAVE_AVCODEC_MT
+    /* Switch threads at an IDR frame only, once the frames of the current
+     * threads are out. The block is kept meanwhile: it is passed again as
+     * long as pictures are returned. */
+    if( p_block && p_sys->threads.b_auto
+     && p_sys->threads.i_wanted != p_context->thread_count
+     && lavc_ThreadsCanSwitchAt( p_dec, p_block ) )
+        p_sys->threads.b_drain = true;
+    b_drain = p_sys->threads.b_drain;
+#endif
+
     /*
      * Do the actual decoding now */
 
@@ -808,7 +1104,7 @@ static picture_t *DecodeVideo( decoder_t *p_dec, block_t **pp_block )
         post_mt( p_sys );
 
         av_init_packet( &pkt );
-        if( p_block )
+        if( p_block && !b_drain )
         {
             pkt.data = p_block->p_buffer;
             pkt.size = p_block->i_buffer;
@@ -832,13 +1128,18 @@ static picture_t *DecodeVideo( decoder_t *p_dec, block_t **pp_block )
         }
 
         /* Make sure we don't reuse the same timestamps twice */
-        if( p_block )
+        if( p_block && !b_drain )
         {
             p_block->i_pts =
             p_block->i_dts = VLC_TS_INVALID;
         }
 
+#ifdef HAVE_AVCODEC_MT
+        mtime_t i_busy_start = mdate();
+#endif
         int ret = avcodec_send_packet(p_context, &pkt);
+        if( b_drain && ret == AVERROR_EOF )
+            ret = 0; /* already draining */
         if( ret != 0 && ret != AVERROR(EAGAIN) )
         {
             if (ret == AVERROR(ENOMEM) || ret == AVERROR(EINVAL))
@@ -860,6 +1161,22 @@ static picture_t *DecodeVideo( decoder_t *p_dec, block_t **pp_block )
         }
 
         ret = avcodec_receive_frame(p_context, frame);
+#ifdef HAVE_AVCODEC_MT
+        p_sys->threads.i_busy += mdate() - i_busy_start;
+
+        if( b_drain && ret == AVERROR_EOF )
+        {
+            av_frame_free(&frame);
+            wait_mt( p_sys );
+            if( lavc_ThreadsSwitch( p_dec ) )
+            {
+                p_dec->b_error = true;
+                break;
+            }
+            /* Now decode the IDR frame with the new threads */
+            return DecodeVideo( p_dec, pp_block );
+        }
+#endif
         if( ret != 0 && ret != AVERROR(EAGAIN) )
         {
             if (ret == AVERROR(ENOMEM) || ret == AVERROR(EINVAL))
@@ -877,7 +1194,7 @@ static picture_t *DecodeVideo( decoder_t *p_dec, block_t **pp_block )
         if( eos_spotted )
             p_sys->b_first_frame = true;
 
-        if( p_block )
+        if( p_block && !b_drain )
         {
             if( p_block->i_buffer <= 0 )
                 eos_spotted = false;
@@ -895,6 +1212,11 @@ static picture_t *DecodeVideo( decoder_t *p_dec, block_t **pp_block )
             continue;
         }
 
+#ifdef HAVE_AVCODEC_MT
+        if( p_sys->threads.b_auto )
+            lavc_ThreadsUpdate( p_dec );
+#endif
+
         /* Compute the PTS */
 #ifdef FF_API_PKT_PTS
         mtime_t i_pts = frame->pts;
@@ -1011,6 +1333,16 @@ static picture_t *DecodeVideo( decoder_t *p_dec, block_t **pp_block )
             picture_Release( p_pic );
     }
 
+#ifdef HAVE_AVCODEC_MT
+    if( b_drain )
+    {   /* Could not drain: leave the draining mode, keep the threads */
+        post_mt( p_sys );
+        if( avcodec_is_open( p_context ) )
+            avcodec_flush_buffers( p_context );
+        wait_mt( p_sys );
+        lavc_ThreadsSettle( p_sys );
+    }
+#endif
     if( p_block )
         block_Release( p_block );
     return NULL;
@@ -1039,6 +1371,11 @@ void EndVideoDec( decoder_t *p_dec )
     if( p_sys->p_va )
         vlc_va_Delete( p_sys->p_va, p_sys->p_context );
 
+#ifdef HAVE_AVCODEC_MT
+    if( p_sys->threads.b_auto )
+        lavc_ThreadsRelease( p_sys->threads.i_reserved );
+    var_Destroy( p_dec, "avcodec-threads-active" );
+#endif
     vlc_sem_destroy( &p_sys->sem_mt );
 }
 
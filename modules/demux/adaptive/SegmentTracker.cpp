@@ -86,6 +86,7 @@ SegmentTracker::SegmentTracker(AbstractAdaptationLogic *logic_, BaseAdaptationSe
     setAdaptationLogic(logic_);
     adaptationSet = adaptSet;
     format = StreamFormat::UNSUPPORTED;
+    prefetchDepth = 0;
 }
 
 SegmentTracker::~SegmentTracker()
@@ -93,6 +94,73 @@ SegmentTracker::~SegmentTracker()
     reset();
 }
 
+SegmentTracker::PrefetchedChunk::PrefetchedChunk(BaseRepresentation *rep_,
+                                                 uint64_t number_, SegmentChunk *chunk_)
+{
+    rep = rep_;
+    number = number_;
+    chunk = chunk_;
+}
+
+void SegmentTracker::setPrefetchDepth(unsigned depth)
+{
+    prefetchDepth = depth;
+    if(prefetched.size() > depth)
+        clearPrefetched();
+}
+
+void SegmentTracker::clearPrefetched()
+{
+    std::list<PrefetchedChunk>::const_iterator it;
+    for(it = prefetched.begin(); it != prefetched.end(); ++it)
+        delete (*it).chunk;
+    prefetched.clear();
+}
+
+SegmentChunk * SegmentTracker::getMediaChunk(ISegment *segment, uint64_t number,
+                                             BaseRepresentation *rep,
+                                             AbstractConnectionManager *connManager)
+{
+    /* Drop anything we won't read anymore (switch, seek, gap) */
+    while(!prefetched.empty())
+    {
+        const PrefetchedChunk &pc = prefetched.front();
+        if(pc.rep == rep && pc.number == number)
+        {
+            SegmentChunk *chunk = pc.chunk;
+            prefetched.pop_front();
+            return chunk;
+        }
+        delete pc.chunk;
+        prefetched.pop_front();
+    }
+    return segment->toChunk(number, rep, connManager);
+}
+
+void SegmentTracker::prefetchChunks(uint64_t number, BaseRepresentation *rep,
+                                    AbstractConnectionManager *connManager)
+{
+    /* Live segments past the edge might not be available yet */
+    if(prefetchDepth == 0 || rep->getPlaylist()->isLive())
+        return;
+
+    if(!prefetched.empty())
+        number = prefetched.back().number;
+
+    while(prefetched.size() < prefetchDepth)
+    {
+        bool b_gap;
+        ISegment *segment = rep->getNextSegment(BaseRepresentation::INFOTYPE_MEDIA,
+                                                number + 1, &number, &b_gap);
+        if(!segment)
+            break;
+        SegmentChunk *chunk = segment->toChunk(number, rep, connManager);
+        if(!chunk)
+            break;
+        prefetched.push_back(PrefetchedChunk(rep, number, chunk));
+    }
+}
+
 void SegmentTracker::setAdaptationLogic(AbstractAdaptationLogic *logic_)
 {
     logic = logic_;
@@ -126,6 +194,7 @@ bool SegmentTracker::segmentsListReady() const
 
 void SegmentTracker::reset()
 {
+    clearPrefetched();
     notify(SegmentTrackerEvent(curRepresentation, NULL));
     curRepresentation = NULL;
     init_sent = false;
@@ -164,6 +233,7 @@ SegmentChunk * SegmentTracker::getNextChunk(bool switch_allowed,
 
     if(rep != curRepresentation)
     {
+        clearPrefetched();
         notify(SegmentTrackerEvent(curRepresentation, rep));
         prevRep = curRepresentation;
         curRepresentation = rep;
@@ -246,7 +316,7 @@ SegmentChunk * SegmentTracker::getNextChunk(bool switch_allowed,
         initializing = false;
     }
 
-    SegmentChunk *chunk = segment->toChunk(next, rep, connManager);
+    SegmentChunk *chunk = getMediaChunk(segment, next, rep, connManager);
 
     /* Notify new segment length for stats / logic */
     if(chunk)
@@ -273,6 +343,7 @@ SegmentChunk * SegmentTracker::getNextChunk(bool switch_allowed,
     {
         curNumber = next;
         next++;
+        prefetchChunks(curNumber, rep, connManager);
     }
 
     return chunk;
@@ -303,6 +374,8 @@ void SegmentTracker::setPositionByNumber(uint64_t segnumber, bool restarted)
         index_sent = false;
         init_sent = false;
     }
+    if(segnumber != next)
+        clearPrefetched();
     curNumber = next = segnumber;
 }
 
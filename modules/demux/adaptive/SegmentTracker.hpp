@@ -44,6 +44,7 @@ namespace adaptive
         class BaseAdaptationSet;
         class BaseRepresentation;
         class SegmentChunk;
+        class ISegment;
     }
 
     using namespace playlist;
@@ -126,10 +127,23 @@ namespace adaptive
             void notifyBufferingLevel(mtime_t, mtime_t) const;
             void registerListener(SegmentTrackerListenerInterface *);
             void updateSelected();
+            void setPrefetchDepth(unsigned);
 
         private:
+            class PrefetchedChunk
+            {
+                public:
+                    PrefetchedChunk(BaseRepresentation *, uint64_t, SegmentChunk *);
+                    BaseRepresentation *rep;
+                    uint64_t number;
+                    SegmentChunk *chunk;
+            };
             void setAdaptationLogic(AbstractAdaptationLogic *);
             void notify(const SegmentTrackerEvent &) const;
+            SegmentChunk * getMediaChunk(ISegment *, uint64_t, BaseRepresentation *,
+                                         AbstractConnectionManager *);
+            void prefetchChunks(uint64_t, BaseRepresentation *, AbstractConnectionManager *);
+            void clearPrefetched();
             bool first;
             bool initializing;
             bool index_sent;
@@ -141,6 +155,8 @@ namespace adaptive
             BaseAdaptationSet *adaptationSet;
             BaseRepresentation *curRepresentation;
             std::list<SegmentTrackerListenerInterface *> listeners;
+            unsigned prefetchDepth;
+            std::list<PrefetchedChunk> prefetched; /* next media chunks, in order */
     };
 }
 
@@ -28,39 +28,91 @@
 
 using namespace adaptive::http;
 
+DownloaderStats::DownloaderStats()
+{
+    workers = 0;
+    peak = 0;
+    sources = 0;
+    busytime = 0;
+    uptime = 0;
+}
+
+double DownloaderStats::getAverageConcurrency() const
+{
+    if(uptime <= 0)
+        return 0.0;
+    return (double) busytime / uptime;
+}
+
+Downloader::StreamQueue::StreamQueue(const ID &id_) :
+    id(id_)
+{
+
+}
+
 Downloader::Downloader()
 {
     vlc_mutex_init(&lock);
     vlc_cond_init(&waitcond);
+    vlc_cond_init(&updatedcond);
     killed = false;
-    thread_handle_valid = false;
+    nextqueue = queues.end();
+    starttime = 0;
 }
 
-bool Downloader::start()
+bool Downloader::start(unsigned workers)
 {
-    if(!thread_handle_valid &&
-       vlc_clone(&thread_handle, downloaderThread,
-                 reinterpret_cast<void *>(this), VLC_THREAD_PRIORITY_INPUT))
+    vlc_mutex_lock(&lock);
+    if(!threads.empty())
+    {
+        vlc_mutex_unlock(&lock);
+        return true;
+    }
+
+    if(workers == 0)
+        workers = 1;
+    threads.reserve(workers);
+    for(unsigned i=0; i<workers; i++)
     {
-        return false;
+        vlc_thread_t th;
+        if(vlc_clone(&th, downloaderThread,
+                     reinterpret_cast<void *>(this), VLC_THREAD_PRIORITY_INPUT))
+            break;
+        threads.push_back(th);
     }
-    thread_handle_valid = true;
-    return true;
+    stats.workers = threads.size();
+    starttime = mdate();
+    vlc_mutex_unlock(&lock);
+
+    return !threads.empty();
 }
 
 Downloader::~Downloader()
 {
+    vlc_mutex_lock(&lock);
     killed = true;
-    vlc_cond_signal(&waitcond);
-    if(thread_handle_valid)
-        vlc_join(thread_handle, NULL);
-    vlc_mutex_destroy(&lock);
+    vlc_cond_broadcast(&waitcond);
+    vlc_mutex_unlock(&lock);
+    std::vector<vlc_thread_t>::const_iterator it;
+    for(it = threads.begin(); it != threads.end(); ++it)
+        vlc_join(*it, NULL);
+    vlc_cond_destroy(&updatedcond);
     vlc_cond_destroy(&waitcond);
+    vlc_mutex_destroy(&lock);
 }
+
 void Downloader::schedule(HTTPChunkBufferedSource *source)
 {
     vlc_mutex_lock(&lock);
-    chunks.push_back(source);
+    std::list<StreamQueue>::iterator it;
+    for(it = queues.begin(); it != queues.end(); ++it)
+    {
+        if((*it).id == source->sourceid)
+            break;
+    }
+    if(it == queues.end())
+        it = queues.insert(queues.end(), StreamQueue(source->sourceid));
+    (*it).chunks.push_back(source);
     vlc_cond_signal(&waitcond);
     vlc_mutex_unlock(&lock);
 }
@@ -68,10 +120,23 @@ void Downloader::schedule(HTTPChunkBufferedSource *source)
 void Downloader::cancel(HTTPChunkBufferedSource *source)
 {
     vlc_mutex_lock(&lock);
-    chunks.remove(source);
+    /* Can't release a source a worker is still writing to */
+    while(isBusy(source))
+        vlc_cond_wait(&updatedcond, &lock);
+    remove(source);
     vlc_mutex_unlock(&lock);
 }
 
+DownloaderStats Downloader::getStats() const
+{
+    vlc_mutex_lock(const_cast<vlc_mutex_t *>(&lock));
+    DownloaderStats ret = stats;
+    if(starttime)
+        ret.uptime = mdate() - starttime;
+    vlc_mutex_unlock(const_cast<vlc_mutex_t *>(&lock));
+    return ret;
+}
+
 void * Downloader::downloaderThread(void *opaque)
 {
     Downloader *instance = reinterpret_cast<Downloader *>(opaque);
@@ -87,31 +152,118 @@ void Downloader::DownloadSource(HTTPChunkBufferedSource *source)
         source->bufferize(HTTPChunkSource::CHUNK_SIZE);
 }
 
-void Downloader::Run()
+bool Downloader::isBusy(const HTTPChunkBufferedSource *source) const
 {
-    while(1)
+    std::vector<HTTPChunkBufferedSource *>::const_iterator it;
+    for(it = current.begin(); it != current.end(); ++it)
     {
-        vlc_mutex_lock(&lock);
-        if(killed)
+        if(*it == source)
+            return true;
+    }
+    return false;
+}
+
+void Downloader::remove(HTTPChunkBufferedSource *source)
+{
+    std::list<StreamQueue>::iterator it;
+    for(it = queues.begin(); it != queues.end(); ++it)
+    {
+        StreamQueue &queue = *it;
+        if(queue.id == source->sourceid)
+        {
+            queue.chunks.remove(source);
+            if(queue.chunks.empty())
+            {
+                if(nextqueue == it)
+                    ++nextqueue;
+                queues.erase(it);
+            }
             break;
+        }
+    }
+}
 
-        while(chunks.empty() && !killed)
+HTTPChunkBufferedSource * Downloader::getNextSource()
+{
+    if(queues.empty())
+        return NULL;
+
+    /* Streams are served round robin. First pass only considers the
+     * segment each stream is currently reading from, second pass
+     * allows fetching the prefetched ones. */
+    for(int pass = 0; pass < 2; pass++)
+    {
+        std::list<StreamQueue>::iterator it = nextqueue;
+        for(size_t i=0; i<queues.size(); i++, ++it)
         {
-            vlc_cond_wait(&waitcond, &lock);
+            if(it == queues.end())
+                it = queues.begin();
+
+            std::list<HTTPChunkBufferedSource *> &chunks = (*it).chunks;
+            std::list<HTTPChunkBufferedSource *>::const_iterator cit;
+            for(cit = chunks.begin(); cit != chunks.end(); ++cit)
+            {
+                if(!isBusy(*cit))
+                {
+                    nextqueue = it;
+                    ++nextqueue;
+                    return *cit;
+                }
+                if(pass == 0)
+                    break;
+            }
         }
+    }
 
+    return NULL;
+}
+
+void Downloader::Run()
+{
+    vlc_mutex_lock(&lock);
+    while(1)
+    {
         if(killed)
             break;
 
-        if(!chunks.empty())
+        HTTPChunkBufferedSource *source = getNextSource();
+        if(!source)
         {
-            HTTPChunkBufferedSource *source = chunks.front();
-            DownloadSource(source);
-            if(source->isDone())
-                chunks.pop_front();
+            vlc_cond_wait(&waitcond, &lock);
+            continue;
         }
 
+        current.push_back(source);
+        if(current.size() > stats.peak)
+            stats.peak = current.size();
         vlc_mutex_unlock(&lock);
+
+        const mtime_t time = mdate();
+        DownloadSource(source);
+        const mtime_t elapsed = mdate() - time;
+
+        vlc_mutex_lock(&lock);
+        stats.busytime += elapsed;
+        for(std::vector<HTTPChunkBufferedSource *>::iterator it = current.begin();
+            it != current.end(); ++it)
+        {
+            if(*it == source)
+            {
+                current.erase(it);
+                break;
+            }
+        }
+        if(source->isDone())
+        {
+            stats.sources++;
+            remove(source);
+        }
+        else
+        {
+            /* remaining data can be fetched by any worker */
+            vlc_cond_signal(&waitcond);
+        }
+        vlc_cond_broadcast(&updatedcond);
     }
     vlc_mutex_unlock(&lock);
 }
@@ -24,6 +24,7 @@
 
 #include <vlc_common.h>
 #include <list>
+#include <vector>
 
 namespace adaptive
 {
@@ -31,26 +32,53 @@ namespace adaptive
     namespace http
     {
 
+        class DownloaderStats
+        {
+            public:
+                DownloaderStats();
+                unsigned     workers;        /* pool size */
+                unsigned     peak;           /* max simultaneous downloads */
+                uint64_t     sources;        /* completed sources */
+                mtime_t      busytime;       /* sum of all workers download time */
+                mtime_t      uptime;         /* time since pool start */
+                double       getAverageConcurrency() const;
+        };
+
         class Downloader
         {
             public:
                 Downloader();
                 ~Downloader();
-                bool start();
+                bool start(unsigned = 1);
                 void schedule(HTTPChunkBufferedSource *);
                 void cancel(HTTPChunkBufferedSource *);
+                DownloaderStats getStats() const;
 
             private:
+                class StreamQueue
+                {
+                    public:
+                        StreamQueue(const ID &);
+                        ID id;
+                        std::list<HTTPChunkBufferedSource *> chunks;
+                };
+
                 static void * downloaderThread(void *);
                 void Run();
                 void DownloadSource(HTTPChunkBufferedSource *);
-                vlc_thread_t thread_handle;
+                HTTPChunkBufferedSource * getNextSource();
+                bool isBusy(const HTTPChunkBufferedSource *) const;
+                void remove(HTTPChunkBufferedSource *);
+                std::vector<vlc_thread_t> threads;
                 vlc_mutex_t  lock;
                 vlc_cond_t   waitcond;
-                vlc_mutex_t  processlock;
-                bool         thread_handle_valid;
+                vlc_cond_t   updatedcond;
                 bool         killed;
-                std::list<HTTPChunkBufferedSource *> chunks;
+                std::list<StreamQueue> queues; /* one per stream ID */
+                std::list<StreamQueue>::iterator nextqueue; /* round robin */
+                std::vector<HTTPChunkBufferedSource *> current; /* being bufferized */
+                DownloaderStats stats;
+                mtime_t      starttime;
         };
 
     }
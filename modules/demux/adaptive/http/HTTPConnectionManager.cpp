@@ -62,7 +62,11 @@ HTTPConnectionManager::HTTPConnectionManager    (vlc_object_t *p_object_, Connec
 {
     vlc_mutex_init(&lock);
     downloader = new (std::nothrow) Downloader();
-    downloader->start();
+    if(downloader)
+    {
+        int64_t workers = var_InheritInteger(p_object, "adaptive-downloads");
+        downloader->start(workers > 0 ? workers : 1);
+    }
     if(!factory_)
     {
         if(var_InheritBool(p_object, "adaptive-use-access"))
@@ -75,6 +79,13 @@ HTTPConnectionManager::HTTPConnectionManager    (vlc_object_t *p_object_, Connec
 }
 HTTPConnectionManager::~HTTPConnectionManager   ()
 {
+    if(downloader)
+    {
+        const DownloaderStats stats = downloader->getStats();
+        msg_Dbg(p_object, "downloaded %" PRIu64 " segments using %u/%u workers"
+                          " (average concurrency %.2f)", stats.sources,
+                          stats.peak, stats.workers, stats.getAverageConcurrency());
+    }
     delete downloader;
     delete factory;
     this->closeAllConnections();
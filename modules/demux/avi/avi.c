@@ -43,6 +43,7 @@
 #include <vlc_codecs.h>
 #include <vlc_charset.h>
 #include <vlc_memory.h>
+#include <vlc_seekindex.h>
 
 #include "libavi.h"
 #include "../rawdv.h"
@@ -227,7 +228,8 @@ static int AVI_PacketNext     ( demux_t * );
 static int AVI_PacketSearch   ( demux_t * );
 
 static void AVI_IndexLoad    ( demux_t * );
-static void AVI_IndexCreate  ( demux_t * );
+static void AVI_IndexCreate  ( demux_t *, vlc_seekindex_t * );
+static vlc_seekindex_t *AVI_IndexCached( demux_t * );
 
 static void AVI_ExtractSubtitle( demux_t *, unsigned int i_stream, avi_chunk_list_t *, avi_chunk_STRING_t * );
 
@@ -264,6 +266,7 @@ static int Open( vlc_object_t * p_this )
     demux_sys_t     *p_sys;
 
     bool       b_index = false, b_aborted = false;
+    vlc_seekindex_t *p_cache = NULL;
     int              i_do_index;
 
     avi_chunk_list_t    *p_riff;
@@ -731,7 +734,8 @@ static int Open( vlc_object_t * p_this )
 aviindex:
         if( p_sys->b_fastseekable )
         {
-            AVI_IndexCreate( p_demux );
+            AVI_IndexCreate( p_demux, p_cache );
+            p_cache = NULL;
         }
         else if( p_sys->b_seekable )
         {
@@ -771,6 +775,13 @@ aviindex:
                 b_index = true;
                 goto aviindex;
             }
+            if( i_do_index == 0 &&
+                ( p_cache = AVI_IndexCached( p_demux ) ) != NULL )
+            {
+                /* Built before, no need to ask again */
+                b_index = true;
+                goto aviindex;
+            }
             if( i_do_index == 0 )
             {
                 const char *psz_msg = _(
@@ -2615,7 +2626,84 @@ static void AVI_IndexLoad( demux_t *p_demux )
     }
 }
 
-static void AVI_IndexCreate( demux_t *p_demux )
+/* Created indexes are stored in the seek index cache, with one entry per
+ * chunk: the track is the stream number and the time is the chunk number. */
+#define AVI_SEEKINDEX_VERSION 1
+
+/* Returns the cached index if it is not empty, to be passed to
+ * AVI_IndexCreate() */
+static vlc_seekindex_t *AVI_IndexCached( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    vlc_seekindex_t *p_cache;
+
+    p_cache = vlc_seekindex_New( p_demux, p_demux->s, "avi",
+                                 AVI_SEEKINDEX_VERSION );
+    if( !p_cache )
+        return NULL;
+
+    for( unsigned i = 0; i < p_sys->i_track; i++ )
+    {
+        const vlc_seekindex_entry_t *p_entries;
+        if( vlc_seekindex_Get( p_cache, i, &p_entries ) > 0 )
+            return p_cache;
+    }
+    vlc_seekindex_Delete( p_cache );
+    return NULL;
+}
+
+static bool AVI_IndexLoadCache( demux_t *p_demux, vlc_seekindex_t *p_cache )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    size_t i_total = 0;
+
+    for( unsigned i_stream = 0; i_stream < p_sys->i_track; i_stream++ )
+    {
+        avi_track_t *tk = p_sys->track[i_stream];
+        const vlc_seekindex_entry_t *p_entries;
+        size_t i_count = vlc_seekindex_Get( p_cache, i_stream, &p_entries );
+
+        for( size_t i = 0; i < i_count; i++ )
+        {
+            avi_entry_t index;
+            index.i_id      = 0; /* unused once indexed */
+            index.i_flags   = p_entries[i].i_flags;
+            index.i_pos     = p_entries[i].i_pos;
+            index.i_length  = p_entries[i].i_size;
+            index.i_lengthtotal = p_entries[i].i_size;
+            avi_index_Append( &tk->idx, &p_sys->i_movi_lastchunk_pos, &index );
+        }
+        i_total += i_count;
+    }
+    return i_total > 0;
+}
+
+static void AVI_IndexSaveCache( demux_t *p_demux, vlc_seekindex_t *p_cache )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    for( unsigned i_stream = 0; i_stream < p_sys->i_track; i_stream++ )
+    {
+        const avi_index_t *p_index = &p_sys->track[i_stream]->idx;
+
+        for( unsigned i = 0; i < p_index->i_size; i++ )
+        {
+            const avi_entry_t *p_entry = &p_index->p_entry[i];
+            vlc_seekindex_entry_t entry = {
+                .i_time = i,
+                .i_pos = p_entry->i_pos,
+                .i_track = i_stream,
+                .i_flags = p_entry->i_flags,
+                .i_size = p_entry->i_length,
+            };
+            if( vlc_seekindex_Add( p_cache, &entry ) )
+                return;
+        }
+    }
+}
+
+/* Takes ownership of p_cache, if any, else opens the cache itself */
+static void AVI_IndexCreate( demux_t *p_demux, vlc_seekindex_t *p_cache )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
 
@@ -2627,6 +2715,7 @@ static void AVI_IndexCreate( demux_t *p_demux )
 
     mtime_t i_dialog_update;
     vlc_dialog_id *p_dialog_id = NULL;
+    bool b_cancelled = false;
 
     p_riff = AVI_ChunkFind( &p_sys->ck_root, AVIFOURCC_RIFF, 0);
     p_movi = AVI_ChunkFind( p_riff, AVIFOURCC_movi, 0);
@@ -2634,12 +2723,24 @@ static void AVI_IndexCreate( demux_t *p_demux )
     if( !p_movi )
     {
         msg_Err( p_demux, "cannot find p_movi" );
+        if( p_cache )
+            vlc_seekindex_Delete( p_cache );
         return;
     }
 
     for( i_stream = 0; i_stream < p_sys->i_track; i_stream++ )
         avi_index_Init( &p_sys->track[i_stream]->idx );
 
+    if( !p_cache )
+        p_cache = vlc_seekindex_New( p_demux, p_demux->s, "avi",
+                                     AVI_SEEKINDEX_VERSION );
+    if( p_cache && AVI_IndexLoadCache( p_demux, p_cache ) )
+    {
+        msg_Dbg( p_demux, "index loaded from cache" );
+        vlc_seekindex_Delete( p_cache );
+        return;
+    }
+
     i_movi_end = __MIN( (off_t)(p_movi->i_chunk_pos + p_movi->i_chunk_size),
                         stream_Size( p_demux->s ) );
 
@@ -2665,7 +2766,10 @@ static void AVI_IndexCreate( demux_t *p_demux )
         if( p_dialog_id != NULL && mdate() - i_dialog_update > 100000 )
         {
             if( vlc_dialog_is_cancelled( p_demux, p_dialog_id ) )
+            {
+                b_cancelled = true;
                 break;
+            }
 
             double f_current = vlc_stream_Tell( p_demux->s );
             double f_size    = stream_Size( p_demux->s );
@@ -2739,6 +2843,14 @@ print_stat:
     if( p_dialog_id != NULL )
         vlc_dialog_release( p_demux, p_dialog_id );
 
+    if( p_cache )
+    {
+        /* A partial index would be reused as is */
+        if( !b_cancelled )
+            AVI_IndexSaveCache( p_demux, p_cache );
+        vlc_seekindex_Delete( p_cache );
+    }
+
     for( i_stream = 0; i_stream < p_sys->i_track; i_stream++ )
     {
         msg_Dbg( p_demux, "stream[%d] creating %d index entries",
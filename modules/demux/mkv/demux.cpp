@@ -433,7 +433,15 @@ demux_sys_t::~demux_sys_t()
     CleanUi();
     size_t i;
     for ( i=0; i<streams.size(); i++ )
-        delete streams[i];
+    {
+        matroska_stream_c *p_stream = streams[i];
+        if( p_stream->p_seekindex )
+        {
+            for( size_t j = 0; j < p_stream->segments.size(); j++ )
+                p_stream->segments[j]->SaveSeekIndex( p_stream->p_seekindex, j );
+        }
+        delete p_stream;
+    }
     for ( i=0; i<opened_segments.size(); i++ )
         delete opened_segments[i];
     for ( i=0; i<used_vsegments.size(); i++ )
@@ -60,11 +60,14 @@ matroska_segment_c::matroska_segment_c( demux_sys_t & demuxer, EbmlStream & estr
     ,ep(NULL)
     ,b_preloaded(false)
     ,b_ref_external_segments(false)
+    ,p_indexer(NULL)
 {
 }
 
 matroska_segment_c::~matroska_segment_c()
 {
+    delete p_indexer;
+
     for( tracks_map_t::iterator it = tracks.begin(); it != tracks.end(); ++it)
     {
         tracks_map_t::mapped_type& track = it->second;
@@ -818,6 +821,9 @@ void matroska_segment_c::Seek( mtime_t i_absolute_mk_date, mtime_t i_mk_time_off
         track.i_last_dts        = VLC_TS_INVALID;
     }
 
+    if( p_indexer )
+        p_indexer->merge( _seeker );
+
     // find appropriate seekpoints //
 
     try {
@@ -1118,6 +1124,42 @@ void matroska_segment_c::ESDestroy( )
     }
 }
 
+void matroska_segment_c::LoadSeekIndex( vlc_seekindex_t *p_index, uint32_t i_segment )
+{
+    SegmentSeeker::track_ids_t track_ids;
+
+    for( tracks_map_t::const_iterator it = tracks.begin(); it != tracks.end(); ++it )
+        track_ids.push_back( it->first );
+
+    _seeker.load_index( p_index, i_segment, track_ids );
+}
+
+void matroska_segment_c::SaveSeekIndex( vlc_seekindex_t *p_index, uint32_t i_segment )
+{
+    if( p_indexer )
+    {
+        p_indexer->stop();
+        p_indexer->merge( _seeker );
+    }
+    _seeker.save_index( p_index, i_segment );
+}
+
+void matroska_segment_c::StartClusterIndexer( const char *psz_url )
+{
+    if( p_indexer || cluster == NULL || segment == NULL )
+        return;
+
+    p_indexer = new (std::nothrow) ClusterIndexer( &sys.demuxer, psz_url,
+                                                   segment->GetElementPosition(),
+                                                   cluster->GetElementPosition(),
+                                                   i_timescale );
+    if( p_indexer && !p_indexer->start() )
+    {
+        delete p_indexer;
+        p_indexer = NULL;
+    }
+}
+
 int matroska_segment_c::BlockGet( KaxBlock * & pp_block, KaxSimpleBlock * & pp_simpleblock, bool *pb_key_picture, bool *pb_discardable_picture, int64_t *pi_duration )
 {
     tracks_map_t::iterator track_it;
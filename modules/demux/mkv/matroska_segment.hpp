@@ -149,6 +149,11 @@ public:
     bool ESCreate( );
     void ESDestroy( );
 
+    void LoadSeekIndex( vlc_seekindex_t *, uint32_t i_segment );
+    void SaveSeekIndex( vlc_seekindex_t *, uint32_t i_segment );
+
+    void StartClusterIndexer( const char *psz_url );
+
     static bool CompareSegmentUIDs( const matroska_segment_c * item_a, const matroska_segment_c * item_b );
 
     bool SameFamily( const matroska_segment_c & of_segment ) const;
@@ -172,6 +177,7 @@ private:
     void EnsureDuration();
 
     SegmentSeeker _seeker;
+    ClusterIndexer *p_indexer;
 
     friend SegmentSeeker;
 };
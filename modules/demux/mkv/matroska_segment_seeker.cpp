@@ -47,6 +47,21 @@ namespace {
 
     template<class It> It prev_( It it ) { return --it; }
     template<class It> It next_( It it ) { return ++it; }
+
+    // seek index tracks: the segment number in the upper bits, followed by
+    // the track number or one of these
+    uint32_t const INDEX_RANGES   = 0xFFFFFE;
+    uint32_t const INDEX_CLUSTERS = 0xFFFFFF;
+
+    uint32_t index_track( uint32_t segment, uint32_t track )
+    {
+        return ( segment << 24 ) | track;
+    }
+
+    bool same_pts( SegmentSeeker::Cluster const& lhs, SegmentSeeker::Cluster const& rhs )
+    {
+        return lhs.pts == rhs.pts;
+    }
 }
 
 SegmentSeeker::cluster_positions_t::iterator
@@ -61,7 +76,7 @@ SegmentSeeker::add_cluster_position( fptr_t fpos )
     return _cluster_positions.insert( insertion_point, fpos );
 }
 
-SegmentSeeker::cluster_map_t::iterator
+SegmentSeeker::clusters_t::iterator
 SegmentSeeker::add_cluster( KaxCluster * const p_cluster )
 {
     Cluster cinfo = {
@@ -73,17 +88,29 @@ SegmentSeeker::add_cluster( KaxCluster * const p_cluster )
             : UINT64_MAX
     };
 
+    return add_cluster( cinfo );
+}
+
+SegmentSeeker::clusters_t::iterator
+SegmentSeeker::add_cluster( Cluster const& cinfo )
+{
     add_cluster_position( cinfo.fpos );
 
-    cluster_map_t::iterator it = _clusters.lower_bound( cinfo.pts );
+    clusters_t::iterator it;
+
+    // clusters are mostly added in order, check the last one first
+    if( _clusters.empty() || _clusters.back().pts < cinfo.pts )
+        it = _clusters.end();
+    else
+        it = std::lower_bound( _clusters.begin(), _clusters.end(), cinfo );
 
-    if( it != _clusters.end() && it->second.pts == cinfo.pts )
+    if( it != _clusters.end() && it->pts == cinfo.pts )
     {
         // cluster already known
     }
     else
     {
-        it = _clusters.insert( cluster_map_t::value_type( cinfo.pts, cinfo ) ).first;
+        it = _clusters.insert( it, cinfo );
     }
 
     // ------------------------------------------------------------------
@@ -100,17 +127,49 @@ SegmentSeeker::add_cluster( KaxCluster * const p_cluster )
 
     if( it != _clusters.begin() )
     {
-        Duration::fix( prev_( it )->second, it->second );
+        Duration::fix( *prev_( it ), *it );
     }
 
     if( it != _clusters.end() && next_( it ) != _clusters.end() )
     {
-        Duration::fix( it->second, next_( it )->second );
+        Duration::fix( *it, *next_( it ) );
     }
 
     return it;
 }
 
+void
+SegmentSeeker::add_clusters( clusters_t& clusters )
+{
+    if( clusters.empty() )
+        return;
+
+    // merge the sorted batch at once rather than inserting one by one,
+    // the clusters already known are kept
+
+    std::sort( clusters.begin(), clusters.end() );
+
+    size_t i_known = _clusters.size();
+    _clusters.insert( _clusters.end(), clusters.begin(), clusters.end() );
+    std::inplace_merge( _clusters.begin(), _clusters.begin() + i_known, _clusters.end() );
+    _clusters.erase( std::unique( _clusters.begin(), _clusters.end(), same_pts ), _clusters.end() );
+
+    i_known = _cluster_positions.size();
+    for( clusters_t::const_iterator it = clusters.begin(); it != clusters.end(); ++it )
+        _cluster_positions.push_back( it->fpos );
+    std::sort( _cluster_positions.begin() + i_known, _cluster_positions.end() );
+    std::inplace_merge( _cluster_positions.begin(), _cluster_positions.begin() + i_known, _cluster_positions.end() );
+    _cluster_positions.erase( std::unique( _cluster_positions.begin(), _cluster_positions.end() ), _cluster_positions.end() );
+
+    // update the duration of the adjacent clusters, as add_cluster does
+
+    for( clusters_t::iterator it = _clusters.begin(); next_( it ) != _clusters.end(); ++it )
+    {
+        if( it->fpos + it->size == next_( it )->fpos )
+            it->duration = next_( it )->pts - it->pts;
+    }
+}
+
 void
 SegmentSeeker::add_seekpoint( track_id_t track_id, int trust_level, fptr_t fpos, mtime_t pts )
 {
@@ -222,11 +281,14 @@ SegmentSeeker::get_seekpoints_around( mtime_t target_pts, track_ids_t const& pri
 
     { // check if we got a cluster which is closer to target_pts than the found cues //
 
-        cluster_map_t::iterator it = _clusters.lower_bound( target_pts );
+        Cluster needle = Cluster();
+        needle.pts = target_pts;
+
+        clusters_t::iterator it = std::lower_bound( _clusters.begin(), _clusters.end(), needle );
 
         if( it != _clusters.begin() && --it != _clusters.end() )
         {
-            Cluster const& cluster = it->second;
+            Cluster const& cluster = *it;
 
             if( cluster.fpos > points.first.fpos )
             {
@@ -464,3 +526,261 @@ SegmentSeeker::mkv_jump_to( matroska_segment_c& ms, fptr_t fpos )
     ms.es.I_O().setFilePointer( fpos );
 }
 
+void
+SegmentSeeker::load_index( vlc_seekindex_t * p_index, uint32_t segment, track_ids_t const& track_ids )
+{
+    vlc_seekindex_entry_t const * entries;
+    size_t count;
+
+    count = vlc_seekindex_Get( p_index, index_track( segment, INDEX_CLUSTERS ), &entries );
+    for( size_t i = 0; i < count; ++i )
+    {
+        Cluster cinfo = {
+            /* fpos     */ entries[i].i_pos,
+            /* pts      */ entries[i].i_time,
+            /* duration */ mtime_t( -1 ),
+            /* size     */ entries[i].i_size != UINT32_MAX ? entries[i].i_size : UINT64_MAX
+        };
+        add_cluster( cinfo );
+    }
+
+    for( track_ids_t::const_iterator it = track_ids.begin(); it != track_ids.end(); ++it )
+    {
+        if( *it >= INDEX_RANGES )
+            continue;
+
+        count = vlc_seekindex_Get( p_index, index_track( segment, *it ), &entries );
+        for( size_t i = 0; i < count; ++i )
+            add_seekpoint( *it, Seekpoint::TRUSTED, entries[i].i_pos, entries[i].i_time );
+    }
+
+    // the ranges are only valid with the seekpoints found in them
+    count = vlc_seekindex_Get( p_index, index_track( segment, INDEX_RANGES ), &entries );
+    for( size_t i = 0; i < count; ++i )
+        mark_range_as_searched( Range( entries[i].i_time, entries[i].i_pos ) );
+}
+
+void
+SegmentSeeker::save_index( vlc_seekindex_t * p_index, uint32_t segment ) const
+{
+    for( clusters_t::const_iterator it = _clusters.begin(); it != _clusters.end(); ++it )
+    {
+        vlc_seekindex_entry_t entry = vlc_seekindex_entry_t();
+        entry.i_time  = it->pts;
+        entry.i_pos   = it->fpos;
+        entry.i_track = index_track( segment, INDEX_CLUSTERS );
+        entry.i_size  = std::min<fptr_t>( it->size, UINT32_MAX );
+        vlc_seekindex_Add( p_index, &entry );
+    }
+
+    for( tracks_seekpoints_t::const_iterator it = _tracks_seekpoints.begin(); it != _tracks_seekpoints.end(); ++it )
+    {
+        if( it->first >= INDEX_RANGES )
+            continue;
+
+        for( seekpoints_t::const_iterator sp = it->second.begin(); sp != it->second.end(); ++sp )
+        {
+            if( sp->trust_level != Seekpoint::TRUSTED )
+                continue; // cues are read again
+
+            vlc_seekindex_entry_t entry = vlc_seekindex_entry_t();
+            entry.i_time  = sp->pts;
+            entry.i_pos   = sp->fpos;
+            entry.i_track = index_track( segment, it->first );
+            vlc_seekindex_Add( p_index, &entry );
+        }
+    }
+
+    for( ranges_t::const_iterator it = _ranges_searched.begin(); it != _ranges_searched.end(); ++it )
+    {
+        vlc_seekindex_entry_t entry = vlc_seekindex_entry_t();
+        entry.i_time  = it->start;
+        entry.i_pos   = it->end;
+        entry.i_track = index_track( segment, INDEX_RANGES );
+        vlc_seekindex_Add( p_index, &entry );
+    }
+}
+
+ClusterIndexer::ClusterIndexer( demux_t * p_demux, char const * psz_url, fptr_t segment_pos,
+                                fptr_t cluster_pos, uint64_t i_timescale )
+    : p_demux( p_demux )
+    , s( vlc_stream_NewURL( p_demux, psz_url ) )
+    , segment_pos( segment_pos )
+    , cluster_pos( cluster_pos )
+    , i_timescale( i_timescale )
+    , b_dummy( var_InheritBool( p_demux, "mkv-use-dummy" ) )
+    , b_running( false )
+    , b_abort( false )
+{
+    vlc_mutex_init( &lock );
+}
+
+ClusterIndexer::~ClusterIndexer()
+{
+    stop();
+    vlc_mutex_destroy( &lock );
+
+    if( s )
+        vlc_stream_Delete( s );
+}
+
+bool
+ClusterIndexer::start()
+{
+    if( s == NULL || b_running )
+        return false;
+
+    b_running = !vlc_clone( &thread, run, this, VLC_THREAD_PRIORITY_LOW );
+    return b_running;
+}
+
+void
+ClusterIndexer::stop()
+{
+    if( !b_running )
+        return;
+
+    vlc_mutex_lock( &lock );
+    b_abort = true;
+    vlc_mutex_unlock( &lock );
+
+    vlc_join( thread, NULL );
+    b_running = false;
+}
+
+void
+ClusterIndexer::merge( SegmentSeeker& seeker )
+{
+    clusters_t found;
+
+    vlc_mutex_lock( &lock );
+    found.swap( pending );
+    vlc_mutex_unlock( &lock );
+
+    seeker.add_clusters( found );
+}
+
+void *
+ClusterIndexer::run( void * data )
+{
+    static_cast<ClusterIndexer*>( data )->run();
+    return NULL;
+}
+
+void
+ClusterIndexer::run()
+{
+    vlc_stream_io_callback io( s, false );
+    EbmlStream estream( io );
+    EbmlElement * el = NULL;
+    size_t count = 0;
+
+    try {
+        io.setFilePointer( segment_pos );
+        el = estream.FindNextID( EBML_INFO( KaxSegment ), UINT64_MAX );
+
+        if( MKV_CHECKED_PTR_DECL( p_segment, KaxSegment, el ) )
+        {
+            fptr_t fpos = cluster_pos;
+
+            for( ;; )
+            {
+                vlc_mutex_lock( &lock );
+                bool b_stop = b_abort;
+                vlc_mutex_unlock( &lock );
+
+                if( b_stop || !index_cluster( estream, *p_segment, fpos ) )
+                    break;
+                ++count;
+            }
+        }
+    }
+    catch( std::exception const& e )
+    {
+        msg_Warn( p_demux, "cluster indexing stopped: \"%s\"", e.what() );
+    }
+    catch( ... )
+    {
+        msg_Warn( p_demux, "cluster indexing stopped" );
+    }
+
+    delete el;
+    msg_Dbg( p_demux, "indexed %zu clusters in the background", count );
+}
+
+/* Scans forward for the next cluster: an element of unknown size only ends
+ * with the next element of its level */
+bool
+ClusterIndexer::find_next_cluster( EbmlStream& estream, fptr_t& fpos )
+{
+    EbmlElement * el = estream.FindNextID( EBML_INFO( KaxCluster ), UINT64_MAX );
+
+    if( el == NULL )
+        return false;
+
+    fpos = el->GetElementPosition();
+    delete el;
+    return true;
+}
+
+/* Reads the header of the cluster at fpos and moves fpos to the next one */
+bool
+ClusterIndexer::index_cluster( EbmlStream& estream, KaxSegment& segment, fptr_t& fpos )
+{
+    estream.I_O().setFilePointer( fpos );
+
+    EbmlParser parser( &estream, &segment, p_demux, b_dummy );
+    EbmlElement * el = parser.Get();
+
+    if( el == NULL )
+        return false;
+
+    bool b_finite = el->IsFiniteSize();
+    fptr_t next_pos = b_finite ? el->GetEndPosition() : UINT64_MAX;
+
+    if( next_pos <= fpos )
+        return false;
+
+    if( MKV_CHECKED_PTR_DECL( p_cluster, KaxCluster, el ) )
+    {
+        Cluster cinfo = {
+            /* fpos     */ p_cluster->GetElementPosition(),
+            /* pts      */ mtime_t( -1 ),
+            /* duration */ mtime_t( -1 ),
+            /* size     */ b_finite ? next_pos - p_cluster->GetElementPosition()
+                                    : UINT64_MAX
+        };
+
+        parser.Down();
+
+        while( EbmlElement * sub = parser.Get() )
+        {
+            if( MKV_CHECKED_PTR_DECL( p_tc, KaxClusterTimecode, sub ) )
+            {
+                p_tc->ReadData( estream.I_O(), SCOPE_ALL_DATA );
+                cinfo.pts = mtime_t( static_cast<uint64>( *p_tc ) * i_timescale / INT64_C( 1000 ) );
+                break;
+            }
+        }
+
+        if( cinfo.pts < 0 )
+            return false;
+
+        if( !b_finite && find_next_cluster( estream, next_pos ) )
+            cinfo.size = next_pos - cinfo.fpos;
+
+        vlc_mutex_lock( &lock );
+        pending.push_back( cinfo );
+        vlc_mutex_unlock( &lock );
+    }
+    else if( !b_finite )
+        find_next_cluster( estream, next_pos );
+
+    // other top-level elements between clusters are skipped
+
+    if( next_pos == UINT64_MAX )
+        return false;
+
+    fpos = next_pos;
+    return true;
+}
@@ -83,6 +83,11 @@ class SegmentSeeker
             mtime_t pts;
             mtime_t duration;
             fptr_t  size;
+
+            bool operator<( Cluster const& rhs ) const
+            {
+                return pts < rhs.pts;
+            }
         };
 
     public:
@@ -93,7 +98,7 @@ class SegmentSeeker
 
         typedef std::map<track_id_t, Seekpoint> tracks_seekpoint_t;
         typedef std::map<track_id_t, seekpoints_t> tracks_seekpoints_t;
-        typedef std::map<mtime_t, Cluster> cluster_map_t;
+        typedef std::vector<Cluster> clusters_t; /* sorted by pts */
 
         typedef std::pair<Seekpoint, Seekpoint> seekpoint_pair_t;
 
@@ -106,7 +111,9 @@ class SegmentSeeker
         tracks_seekpoint_t find_greatest_seekpoints_in_range( fptr_t , mtime_t );
 
         cluster_positions_t::iterator add_cluster_position( fptr_t pos );
-        cluster_map_t      ::iterator add_cluster( KaxCluster * const );
+        clusters_t         ::iterator add_cluster( KaxCluster * const );
+        clusters_t         ::iterator add_cluster( Cluster const& );
+        void add_clusters( clusters_t& );
 
         void mkv_jump_to( matroska_segment_c&, fptr_t );
 
@@ -116,11 +123,55 @@ class SegmentSeeker
         void mark_range_as_searched( Range );
         ranges_t get_search_areas( fptr_t start, fptr_t end ) const;
 
+        void load_index( vlc_seekindex_t *, uint32_t segment, track_ids_t const& );
+        void save_index( vlc_seekindex_t *, uint32_t segment ) const;
+
     public:
         ranges_t            _ranges_searched;
         tracks_seekpoints_t _tracks_seekpoints;
         cluster_positions_t _cluster_positions;
-        cluster_map_t       _clusters;
+        clusters_t          _clusters;
+};
+
+/* Walks the cluster headers of a segment ahead of playback, on a low
+ * priority thread with its own stream, so that seeking in files without
+ * cues does not have to search for clusters. */
+class ClusterIndexer
+{
+    public:
+        typedef SegmentSeeker::fptr_t fptr_t;
+        typedef SegmentSeeker::Cluster Cluster;
+        typedef SegmentSeeker::clusters_t clusters_t;
+
+        ClusterIndexer( demux_t *, char const * psz_url, fptr_t segment_pos,
+                        fptr_t cluster_pos, uint64_t i_timescale );
+        ~ClusterIndexer();
+
+        bool start();
+        void stop();
+
+        /* moves the clusters found so far to the seeker */
+        void merge( SegmentSeeker& );
+
+    private:
+        static void * run( void * );
+        void run();
+        bool index_cluster( EbmlStream&, KaxSegment&, fptr_t& );
+        bool find_next_cluster( EbmlStream&, fptr_t& );
+
+        demux_t     * p_demux;
+        stream_t    * s;
+        fptr_t        segment_pos;
+        fptr_t        cluster_pos;
+        uint64_t      i_timescale;
+        bool          b_dummy;
+
+        vlc_thread_t  thread;
+        bool          b_running;
+
+        vlc_mutex_t   lock;
+        bool          b_abort;
+        clusters_t    pending;
 };
 
 #endif /* include-guard */
@@ -80,6 +80,10 @@ vlc_module_begin ()
             N_("Preload clusters"),
             N_("Find all cluster positions by jumping cluster-to-cluster before playback"), true );
 
+    add_bool( "mkv-background-index", false,
+            N_("Index clusters in the background"),
+            N_("Find cluster positions of local files without cues in a background thread during playback"), true );
+
     add_shortcut( "mka", "mkv" )
 vlc_module_end ()
 
@@ -138,9 +142,17 @@ static int Open( vlc_object_t * p_this )
     p_stream->p_io_callback = p_io_callback;
     p_stream->p_estream = p_io_stream;
 
+    bool b_fastseek;
+    if( !vlc_stream_Control( p_demux->s, STREAM_CAN_FASTSEEK, &b_fastseek ) &&
+        b_fastseek && p_stream->segments.size() <= 256 )
+        p_stream->p_seekindex = vlc_seekindex_New( p_demux, p_demux->s, "mkv",
+                                                   MKV_SEEKINDEX_VERSION );
+
     for (size_t i=0; i<p_stream->segments.size(); i++)
     {
         p_stream->segments[i]->Preload();
+        if( p_stream->p_seekindex )
+            p_stream->segments[i]->LoadSeekIndex( p_stream->p_seekindex, i );
         b_need_preload |= p_stream->segments[i]->b_ref_external_segments;
         if ( p_stream->segments[i]->translations.size() &&
              p_stream->segments[i]->translations[0]->codec_id == MATROSKA_CHAPTER_CODEC_DVD &&
@@ -148,6 +160,19 @@ static int Open( vlc_object_t * p_this )
             b_need_preload = true;
     }
 
+    if( p_demux->psz_file && !strcmp( p_demux->psz_access, "file" ) &&
+        var_InheritBool( p_demux, "mkv-background-index" ) )
+    {
+        char *psz_url = vlc_path2uri( p_demux->psz_file, "file" );
+        if( psz_url )
+        {
+            for( size_t i = 0; i < p_stream->segments.size(); i++ )
+                if( !p_stream->segments[i]->b_cues )
+                    p_stream->segments[i]->StartClusterIndexer( psz_url );
+            free( psz_url );
+        }
+    }
+
     p_segment = p_stream->segments[0];
     if( p_segment->cluster == NULL && p_segment->stored_editions.size() == 0 )
     {
@@ -44,6 +44,7 @@
 #include <vlc_charset.h>
 #include <vlc_input.h>
 #include <vlc_demux.h>
+#include <vlc_seekindex.h>
 #include <vlc_aout.h> /* For reordering */
 
 #include <iostream>
@@ -113,6 +114,9 @@ enum
 
 #define MKVD_TIMECODESCALE 1000000
 
+/* version of the seek index entries (see SegmentSeeker::save_index) */
+#define MKV_SEEKINDEX_VERSION 1
+
 #define MKV_IS_ID( el, C ) ( el != NULL && typeid( *el ) == typeid( C ) )
 #define MKV_CHECKED_PTR_DECL( name, type, src ) type * name = MKV_IS_ID(src, type) ? static_cast<type*>(src) : NULL
 
@@ -156,15 +160,18 @@ private:
 class matroska_segment_c;
 struct matroska_stream_c
 {
-    matroska_stream_c() :p_io_callback(NULL) ,p_estream(NULL) {}
+    matroska_stream_c() :p_io_callback(NULL) ,p_estream(NULL) ,p_seekindex(NULL) {}
     ~matroska_stream_c()
     {
+        if( p_seekindex )
+            vlc_seekindex_Delete( p_seekindex );
         delete p_io_callback;
         delete p_estream;
     }
 
     IOCallback         *p_io_callback;
     EbmlStream         *p_estream;
+    vlc_seekindex_t    *p_seekindex; /* seek points of the segments */
 
     std::vector<matroska_segment_c*> segments;
 };
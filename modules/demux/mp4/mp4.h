@@ -47,11 +47,19 @@ typedef struct
     uint64_t     i_first_dts;   /* DTS of the first sample */
     uint64_t     i_duration;    /* total duration of all samples */
 
+    /* Runs of the stts/ctts tables covering this chunk. For moov chunks,
+     * these point into the boxes tables, and the first i_skip_* samples
+     * of the first run belong to the previous chunks. Fragment chunks own
+     * their (unshared) tables. The last dts run also covers the samples
+     * past the end of a short stts table; the samples past the end of a
+     * short ctts table have no composition offset. */
     uint32_t     i_entries_dts;
+    uint32_t     i_skip_dts;
     uint32_t     *p_sample_count_dts;
-    uint32_t     *p_sample_delta_dts;   /* dts delta */
+    int32_t      *p_sample_delta_dts;   /* dts delta */
 
     uint32_t     i_entries_pts;
+    uint32_t     i_skip_pts;
     uint32_t     *p_sample_count_pts;
     int32_t      *p_sample_offset_pts;  /* pts-dts */
 
@@ -115,8 +123,7 @@ typedef struct
     /* sample size, p_sample_size defined only if i_sample_size == 0
         else i_sample_size is size for all sample */
     uint32_t         i_sample_size;
-    uint32_t         *p_sample_size; /* XXX perhaps add file offset if take
-                                    too much time to do sumations each time*/
+    const uint32_t   *p_sample_size; /* stsz table (not copied) */
 
     uint32_t     i_sample_first; /* i_sample_first value
                                                    of the next chunk */
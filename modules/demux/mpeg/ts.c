@@ -34,6 +34,7 @@
 #include <vlc_plugin.h>
 #include <vlc_access.h>    /* DVB-specific things */
 #include <vlc_demux.h>
+#include <vlc_seekindex.h>
 
 #include "ts_pid.h"
 #include "ts_streams.h"
@@ -45,6 +46,7 @@
 #include "ts_hotfixes.h"
 #include "ts_sl.h"
 #include "ts_metadata.h"
+#include "ts_bulk.h"
 #include "sections.h"
 #include "pes.h"
 #include "timestamps.h"
@@ -180,6 +182,9 @@ static bool GatherSectionsData( demux_t *p_demux, ts_pid_t *, block_t *, size_t
 static void ProgramSetPCR( demux_t *p_demux, ts_pmt_t *p_prg, mtime_t i_pcr );
 
 static block_t* ReadTSPacket( demux_t *p_demux );
+static uint64_t TSTell( demux_sys_t * );
+static int TSSeek( demux_sys_t *, uint64_t );
+static void TSFlush( demux_sys_t * );
 static int SeekToTime( demux_t *p_demux, const ts_pmt_t *, int64_t time );
 static void ReadyQueuesPostSeek( demux_t *p_demux );
 static void PCRHandle( demux_t *p_demux, ts_pid_t *, mtime_t );
@@ -338,6 +343,10 @@ static int DetectPVRHeadersAndHeaderSize( demux_t *p_demux, unsigned *pi_header_
     return DetectPacketSize( p_demux, pi_header_size, 0 );
 }
 
+/* The seek index stores, per program number, the unwrapped timestamps found
+ * while seeking, with the position following their packet. */
+#define TS_SEEKINDEX_VERSION 1
+
 /*****************************************************************************
  * Open
  *****************************************************************************/
@@ -385,6 +394,10 @@ static int Open( vlc_object_t *p_this )
     p_sys->i_packet_size = i_packet_size;
     p_sys->i_packet_header_size = i_packet_header_size;
     p_sys->i_ts_read = 50;
+    p_sys->bulk.p_chunk = NULL;
+    p_sys->bulk.i_offset = 0;
+    p_sys->bulk.i_synced = 0;
+    p_sys->bulk.i_size = 0;
     p_sys->csa = NULL;
     p_sys->b_start_record = false;
 
@@ -478,6 +491,7 @@ static int Open( vlc_object_t *p_this )
 
     p_sys->b_canseek = false;
     p_sys->b_canfastseek = false;
+    p_sys->p_seekindex = NULL;
     p_sys->b_ignore_time_for_positions = var_InheritBool( p_demux, "ts-seek-percent" );
 
     p_sys->standard = TS_STANDARD_AUTO;
@@ -506,6 +520,9 @@ static int Open( vlc_object_t *p_this )
     vlc_stream_Control( p_sys->stream, STREAM_CAN_SEEK, &p_sys->b_canseek );
     vlc_stream_Control( p_sys->stream, STREAM_CAN_FASTSEEK,
                         &p_sys->b_canfastseek );
+    if( p_sys->b_canfastseek )
+        p_sys->p_seekindex = vlc_seekindex_New( p_demux, p_sys->stream, "ts",
+                                                TS_SEEKINDEX_VERSION );
 
     /* Preparse time */
     if( p_sys->b_canseek )
@@ -556,6 +573,12 @@ static void Close( vlc_object_t *p_this )
 
     vlc_mutex_destroy( &p_sys->csa_lock );
 
+    if( p_sys->bulk.p_chunk )
+        ts_bulk_Release( p_sys->bulk.p_chunk );
+
+    if( p_sys->p_seekindex )
+        vlc_seekindex_Delete( p_sys->p_seekindex );
+
     /* Release all non default pids */
     ts_pid_list_Release( p_demux, &p_sys->pids );
 
@@ -610,14 +633,6 @@ static int Demux( demux_t *p_demux )
             return VLC_DEMUXER_EOF;
         }
 
-        if( p_sys->b_start_record )
-        {
-            /* Enable recording once synchronized */
-            vlc_stream_Control( p_sys->stream, STREAM_SET_RECORD_STATE, true,
-                                "ts" );
-            p_sys->b_start_record = false;
-        }
-
         /* Early reject truncated packets from hw devices */
         if( unlikely(p_pkt->i_buffer < TS_PACKET_SIZE_188) )
         {
@@ -912,7 +927,7 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
 
         if( (i64 = stream_Size( p_sys->stream) ) > 0 )
         {
-            uint64_t offset = vlc_stream_Tell( p_sys->stream );
+            uint64_t offset = TSTell( p_sys );
             *pf = (double)offset / (double)i64;
             return VLC_SUCCESS;
         }
@@ -959,7 +974,7 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
 
         i64 = stream_Size( p_sys->stream );
         if( i64 > 0 &&
-            vlc_stream_Seek( p_sys->stream, (int64_t)(i64 * f) ) == VLC_SUCCESS )
+            TSSeek( p_sys, (int64_t)(i64 * f) ) == VLC_SUCCESS )
         {
             ReadyQueuesPostSeek( p_demux );
             return VLC_SUCCESS;
@@ -1091,9 +1106,11 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
     }
 
     case DEMUX_SET_TITLE:
+        TSFlush( p_sys );
         return vlc_stream_vaControl( p_sys->stream, STREAM_SET_TITLE, args );
 
     case DEMUX_SET_SEEKPOINT:
+        TSFlush( p_sys );
         return vlc_stream_vaControl( p_sys->stream, STREAM_SET_SEEKPOINT,
                                      args );
 
@@ -1452,6 +1469,9 @@ static void ParsePESDataChain( demux_t *p_demux, ts_pid_t *pid, block_t *p_pes )
             p_chain = p_chain->p_next;
             p_block->p_next = NULL;
 
+            /* A single packet PES would pin its whole chunk until decoded */
+            p_block = ts_bulk_Detach( NULL, p_block );
+
             if( !p_pmt->pcr.b_fix_done ) /* Not seen yet */
                 PCRFixHandle( p_demux, p_pmt, p_block );
 
@@ -1647,79 +1667,270 @@ static bool PushPESBlock( demux_t *p_demux, ts_pid_t *pid, block_t *p_pkt, bool
     return b_ret;
 }
 
-static block_t* ReadTSPacket( demux_t *p_demux )
+static uint64_t TSTell( demux_sys_t *p_sys )
+{
+    /* Packets read ahead are not consumed yet */
+    return vlc_stream_Tell( p_sys->stream ) -
+           ( p_sys->bulk.i_size - p_sys->bulk.i_offset );
+}
+
+static void TSFlush( demux_sys_t *p_sys )
+{
+    p_sys->bulk.i_offset = 0;
+    p_sys->bulk.i_synced = 0;
+    p_sys->bulk.i_size = 0;
+}
+
+static int TSSeek( demux_sys_t *p_sys, uint64_t i_pos )
+{
+    TSFlush( p_sys );
+    return vlc_stream_Seek( p_sys->stream, i_pos );
+}
+
+/* Skips the stream up to the next two consecutive sync bytes */
+static bool ResyncTSStream( demux_t *p_demux )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
 
-    block_t     *p_pkt;
+    for( ;; )
+    {
+        const uint8_t *p_peek;
+        int i_peek = 0;
+        unsigned i_skip = 0;
+
+        i_peek = vlc_stream_Peek( p_sys->stream, &p_peek,
+                p_sys->i_packet_size * 10 );
+        if( i_peek < 0 || (unsigned)i_peek < p_sys->i_packet_size + 1 )
+        {
+            msg_Dbg( p_demux, "eof ?" );
+            return false;
+        }
+
+        while( i_skip < i_peek - p_sys->i_packet_size )
+        {
+            if( p_peek[i_skip + p_sys->i_packet_header_size] == 0x47 &&
+                    p_peek[i_skip + p_sys->i_packet_header_size + p_sys->i_packet_size] == 0x47 )
+            {
+                break;
+            }
+            i_skip++;
+        }
+        msg_Dbg( p_demux, "skipping %d bytes of garbage", i_skip );
+        if (vlc_stream_Read( p_sys->stream, NULL, i_skip ) != i_skip)
+            return false;
+
+        if( i_skip < i_peek - p_sys->i_packet_size )
+            return true;
+    }
+}
+
+/* Descrambles the synchronized packets read ahead at once */
+static void DescrambleTSChunk( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    uint8_t *p_buf = ts_bulk_Buffer( p_sys->bulk.p_chunk );
+    uint8_t *pp_pkts[TS_BULK_PACKETS];
+    unsigned i_count = 0;
 
-    /* Get a new TS packet */
-    if( !( p_pkt = vlc_stream_Block( p_sys->stream, p_sys->i_packet_size ) ) )
+    for( size_t i = p_sys->bulk.i_offset; i < p_sys->bulk.i_synced;
+         i += p_sys->i_packet_size )
     {
-        int64_t size = stream_Size( p_sys->stream );
-        if( size >= 0 && (uint64_t)size == vlc_stream_Tell( p_sys->stream ) )
-            msg_Dbg( p_demux, "EOF at %"PRIu64, vlc_stream_Tell( p_sys->stream ) );
-        else
-            msg_Dbg( p_demux, "Can't read TS packet at %"PRIu64, vlc_stream_Tell(p_sys->stream) );
-        return NULL;
+        uint8_t *p = &p_buf[i + p_sys->i_packet_header_size];
+        if( p[3]&0x80 )
+            pp_pkts[i_count++] = p;
     }
+    if( i_count == 0 )
+        return;
+
+    /* Descrambled packets are left clear, so ProcessTSPacket() skips them */
+    vlc_mutex_lock( &p_sys->csa_lock );
+    csa_DecryptBatch( p_sys->csa, pp_pkts, i_count, p_sys->i_csa_pkt_size );
+    vlc_mutex_unlock( &p_sys->csa_lock );
+}
 
-    if( p_pkt->i_buffer < TS_HEADER_SIZE + p_sys->i_packet_header_size )
+/* Completes the last packet read ahead and checks the sync bytes */
+static bool CompleteTSChunk( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    uint8_t *p_buf = ts_bulk_Buffer( p_sys->bulk.p_chunk );
+    const size_t i_partial = p_sys->bulk.i_size % p_sys->i_packet_size;
+
+    if( i_partial > 0 )
     {
-        block_Release( p_pkt );
-        return NULL;
+        ssize_t i_read = vlc_stream_Read( p_sys->stream,
+                                          &p_buf[p_sys->bulk.i_size],
+                                          p_sys->i_packet_size - i_partial );
+        if( i_read > 0 )
+            p_sys->bulk.i_size += i_read;
+        /* Drop the truncated packet at end of stream */
+        p_sys->bulk.i_size -= p_sys->bulk.i_size % p_sys->i_packet_size;
     }
 
-    /* Skip header (BluRay streams).
-     * re-sync logic would do this (by adjusting packet start), but this would result in losing first and last ts packets.
-     * First packet is usually PAT, and losing it means losing whole first GOP. This is fatal with still-image based menus.
-     */
-    p_pkt->p_buffer += p_sys->i_packet_header_size;
-    p_pkt->i_buffer -= p_sys->i_packet_header_size;
+    p_sys->bulk.i_synced = p_sys->bulk.i_offset +
+        ts_bulk_SyncedSize( &p_buf[p_sys->bulk.i_offset],
+                            p_sys->bulk.i_size - p_sys->bulk.i_offset,
+                            p_sys->i_packet_size, p_sys->i_packet_header_size );
+    if( p_sys->csa )
+        DescrambleTSChunk( p_demux );
+    return p_sys->bulk.i_offset < p_sys->bulk.i_size;
+}
 
-    /* Check sync byte and re-sync if needed */
-    if( p_pkt->p_buffer[0] != 0x47 )
+/* Skips the packets read ahead up to the next two consecutive sync bytes */
+static bool ResyncTSChunk( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    uint8_t *p_buf = ts_bulk_Buffer( p_sys->bulk.p_chunk );
+    const size_t i_sync = p_sys->i_packet_header_size;
+    const size_t i_next = i_sync + p_sys->i_packet_size;
+    size_t i_skip = p_sys->bulk.i_offset + 1;
+
+    while( i_skip + i_next < p_sys->bulk.i_size )
     {
-        msg_Warn( p_demux, "lost synchro" );
-        block_Release( p_pkt );
-        for( ;; )
-        {
-            const uint8_t *p_peek;
-            int i_peek = 0;
-            unsigned i_skip = 0;
+        if( p_buf[i_skip + i_sync] == 0x47 && p_buf[i_skip + i_next] == 0x47 )
+            break;
+        i_skip++;
+    }
 
-            i_peek = vlc_stream_Peek( p_sys->stream, &p_peek,
-                    p_sys->i_packet_size * 10 );
-            if( i_peek < 0 || (unsigned)i_peek < p_sys->i_packet_size + 1 )
-            {
-                msg_Dbg( p_demux, "eof ?" );
-                return NULL;
-            }
+    if( i_skip + i_next >= p_sys->bulk.i_size )
+    {
+        /* Nothing in there, continue with the stream */
+        msg_Dbg( p_demux, "skipping %zu bytes of garbage",
+                 p_sys->bulk.i_size - p_sys->bulk.i_offset );
+        TSFlush( p_sys );
+        return ResyncTSStream( p_demux );
+    }
 
-            while( i_skip < i_peek - p_sys->i_packet_size )
-            {
-                if( p_peek[i_skip + p_sys->i_packet_header_size] == 0x47 &&
-                        p_peek[i_skip + p_sys->i_packet_header_size + p_sys->i_packet_size] == 0x47 )
-                {
-                    break;
-                }
-                i_skip++;
-            }
-            msg_Dbg( p_demux, "skipping %d bytes of garbage", i_skip );
-            if (vlc_stream_Read( p_sys->stream, NULL, i_skip ) != i_skip)
-                return NULL;
+    msg_Dbg( p_demux, "skipping %zu bytes of garbage",
+             i_skip - p_sys->bulk.i_offset );
+    memmove( &p_buf[p_sys->bulk.i_offset], &p_buf[i_skip],
+             p_sys->bulk.i_size - i_skip );
+    p_sys->bulk.i_size -= i_skip - p_sys->bulk.i_offset;
+    return CompleteTSChunk( p_demux );
+}
 
-            if( i_skip < i_peek - p_sys->i_packet_size )
-            {
-                break;
-            }
+static void DetachTSChain( ts_bulk_t *p_chunk, block_t **pp_chain,
+                           block_t ***ppp_last )
+{
+    unsigned i_held = 0;
+
+    for( const block_t *p = *pp_chain; p != NULL; p = p->p_next )
+        if( ts_bulk_Holds( p_chunk, p ) )
+            i_held++;
+    /* Copying many packets would cost more than a new chunk */
+    if( i_held == 0 || i_held > TS_BULK_PACKETS / 8 )
+        return;
+
+    for( ; *pp_chain != NULL; pp_chain = &(*pp_chain)->p_next )
+    {
+        *pp_chain = ts_bulk_Detach( p_chunk, *pp_chain );
+        if( (*pp_chain)->p_next == NULL )
+            *ppp_last = &(*pp_chain)->p_next;
+    }
+}
+
+/* Copies the packets still being gathered out of the current chunk, for the
+ * PES holding only a few of them */
+static void DetachTSChunk( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    ts_pid_next_context_t pidnextctx = ts_pid_NextContextInitValue;
+    ts_pid_t *pid;
+
+    while( (pid = ts_pid_Next( &p_sys->pids, &pidnextctx )) )
+    {
+        if( pid->type != TYPE_PES )
+            continue;
+
+        ts_pes_t *p_pes = pid->u.p_pes;
+        DetachTSChain( p_sys->bulk.p_chunk, &p_pes->gather.p_data,
+                       &p_pes->gather.pp_last );
+        DetachTSChain( p_sys->bulk.p_chunk, &p_pes->prepcr.p_head,
+                       &p_pes->prepcr.pp_last );
+        DetachTSChain( p_sys->bulk.p_chunk, &p_pes->sl.p_data,
+                       &p_pes->sl.pp_last );
+    }
+}
+
+/* Reads as many packets as available at once, up to a chunk */
+static bool ReadTSChunk( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    /* Reuse the chunk unless some of its packets are still in use */
+    if( p_sys->bulk.p_chunk && !ts_bulk_IsUnused( p_sys->bulk.p_chunk ) )
+    {
+        /* Do not pin a whole chunk for a few packets, such as the start of
+         * a low bitrate PES */
+        DetachTSChunk( p_demux );
+        if( !ts_bulk_IsUnused( p_sys->bulk.p_chunk ) )
+        {
+            ts_bulk_Release( p_sys->bulk.p_chunk );
+            p_sys->bulk.p_chunk = NULL;
         }
-        if( !( p_pkt = vlc_stream_Block( p_sys->stream, p_sys->i_packet_size ) ) )
+    }
+    if( p_sys->bulk.p_chunk == NULL )
+    {
+        p_sys->bulk.p_chunk = ts_bulk_New( p_sys->i_packet_size );
+        if( unlikely(p_sys->bulk.p_chunk == NULL) )
+            return false;
+    }
+
+    if( p_sys->b_start_record )
+    {
+        /* Enable recording once all the packets read ahead are consumed,
+         * so that the recording starts at the demuxer position */
+        vlc_stream_Control( p_sys->stream, STREAM_SET_RECORD_STATE, true,
+                            "ts" );
+        p_sys->b_start_record = false;
+    }
+
+    TSFlush( p_sys );
+    ssize_t i_read = vlc_stream_ReadPartial( p_sys->stream,
+                                             ts_bulk_Buffer( p_sys->bulk.p_chunk ),
+                                             ts_bulk_Capacity( p_sys->bulk.p_chunk ) );
+    if( i_read <= 0 )
+        return false;
+    p_sys->bulk.i_size = i_read;
+    return CompleteTSChunk( p_demux );
+}
+
+static block_t* ReadTSPacket( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    for( ;; )
+    {
+        /* Get new TS packets */
+        if( p_sys->bulk.i_offset >= p_sys->bulk.i_size &&
+            !ReadTSChunk( p_demux ) )
         {
-            msg_Dbg( p_demux, "eof ?" );
+            int64_t size = stream_Size( p_sys->stream );
+            if( size >= 0 && (uint64_t)size == vlc_stream_Tell( p_sys->stream ) )
+                msg_Dbg( p_demux, "EOF at %"PRIu64, vlc_stream_Tell( p_sys->stream ) );
+            else
+                msg_Dbg( p_demux, "Can't read TS packet at %"PRIu64, vlc_stream_Tell(p_sys->stream) );
             return NULL;
         }
+
+        /* Check sync byte and re-sync if needed */
+        if( p_sys->bulk.i_offset < p_sys->bulk.i_synced )
+            break;
+
+        msg_Warn( p_demux, "lost synchro" );
+        if( !ResyncTSChunk( p_demux ) )
+            return NULL;
     }
+
+    block_t *p_pkt = ts_bulk_Packet( p_sys->bulk.p_chunk, p_sys->bulk.i_offset );
+    p_sys->bulk.i_offset += p_sys->i_packet_size;
+
+    /* Skip header (BluRay streams).
+     * re-sync logic would do this (by adjusting packet start), but this would result in losing first and last ts packets.
+     * First packet is usually PAT, and losing it means losing whole first GOP. This is fatal with still-image based menus.
+     */
+    p_pkt->p_buffer += p_sys->i_packet_header_size;
+    p_pkt->i_buffer -= p_sys->i_packet_header_size;
+
     return p_pkt;
 }
 
@@ -1843,13 +2054,13 @@ static int SeekToTime( demux_t *p_demux, const ts_pmt_t *p_pmt, int64_t i_scaled
 
     /* Deal with common but worst binary search case */
     if( p_pmt->pcr.i_first == i_scaledtime && p_sys->b_canseek )
-        return vlc_stream_Seek( p_sys->stream, 0 );
+        return TSSeek( p_sys, 0 );
 
     const int64_t i_stream_size = stream_Size( p_sys->stream );
     if( !p_sys->b_canfastseek || i_stream_size < p_sys->i_packet_size )
         return VLC_EGENERIC;
 
-    const uint64_t i_initial_pos = vlc_stream_Tell( p_sys->stream );
+    const uint64_t i_initial_pos = TSTell( p_sys );
 
     /* Find the time position by using binary search algorithm. */
     uint64_t i_head_pos = 0;
@@ -1857,6 +2068,23 @@ static int SeekToTime( demux_t *p_demux, const ts_pmt_t *p_pmt, int64_t i_scaled
     if( i_head_pos >= i_tail_pos )
         return VLC_EGENERIC;
 
+    /* Start from the closest positions found before */
+    const vlc_seekindex_entry_t *p_lower, *p_upper;
+    if( p_sys->p_seekindex &&
+        vlc_seekindex_Lookup( p_sys->p_seekindex, p_pmt->i_number,
+                              i_scaledtime, &p_lower, &p_upper ) )
+    {
+        if( p_lower && p_lower->i_pos <= i_tail_pos )
+        {
+            if( i_scaledtime - p_lower->i_time < TO_SCALE(VLC_TS_0 + CLOCK_FREQ / 2) &&
+                TSSeek( p_sys, p_lower->i_pos ) == VLC_SUCCESS )
+                return VLC_SUCCESS;
+            i_head_pos = p_lower->i_pos;
+        }
+        if( p_upper && p_upper->i_pos > i_head_pos && p_upper->i_pos < i_tail_pos )
+            i_tail_pos = p_upper->i_pos;
+    }
+
     bool b_found = false;
     while( (i_head_pos + p_sys->i_packet_size) <= i_tail_pos && !b_found )
     {
@@ -1865,7 +2093,7 @@ static int SeekToTime( demux_t *p_demux, const ts_pmt_t *p_pmt, int64_t i_scaled
         uint64_t i_div = i_splitpos % p_sys->i_packet_size;
         i_splitpos -= i_div;
 
-        if ( vlc_stream_Seek( p_sys->stream, i_splitpos ) != VLC_SUCCESS )
+        if ( TSSeek( p_sys, i_splitpos ) != VLC_SUCCESS )
             break;
 
         uint64_t i_pos = i_splitpos;
@@ -1879,7 +2107,7 @@ static int SeekToTime( demux_t *p_demux, const ts_pmt_t *p_pmt, int64_t i_scaled
                 break;
             }
             else
-                i_pos = vlc_stream_Tell( p_sys->stream );
+                i_pos = TSTell( p_sys );
 
             int i_pid = PIDGet( p_pkt );
             ts_pid_t *p_pid = GetPID(p_sys, i_pid);
@@ -1916,7 +2144,18 @@ static int SeekToTime( demux_t *p_demux, const ts_pmt_t *p_pmt, int64_t i_scaled
 
             if( i_pcr != -1 )
             {
-                int64_t i_diff = i_scaledtime - TimeStampWrapAround( p_pmt->pcr.i_first, i_pcr );
+                i_pcr = TimeStampWrapAround( p_pmt->pcr.i_first, i_pcr );
+                if( p_sys->p_seekindex )
+                {
+                    const vlc_seekindex_entry_t entry = {
+                        .i_time = i_pcr,
+                        .i_pos = i_pos,
+                        .i_track = p_pmt->i_number,
+                    };
+                    vlc_seekindex_Add( p_sys->p_seekindex, &entry );
+                }
+
+                int64_t i_diff = i_scaledtime - i_pcr;
                 if ( i_diff < 0 )
                     i_tail_pos = (i_splitpos >= p_sys->i_packet_size) ? i_splitpos - p_sys->i_packet_size : 0;
                 else if( i_diff < TO_SCALE(VLC_TS_0 + CLOCK_FREQ / 2) ) // 500ms
@@ -1934,7 +2173,7 @@ static int SeekToTime( demux_t *p_demux, const ts_pmt_t *p_pmt, int64_t i_scaled
     if( !b_found )
     {
         msg_Dbg( p_demux, "Seek():cannot find a time position." );
-        vlc_stream_Seek( p_sys->stream, i_initial_pos );
+        TSSeek( p_sys, i_initial_pos );
         return VLC_EGENERIC;
     }
     return VLC_SUCCESS;
@@ -2044,7 +2283,7 @@ static int ProbeChunk( demux_t *p_demux, int i_program, bool b_end, int64_t *pi_
 int ProbeStart( demux_t *p_demux, int i_program )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
-    const uint64_t i_initial_pos = vlc_stream_Tell( p_sys->stream );
+    const uint64_t i_initial_pos = TSTell( p_sys );
     int64_t i_stream_size = stream_Size( p_sys->stream );
 
     int i_probe_count = 0;
@@ -2057,7 +2296,7 @@ int ProbeStart( demux_t *p_demux, int i_program )
         i_pos = p_sys->i_packet_size * i_probe_count;
         i_pos = __MIN( i_pos, i_stream_size );
 
-        if( vlc_stream_Seek( p_sys->stream, i_pos ) )
+        if( TSSeek( p_sys, i_pos ) )
             return VLC_EGENERIC;
 
         ProbeChunk( p_demux, i_program, false, &i_pcr, &b_found );
@@ -2066,7 +2305,7 @@ int ProbeStart( demux_t *p_demux, int i_program )
         i_probe_count += PROBE_CHUNK_COUNT;
     } while( i_pos > 0 && (i_pcr == -1 || !b_found) && i_probe_count < (2 * PROBE_CHUNK_COUNT) );
 
-    if( vlc_stream_Seek( p_sys->stream, i_initial_pos ) )
+    if( TSSeek( p_sys, i_initial_pos ) )
         return VLC_EGENERIC;
 
     return (b_found) ? VLC_SUCCESS : VLC_EGENERIC;
@@ -2075,7 +2314,7 @@ int ProbeStart( demux_t *p_demux, int i_program )
 int ProbeEnd( demux_t *p_demux, int i_program )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
-    const uint64_t i_initial_pos = vlc_stream_Tell( p_sys->stream );
+    const uint64_t i_initial_pos = TSTell( p_sys );
     int64_t i_stream_size = stream_Size( p_sys->stream );
 
     int i_probe_count = PROBE_CHUNK_COUNT;
@@ -2088,7 +2327,7 @@ int ProbeEnd( demux_t *p_demux, int i_program )
         i_pos = i_stream_size - (p_sys->i_packet_size * i_probe_count);
         i_pos = __MAX( i_pos, 0 );
 
-        if( vlc_stream_Seek( p_sys->stream, i_pos ) )
+        if( TSSeek( p_sys, i_pos ) )
             return VLC_EGENERIC;
 
         ProbeChunk( p_demux, i_program, true, &i_pcr, &b_found );
@@ -2097,7 +2336,7 @@ int ProbeEnd( demux_t *p_demux, int i_program )
         i_probe_count += PROBE_CHUNK_COUNT;
     } while( i_pos > 0 && (i_pcr == -1 || !b_found) && i_probe_count < (6 * PROBE_CHUNK_COUNT) );
 
-    if( vlc_stream_Seek( p_sys->stream, i_initial_pos ) )
+    if( TSSeek( p_sys, i_initial_pos ) )
         return VLC_EGENERIC;
 
     return (b_found) ? VLC_SUCCESS : VLC_EGENERIC;
@@ -24,6 +24,8 @@
     typedef struct arib_instance_t arib_instance_t;
 #endif
 typedef struct csa_t csa_t;
+typedef struct ts_bulk_t ts_bulk_t;
+typedef struct vlc_seekindex_t vlc_seekindex_t;
 
 #define TS_USER_PMT_NUMBER (0)
 
@@ -49,6 +51,7 @@ struct demux_sys_t
     stream_t   *stream;
     bool        b_canseek;
     bool        b_canfastseek;
+    vlc_seekindex_t *p_seekindex; /* PCR positions found while seeking */
     vlc_mutex_t     csa_lock;
 
     /* TS packet size (188, 192, 204) */
@@ -60,6 +63,15 @@ struct demux_sys_t
     /* how many TS packet we read at once */
     unsigned    i_ts_read;
 
+    /* TS packets read ahead in bulk, from i_offset to i_size */
+    struct
+    {
+        ts_bulk_t *p_chunk;
+        size_t     i_offset;
+        size_t     i_synced; /* end of the checked packets */
+        size_t     i_size;
+    } bulk;
+
     bool        b_ignore_time_for_positions;
 
     ts_standards_e standard;
@@ -0,0 +1,145 @@
+/*****************************************************************************
+ * ts_bulk.c : MPEG TS packets bulk reading
+ *****************************************************************************
+ * Copyright (C) 2017 - VideoLAN Authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <assert.h>
+#include <string.h>
+
+#include <vlc_common.h>
+#include <vlc_block.h>
+#include <vlc_atomic.h>
+
+#include "ts_bulk.h"
+
+typedef struct
+{
+    block_t    self;
+    ts_bulk_t *p_owner;
+} ts_bulk_packet_t;
+
+struct ts_bulk_t
+{
+    atomic_uint i_refs; /* reader + packets in use */
+    unsigned    i_packet_size;
+    ts_bulk_packet_t packets[TS_BULK_PACKETS];
+    uint8_t     buffer[];
+};
+
+ts_bulk_t * ts_bulk_New( unsigned i_packet_size )
+{
+    ts_bulk_t *p_bulk = malloc( sizeof(*p_bulk) +
+                                (size_t) TS_BULK_PACKETS * i_packet_size );
+    if( unlikely(p_bulk == NULL) )
+        return NULL;
+
+    atomic_init( &p_bulk->i_refs, 1 );
+    p_bulk->i_packet_size = i_packet_size;
+    for( unsigned i = 0; i < TS_BULK_PACKETS; i++ )
+        p_bulk->packets[i].p_owner = p_bulk;
+    return p_bulk;
+}
+
+void ts_bulk_Release( ts_bulk_t *p_bulk )
+{
+    if( atomic_fetch_sub( &p_bulk->i_refs, 1 ) == 1 )
+        free( p_bulk );
+}
+
+bool ts_bulk_IsUnused( ts_bulk_t *p_bulk )
+{
+    return atomic_load( &p_bulk->i_refs ) == 1;
+}
+
+uint8_t * ts_bulk_Buffer( ts_bulk_t *p_bulk )
+{
+    return p_bulk->buffer;
+}
+
+size_t ts_bulk_Capacity( const ts_bulk_t *p_bulk )
+{
+    return (size_t) TS_BULK_PACKETS * p_bulk->i_packet_size;
+}
+
+static void ts_bulk_PacketRelease( block_t *p_block )
+{
+    ts_bulk_packet_t *p_pkt = (ts_bulk_packet_t *) p_block;
+
+    ts_bulk_Release( p_pkt->p_owner );
+}
+
+block_t * ts_bulk_Packet( ts_bulk_t *p_bulk, size_t i_offset )
+{
+    const unsigned i = i_offset / p_bulk->i_packet_size;
+    assert( i_offset % p_bulk->i_packet_size == 0 );
+    assert( i < TS_BULK_PACKETS );
+
+    block_t *p_block = &p_bulk->packets[i].self;
+    block_Init( p_block, &p_bulk->buffer[i_offset], p_bulk->i_packet_size );
+    p_block->pf_release = ts_bulk_PacketRelease;
+    atomic_fetch_add( &p_bulk->i_refs, 1 );
+    return p_block;
+}
+
+bool ts_bulk_Holds( const ts_bulk_t *p_bulk, const block_t *p_block )
+{
+    return p_block->pf_release == ts_bulk_PacketRelease &&
+           (p_bulk == NULL ||
+            ((const ts_bulk_packet_t *) p_block)->p_owner == p_bulk);
+}
+
+block_t * ts_bulk_Detach( ts_bulk_t *p_bulk, block_t *p_block )
+{
+    if( !ts_bulk_Holds( p_bulk, p_block ) )
+        return p_block;
+
+    block_t *p_copy = block_Alloc( p_block->i_buffer );
+    if( unlikely(p_copy == NULL) )
+        return p_block;
+
+    memcpy( p_copy->p_buffer, p_block->p_buffer, p_block->i_buffer );
+    block_CopyProperties( p_copy, p_block );
+    p_copy->p_next = p_block->p_next;
+    block_Release( p_block );
+    return p_copy;
+}
+
+size_t ts_bulk_SyncedSize( const uint8_t *p_buf, size_t i_buf,
+                           unsigned i_packet_size, unsigned i_header_size )
+{
+    const size_t i_packets = i_buf / i_packet_size;
+    const uint8_t *p_sync = &p_buf[i_header_size];
+    size_t i = 0;
+
+    /* Check by groups of 8 packets with a single branch per group, then
+     * narrow down. This is plain scalar code: the sync bytes are a packet
+     * apart, so there is nothing to gain from SIMD loads. */
+    for( ; i + 8 <= i_packets; i += 8 )
+    {
+        unsigned i_bad = 0;
+        for( unsigned j = 0; j < 8; j++ )
+            i_bad |= p_sync[(i + j) * i_packet_size] ^ 0x47;
+        if( i_bad )
+            break;
+    }
+    while( i < i_packets && p_sync[i * i_packet_size] == 0x47 )
+        i++;
+    return i * i_packet_size;
+}
@@ -0,0 +1,57 @@
+/*****************************************************************************
+ * ts_bulk.h : MPEG TS packets bulk reading
+ *****************************************************************************
+ * Copyright (C) 2017 - VideoLAN Authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+#ifndef VLC_TS_BULK_H
+#define VLC_TS_BULK_H
+
+/* Packets per chunk, a multiple of the 7 packets of a datagram */
+#define TS_BULK_PACKETS (7 * 8)
+
+/* A chunk of TS packets read at once.
+ * Packets are handed out as blocks pointing into the chunk, which is freed
+ * once the reader and all the packets have released it. */
+typedef struct ts_bulk_t ts_bulk_t;
+
+ts_bulk_t * ts_bulk_New( unsigned i_packet_size );
+void ts_bulk_Release( ts_bulk_t * );
+
+/* Returns true if no packet of the chunk is in use anymore */
+bool ts_bulk_IsUnused( ts_bulk_t * );
+uint8_t * ts_bulk_Buffer( ts_bulk_t * );
+size_t ts_bulk_Capacity( const ts_bulk_t * );
+
+/* Returns the packet at i_offset (a multiple of the packet size) as a block.
+ * Each packet can be taken once until the chunk gets unused. */
+block_t * ts_bulk_Packet( ts_bulk_t *, size_t i_offset );
+
+/* Returns true if the block is a packet of the chunk, or of any chunk if
+ * the chunk is NULL */
+bool ts_bulk_Holds( const ts_bulk_t *, const block_t * );
+
+/* Replaces a packet of the chunk, or of any chunk if the chunk is NULL, by
+ * a copy, so that it does not hold the chunk anymore. Other blocks are
+ * returned unchanged. The copy keeps the link to the next block of a
+ * chain. */
+block_t * ts_bulk_Detach( ts_bulk_t *, block_t * );
+
+/* Returns the length of the run of synchronized packets at the start of
+ * the buffer, in bytes */
+size_t ts_bulk_SyncedSize( const uint8_t *p_buf, size_t i_buf,
+                           unsigned i_packet_size, unsigned i_header_size );
+
+#endif
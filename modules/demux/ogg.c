@@ -35,6 +35,7 @@
 #include <vlc_demux.h>
 #include <vlc_meta.h>
 #include <vlc_input.h>
+#include <vlc_seekindex.h>
 
 #include <ogg/ogg.h>
 
@@ -246,6 +247,11 @@ static int Open( vlc_object_t * p_this )
     /* */
     TAB_INIT( p_sys->i_seekpoints, p_sys->pp_seekpoints );
 
+    bool b_canfastseek = false;
+    vlc_stream_Control( p_demux->s, STREAM_CAN_FASTSEEK, &b_canfastseek );
+    if( b_canfastseek )
+        p_sys->p_seekindex = vlc_seekindex_New( p_demux, p_demux->s, "ogg",
+                                                OGGSEEK_INDEX_VERSION );
 
     while ( !p_sys->b_preparsing_done && p_demux->pf_demux( p_demux ) > 0 )
     {}
@@ -271,6 +277,9 @@ static void Close( vlc_object_t *p_this )
     if( p_sys->p_old_stream )
         Ogg_LogicalStreamDelete( p_demux, p_sys->p_old_stream );
 
+    if( p_sys->p_seekindex )
+        vlc_seekindex_Delete( p_sys->p_seekindex );
+
     free( p_sys );
 }
 
@@ -233,6 +233,8 @@ struct demux_sys_t
     /* Length, if available. */
     int64_t i_length;
 
+    /* keyframe positions found while seeking, kept across sessions */
+    vlc_seekindex_t *p_seekindex;
 };
 
 
@@ -32,6 +32,7 @@
 
 #include <vlc_common.h>
 #include <vlc_demux.h>
+#include <vlc_seekindex.h>
 
 #include <ogg/ogg.h>
 #include <limits.h>
@@ -151,9 +152,42 @@ const demux_index_entry_t *OggSeek_IndexAdd ( logical_stream_t *p_stream,
     return idx;
 }
 
-static bool OggSeekIndexFind ( logical_stream_t *p_stream, int64_t i_timestamp,
+static void OggSeekIndexAdd ( demux_t *p_demux, logical_stream_t *p_stream,
+                              int64_t i_timestamp, int64_t i_pagepos )
+{
+    vlc_seekindex_t *p_seekindex = p_demux->p_sys->p_seekindex;
+    if ( p_seekindex != NULL )
+    {
+        const vlc_seekindex_entry_t entry = {
+            .i_time = i_timestamp,
+            .i_pos = i_pagepos,
+            .i_track = p_stream->i_serial_no,
+        };
+        vlc_seekindex_Add( p_seekindex, &entry );
+    }
+    else
+        OggSeek_IndexAdd( p_stream, i_timestamp, i_pagepos );
+}
+
+static bool OggSeekIndexFind ( demux_t *p_demux, logical_stream_t *p_stream,
+                               int64_t i_timestamp,
                                int64_t *pi_pos_lower, int64_t *pi_pos_upper )
 {
+    vlc_seekindex_t *p_seekindex = p_demux->p_sys->p_seekindex;
+    if ( p_seekindex != NULL )
+    {
+        /* Also holds the positions found in previous sessions */
+        const vlc_seekindex_entry_t *p_lower, *p_upper;
+        vlc_seekindex_Lookup( p_seekindex, p_stream->i_serial_no, i_timestamp,
+                              &p_lower, &p_upper );
+        if ( p_lower == NULL )
+            return false;
+        *pi_pos_lower = p_lower->i_pos;
+        if ( p_upper != NULL )
+            *pi_pos_upper = p_upper->i_pos;
+        return true;
+    }
+
     demux_index_entry_t *idx = p_stream->idx;
 
     while ( idx != NULL )
@@ -908,7 +942,7 @@ int Oggseek_BlindSeektoAbsoluteTime( demux_t *p_demux, logical_stream_t *p_strea
     if ( i_lowerpos != -1 ) b_found = true;
 
     /* And also search in our own index */
-    if ( !b_found && OggSeekIndexFind( p_stream, i_time, &i_lowerpos, &i_upperpos ) )
+    if ( !b_found && OggSeekIndexFind( p_demux, p_stream, i_time, &i_lowerpos, &i_upperpos ) )
     {
         b_found = true;
     }
@@ -1005,7 +1039,7 @@ int Oggseek_SeektoAbsolutetime( demux_t *p_demux, logical_stream_t *p_stream,
     OggDebug( msg_Dbg( p_demux, "Search bounds set to %"PRId64" %"PRId64" using skeleton index", i_offset_lower, i_offset_upper ) );
 
     OggNoDebug(
-        OggSeekIndexFind( p_stream, i_time, &i_offset_lower, &i_offset_upper )
+        OggSeekIndexFind( p_demux, p_stream, i_time, &i_offset_lower, &i_offset_upper )
     );
 
     i_offset_lower = __MAX( i_offset_lower, p_stream->i_data_start );
@@ -1023,7 +1057,7 @@ int Oggseek_SeektoAbsolutetime( demux_t *p_demux, logical_stream_t *p_stream,
     /* Insert keyframe position into index */
     OggNoDebug(
     if ( i_pagepos >= p_stream->i_data_start )
-        OggSeek_IndexAdd( p_stream, i_time, i_pagepos )
+        OggSeekIndexAdd( p_demux, p_stream, i_time, i_pagepos )
     );
 
     OggDebug( msg_Dbg( p_demux, "=================== Seeked To %"PRId64" time %"PRId64, i_pagepos, i_time ) );
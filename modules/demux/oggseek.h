@@ -49,6 +49,10 @@ struct oggseek_index_entry
     int64_t i_pagepos_end;
 };
 
+/* Version of the seek index entries: the track is the stream serial number,
+ * the time the seek time and the position the page of its keyframe */
+#define OGGSEEK_INDEX_VERSION 1
+
 int64_t Ogg_GetKeyframeGranule ( logical_stream_t *p_stream, int64_t i_granule );
 bool    Ogg_IsKeyFrame ( logical_stream_t *, ogg_packet * );
 
@@ -27,6 +27,7 @@
 #endif
 
 #include <vlc_common.h>
+#include <vlc_cpu.h>
 
 #include "csa.h"
 
@@ -47,6 +48,10 @@ struct csa_t
     int     p, q, r;
 
     bool    use_odd;
+
+    /* block cypher rounds on 64-bit words (see csa_BlockCypher8) */
+    uint64_t block_enc[256];
+    uint64_t block_dec[256];
 };
 
 static void csa_ComputeKey( uint8_t kk[57], uint8_t ck[8] );
@@ -55,13 +60,18 @@ static void csa_StreamCypher( csa_t *c, int b_init, uint8_t *ck, uint8_t *sb, ui
 
 static void csa_BlockDecypher( uint8_t kk[57], uint8_t ib[8], uint8_t bd[8] );
 static void csa_BlockCypher( uint8_t kk[57], uint8_t bd[8], uint8_t ib[8] );
+static void csa_BlockInit( csa_t *c );
 
 /*****************************************************************************
  * csa_New:
  *****************************************************************************/
 csa_t *csa_New( void )
 {
-    return calloc( 1, sizeof( csa_t ) );
+    csa_t *c = calloc( 1, sizeof( csa_t ) );
+
+    if( c != NULL )
+        csa_BlockInit( c );
+    return c;
 }
 
 /*****************************************************************************
@@ -72,6 +82,14 @@ void csa_Delete( csa_t *c )
     free( c );
 }
 
+/*****************************************************************************
+ * csa_Copy: copies the keys, so that both states can encrypt concurrently
+ *****************************************************************************/
+void csa_Copy( csa_t *dst, const csa_t *src )
+{
+    *dst = *src;
+}
+
 /*****************************************************************************
  * csa_SetCW:
  *****************************************************************************/
@@ -610,3 +628,378 @@ static void csa_BlockCypher( uint8_t kk[57], uint8_t bd[8], uint8_t ib[8] )
     }
 }
 
+
+/*****************************************************************************
+ * Batch (de)scrambling
+ *****************************************************************************
+ * The stream cypher runs bitsliced on up to 256 packets at once (see
+ * csa_bs.h). The block cypher runs on 8 packets at once.
+ *****************************************************************************/
+typedef struct
+{
+    uint8_t       *p_data;   /* payload after the header */
+    const uint8_t *ck;
+    const uint8_t *kk;
+    int            i_size;   /* payload size to (de)scramble */
+    int            i_blocks; /* 8-byte stream blocks after the first one */
+} csa_lane_t;
+
+static void csa_LaneSetup( csa_lane_t *lane, uint8_t *pkt, int i_hdr,
+                           int i_pkt_size )
+{
+    const int n = (i_pkt_size - i_hdr) / 8;
+    const int i_residue = (i_pkt_size - i_hdr) % 8;
+
+    lane->p_data = &pkt[i_hdr];
+    lane->i_size = i_pkt_size - i_hdr;
+    lane->i_blocks = (n > 0 ? n - 1 : 0) + (i_residue > 0 ? 1 : 0);
+}
+
+/* Same as the beginning of csa_Encrypt(), returns false if there is
+ * nothing more to do */
+static bool csa_EncryptLane( csa_t *c, csa_lane_t *lane, uint8_t *pkt,
+                             int i_pkt_size )
+{
+    int i_hdr = 4;
+
+    pkt[3] |= 0x80;
+    if( c->use_odd )
+    {
+        pkt[3] |= 0x40;
+        lane->ck = c->o_ck;
+        lane->kk = c->o_kk;
+    }
+    else
+    {
+        lane->ck = c->e_ck;
+        lane->kk = c->e_kk;
+    }
+
+    if( pkt[3]&0x20 )
+        i_hdr += pkt[4] + 1;
+    if( (i_pkt_size - i_hdr) / 8 <= 0 )
+    {
+        pkt[3] &= 0x3f;
+        return false;
+    }
+    csa_LaneSetup( lane, pkt, i_hdr, i_pkt_size );
+    return true;
+}
+
+/* Same as the beginning of csa_Decrypt() */
+static bool csa_DecryptLane( csa_t *c, csa_lane_t *lane, uint8_t *pkt,
+                             int i_pkt_size )
+{
+    int i_hdr = 4;
+
+    if( (pkt[3]&0x80) == 0 )
+        return false;
+    if( pkt[3]&0x40 )
+    {
+        lane->ck = c->o_ck;
+        lane->kk = c->o_kk;
+    }
+    else
+    {
+        lane->ck = c->e_ck;
+        lane->kk = c->e_kk;
+    }
+    pkt[3] &= 0x3f;
+
+    if( pkt[3]&0x20 )
+        i_hdr += pkt[4] + 1;
+    if( 188 - i_hdr < 8 || (i_pkt_size - i_hdr) / 8 < 0 )
+        return false;
+    csa_LaneSetup( lane, pkt, i_hdr, i_pkt_size );
+    return lane->i_size >= 8 || lane->i_blocks > 0;
+}
+
+static void csa_BlockInit( csa_t *c )
+{
+    for( unsigned i = 0; i < 256; i++ )
+    {
+        const uint64_t sbox_out = block_sbox[i];
+        const uint64_t perm_out = block_perm[sbox_out];
+
+        c->block_enc[i] = (sbox_out << 56) ^ (perm_out << 40);
+        c->block_dec[i] = (sbox_out * UINT64_C(0x0000000101010001))
+                        ^ (perm_out << 48);
+    }
+}
+
+/* csa_BlockCypher() on 8 independent blocks at once, with R[1]..R[8] in
+ * the bytes of a word from the least significant one. The register moves
+ * become shifts, and the 8 blocks hide the latency of the table lookups. */
+#define CSA_BLOCK_LANES 8
+
+static void csa_BlockCypher8( const csa_t *c, uint64_t w[CSA_BLOCK_LANES],
+                              const uint8_t *const kk[CSA_BLOCK_LANES] )
+{
+    for( int i = 1; i <= 56; i++ )
+        for( unsigned l = 0; l < CSA_BLOCK_LANES; l++ )
+            w[l] = (w[l] >> 8)
+                 ^ ((w[l] & 0xff) * UINT64_C(0x0100000001010100))
+                 ^ c->block_enc[kk[l][i] ^ (w[l] >> 56)];
+}
+
+static void csa_BlockDecypher8( const csa_t *c, uint64_t w[CSA_BLOCK_LANES],
+                                const uint8_t *const kk[CSA_BLOCK_LANES] )
+{
+    for( int i = 56; i > 0; i-- )
+        for( unsigned l = 0; l < CSA_BLOCK_LANES; l++ )
+            w[l] = (w[l] << 8)
+                 ^ ((w[l] >> 56) * UINT64_C(0x0000000101010001))
+                 ^ c->block_dec[kk[l][i] ^ ((w[l] >> 48) & 0xff)];
+}
+
+/* Block cypher chains of csa_Encrypt(), in place: ib[i] goes to block i-1 */
+static void csa_EncryptBlocks( const csa_t *c, const csa_lane_t *lanes,
+                               unsigned count )
+{
+    for( unsigned base = 0; base < count; base += CSA_BLOCK_LANES )
+    {
+        const csa_lane_t *lane = &lanes[base];
+        const unsigned m = __MIN( count - base, CSA_BLOCK_LANES );
+        const uint8_t *kk[CSA_BLOCK_LANES];
+        uint64_t ib[CSA_BLOCK_LANES] = { 0 }, w[CSA_BLOCK_LANES] = { 0 };
+        int n_max = 0;
+
+        for( unsigned l = 0; l < CSA_BLOCK_LANES; l++ )
+        {
+            kk[l] = lane[l < m ? l : 0].kk;
+            if( l < m && lane[l].i_size / 8 > n_max )
+                n_max = lane[l].i_size / 8;
+        }
+
+        for( int t = 0; t < n_max; t++ )
+        {
+            for( unsigned l = 0; l < m; l++ )
+            {
+                const int i = lane[l].i_size / 8 - t;
+                if( i > 0 )
+                    w[l] = GetQWLE( &lane[l].p_data[8 * (i - 1)] ) ^ ib[l];
+            }
+            csa_BlockCypher8( c, w, kk );
+            for( unsigned l = 0; l < m; l++ )
+            {
+                const int i = lane[l].i_size / 8 - t;
+                if( i > 0 )
+                {
+                    ib[l] = w[l];
+                    SetQWLE( &lane[l].p_data[8 * (i - 1)], w[l] );
+                }
+            }
+        }
+    }
+}
+
+/* Block cypher chains of csa_Decrypt(), once the stream is removed */
+static void csa_DecryptBlocks( const csa_t *c, const csa_lane_t *lanes,
+                               unsigned count )
+{
+    for( unsigned base = 0; base < count; base += CSA_BLOCK_LANES )
+    {
+        const csa_lane_t *lane = &lanes[base];
+        const unsigned m = __MIN( count - base, CSA_BLOCK_LANES );
+        const uint8_t *kk[CSA_BLOCK_LANES];
+        uint64_t w[CSA_BLOCK_LANES] = { 0 };
+        int n_max = 0;
+
+        for( unsigned l = 0; l < CSA_BLOCK_LANES; l++ )
+        {
+            kk[l] = lane[l < m ? l : 0].kk;
+            if( l < m && lane[l].i_size / 8 > n_max )
+                n_max = lane[l].i_size / 8;
+        }
+
+        for( int i = 1; i <= n_max; i++ )
+        {
+            for( unsigned l = 0; l < m; l++ )
+                if( i <= lane[l].i_size / 8 )
+                    w[l] = GetQWLE( &lane[l].p_data[8 * (i - 1)] );
+            csa_BlockDecypher8( c, w, kk );
+            for( unsigned l = 0; l < m; l++ )
+            {
+                const int n = lane[l].i_size / 8;
+                uint8_t *p = &lane[l].p_data[8 * (i - 1)];
+
+                if( i < n )
+                    SetQWLE( p, w[l] ^ GetQWLE( &p[8] ) );
+                else if( i == n )
+                    SetQWLE( p, w[l] );
+            }
+        }
+    }
+}
+
+/* Applies the g-th generated stream block to a lane */
+static inline void csa_ApplyStream( const csa_lane_t *lane, int g,
+                                    uint64_t stream )
+{
+    if( g > lane->i_blocks )
+        return;
+
+    if( g < lane->i_size / 8 )
+    {
+        uint8_t *p = &lane->p_data[8 * g];
+
+        SetQWLE( p, GetQWLE( p ) ^ stream );
+    }
+    else
+    {   /* residue */
+        const int i_residue = lane->i_size % 8;
+        uint8_t *p = &lane->p_data[lane->i_size - i_residue];
+
+        for( int j = 0; j < i_residue; j++ )
+            p[j] ^= stream >> (8 * j);
+    }
+}
+
+/* Transposes a 64x64 bits matrix: bit j of a[i] becomes bit i of a[j] */
+static void csa_Transpose64( uint64_t a[64] )
+{
+    uint64_t m = UINT64_C(0x00000000FFFFFFFF);
+
+    for( unsigned j = 32; j != 0; j >>= 1, m ^= m << j )
+        for( unsigned k = 0; k < 64; k = ((k | j) + 1) & ~j )
+        {
+            uint64_t t = ((a[k] >> j) ^ a[k | j]) & m;
+
+            a[k] ^= t << j;
+            a[k | j] ^= t;
+        }
+}
+
+typedef uint64_t csa_bs64_t __attribute__((vector_size(8)));
+#define CSA_BS_LANES  64
+#define CSA_BS_WORD   csa_bs64_t
+#define CSA_BS_TARGET
+#define CSA_BS(name)  csa_bs64_##name
+#include "csa_bs.h"
+#undef CSA_BS
+#undef CSA_BS_TARGET
+#undef CSA_BS_WORD
+#undef CSA_BS_LANES
+
+#if (defined (__i386__) || defined (__x86_64__)) && \
+    (VLC_GCC_VERSION(4, 9) || defined (__clang__))
+# define CSA_BS_X86 1
+
+typedef uint64_t csa_bs128_t __attribute__((vector_size(16)));
+# define CSA_BS_LANES  128
+# define CSA_BS_WORD   csa_bs128_t
+# define CSA_BS_TARGET __attribute__ ((__target__ ("sse2")))
+# define CSA_BS(name)  csa_bs128_##name
+# include "csa_bs.h"
+# undef CSA_BS
+# undef CSA_BS_TARGET
+# undef CSA_BS_WORD
+# undef CSA_BS_LANES
+
+typedef uint64_t csa_bs256_t __attribute__((vector_size(32)));
+# define CSA_BS_LANES  256
+# define CSA_BS_WORD   csa_bs256_t
+# define CSA_BS_TARGET __attribute__ ((__target__ ("avx2")))
+# define CSA_BS(name)  csa_bs256_##name
+# include "csa_bs.h"
+# undef CSA_BS
+# undef CSA_BS_TARGET
+# undef CSA_BS_WORD
+# undef CSA_BS_LANES
+#endif
+
+#define CSA_BATCH_MAX 256
+
+typedef void (*csa_stream_fn)( const csa_lane_t *, unsigned );
+
+/* Picks the narrowest bitsliced cypher fitting the batch */
+static unsigned csa_StreamSelect( unsigned count, csa_stream_fn *pf )
+{
+#ifdef CSA_BS_X86
+    if( count > 128 && vlc_CPU_AVX2() )
+    {
+        *pf = csa_bs256_Stream;
+        return 256;
+    }
+    if( count > 64 && vlc_CPU_SSE2() )
+    {
+        *pf = csa_bs128_Stream;
+        return 128;
+    }
+#endif
+    VLC_UNUSED(count);
+    *pf = csa_bs64_Stream;
+    return 64;
+}
+
+/*****************************************************************************
+ * csa_EncryptBatch:
+ *****************************************************************************/
+void csa_EncryptBatch( csa_t *c, uint8_t *const *pkts, unsigned count,
+                       int i_pkt_size )
+{
+    csa_lane_t lanes[CSA_BATCH_MAX];
+
+    if( count == 1 )
+    {
+        csa_Encrypt( c, pkts[0], i_pkt_size );
+        return;
+    }
+
+    while( count > 0 )
+    {
+        csa_stream_fn pf_stream;
+        unsigned i_width = csa_StreamSelect( count, &pf_stream );
+        unsigned i_lanes = 0;
+
+        if( i_width > count )
+            i_width = count;
+        for( unsigned i = 0; i < i_width; i++ )
+            if( csa_EncryptLane( c, &lanes[i_lanes], pkts[i], i_pkt_size ) )
+                i_lanes++;
+
+        if( i_lanes > 0 )
+        {
+            csa_EncryptBlocks( c, lanes, i_lanes );
+            pf_stream( lanes, i_lanes );
+        }
+        pkts += i_width;
+        count -= i_width;
+    }
+}
+
+/*****************************************************************************
+ * csa_DecryptBatch:
+ *****************************************************************************/
+void csa_DecryptBatch( csa_t *c, uint8_t *const *pkts, unsigned count,
+                       int i_pkt_size )
+{
+    csa_lane_t lanes[CSA_BATCH_MAX];
+
+    if( count == 1 )
+    {
+        csa_Decrypt( c, pkts[0], i_pkt_size );
+        return;
+    }
+
+    while( count > 0 )
+    {
+        csa_stream_fn pf_stream;
+        unsigned i_width = csa_StreamSelect( count, &pf_stream );
+        unsigned i_lanes = 0;
+
+        if( i_width > count )
+            i_width = count;
+        for( unsigned i = 0; i < i_width; i++ )
+            if( csa_DecryptLane( c, &lanes[i_lanes], pkts[i], i_pkt_size ) )
+                i_lanes++;
+
+        if( i_lanes > 0 )
+        {
+            pf_stream( lanes, i_lanes );
+            csa_DecryptBlocks( c, lanes, i_lanes );
+        }
+        pkts += i_width;
+        count -= i_width;
+    }
+}
@@ -0,0 +1,420 @@
+/*****************************************************************************
+ * csa_bs.h: bitsliced CSA stream cypher
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* This file is included by csa.c once per vector width, with:
+ *  CSA_BS_LANES   the number of packets processed at once (a multiple of 64)
+ *  CSA_BS_WORD    an unsigned vector type of CSA_BS_LANES bits
+ *  CSA_BS_TARGET  the function attributes to build with
+ *  CSA_BS(name)   the name mangling of the functions
+ *
+ * Each bit of the cypher state is stored in one word, with one packet per
+ * bit lane. Bytes are sliced the same way: row 8*i+k holds the bit k of
+ * the byte i of every packet.
+ *
+ * S-boxes are in algebraic normal form, generated from the tables of
+ * csa_StreamCypher(). */
+
+CSA_BS_TARGET
+static inline void CSA_BS(sbox1)( CSA_BS_WORD a, CSA_BS_WORD b, CSA_BS_WORD c,
+                                  CSA_BS_WORD d, CSA_BS_WORD e,
+                                  CSA_BS_WORD *o0, CSA_BS_WORD *o1 )
+{
+    const CSA_BS_WORD ab = a & b;
+    const CSA_BS_WORD ac = a & c;
+    const CSA_BS_WORD ad = a & d;
+    const CSA_BS_WORD ae = a & e;
+    const CSA_BS_WORD bc = b & c;
+    const CSA_BS_WORD bd = b & d;
+    const CSA_BS_WORD be = b & e;
+    const CSA_BS_WORD cd = c & d;
+    const CSA_BS_WORD ce = c & e;
+    const CSA_BS_WORD de = d & e;
+    const CSA_BS_WORD abc = ab & c;
+    const CSA_BS_WORD abd = ab & d;
+    const CSA_BS_WORD acd = ac & d;
+    const CSA_BS_WORD ade = ad & e;
+    const CSA_BS_WORD bcd = bc & d;
+    const CSA_BS_WORD bce = bc & e;
+    const CSA_BS_WORD bde = bd & e;
+    const CSA_BS_WORD abcd = abc & d;
+    const CSA_BS_WORD abce = abc & e;
+    const CSA_BS_WORD abde = abd & e;
+    *o0 = b ^ d ^ ab ^ ae ^ be ^ ce ^ abc ^ abd ^ bde ^ abce;
+    *o1 = ~(a ^ d ^ e ^ ab ^ ac ^ bc ^ bd ^ be ^ cd ^ ce ^ de ^ abc ^ abd ^
+          acd ^ ade ^ bcd ^ bce ^ abcd ^ abde);
+}
+
+CSA_BS_TARGET
+static inline void CSA_BS(sbox2)( CSA_BS_WORD a, CSA_BS_WORD b, CSA_BS_WORD c,
+                                  CSA_BS_WORD d, CSA_BS_WORD e,
+                                  CSA_BS_WORD *o0, CSA_BS_WORD *o1 )
+{
+    const CSA_BS_WORD ab = a & b;
+    const CSA_BS_WORD ac = a & c;
+    const CSA_BS_WORD ad = a & d;
+    const CSA_BS_WORD bc = b & c;
+    const CSA_BS_WORD bd = b & d;
+    const CSA_BS_WORD cd = c & d;
+    const CSA_BS_WORD ce = c & e;
+    const CSA_BS_WORD abc = ab & c;
+    const CSA_BS_WORD abd = ab & d;
+    const CSA_BS_WORD abe = ab & e;
+    const CSA_BS_WORD acd = ac & d;
+    const CSA_BS_WORD ade = ad & e;
+    const CSA_BS_WORD bce = bc & e;
+    const CSA_BS_WORD bde = bd & e;
+    const CSA_BS_WORD cde = cd & e;
+    const CSA_BS_WORD abce = abc & e;
+    const CSA_BS_WORD abde = abd & e;
+    *o0 = ~(c ^ d ^ ab ^ ac ^ ce ^ ade ^ bce ^ bde ^ abce ^ abde);
+    *o1 = ~(b ^ d ^ e ^ cd ^ ce ^ abc ^ abd ^ abe ^ acd ^ cde ^ abde);
+}
+
+CSA_BS_TARGET
+static inline void CSA_BS(sbox3)( CSA_BS_WORD a, CSA_BS_WORD b, CSA_BS_WORD c,
+                                  CSA_BS_WORD d, CSA_BS_WORD e,
+                                  CSA_BS_WORD *o0, CSA_BS_WORD *o1 )
+{
+    const CSA_BS_WORD ab = a & b;
+    const CSA_BS_WORD ac = a & c;
+    const CSA_BS_WORD ad = a & d;
+    const CSA_BS_WORD bc = b & c;
+    const CSA_BS_WORD bd = b & d;
+    const CSA_BS_WORD be = b & e;
+    const CSA_BS_WORD cd = c & d;
+    const CSA_BS_WORD ce = c & e;
+    const CSA_BS_WORD de = d & e;
+    const CSA_BS_WORD abc = ab & c;
+    const CSA_BS_WORD abe = ab & e;
+    const CSA_BS_WORD acd = ac & d;
+    const CSA_BS_WORD ace = ac & e;
+    const CSA_BS_WORD ade = ad & e;
+    const CSA_BS_WORD bcd = bc & d;
+    const CSA_BS_WORD bde = bd & e;
+    const CSA_BS_WORD cde = cd & e;
+    const CSA_BS_WORD abcd = abc & d;
+    const CSA_BS_WORD acde = acd & e;
+    *o0 = a ^ b ^ d ^ ce ^ de;
+    *o1 = ~(a ^ b ^ d ^ e ^ ac ^ ad ^ bc ^ bd ^ be ^ cd ^ ce ^ abc ^ abe ^
+          acd ^ ace ^ ade ^ bcd ^ bde ^ cde ^ abcd ^ acde);
+}
+
+CSA_BS_TARGET
+static inline void CSA_BS(sbox4)( CSA_BS_WORD a, CSA_BS_WORD b, CSA_BS_WORD c,
+                                  CSA_BS_WORD d, CSA_BS_WORD e,
+                                  CSA_BS_WORD *o0, CSA_BS_WORD *o1 )
+{
+    const CSA_BS_WORD ab = a & b;
+    const CSA_BS_WORD ac = a & c;
+    const CSA_BS_WORD ad = a & d;
+    const CSA_BS_WORD ae = a & e;
+    const CSA_BS_WORD bc = b & c;
+    const CSA_BS_WORD bd = b & d;
+    const CSA_BS_WORD be = b & e;
+    const CSA_BS_WORD cd = c & d;
+    const CSA_BS_WORD de = d & e;
+    const CSA_BS_WORD abc = ab & c;
+    const CSA_BS_WORD abd = ab & d;
+    const CSA_BS_WORD abe = ab & e;
+    const CSA_BS_WORD acd = ac & d;
+    const CSA_BS_WORD bcd = bc & d;
+    const CSA_BS_WORD bde = bd & e;
+    const CSA_BS_WORD cde = cd & e;
+    const CSA_BS_WORD abcd = abc & d;
+    const CSA_BS_WORD abde = abd & e;
+    const CSA_BS_WORD acde = acd & e;
+    *o0 = ~(c ^ d ^ ab ^ ad ^ ae ^ bc ^ be ^ de ^ abc ^ abe ^ bde ^ abcd ^
+          abde ^ acde);
+    *o1 = ~(a ^ b ^ c ^ e ^ ab ^ ad ^ ae ^ de ^ abc ^ abe ^ bcd ^ cde ^ abcd ^
+          abde ^ acde);
+}
+
+CSA_BS_TARGET
+static inline void CSA_BS(sbox5)( CSA_BS_WORD a, CSA_BS_WORD b, CSA_BS_WORD c,
+                                  CSA_BS_WORD d, CSA_BS_WORD e,
+                                  CSA_BS_WORD *o0, CSA_BS_WORD *o1 )
+{
+    const CSA_BS_WORD ab = a & b;
+    const CSA_BS_WORD ac = a & c;
+    const CSA_BS_WORD ad = a & d;
+    const CSA_BS_WORD ae = a & e;
+    const CSA_BS_WORD bc = b & c;
+    const CSA_BS_WORD bd = b & d;
+    const CSA_BS_WORD be = b & e;
+    const CSA_BS_WORD cd = c & d;
+    const CSA_BS_WORD ce = c & e;
+    const CSA_BS_WORD de = d & e;
+    const CSA_BS_WORD abc = ab & c;
+    const CSA_BS_WORD abd = ab & d;
+    const CSA_BS_WORD abe = ab & e;
+    const CSA_BS_WORD acd = ac & d;
+    const CSA_BS_WORD ace = ac & e;
+    const CSA_BS_WORD bcd = bc & d;
+    const CSA_BS_WORD bce = bc & e;
+    const CSA_BS_WORD bde = bd & e;
+    const CSA_BS_WORD cde = cd & e;
+    const CSA_BS_WORD abcd = abc & d;
+    const CSA_BS_WORD abce = abc & e;
+    const CSA_BS_WORD abde = abd & e;
+    const CSA_BS_WORD acde = acd & e;
+    *o0 = c ^ ab ^ ac ^ ae ^ bd ^ be ^ ce ^ de ^ abd ^ abe ^ acd ^ ace ^ bce ^
+          cde ^ abde ^ acde;
+    *o1 = ~(b ^ d ^ e ^ ac ^ ad ^ ae ^ be ^ cd ^ ce ^ de ^ abd ^ abe ^ acd ^
+          bcd ^ bce ^ bde ^ cde ^ abcd ^ abce ^ acde);
+}
+
+CSA_BS_TARGET
+static inline void CSA_BS(sbox6)( CSA_BS_WORD a, CSA_BS_WORD b, CSA_BS_WORD c,
+                                  CSA_BS_WORD d, CSA_BS_WORD e,
+                                  CSA_BS_WORD *o0, CSA_BS_WORD *o1 )
+{
+    const CSA_BS_WORD ab = a & b;
+    const CSA_BS_WORD ac = a & c;
+    const CSA_BS_WORD ad = a & d;
+    const CSA_BS_WORD bc = b & c;
+    const CSA_BS_WORD bd = b & d;
+    const CSA_BS_WORD cd = c & d;
+    const CSA_BS_WORD ce = c & e;
+    const CSA_BS_WORD abc = ab & c;
+    const CSA_BS_WORD abd = ab & d;
+    const CSA_BS_WORD abe = ab & e;
+    const CSA_BS_WORD acd = ac & d;
+    const CSA_BS_WORD ade = ad & e;
+    const CSA_BS_WORD bcd = bc & d;
+    const CSA_BS_WORD bce = bc & e;
+    const CSA_BS_WORD bde = bd & e;
+    const CSA_BS_WORD cde = cd & e;
+    const CSA_BS_WORD abcd = abc & d;
+    const CSA_BS_WORD abde = abd & e;
+    const CSA_BS_WORD acde = acd & e;
+    *o0 = c ^ e ^ bc ^ bd ^ cd ^ acd ^ ade ^ bcd ^ cde ^ abcd ^ abde ^ acde;
+    *o1 = a ^ d ^ bc ^ ce ^ abe ^ ade ^ bce ^ bde;
+}
+
+CSA_BS_TARGET
+static inline void CSA_BS(sbox7)( CSA_BS_WORD a, CSA_BS_WORD b, CSA_BS_WORD c,
+                                  CSA_BS_WORD d, CSA_BS_WORD e,
+                                  CSA_BS_WORD *o0, CSA_BS_WORD *o1 )
+{
+    const CSA_BS_WORD ab = a & b;
+    const CSA_BS_WORD ac = a & c;
+    const CSA_BS_WORD ad = a & d;
+    const CSA_BS_WORD ae = a & e;
+    const CSA_BS_WORD bc = b & c;
+    const CSA_BS_WORD bd = b & d;
+    const CSA_BS_WORD cd = c & d;
+    const CSA_BS_WORD de = d & e;
+    const CSA_BS_WORD abc = ab & c;
+    const CSA_BS_WORD abd = ab & d;
+    const CSA_BS_WORD acd = ac & d;
+    const CSA_BS_WORD ade = ad & e;
+    const CSA_BS_WORD bde = bd & e;
+    const CSA_BS_WORD cde = cd & e;
+    const CSA_BS_WORD abcd = abc & d;
+    const CSA_BS_WORD abde = abd & e;
+    const CSA_BS_WORD acde = acd & e;
+    *o0 = a ^ b ^ c ^ e ^ bc ^ cd ^ de ^ abd ^ cde ^ abde;
+    *o1 = b ^ c ^ d ^ e ^ ac ^ ae ^ de ^ acd ^ ade ^ bde ^ abcd ^ abde ^ acde;
+}
+
+/* Loads 8 bytes of every lane into 64 rows */
+CSA_BS_TARGET
+static void CSA_BS(Slice)( CSA_BS_WORD row[64], const uint64_t *lanes )
+{
+    for( unsigned c = 0; c < CSA_BS_LANES / 64; c++ )
+    {
+        uint64_t t[64];
+
+        memcpy( t, &lanes[64 * c], sizeof( t ) );
+        csa_Transpose64( t );
+        for( unsigned b = 0; b < 64; b++ )
+            row[b][c] = t[b];
+    }
+}
+
+/* Stores 64 rows back into 8 bytes of every lane */
+CSA_BS_TARGET
+static void CSA_BS(Unslice)( uint64_t *lanes, const CSA_BS_WORD row[64] )
+{
+    for( unsigned c = 0; c < CSA_BS_LANES / 64; c++ )
+    {
+        uint64_t *t = &lanes[64 * c];
+
+        for( unsigned b = 0; b < 64; b++ )
+            t[b] = row[b][c];
+        csa_Transpose64( t );
+    }
+}
+
+typedef struct
+{
+    CSA_BS_WORD A[11][4]; /* A[1]..A[10], one word per bit */
+    CSA_BS_WORD B[11][4];
+    CSA_BS_WORD X[4], Y[4], Z[4];
+    CSA_BS_WORD D[4], E[4], F[4];
+    CSA_BS_WORD p, q, r;
+} CSA_BS(stream_t);
+
+/* One step of csa_StreamCypher(), returns the 2 output bits.
+ * in_a and in_b are the input nibbles during initialisation, or NULL. */
+CSA_BS_TARGET
+static inline void CSA_BS(Step)( CSA_BS(stream_t) *s,
+                                 const CSA_BS_WORD *in_a,
+                                 const CSA_BS_WORD *in_b,
+                                 CSA_BS_WORD *hi, CSA_BS_WORD *lo )
+{
+    CSA_BS_WORD (*A)[4] = s->A, (*B)[4] = s->B;
+    CSA_BS_WORD s1[2], s2[2], s3[2], s4[2], s5[2], s6[2], s7[2];
+
+    CSA_BS(sbox1)( A[4][0], A[1][2], A[6][1], A[7][3], A[9][0], &s1[0], &s1[1] );
+    CSA_BS(sbox2)( A[2][1], A[3][2], A[6][3], A[7][0], A[9][1], &s2[0], &s2[1] );
+    CSA_BS(sbox3)( A[1][3], A[2][0], A[5][1], A[5][3], A[6][2], &s3[0], &s3[1] );
+    CSA_BS(sbox4)( A[3][3], A[1][1], A[2][3], A[4][2], A[8][0], &s4[0], &s4[1] );
+    CSA_BS(sbox5)( A[5][2], A[4][3], A[6][0], A[8][1], A[9][2], &s5[0], &s5[1] );
+    CSA_BS(sbox6)( A[3][1], A[4][1], A[5][0], A[7][2], A[9][3], &s6[0], &s6[1] );
+    CSA_BS(sbox7)( A[2][2], A[3][0], A[7][1], A[8][2], A[8][3], &s7[0], &s7[1] );
+
+    /* 4x4 xor for T3 */
+    const CSA_BS_WORD extra_B[4] = {
+        B[9][2] ^ B[6][3] ^ B[3][1] ^ B[8][0],
+        B[5][3] ^ B[8][2] ^ B[4][0] ^ B[5][1],
+        B[6][0] ^ B[8][1] ^ B[3][3] ^ B[4][2],
+        B[3][0] ^ B[6][1] ^ B[7][2] ^ B[9][3],
+    };
+
+    CSA_BS_WORD next_A1[4], next_B1[4], carry = s->r;
+    for( unsigned k = 0; k < 4; k++ )
+    {
+        /* T1 and T2 */
+        next_A1[k] = A[10][k] ^ s->X[k];
+        next_B1[k] = B[7][k] ^ B[10][k] ^ s->Y[k];
+        if( in_a != NULL )
+        {
+            next_A1[k] ^= s->D[k] ^ in_a[k];
+            next_B1[k] ^= in_b[k];
+        }
+
+        /* T3 */
+        s->D[k] = s->E[k] ^ s->Z[k] ^ extra_B[k];
+
+        /* T4: F = q ? Z + E + r : E, E = F */
+        const CSA_BS_WORD zxe = s->Z[k] ^ s->E[k];
+        const CSA_BS_WORD sum = zxe ^ carry;
+        const CSA_BS_WORD next_E = s->F[k];
+
+        carry = (s->Z[k] & s->E[k]) | (carry & zxe);
+        s->F[k] = s->E[k] ^ (s->q & (s->E[k] ^ sum));
+        s->E[k] = next_E;
+    }
+    s->r ^= s->q & (s->r ^ carry);
+
+    /* if p, rotate B1 left */
+    const CSA_BS_WORD b3 = next_B1[3];
+    for( unsigned k = 3; k > 0; k-- )
+        next_B1[k] ^= s->p & (next_B1[k] ^ next_B1[k - 1]);
+    next_B1[0] ^= s->p & (next_B1[0] ^ b3);
+
+    memmove( A[2], A[1], 9 * sizeof( A[1] ) );
+    memmove( B[2], B[1], 9 * sizeof( B[1] ) );
+    memcpy( A[1], next_A1, sizeof( next_A1 ) );
+    memcpy( B[1], next_B1, sizeof( next_B1 ) );
+
+    s->X[3] = s4[0]; s->X[2] = s3[0]; s->X[1] = s2[1]; s->X[0] = s1[1];
+    s->Y[3] = s6[0]; s->Y[2] = s5[0]; s->Y[1] = s4[1]; s->Y[0] = s3[1];
+    s->Z[3] = s2[0]; s->Z[2] = s1[0]; s->Z[1] = s6[1]; s->Z[0] = s5[1];
+    s->p = s7[1];
+    s->q = s7[0];
+
+    *hi = s->D[3] ^ s->D[2];
+    *lo = s->D[1] ^ s->D[0];
+}
+
+/* Initialises the cypher of each lane with its key and first block */
+CSA_BS_TARGET
+static void CSA_BS(Init)( CSA_BS(stream_t) *s, const CSA_BS_WORD ck[64],
+                          const CSA_BS_WORD sb[64] )
+{
+    memset( s, 0, sizeof( *s ) );
+
+    for( unsigned i = 0; i < 4; i++ )
+        for( unsigned k = 0; k < 4; k++ )
+        {
+            s->A[1 + 2 * i][k] = ck[8 * i + 4 + k];
+            s->A[2 + 2 * i][k] = ck[8 * i + k];
+            s->B[1 + 2 * i][k] = ck[8 * (4 + i) + 4 + k];
+            s->B[2 + 2 * i][k] = ck[8 * (4 + i) + k];
+        }
+
+    for( unsigned i = 0; i < 8; i++ )
+    {
+        const CSA_BS_WORD *in1 = &sb[8 * i + 4], *in2 = &sb[8 * i];
+        CSA_BS_WORD hi, lo;
+
+        for( unsigned j = 0; j < 4; j++ )
+            if( j & 1 )
+                CSA_BS(Step)( s, in2, in1, &hi, &lo );
+            else
+                CSA_BS(Step)( s, in1, in2, &hi, &lo );
+    }
+}
+
+/* Generates the next 8 bytes of the stream of each lane */
+CSA_BS_TARGET
+static void CSA_BS(Generate)( CSA_BS(stream_t) *s, CSA_BS_WORD cb[64] )
+{
+    for( unsigned i = 0; i < 8; i++ )
+        for( unsigned j = 0; j < 4; j++ )
+            CSA_BS(Step)( s, NULL, NULL, &cb[8 * i + 7 - 2 * j],
+                          &cb[8 * i + 6 - 2 * j] );
+}
+
+/* Runs the stream cypher of up to CSA_BS_LANES packets, initialised with the
+ * key and first payload block of each lane, and applies it to the payloads */
+CSA_BS_TARGET
+static void CSA_BS(Stream)( const csa_lane_t *lanes, unsigned count )
+{
+    uint64_t buf[CSA_BS_LANES];
+    CSA_BS_WORD ck[64], sb[64];
+    CSA_BS(stream_t) s;
+    int i_blocks = 0;
+
+    for( unsigned i = 0; i < count; i++ )
+    {
+        buf[i] = GetQWLE( lanes[i].ck );
+        if( lanes[i].i_blocks > i_blocks )
+            i_blocks = lanes[i].i_blocks;
+    }
+    memset( &buf[count], 0, (CSA_BS_LANES - count) * sizeof( *buf ) );
+    CSA_BS(Slice)( ck, buf );
+
+    for( unsigned i = 0; i < count; i++ )
+        buf[i] = GetQWLE( lanes[i].p_data );
+    CSA_BS(Slice)( sb, buf );
+
+    CSA_BS(Init)( &s, ck, sb );
+
+    for( int g = 1; g <= i_blocks; g++ )
+    {
+        CSA_BS(Generate)( &s, sb );
+        CSA_BS(Unslice)( buf, sb );
+        for( unsigned i = 0; i < count; i++ )
+            csa_ApplyStream( &lanes[i], g, buf[i] );
+    }
+}
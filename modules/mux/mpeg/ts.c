@@ -40,6 +40,7 @@
 #include <vlc_block.h>
 #include <vlc_rand.h>
 #include <vlc_charset.h>
+#include <vlc_cpu.h>
 
 #include <vlc_iso_lang.h>
 
@@ -185,6 +186,11 @@ static const char *const ts_standards_list_text[] =
     "The encryption routines subtract the TS-header from the value before " \
     "encrypting." )
 
+#define THREADS_TEXT N_("Threads")
+#define THREADS_LONGTEXT N_("Number of threads used to packetize the " \
+  "elementary streams and to encrypt the TS packets. The output is the " \
+  "same as with a single thread. 0 means one thread per CPU core.")
+
 #define SOUT_CFG_PREFIX "sout-ts-"
 #define MAX_PMT 64       /* Maximum number of programs. FIXME: I just chose an arbitrary number. Where is the maximum in the spec? */
 #define MAX_PMT_PID 64       /* Maximum pids in each pmt.  FIXME: I just chose an arbitrary number. Where is the maximum in the spec? */
@@ -233,6 +239,9 @@ vlc_module_begin ()
     add_string( SOUT_CFG_PREFIX "csa-use", "1",  CU_TEXT,   CU_LONGTEXT,   true)
     add_integer(SOUT_CFG_PREFIX "csa-pkt", 188,  CPKT_TEXT, CPKT_LONGTEXT, true)
 
+    add_integer(SOUT_CFG_PREFIX "threads", 1, THREADS_TEXT, THREADS_LONGTEXT, true)
+        change_integer_range( 0, 32 )
+
     set_callbacks( Open, Close )
 vlc_module_end ()
 
@@ -245,7 +254,7 @@ static const char *const ppsz_sout_options[] = {
     "netid", "sdtdesc",
     "es-id-pid", "shaping", "pcr", "bmin", "bmax", "use-key-frames",
     "dts-delay", "csa-ck", "csa2-ck", "csa-use", "csa-pkt", "crypt-audio", "crypt-video",
-    "muxpmt", "program-pmt", "alignment",
+    "muxpmt", "program-pmt", "alignment", "threads",
     NULL
 };
 
@@ -329,13 +338,29 @@ typedef struct
 
 } pes_state_t;
 
+typedef struct
+{
+    sout_buffer_chain_t chain_ts; /* TS packets built ahead by a worker */
+    mtime_t             *pi_dts;  /* PES DTS before each of those packets */
+    size_t              i_dts_max;
+    size_t              i_dts_pos;
+} ts_ahead_t;
+
 typedef struct
 {
     ts_stream_t  ts;
     pes_stream_t pes;
     pes_state_t  state;
+    ts_ahead_t   ahead;
 } sout_input_sys_t;
 
+typedef struct
+{
+    sout_mux_t   *p_mux;
+    vlc_thread_t thread;
+    unsigned     i_index;
+} ts_worker_t;
+
 struct sout_mux_sys_t
 {
     sout_input_t    *p_pcr_input;
@@ -381,6 +406,27 @@ struct sout_mux_sys_t
     int             i_csa_pkt_size;
     bool            b_crypt_audio;
     bool            b_crypt_video;
+
+    /* worker pool (see WorkersDispatch), worker 0 is the muxer thread */
+    unsigned        i_threads;
+    ts_worker_t     *p_workers;
+    vlc_mutex_t     workers_lock;
+    vlc_cond_t      workers_wait;
+    vlc_cond_t      workers_done;
+    void            (*pf_job)( sout_mux_t *, unsigned i_job, unsigned i_worker );
+    unsigned        i_jobs;
+    unsigned        i_jobs_next;
+    unsigned        i_jobs_done;
+    bool            b_workers_exit;
+
+    sout_input_sys_t **pp_ahead;    /* streams to packetize ahead */
+    int             i_ahead_max;
+    mtime_t         i_ahead_dts;    /* packetize up to that PES DTS */
+
+    uint8_t         **pp_scrambled; /* TS packets to encrypt */
+    unsigned        i_scrambled_max;
+    unsigned        i_scrambled;
+    csa_t           **pp_csa;       /* cypher state of each worker */
 };
 
 
@@ -531,6 +577,157 @@ static csa_t *csaSetup( vlc_object_t *p_this )
     return csa;
 }
 
+/*****************************************************************************
+ * Worker pool: runs the jobs of a round on all workers, then returns
+ *****************************************************************************/
+static void WorkersRun( sout_mux_sys_t *p_sys, sout_mux_t *p_mux,
+                        unsigned i_worker )
+{
+    /* workers_lock is held */
+    while( p_sys->i_jobs_next < p_sys->i_jobs )
+    {
+        unsigned i_job = p_sys->i_jobs_next++;
+
+        vlc_mutex_unlock( &p_sys->workers_lock );
+        p_sys->pf_job( p_mux, i_job, i_worker );
+        vlc_mutex_lock( &p_sys->workers_lock );
+
+        if( ++p_sys->i_jobs_done == p_sys->i_jobs )
+            vlc_cond_signal( &p_sys->workers_done );
+    }
+}
+
+static void *WorkerThread( void *data )
+{
+    ts_worker_t *p_worker = data;
+    sout_mux_t *p_mux = p_worker->p_mux;
+    sout_mux_sys_t *p_sys = p_mux->p_sys;
+
+    vlc_mutex_lock( &p_sys->workers_lock );
+    for( ;; )
+    {
+        while( !p_sys->b_workers_exit &&
+               p_sys->i_jobs_next >= p_sys->i_jobs )
+            vlc_cond_wait( &p_sys->workers_wait, &p_sys->workers_lock );
+        if( p_sys->b_workers_exit )
+            break;
+
+        WorkersRun( p_sys, p_mux, p_worker->i_index );
+    }
+    vlc_mutex_unlock( &p_sys->workers_lock );
+    return NULL;
+}
+
+static void WorkersDispatch( sout_mux_t *p_mux, unsigned i_jobs,
+                             void (*pf_job)( sout_mux_t *, unsigned, unsigned ) )
+{
+    sout_mux_sys_t *p_sys = p_mux->p_sys;
+
+    vlc_mutex_lock( &p_sys->workers_lock );
+    p_sys->pf_job = pf_job;
+    p_sys->i_jobs = i_jobs;
+    p_sys->i_jobs_next = 0;
+    p_sys->i_jobs_done = 0;
+    if( i_jobs > 1 )
+        vlc_cond_broadcast( &p_sys->workers_wait );
+
+    WorkersRun( p_sys, p_mux, 0 );
+    while( p_sys->i_jobs_done < i_jobs )
+        vlc_cond_wait( &p_sys->workers_done, &p_sys->workers_lock );
+    p_sys->i_jobs = 0;
+    p_sys->i_jobs_next = 0;
+    vlc_mutex_unlock( &p_sys->workers_lock );
+}
+
+static void WorkersStart( sout_mux_t *p_mux )
+{
+    sout_mux_sys_t *p_sys = p_mux->p_sys;
+    int i_threads = var_GetInteger( p_mux, SOUT_CFG_PREFIX "threads" );
+
+    if( i_threads <= 0 )
+        i_threads = vlc_GetCPUCount();
+    p_sys->i_threads = 1;
+    if( i_threads <= 1 )
+        return;
+
+    p_sys->p_workers = calloc( i_threads, sizeof( *p_sys->p_workers ) );
+    p_sys->pp_csa = calloc( i_threads, sizeof( *p_sys->pp_csa ) );
+    if( unlikely(p_sys->p_workers == NULL || p_sys->pp_csa == NULL) )
+    {
+        free( p_sys->p_workers );
+        free( p_sys->pp_csa );
+        p_sys->p_workers = NULL;
+        p_sys->pp_csa = NULL;
+        return;
+    }
+
+    vlc_mutex_init( &p_sys->workers_lock );
+    vlc_cond_init( &p_sys->workers_wait );
+    vlc_cond_init( &p_sys->workers_done );
+
+    for( int i = 1; i < i_threads; i++ )
+    {
+        ts_worker_t *p_worker = &p_sys->p_workers[i];
+
+        p_worker->p_mux = p_mux;
+        p_worker->i_index = i;
+        if( vlc_clone( &p_worker->thread, WorkerThread, p_worker,
+                       VLC_THREAD_PRIORITY_OUTPUT ) )
+            break;
+        p_sys->i_threads++;
+    }
+
+    if( p_sys->csa != NULL )
+        for( unsigned i = 0; i < p_sys->i_threads; i++ )
+        {
+            p_sys->pp_csa[i] = csa_New();
+            if( unlikely(p_sys->pp_csa[i] == NULL) )
+            {   /* encrypt on the muxer thread only */
+                for( unsigned j = 0; j < i; j++ )
+                    csa_Delete( p_sys->pp_csa[j] );
+                free( p_sys->pp_csa );
+                p_sys->pp_csa = NULL;
+                break;
+            }
+        }
+    else
+    {
+        free( p_sys->pp_csa );
+        p_sys->pp_csa = NULL;
+    }
+
+    msg_Dbg( p_mux, "using %u threads", p_sys->i_threads );
+}
+
+static void WorkersStop( sout_mux_t *p_mux )
+{
+    sout_mux_sys_t *p_sys = p_mux->p_sys;
+
+    if( p_sys->p_workers == NULL )
+        return;
+
+    vlc_mutex_lock( &p_sys->workers_lock );
+    p_sys->b_workers_exit = true;
+    vlc_cond_broadcast( &p_sys->workers_wait );
+    vlc_mutex_unlock( &p_sys->workers_lock );
+
+    for( unsigned i = 1; i < p_sys->i_threads; i++ )
+        vlc_join( p_sys->p_workers[i].thread, NULL );
+
+    vlc_cond_destroy( &p_sys->workers_done );
+    vlc_cond_destroy( &p_sys->workers_wait );
+    vlc_mutex_destroy( &p_sys->workers_lock );
+    free( p_sys->p_workers );
+
+    if( p_sys->pp_csa != NULL )
+    {
+        for( unsigned i = 0; i < p_sys->i_threads; i++ )
+            csa_Delete( p_sys->pp_csa[i] );
+        free( p_sys->pp_csa );
+    }
+    free( p_sys->pp_ahead );
+}
+
 /*****************************************************************************
  * Open:
  *****************************************************************************/
@@ -735,6 +932,8 @@ static int Open( vlc_object_t *p_this )
 
     p_sys->csa = csaSetup(p_this);
 
+    WorkersStart( p_mux );
+
     p_mux->pf_control   = Control;
     p_mux->pf_addstream = AddStream;
     p_mux->pf_delstream = DelStream;
@@ -751,6 +950,8 @@ static void Close( vlc_object_t * p_this )
     sout_mux_t          *p_mux = (sout_mux_t*)p_this;
     sout_mux_sys_t      *p_sys = p_mux->p_sys;
 
+    WorkersStop( p_mux );
+
     if( p_sys->p_dvbpsi )
         dvbpsi_delete( p_sys->p_dvbpsi );
 
@@ -762,6 +963,7 @@ static void Close( vlc_object_t * p_this )
         csa_Delete( p_sys->csa );
         vlc_mutex_destroy( &p_sys->csa_lock );
     }
+    free( p_sys->pp_scrambled );
 
     for (int i = 0; i < MAX_SDT_DESC; i++ )
     {
@@ -1035,6 +1237,7 @@ static int AddStream( sout_mux_t *p_mux, sout_input_t *p_input )
 
     /* Init pes chain */
     BufferChainInit( &p_stream->state.chain_pes );
+    BufferChainInit( &p_stream->ahead.chain_ts );
 
     /* We only change PMT version (PAT isn't changed) */
     p_sys->i_pmt_version_number = ( p_sys->i_pmt_version_number + 1 )%32;
@@ -1072,6 +1275,8 @@ static void DelStream( sout_mux_t *p_mux, sout_input_t *p_input )
 
     /* Empty all data in chain_pes */
     BufferChainClean( &p_stream->state.chain_pes );
+    BufferChainClean( &p_stream->ahead.chain_ts );
+    free( p_stream->ahead.pi_dts );
 
     free(p_stream->pes.lang);
     free( p_stream->pes.p_extra );
@@ -1178,6 +1383,77 @@ static void SetBlockDuration( sout_input_t *p_input, block_t *p_data )
     }
 }
 
+/* Packetizes a stream up to the muxing bound, on a worker.
+ * The TS packets of a stream never carrying the PCR only depend on the
+ * stream state, so they can be built ahead of the muxing loop. */
+static void AheadJob( sout_mux_t *p_mux, unsigned i_job, unsigned i_worker )
+{
+    sout_mux_sys_t *p_sys = p_mux->p_sys;
+    sout_input_sys_t *p_stream = p_sys->pp_ahead[i_job];
+    ts_ahead_t *p_ahead = &p_stream->ahead;
+    VLC_UNUSED(i_worker);
+
+    p_ahead->i_dts_pos = 0;
+    for( size_t i = 0; p_stream->state.i_pes_dts != 0 &&
+                       p_stream->state.i_pes_dts <= p_sys->i_ahead_dts; i++ )
+    {
+        if( i >= p_ahead->i_dts_max )
+        {
+            size_t i_max = p_ahead->i_dts_max ? 2 * p_ahead->i_dts_max : 64;
+            mtime_t *pi_dts = realloc( p_ahead->pi_dts,
+                                       i_max * sizeof( *pi_dts ) );
+            if( unlikely(pi_dts == NULL) )
+                break; /* the muxing loop will packetize the rest */
+            p_ahead->pi_dts = pi_dts;
+            p_ahead->i_dts_max = i_max;
+        }
+
+        p_ahead->pi_dts[i] = p_stream->state.i_pes_dts;
+        BufferChainAppend( &p_ahead->chain_ts,
+                           TSNew( p_mux, p_stream, false ) );
+    }
+}
+
+static void PacketizeAhead( sout_mux_t *p_mux, sout_input_sys_t *p_pcr_stream,
+                            mtime_t i_max_dts )
+{
+    sout_mux_sys_t *p_sys = p_mux->p_sys;
+    unsigned i_jobs = 0;
+
+    if( p_sys->i_ahead_max < p_mux->i_nb_inputs )
+    {
+        sout_input_sys_t **pp_ahead = realloc( p_sys->pp_ahead,
+                        p_mux->i_nb_inputs * sizeof( *pp_ahead ) );
+        if( unlikely(pp_ahead == NULL) )
+            return;
+        p_sys->pp_ahead = pp_ahead;
+        p_sys->i_ahead_max = p_mux->i_nb_inputs;
+    }
+
+    for( int i = 0; i < p_mux->i_nb_inputs; i++ )
+    {
+        sout_input_sys_t *p_stream = (sout_input_sys_t*)p_mux->pp_inputs[i]->p_sys;
+
+        if( p_stream != p_pcr_stream && p_stream->state.i_pes_dts != 0 &&
+            p_stream->state.i_pes_dts <= i_max_dts )
+            p_sys->pp_ahead[i_jobs++] = p_stream;
+    }
+
+    if( i_jobs > 0 )
+    {
+        p_sys->i_ahead_dts = i_max_dts;
+        WorkersDispatch( p_mux, i_jobs, AheadJob );
+    }
+}
+
+/* Returns the PES DTS of the next TS packet of a stream */
+static mtime_t NextDTS( const sout_input_sys_t *p_stream )
+{
+    if( p_stream->ahead.chain_ts.i_depth > 0 )
+        return p_stream->ahead.pi_dts[p_stream->ahead.i_dts_pos];
+    return p_stream->state.i_pes_dts;
+}
+
 /* returns true if needs more data */
 static bool MuxStreams(sout_mux_t *p_mux )
 {
@@ -1446,6 +1722,8 @@ static bool MuxStreams(sout_mux_t *p_mux )
     /* msg_Dbg( p_mux, "estimated pck=%d", i_packet_count ); */
 
     const mtime_t i_pcr_dts = p_pcr_stream->state.i_pes_dts;
+    if( p_sys->i_threads > 1 )
+        PacketizeAhead( p_mux, p_pcr_stream, i_pcr_dts + i_pcr_length );
     for (;;)
     {
         int          i_stream = -1;
@@ -1456,16 +1734,17 @@ static bool MuxStreams(sout_mux_t *p_mux )
         for (int i = 0; i < p_mux->i_nb_inputs; i++ )
         {
             p_stream = (sout_input_sys_t*)p_mux->pp_inputs[i]->p_sys;
+            mtime_t i_next_dts = NextDTS( p_stream );
 
-            if( p_stream->state.i_pes_dts == 0 )
+            if( i_next_dts == 0 )
             {
                 continue;
             }
 
-            if( i_stream == -1 || p_stream->state.i_pes_dts < i_dts )
+            if( i_stream == -1 || i_next_dts < i_dts )
             {
                 i_stream = i;
-                i_dts = p_stream->state.i_pes_dts;
+                i_dts = i_next_dts;
             }
         }
         if( i_stream == -1 || i_dts > i_pcr_dts + i_pcr_length )
@@ -1487,7 +1766,14 @@ static bool MuxStreams(sout_mux_t *p_mux )
         }
 
         /* Build the TS packet */
-        block_t *p_ts = TSNew( p_mux, p_stream, b_pcr );
+        block_t *p_ts;
+        if( p_stream->ahead.chain_ts.i_depth > 0 )
+        {
+            p_ts = BufferChainGet( &p_stream->ahead.chain_ts );
+            p_stream->ahead.i_dts_pos++;
+        }
+        else
+            p_ts = TSNew( p_mux, p_stream, b_pcr );
         if( p_sys->csa != NULL &&
              (p_input->p_fmt->i_cat != AUDIO_ES || p_sys->b_crypt_audio) &&
              (p_input->p_fmt->i_cat != VIDEO_ES || p_sys->b_crypt_video) )
@@ -1709,11 +1995,65 @@ static void TSSchedule( sout_mux_t *p_mux, sout_buffer_chain_t *p_chain_ts,
         TSDate( p_mux, &new_chain, i_pcr_length, i_pcr_dts );
 }
 
+#define CSA_JOB_PACKETS 256
+
+static void EncryptJob( sout_mux_t *p_mux, unsigned i_job, unsigned i_worker )
+{
+    sout_mux_sys_t *p_sys = p_mux->p_sys;
+    unsigned i_start = i_job * CSA_JOB_PACKETS;
+
+    csa_EncryptBatch( p_sys->pp_csa[i_worker], &p_sys->pp_scrambled[i_start],
+                      __MIN( p_sys->i_scrambled - i_start, CSA_JOB_PACKETS ),
+                      p_sys->i_csa_pkt_size );
+}
+
+/* Encrypts the TS packets of a chain at once, on the workers if any.
+ * The scrambling does not depend on the PCR value, so this can happen
+ * before TSSetPCR(). */
+static bool EncryptChain( sout_mux_t *p_mux, sout_buffer_chain_t *p_chain_ts )
+{
+    sout_mux_sys_t *p_sys = p_mux->p_sys;
+
+    if( p_sys->i_scrambled_max < (unsigned)p_chain_ts->i_depth )
+    {
+        uint8_t **pp_scrambled = realloc( p_sys->pp_scrambled,
+                        p_chain_ts->i_depth * sizeof( *pp_scrambled ) );
+        if( unlikely(pp_scrambled == NULL) )
+            return false;
+        p_sys->pp_scrambled = pp_scrambled;
+        p_sys->i_scrambled_max = p_chain_ts->i_depth;
+    }
+
+    p_sys->i_scrambled = 0;
+    for( block_t *p_ts = p_chain_ts->p_first; p_ts != NULL; p_ts = p_ts->p_next )
+        if( p_ts->i_flags & BLOCK_FLAG_SCRAMBLED )
+            p_sys->pp_scrambled[p_sys->i_scrambled++] = p_ts->p_buffer;
+
+    /* Keys are sampled once per chain rather than once per packet */
+    vlc_mutex_lock( &p_sys->csa_lock );
+    if( p_sys->pp_csa == NULL )
+    {
+        csa_EncryptBatch( p_sys->csa, p_sys->pp_scrambled, p_sys->i_scrambled,
+                          p_sys->i_csa_pkt_size );
+        vlc_mutex_unlock( &p_sys->csa_lock );
+        return true;
+    }
+    for( unsigned i = 0; i < p_sys->i_threads; i++ )
+        csa_Copy( p_sys->pp_csa[i], p_sys->csa );
+    vlc_mutex_unlock( &p_sys->csa_lock );
+
+    WorkersDispatch( p_mux, (p_sys->i_scrambled + CSA_JOB_PACKETS - 1)
+                            / CSA_JOB_PACKETS, EncryptJob );
+    return true;
+}
+
 static void TSDate( sout_mux_t *p_mux, sout_buffer_chain_t *p_chain_ts,
                     mtime_t i_pcr_length, mtime_t i_pcr_dts )
 {
     sout_mux_sys_t  *p_sys = p_mux->p_sys;
     int i_packet_count = p_chain_ts->i_depth;
+    bool b_encrypted = p_sys->csa != NULL &&
+                       EncryptChain( p_mux, p_chain_ts );
 
     if ( i_pcr_length / 1000 > 0 )
     {
@@ -1748,7 +2088,7 @@ static void TSDate( sout_mux_t *p_mux, sout_buffer_chain_t *p_chain_ts,
             /* msg_Dbg( p_mux, "pcr=%lld ms", p_ts->i_dts / 1000 ); */
             TSSetPCR( p_ts, p_ts->i_dts - p_sys->first_dts );
         }
-        if( p_ts->i_flags & BLOCK_FLAG_SCRAMBLED )
+        if( ( p_ts->i_flags & BLOCK_FLAG_SCRAMBLED ) && !b_encrypted )
         {
             vlc_mutex_lock( &p_sys->csa_lock );
             csa_Encrypt( p_sys->csa, p_ts->p_buffer, p_sys->i_csa_pkt_size );
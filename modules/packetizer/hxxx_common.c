@@ -25,6 +25,7 @@
 
 #include <vlc_block.h>
 #include <vlc_codec.h>
+#include <vlc_atomic.h>
 #include "../codec/cc.h"
 
 /****************************************************************************
@@ -103,6 +104,71 @@ block_t * cc_storage_get_current( cc_storage_t *p_ccs, bool pb_present[4] )
     return p_block;
 }
 
+/****************************************************************************
+ * NAL units sharing the buffer of their length-prefixed access unit
+ ****************************************************************************/
+/* NAL units smaller than this are copied, so that the parameter sets which
+ * the packetizers keep do not hold whole access units */
+#define HXXX_NAL_SHARE_MIN 1024
+
+typedef struct
+{
+    block_t *p_block;
+    atomic_uint i_refs;
+} hxxx_nal_owner_t;
+
+typedef struct
+{
+    block_t self;
+    hxxx_nal_owner_t *p_owner;
+} hxxx_nal_block_t;
+
+static hxxx_nal_owner_t *hxxx_nal_owner_New( block_t *p_block )
+{
+    hxxx_nal_owner_t *p_owner = malloc( sizeof(*p_owner) );
+    if( likely(p_owner) )
+    {
+        p_owner->p_block = p_block;
+        atomic_init( &p_owner->i_refs, 1 );
+    }
+    return p_owner;
+}
+
+static void hxxx_nal_owner_Release( hxxx_nal_owner_t *p_owner )
+{
+    if( atomic_fetch_sub( &p_owner->i_refs, 1 ) == 1 )
+    {
+        block_Release( p_owner->p_block );
+        free( p_owner );
+    }
+}
+
+static void hxxx_nal_block_Release( block_t *p_nal )
+{
+    hxxx_nal_block_t *p_sys = (hxxx_nal_block_t *) p_nal;
+
+    hxxx_nal_owner_Release( p_sys->p_owner );
+    free( p_sys );
+}
+
+/* Creates a block pointing to a part of the access unit buffer.
+ * The parsers may modify and release it like any other block. */
+static block_t *hxxx_nal_block_New( hxxx_nal_owner_t *p_owner,
+                                    uint8_t *p_buf, size_t i_buf )
+{
+    hxxx_nal_block_t *p_sys = malloc( sizeof(*p_sys) );
+    if( unlikely(!p_sys) )
+        return NULL;
+
+    block_Init( &p_sys->self, p_buf, i_buf );
+    p_sys->self.pf_release = hxxx_nal_block_Release;
+    p_sys->self.i_dts = p_owner->p_block->i_dts;
+    p_sys->self.i_pts = p_owner->p_block->i_pts;
+    p_sys->p_owner = p_owner;
+    atomic_fetch_add( &p_owner->i_refs, 1 );
+    return &p_sys->self;
+}
+
 /****************************************************************************
  * PacketizeXXC1: Takes VCL blocks of data and creates annexe B type NAL stream
  * Will always use 4 byte 0 0 0 1 startcodes
@@ -113,6 +179,7 @@ block_t *PacketizeXXC1( decoder_t *p_dec, uint8_t i_nal_length_size,
 {
     block_t       *p_block;
     block_t       *p_ret = NULL;
+    hxxx_nal_owner_t *p_owner = NULL;
     uint8_t       *p;
 
     if( !pp_block || !*pp_block )
@@ -150,7 +217,7 @@ block_t *PacketizeXXC1( decoder_t *p_dec, uint8_t i_nal_length_size,
         /* Convert AVC to AnnexB */
         block_t *p_nal;
         /* If data exactly match remaining bytes (1 NAL only or trailing one) */
-        if( i_size == p_block->p_buffer + p_block->i_buffer - p )
+        if( i_size == p_block->p_buffer + p_block->i_buffer - p && !p_owner )
         {
             p_block->i_buffer = i_size;
             p_block->p_buffer = p;
@@ -158,6 +225,13 @@ block_t *PacketizeXXC1( decoder_t *p_dec, uint8_t i_nal_length_size,
             if( p_nal )
                 p_block = NULL;
         }
+        /* 4 bytes length prefixes are replaced by startcodes in place */
+        else if( i_nal_length_size == 4 && i_size >= HXXX_NAL_SHARE_MIN &&
+                 ( p_owner || (p_owner = hxxx_nal_owner_New( p_block )) ) )
+        {
+            p_nal = hxxx_nal_block_New( p_owner, p - 4, 4 + i_size );
+            p += i_size;
+        }
         else
         {
             p_nal = block_Alloc( 4 + i_size );
@@ -191,7 +265,9 @@ block_t *PacketizeXXC1( decoder_t *p_dec, uint8_t i_nal_length_size,
             break;
     }
 
-    if( p_block )
+    if( p_owner )
+        hxxx_nal_owner_Release( p_owner );
+    else if( p_block )
         block_Release( p_block );
 
     return p_ret;
@@ -52,7 +52,7 @@ static inline const uint8_t * startcode_FindAnnexB_SSE2( const uint8_t *p, const
     /* First align to 16 */
     /* Skipping this step and doing unaligned loads isn't faster */
     const uint8_t *alignedend = p + 16 - ((intptr_t)p & 15);
-    for (end -= 3; p < alignedend && p < end; p++) {
+    for (end -= 2; p < alignedend && p < end; p++) {
         if (p[0] == 0 && p[1] == 0 && p[2] == 1)
             return p;
     }
@@ -109,19 +109,98 @@ static inline const uint8_t * startcode_FindAnnexB_SSE2( const uint8_t *p, const
 
 #endif
 
+#if (defined (__i386__) || defined (__x86_64__)) && \
+    (VLC_GCC_VERSION(4, 9) || defined (__clang__))
+# define STARTCODE_AVX2 1
+# include <immintrin.h>
+
+/* Compares 32 positions at once against the three bytes of the startcode,
+ * using unaligned loads of the same data shifted by one and two bytes. */
+__attribute__ ((__target__ ("avx2")))
+static inline const uint8_t * startcode_FindAnnexB_AVX2( const uint8_t *p, const uint8_t *end )
+{
+    const __m256i zeros = _mm256_setzero_si256();
+    const __m256i ones = _mm256_set1_epi8( 0x01 );
+
+    for( ; end - p >= 64 + 2; p += 64 )
+    {
+        __m256i v0 = _mm256_loadu_si256( (const __m256i *)p );
+        __m256i v1 = _mm256_loadu_si256( (const __m256i *)(p + 32) );
+        __m256i z = _mm256_cmpeq_epi8( _mm256_min_epu8( v0, v1 ), zeros );
+
+        /* Fast path: no zero byte at all in the next 64 positions */
+        if( _mm256_testz_si256( z, z ) )
+            continue;
+
+        for( unsigned i = 0; i < 64; i += 32 )
+        {
+            __m256i a = _mm256_loadu_si256( (const __m256i *)(p + i) );
+            __m256i b = _mm256_loadu_si256( (const __m256i *)(p + i + 1) );
+            __m256i c = _mm256_loadu_si256( (const __m256i *)(p + i + 2) );
+            uint32_t match = _mm256_movemask_epi8(
+                _mm256_and_si256( _mm256_and_si256( _mm256_cmpeq_epi8( a, zeros ),
+                                                    _mm256_cmpeq_epi8( b, zeros ) ),
+                                  _mm256_cmpeq_epi8( c, ones ) ) );
+            if( match )
+                return p + i + ctz( match );
+        }
+    }
+
+    for( end -= 2; p < end; p++ )
+    {
+        if( p[0] == 0 && p[1] == 0 && p[2] == 1 )
+            return p;
+    }
+
+    return NULL;
+}
+
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+# define STARTCODE_NEON 1
+# include <arm_neon.h>
+
+static inline const uint8_t * startcode_FindAnnexB_NEON( const uint8_t *p, const uint8_t *end )
+{
+    const uint8x16_t zeros = vdupq_n_u8( 0x00 );
+    const uint8x16_t ones = vdupq_n_u8( 0x01 );
+
+    for( ; end - p >= 16 + 2; p += 16 )
+    {
+        uint8x16_t match = vandq_u8( vandq_u8( vceqq_u8( vld1q_u8( p ), zeros ),
+                                               vceqq_u8( vld1q_u8( p + 1 ), zeros ) ),
+                                     vceqq_u8( vld1q_u8( p + 2 ), ones ) );
+        uint64x2_t m = vreinterpretq_u64_u8( match );
+
+        if( vgetq_lane_u64( m, 0 ) | vgetq_lane_u64( m, 1 ) )
+        {
+            for( unsigned i = 0; i < 16; i++ )
+                if( p[i] == 0 && p[i+1] == 0 && p[i+2] == 1 )
+                    return p + i;
+        }
+    }
+
+    for( end -= 2; p < end; p++ )
+    {
+        if( p[0] == 0 && p[1] == 0 && p[2] == 1 )
+            return p;
+    }
+
+    return NULL;
+}
+
+#endif
+
 /* That code is adapted from libav's ff_avc_find_startcode_internal
  * and i believe the trick originated from
  * https://graphics.stanford.edu/~seander/bithacks.html#ZeroInWord
  */
-static inline const uint8_t * startcode_FindAnnexB( const uint8_t *p, const uint8_t *end )
+static inline const uint8_t * startcode_FindAnnexB_C( const uint8_t *p, const uint8_t *end )
 {
-#if defined(CAN_COMPILE_SSE2) || defined(HAVE_SSE2_INTRINSICS)
-    if (vlc_CPU_SSE2())
-        return startcode_FindAnnexB_SSE2(p, end);
-#endif
     const uint8_t *a = p + 4 - ((intptr_t)p & 3);
 
-    for (end -= 3; p < a && p < end; p++) {
+    for (end -= 2; p < a && p < end; p++) {
         if (p[0] == 0 && p[1] == 0 && p[2] == 1)
             return p;
     }
@@ -143,6 +222,24 @@ static inline const uint8_t * startcode_FindAnnexB( const uint8_t *p, const uint
     return NULL;
 }
 
+static inline const uint8_t * startcode_FindAnnexB( const uint8_t *p, const uint8_t *end )
+{
+#ifdef STARTCODE_AVX2
+    if (vlc_CPU_AVX2())
+        return startcode_FindAnnexB_AVX2(p, end);
+#endif
+#if defined(CAN_COMPILE_SSE2) || defined(HAVE_SSE2_INTRINSICS)
+    if (vlc_CPU_SSE2())
+        return startcode_FindAnnexB_SSE2(p, end);
+#endif
+#ifdef STARTCODE_NEON
+    /* Only built when the compiler targets NEON already */
+    return startcode_FindAnnexB_NEON(p, end);
+#else
+    return startcode_FindAnnexB_C(p, end);
+#endif
+}
+
 /* Special variation to return on prefix only and no data */
 static inline const uint8_t * startcode_FindAnyAnnexB( const uint8_t *p, const uint8_t *end )
 {
@@ -35,6 +35,7 @@
 #include <vlc_plugin.h>
 #include <vlc_vout_display.h>
 #include <vlc_picture_pool.h>
+#include <vlc_atomic.h>
 
 /*****************************************************************************
  * Module descriptor
@@ -82,12 +83,16 @@ vlc_module_end()
  * Local prototypes
  *****************************************************************************/
 struct picture_sys_t {
+    vout_display_sys_t *sys;
     void *id;
+    void *planes[PICTURE_PLANE_MAX];
 };
 
 /* NOTE: the callback prototypes must match those of LibVLC */
 struct vout_display_sys_t {
     picture_pool_t *pool;
+    bool direct; /* pictures are in the application buffers */
+    atomic_uint refs; /* display and direct pictures */
 
     void *opaque;
     void *pic_opaque;
@@ -95,6 +100,8 @@ struct vout_display_sys_t {
     void (*unlock)(void *sys, void *id, void *const *plane);
     void (*display)(void *sys, void *id);
     void (*cleanup)(void *sys);
+    void *(*get)(void *sys, void **plane);
+    void (*release)(void *sys, void *id);
 
     unsigned pitches[PICTURE_PLANE_MAX];
     unsigned lines[PICTURE_PLANE_MAX];
@@ -108,6 +115,25 @@ static void           Prepare(vout_display_t *, picture_t *, subpicture_t *);
 static void           Display(vout_display_t *, picture_t *, subpicture_t *);
 static int            Control(vout_display_t *, int, va_list);
 
+/**
+ * Checks that the application buffers can hold pictures of the format, so
+ * that the pictures can be decoded or converted into them directly.
+ */
+static bool CanRenderDirect(const video_format_t *fmt,
+                            const vout_display_sys_t *sys)
+{
+    picture_t pic;
+
+    if (picture_Setup(&pic, fmt))
+        return false;
+
+    for (int i = 0; i < pic.i_planes; i++)
+        if (sys->pitches[i] < (unsigned)pic.p[i].i_visible_pitch
+         || sys->lines[i] < (unsigned)pic.p[i].i_visible_lines)
+            return false;
+    return true;
+}
+
 /*****************************************************************************
  * Open: allocates video thread
  *****************************************************************************
@@ -133,7 +159,10 @@ static int Open(vlc_object_t *object)
     sys->display = var_InheritAddress(vd, "vmem-display");
     sys->cleanup = var_InheritAddress(vd, "vmem-cleanup");
     sys->opaque = var_InheritAddress(vd, "vmem-data");
+    sys->get = var_InheritAddress(vd, "vmem-get");
+    sys->release = var_InheritAddress(vd, "vmem-release");
     sys->pool = NULL;
+    atomic_init(&sys->refs, 1);
 
     /* Define the video format */
     video_format_t fmt;
@@ -207,6 +236,10 @@ static int Open(vlc_object_t *object)
         break;
     }
 
+    sys->direct = sys->get != NULL && CanRenderDirect(&fmt, sys);
+    if (sys->get != NULL && !sys->direct)
+        msg_Warn(vd, "buffers too small for direct rendering, copying");
+
     /* */
     vout_display_info_t info = vd->info;
     info.has_hide_mouse = true;
@@ -227,16 +260,108 @@ static int Open(vlc_object_t *object)
     return VLC_SUCCESS;
 }
 
+/* Cleans up once the display and all the direct pictures are gone */
+static void Release(vout_display_sys_t *sys)
+{
+    if (atomic_fetch_sub(&sys->refs, 1) != 1)
+        return;
+
+    if (sys->cleanup)
+        sys->cleanup(sys->opaque);
+    free(sys);
+}
+
 static void Close(vlc_object_t *object)
 {
     vout_display_t *vd = (vout_display_t *)object;
     vout_display_sys_t *sys = vd->sys;
 
-    if (sys->cleanup)
-        sys->cleanup(sys->opaque);
     if (sys->pool)
         picture_pool_Release(sys->pool);
-    free(sys);
+    Release(sys);
+}
+
+static int LockDirect(picture_t *pic)
+{
+    picture_sys_t *picsys = pic->p_sys;
+    vout_display_sys_t *sys = picsys->sys;
+
+    memset(picsys->planes, 0, sizeof (picsys->planes));
+    picsys->id = sys->get(sys->opaque, picsys->planes);
+    if (picsys->planes[0] == NULL)
+        return VLC_EGENERIC; /* no buffer available */
+
+    for (int i = 0; i < pic->i_planes; i++)
+        pic->p[i].p_pixels = picsys->planes[i];
+    return VLC_SUCCESS;
+}
+
+static void UnlockDirect(picture_t *pic)
+{
+    picture_sys_t *picsys = pic->p_sys;
+    vout_display_sys_t *sys = picsys->sys;
+
+    if (sys->release != NULL)
+        sys->release(sys->opaque, picsys->id);
+}
+
+static void DestroyDirect(picture_t *pic)
+{
+    picture_sys_t *picsys = pic->p_sys;
+
+    Release(picsys->sys);
+    free(picsys);
+    free(pic);
+}
+
+/**
+ * Creates a pool of pictures without pixels of their own: the application
+ * provides the buffers whenever a picture is taken from the pool, and gets
+ * them back when the picture is no longer referenced.
+ */
+static picture_pool_t *PoolNewDirect(vout_display_t *vd, unsigned count)
+{
+    vout_display_sys_t *sys = vd->sys;
+    picture_t *pictures[count ? count : 1];
+    unsigned i;
+
+    for (i = 0; i < count; i++) {
+        picture_sys_t *picsys = malloc(sizeof (*picsys));
+        if (unlikely(picsys == NULL))
+            goto error;
+        picsys->sys = sys;
+
+        picture_resource_t rsc = {
+            .p_sys = picsys,
+            .pf_destroy = DestroyDirect,
+        };
+        for (unsigned j = 0; j < PICTURE_PLANE_MAX; j++) {
+            rsc.p[j].i_lines = sys->lines[j];
+            rsc.p[j].i_pitch = sys->pitches[j];
+        }
+
+        pictures[i] = picture_NewFromResource(&vd->fmt, &rsc);
+        if (unlikely(pictures[i] == NULL)) {
+            free(picsys);
+            goto error;
+        }
+        atomic_fetch_add(&sys->refs, 1);
+    }
+
+    picture_pool_configuration_t cfg = {
+        .picture_count = count,
+        .picture = pictures,
+        .lock = LockDirect,
+        .unlock = UnlockDirect,
+    };
+    picture_pool_t *pool = picture_pool_NewExtended(&cfg);
+    if (pool != NULL)
+        return pool;
+
+error:
+    while (i > 0)
+        picture_Release(pictures[--i]);
+    return NULL;
 }
 
 static picture_pool_t *Pool(vout_display_t *vd, unsigned count)
@@ -244,7 +369,8 @@ static picture_pool_t *Pool(vout_display_t *vd, unsigned count)
     vout_display_sys_t *sys = vd->sys;
 
     if (sys->pool == NULL)
-        sys->pool = picture_pool_NewFromFormat(&vd->fmt, count);
+        sys->pool = sys->direct ? PoolNewDirect(vd, count)
+                                : picture_pool_NewFromFormat(&vd->fmt, count);
     return sys->pool;
 }
 
@@ -254,6 +380,15 @@ static void Prepare(vout_display_t *vd, picture_t *pic, subpicture_t *subpic)
     picture_resource_t rsc = { .p_sys = NULL };
     void *planes[PICTURE_PLANE_MAX];
 
+    if (sys->direct && pic->p_sys != NULL) {
+        /* Already in the application buffer */
+        sys->pic_opaque = pic->p_sys->id;
+        if (sys->unlock != NULL)
+            sys->unlock(sys->opaque, sys->pic_opaque, pic->p_sys->planes);
+        (void) subpic;
+        return;
+    }
+
     sys->pic_opaque = sys->lock(sys->opaque, planes);
 
     for (unsigned i = 0; i < PICTURE_PLANE_MAX; i++) {
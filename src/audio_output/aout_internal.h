@@ -29,6 +29,9 @@
 /* Max input rate factor (1/4 -> 4) */
 # define AOUT_MAX_INPUT_RATE (4)
 
+/* Max decoded buffers queued for the filters thread */
+# define AOUT_PIPE_SIZE (8)
+
 enum {
     AOUT_RESAMPLING_NONE=0,
     AOUT_RESAMPLING_UP,
@@ -80,6 +83,29 @@ typedef struct
 
     aout_request_vout_t request_vout;
 
+    /* Filters thread (if enabled): single producer single consumer ring of
+     * decoded buffers. A NULL buffer is a barrier. */
+    struct
+    {
+        vlc_thread_t thread;
+        vlc_sem_t ready; /**< posted for each queued buffer */
+        vlc_sem_t room; /**< posted for each free slot */
+        vlc_sem_t barrier; /**< posted when the thread reaches a barrier */
+        struct
+        {
+            block_t *block;
+            int rate;
+            mtime_t date; /**< queuing time */
+        } queue[AOUT_PIPE_SIZE];
+        unsigned read; /**< next slot to read (filters thread only) */
+        unsigned write; /**< next slot to write (decoder thread only) */
+        atomic_bool discard; /**< drop buffers until the next barrier */
+        atomic_llong latency; /**< average queuing to output delay */
+        bool discontinuity; /**< a buffer was dropped before queuing */
+        bool exit;
+        bool active;
+    } pipe;
+
     atomic_uint buffers_lost;
     atomic_uint buffers_played;
     atomic_uchar restart;
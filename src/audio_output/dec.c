@@ -37,6 +37,8 @@
 #include "aout_internal.h"
 #include "libvlc.h"
 
+static void *aout_DecThread (void *);
+
 /**
  * Creates an audio output
  */
@@ -109,9 +111,115 @@ error:
 
     atomic_init (&owner->buffers_lost, 0);
     atomic_init (&owner->buffers_played, 0);
+
+    owner->pipe.active = false;
+    atomic_init (&owner->pipe.latency, 0);
+    if (var_InheritBool (p_aout, "audio-filter-thread"))
+    {
+        vlc_sem_init (&owner->pipe.ready, 0);
+        vlc_sem_init (&owner->pipe.room, AOUT_PIPE_SIZE);
+        vlc_sem_init (&owner->pipe.barrier, 0);
+        owner->pipe.read = owner->pipe.write = 0;
+        atomic_init (&owner->pipe.discard, false);
+        owner->pipe.discontinuity = false;
+        owner->pipe.exit = false;
+
+        if (vlc_clone (&owner->pipe.thread, aout_DecThread, p_aout,
+                       VLC_THREAD_PRIORITY_AUDIO) == 0)
+        {
+            msg_Dbg (p_aout, "filtering audio on a separate thread");
+            owner->pipe.active = true;
+        }
+        else
+        {
+            msg_Warn (p_aout, "cannot start audio filters thread");
+            vlc_sem_destroy (&owner->pipe.barrier);
+            vlc_sem_destroy (&owner->pipe.room);
+            vlc_sem_destroy (&owner->pipe.ready);
+        }
+    }
     return 0;
 }
 
+/*
+ * Filters thread
+ */
+
+static void aout_DecProcess (audio_output_t *, block_t *, int input_rate);
+
+/**
+ * Queues a decoded buffer for the filters thread, waiting for a free slot
+ * if needed. A NULL buffer is a barrier.
+ */
+static void aout_DecQueue (audio_output_t *aout, block_t *block,
+                           int input_rate)
+{
+    aout_owner_t *owner = aout_owner (aout);
+    unsigned slot = owner->pipe.write++ % AOUT_PIPE_SIZE;
+
+    vlc_sem_wait (&owner->pipe.room);
+    owner->pipe.queue[slot].block = block;
+    owner->pipe.queue[slot].rate = input_rate;
+    owner->pipe.queue[slot].date = mdate ();
+    vlc_sem_post (&owner->pipe.ready);
+}
+
+/**
+ * Waits until the filters thread has processed (or discarded) all the
+ * buffers queued so far.
+ */
+static void aout_DecBarrier (audio_output_t *aout)
+{
+    aout_owner_t *owner = aout_owner (aout);
+
+    aout_DecQueue (aout, NULL, 0);
+    vlc_sem_wait (&owner->pipe.barrier);
+}
+
+static void *aout_DecThread (void *data)
+{
+    audio_output_t *aout = data;
+    aout_owner_t *owner = aout_owner (aout);
+
+    for (;;)
+    {
+        vlc_sem_wait (&owner->pipe.ready);
+
+        unsigned slot = owner->pipe.read++ % AOUT_PIPE_SIZE;
+        block_t *block = owner->pipe.queue[slot].block;
+        int input_rate = owner->pipe.queue[slot].rate;
+        mtime_t date = owner->pipe.queue[slot].date;
+
+        vlc_sem_post (&owner->pipe.room);
+
+        if (block == NULL)
+        {
+            bool exit = owner->pipe.exit;
+
+            vlc_sem_post (&owner->pipe.barrier);
+            if (exit)
+                break;
+            continue;
+        }
+
+        if (atomic_load (&owner->pipe.discard))
+        {
+            block_Release (block);
+            continue;
+        }
+
+        aout_OutputLock (aout);
+        aout_DecProcess (aout, block, input_rate);
+        aout_OutputUnlock (aout);
+
+        /* Report the delay to the decoder thread (moving average) */
+        mtime_t latency = atomic_load (&owner->pipe.latency);
+        atomic_store (&owner->pipe.latency,
+                      latency + (mdate () - date - latency) / 8);
+    }
+    return NULL;
+}
+
 /**
  * Stops all plugins involved in the audio output.
  */
@@ -119,6 +227,18 @@ void aout_DecDelete (audio_output_t *aout)
 {
     aout_owner_t *owner = aout_owner (aout);
 
+    if (owner->pipe.active)
+    {
+        owner->pipe.exit = true;
+        atomic_store (&owner->pipe.discard, true);
+        aout_DecBarrier (aout);
+        vlc_join (owner->pipe.thread, NULL);
+        vlc_sem_destroy (&owner->pipe.barrier);
+        vlc_sem_destroy (&owner->pipe.room);
+        vlc_sem_destroy (&owner->pipe.ready);
+        owner->pipe.active = false;
+    }
+
     aout_OutputLock (aout);
     if (owner->mixer_format.i_format)
     {
@@ -338,6 +458,44 @@ static void aout_DecSynchronize (audio_output_t *aout, mtime_t dec_pts,
     }
 }
 
+/**
+ * Filters, amplifies and plays a decoded buffer.
+ * \note The output lock must be held.
+ */
+static void aout_DecProcess (audio_output_t *aout, block_t *block,
+                             int input_rate)
+{
+    aout_owner_t *owner = aout_owner (aout);
+
+    if (unlikely(owner->mixer_format.i_format == 0))
+    {   /* The output failed to restart after the buffer was queued */
+        owner->sync.discontinuity = true;
+        block_Release (block);
+        goto lost;
+    }
+    if (block->i_flags & BLOCK_FLAG_DISCONTINUITY)
+        owner->sync.discontinuity = true;
+
+    block = aout_FiltersPlay (owner->filters, block, input_rate);
+    if (block == NULL)
+        goto lost;
+
+    /* Software volume */
+    aout_volume_Amplify (owner->volume, block);
+
+    /* Drift correction */
+    aout_DecSynchronize (aout, block->i_pts, input_rate);
+
+    /* Output */
+    owner->sync.end = block->i_pts + block->i_length + 1;
+    owner->sync.discontinuity = false;
+    aout_OutputPlay (aout, block);
+    atomic_fetch_add(&owner->buffers_played, 1);
+    return;
+lost:
+    atomic_fetch_add(&owner->buffers_lost, 1);
+}
+
 /*****************************************************************************
  * aout_DecPlay : filter & mix the decoded buffer
  *****************************************************************************/
@@ -357,7 +515,9 @@ int aout_DecPlay (audio_output_t *aout, block_t *block, int input_rate)
     if (unlikely(ret == AOUT_DEC_FAILED))
         goto drop; /* Pipeline is unrecoverably broken :-( */
 
-    const mtime_t now = mdate (), advance = block->i_pts - now;
+    /* Account for the buffers queued before this one, if any */
+    const mtime_t now = mdate () + atomic_load (&owner->pipe.latency);
+    const mtime_t advance = block->i_pts - now;
     if (advance < -AOUT_MAX_PTS_DELAY)
     {   /* Late buffer can be caused by bugs in the decoder, by scheduling
          * latency spikes (excessive load, SIGSTOP, etc.) or if buffering is
@@ -371,31 +531,30 @@ int aout_DecPlay (audio_output_t *aout, block_t *block, int input_rate)
         msg_Err (aout, "buffer too early (%"PRId64" us): dropped", advance);
         goto drop;
     }
-    if (block->i_flags & BLOCK_FLAG_DISCONTINUITY)
-        owner->sync.discontinuity = true;
 
-    block = aout_FiltersPlay (owner->filters, block, input_rate);
-    if (block == NULL)
-        goto lost;
-
-    /* Software volume */
-    aout_volume_Amplify (owner->volume, block);
-
-    /* Drift correction */
-    aout_DecSynchronize (aout, block->i_pts, input_rate);
+    if (owner->pipe.active)
+    {   /* Filter and play on the filters thread, without the output lock so
+         * that the thread can make room in the queue. */
+        aout_OutputUnlock (aout);
+        if (owner->pipe.discontinuity)
+        {
+            block->i_flags |= BLOCK_FLAG_DISCONTINUITY;
+            owner->pipe.discontinuity = false;
+        }
+        aout_DecQueue (aout, block, input_rate);
+        return ret;
+    }
 
-    /* Output */
-    owner->sync.end = block->i_pts + block->i_length + 1;
-    owner->sync.discontinuity = false;
-    aout_OutputPlay (aout, block);
-    atomic_fetch_add(&owner->buffers_played, 1);
+    aout_DecProcess (aout, block, input_rate);
 out:
     aout_OutputUnlock (aout);
     return ret;
 drop:
-    owner->sync.discontinuity = true;
+    if (owner->pipe.active)
+        owner->pipe.discontinuity = true;
+    else
+        owner->sync.discontinuity = true;
     block_Release (block);
-lost:
     atomic_fetch_add(&owner->buffers_lost, 1);
     goto out;
 }
@@ -413,6 +572,11 @@ void aout_DecChangePause (audio_output_t *aout, bool paused, mtime_t date)
 {
     aout_owner_t *owner = aout_owner (aout);
 
+    if (paused && owner->pipe.active)
+        /* Hand the queued buffers to the output before it is paused, lest
+         * they get synchronized against a paused clock */
+        aout_DecBarrier (aout);
+
     aout_OutputLock (aout);
     if (owner->sync.end != VLC_TS_INVALID)
     {
@@ -430,6 +594,13 @@ void aout_DecFlush (audio_output_t *aout, bool wait)
 {
     aout_owner_t *owner = aout_owner (aout);
 
+    if (owner->pipe.active)
+    {   /* Play or discard the queued buffers first */
+        atomic_store (&owner->pipe.discard, !wait);
+        aout_DecBarrier (aout);
+        atomic_store (&owner->pipe.discard, false);
+    }
+
     aout_OutputLock (aout);
     owner->sync.end = VLC_TS_INVALID;
     if (owner->mixer_format.i_format)
@@ -64,19 +64,21 @@ int config_LoadCmdLine( vlc_object_t *p_this, int i_argc,
 #define b_ignore_errors (pindex == NULL)
 
     /* Short options */
-    const module_config_t *pp_shortopts[256];
+    const struct config_entry *pp_shortopts[256];
     char *psz_shortopts;
 
     /*
      * Generate the longopts and shortopts structures used by getopt_long
      */
+    size_t count;
+    const struct config_entry *entries = config_GetEntries( &count );
 
     i_opts = 0;
-    for (const vlc_plugin_t *p = vlc_plugins; p != NULL; p = p->next)
+    for( size_t i = 0; i < count; i++ )
         /* count the number of exported configuration options (to allocate
          * longopts). We also need to allocate space for two options when
          * dealing with boolean to allow for --foo and --no-foo */
-        i_opts += p->conf.count + 2 * p->conf.booleans;
+        i_opts += (CONFIG_CLASS(entries[i].type) == CONFIG_ITEM_BOOL) ? 3 : 1;
 
     p_longopts = malloc( sizeof(*p_longopts) * (i_opts + 1) );
     if( p_longopts == NULL )
@@ -111,64 +113,56 @@ int config_LoadCmdLine( vlc_object_t *p_this, int i_argc,
         pp_shortopts[i_index] = NULL;
     }
 
-    /* Fill the p_longopts and psz_shortopts structures */
+    /* Fill the p_longopts and psz_shortopts structures, from the index so
+     * that the configuration items need not be loaded */
     i_index = 0;
-    for (const vlc_plugin_t *p = vlc_plugins; p != NULL; p = p->next)
+    for( size_t i = 0; i < count; i++ )
     {
-        for (const module_config_t *p_item = p->conf.items,
-                                   *p_end = p_item + p->conf.size;
-             p_item < p_end;
-             p_item++)
-        {
-            /* Ignore hints */
-            if( !CONFIG_ITEM(p_item->i_type) )
-                continue;
+        const struct config_entry *p_item = entries + i;
 
-            /* Add item to long options */
-            p_longopts[i_index].name = strdup( p_item->psz_name );
-            if( p_longopts[i_index].name == NULL ) continue;
-            p_longopts[i_index].flag = &flag;
-            p_longopts[i_index].val = 0;
-
-            if( CONFIG_CLASS(p_item->i_type) != CONFIG_ITEM_BOOL )
-                p_longopts[i_index].has_arg = true;
-            else
-            /* Booleans also need --no-foo and --nofoo options */
-            {
-                char *psz_name;
+        /* Add item to long options */
+        p_longopts[i_index].name = p_item->name;
+        p_longopts[i_index].flag = &flag;
+        p_longopts[i_index].val = 0;
 
-                p_longopts[i_index].has_arg = false;
-                i_index++;
+        if( CONFIG_CLASS(p_item->type) != CONFIG_ITEM_BOOL )
+            p_longopts[i_index].has_arg = true;
+        else
+        /* Booleans also need --no-foo and --nofoo options */
+        {
+            char *psz_name;
 
-                if( asprintf( &psz_name, "no%s", p_item->psz_name ) == -1 )
-                    continue;
-                p_longopts[i_index].name = psz_name;
-                p_longopts[i_index].has_arg = false;
-                p_longopts[i_index].flag = &flag;
-                p_longopts[i_index].val = 1;
-                i_index++;
+            p_longopts[i_index].has_arg = false;
+            i_index++;
 
-                if( asprintf( &psz_name, "no-%s", p_item->psz_name ) == -1 )
-                    continue;
-                p_longopts[i_index].name = psz_name;
-                p_longopts[i_index].has_arg = false;
-                p_longopts[i_index].flag = &flag;
-                p_longopts[i_index].val = 1;
-            }
+            if( asprintf( &psz_name, "no%s", p_item->name ) == -1 )
+                continue;
+            p_longopts[i_index].name = psz_name;
+            p_longopts[i_index].has_arg = false;
+            p_longopts[i_index].flag = &flag;
+            p_longopts[i_index].val = 1;
             i_index++;
 
-            /* If item also has a short option, add it */
-            if( p_item->i_short )
+            if( asprintf( &psz_name, "no-%s", p_item->name ) == -1 )
+                continue;
+            p_longopts[i_index].name = psz_name;
+            p_longopts[i_index].has_arg = false;
+            p_longopts[i_index].flag = &flag;
+            p_longopts[i_index].val = 1;
+        }
+        i_index++;
+
+        /* If item also has a short option, add it */
+        if( p_item->shortcut )
+        {
+            pp_shortopts[(int)p_item->shortcut] = p_item;
+            psz_shortopts[i_shortopts] = p_item->shortcut;
+            i_shortopts++;
+            if( p_item->type != CONFIG_ITEM_BOOL
+             && p_item->shortcut != 'v' )
             {
-                pp_shortopts[(int)p_item->i_short] = p_item;
-                psz_shortopts[i_shortopts] = p_item->i_short;
+                psz_shortopts[i_shortopts] = ':';
                 i_shortopts++;
-                if( p_item->i_type != CONFIG_ITEM_BOOL
-                 && p_item->i_short != 'v' )
-                {
-                    psz_shortopts[i_shortopts] = ':';
-                    i_shortopts++;
-                }
             }
         }
     }
@@ -243,8 +237,8 @@ int config_LoadCmdLine( vlc_object_t *p_this, int i_argc,
         /* A short option has been recognized */
         if( pp_shortopts[i_cmd] != NULL )
         {
-            const char *name = pp_shortopts[i_cmd]->psz_name;
-            switch( CONFIG_CLASS(pp_shortopts[i_cmd]->i_type) )
+            const char *name = pp_shortopts[i_cmd]->name;
+            switch( CONFIG_CLASS(pp_shortopts[i_cmd]->type) )
             {
                 case CONFIG_ITEM_STRING:
                     var_Create( p_this, name, VLC_VAR_STRING );
@@ -295,8 +289,10 @@ int config_LoadCmdLine( vlc_object_t *p_this, int i_argc,
         *pindex = state.ind;
 out:
     /* Free allocated resources */
+    /* Only the --nofoo and --no-foo names were allocated */
     for( i_index = 0; p_longopts[i_index].name; i_index++ )
-        free( (char *)p_longopts[i_index].name );
+        if( p_longopts[i_index].val )
+            free( (char *)p_longopts[i_index].name );
     free( p_longopts );
     free( psz_shortopts );
     free( argv_copy );
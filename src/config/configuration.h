@@ -41,6 +41,18 @@ bool config_PrintHelp (vlc_object_t *);
 int config_SortConfig (void);
 void config_UnsortConfig (void);
 
+/** Configuration items index entry */
+struct config_entry
+{
+    const char *name; /**< Option name */
+    struct vlc_plugin_t *plugin; /**< Plug-in owning the item */
+    uint16_t index; /**< Index of the item within the plug-in */
+    uint8_t type; /**< Item type */
+    char shortcut; /**< Short option name (or 0) */
+};
+
+const struct config_entry *config_GetEntries (size_t *);
+
 #define CONFIG_CLASS(x) ((x) & ~0x1F)
 
 #define IsConfigStringType(type) \
@@ -500,26 +500,29 @@ ssize_t config_GetPszChoices (vlc_object_t *obj, const char *name,
 
 static int confcmp (const void *a, const void *b)
 {
-    const module_config_t *const *ca = a, *const *cb = b;
+    const struct config_entry *ca = a, *cb = b;
 
-    return strcmp ((*ca)->psz_name, (*cb)->psz_name);
+    return strcmp (ca->name, cb->name);
 }
 
 static int confnamecmp (const void *key, const void *elem)
 {
-    const module_config_t *const *conf = elem;
+    const struct config_entry *conf = elem;
 
-    return strcmp (key, (*conf)->psz_name);
+    return strcmp (key, conf->name);
 }
 
 static struct
 {
-    module_config_t **list;
+    struct config_entry *list;
     size_t count;
 } config = { NULL, 0 };
 
 /**
  * Index the configuration items by name for faster lookups.
+ *
+ * The items of plug-ins from the plugins cache are indexed without loading
+ * them, so that they are only loaded if they are actually looked up.
  */
 int config_SortConfig (void)
 {
@@ -527,24 +530,44 @@ int config_SortConfig (void)
     size_t nconf = 0;
 
     for (p = vlc_plugins; p != NULL; p = p->next)
-         nconf += p->conf.size;
+         nconf += p->conf.count;
 
-    module_config_t **clist = malloc (sizeof (*clist) * nconf);
+    struct config_entry *clist = malloc (sizeof (*clist) * nconf);
     if (unlikely(clist == NULL))
         return VLC_ENOMEM;
 
     nconf = 0;
     for (p = vlc_plugins; p != NULL; p = p->next)
     {
-        module_config_t *item, *end;
-
-        for (item = p->conf.items, end = item + p->conf.size;
-             item < end;
-             item++)
+#ifdef HAVE_DYNAMIC_PLUGINS
+        if (!atomic_load_explicit (&p->conf.loaded, memory_order_acquire))
+        {
+            for (size_t i = 0; i < p->conf.count; i++)
+            {
+                const struct vlc_cache_option *opt = p->conf.options + i;
+
+                clist[nconf].name = (const char *)p->conf.data + opt->name;
+                clist[nconf].plugin = p;
+                clist[nconf].index = opt->index;
+                clist[nconf].type = opt->type;
+                clist[nconf].shortcut = opt->shortcut;
+                nconf++;
+            }
+            continue;
+        }
+#endif
+        for (size_t i = 0; i < p->conf.size; i++)
         {
+            const module_config_t *item = p->conf.items + i;
+
             if (!CONFIG_ITEM(item->i_type))
                 continue; /* ignore hints */
-            clist[nconf++] = item;
+            clist[nconf].name = item->psz_name;
+            clist[nconf].plugin = p;
+            clist[nconf].index = i;
+            clist[nconf].type = item->i_type;
+            clist[nconf].shortcut = item->i_short;
+            nconf++;
         }
     }
 
@@ -557,7 +580,7 @@ int config_SortConfig (void)
 
 void config_UnsortConfig (void)
 {
-    module_config_t **clist;
+    struct config_entry *clist;
 
     clist = config.list;
     config.list = NULL;
@@ -578,9 +601,23 @@ module_config_t *config_FindConfig (vlc_object_t *p_this, const char *name)
     if (unlikely(name == NULL))
         return NULL;
 
-    module_config_t *const *p;
+    const struct config_entry *p;
     p = bsearch (name, config.list, config.count, sizeof (*p), confnamecmp);
-    return p ? *p : NULL;
+    if (p == NULL)
+        return NULL;
+
+    module_config_t *items = vlc_plugin_get_config (p->plugin);
+    return (items != NULL) ? items + p->index : NULL;
+}
+
+/**
+ * Gets the index of all configuration items, sorted by name.
+ * \param count number of entries [OUT]
+ */
+const struct config_entry *config_GetEntries (size_t *count)
+{
+    *count = config.count;
+    return config.list;
 }
 
 /**
@@ -616,9 +653,11 @@ void config_ResetAll( vlc_object_t *p_this )
     vlc_rwlock_wrlock (&config_lock);
     for (vlc_plugin_t *p = vlc_plugins; p != NULL; p = p->next)
     {
-        for (size_t i = 0; i < p->conf.size; i++ )
+        module_config_t *items = vlc_plugin_get_config (p);
+
+        for (size_t i = 0; items != NULL && i < p->conf.size; i++ )
         {
-            module_config_t *p_config = p->conf.items + i;
+            module_config_t *p_config = items + i;
 
             if (IsConfigIntegerType (p_config->i_type))
                 p_config->value.i = p_config->orig.i;
@@ -429,13 +429,17 @@ int config_SaveConfigFile (vlc_object_t *p_this)
         if (p->conf.count == 0)
             continue;
 
+        module_config_t *items = vlc_plugin_get_config (p);
+        if (items == NULL)
+            continue;
+
         fprintf( file, "[%s]", module_get_object (p_parser) );
         if( p_parser->psz_longname )
             fprintf( file, " # %s\n\n", p_parser->psz_longname );
         else
             fprintf( file, "\n\n" );
 
-        for (p_item = p->conf.items, p_end = p_item + p->conf.size;
+        for (p_item = items, p_end = p_item + p->conf.size;
              p_item < p_end;
              p_item++)
         {
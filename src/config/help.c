@@ -537,11 +537,12 @@ static bool module_match(const module_t *m, const char *pattern, bool strict)
     return false;
 }
 
-static bool plugin_show(const vlc_plugin_t *plugin, bool advanced)
+static bool plugin_show(const module_config_t *items, size_t size,
+                        bool advanced)
 {
-    for (size_t i = 0; i < plugin->conf.size; i++)
+    for (size_t i = 0; i < size; i++)
     {
-        const module_config_t *item = plugin->conf.items + i;
+        const module_config_t *item = items + i;
 
         if (!CONFIG_ITEM(item->i_type))
             continue;
@@ -577,7 +578,7 @@ static void Usage (vlc_object_t *p_this, char const *psz_search)
     const bool advanced = var_InheritBool(p_this, "advanced");
 
     /* Enumerate the config for each module */
-    for (const vlc_plugin_t *p = vlc_plugins; p != NULL; p = p->next)
+    for (vlc_plugin_t *p = vlc_plugins; p != NULL; p = p->next)
     {
         const module_t *m = p->module;
         const module_config_t *section = NULL;
@@ -587,9 +588,13 @@ static void Usage (vlc_object_t *p_this, char const *psz_search)
             continue; /* Ignore modules without config options */
         if (!module_match(m, psz_search, strict))
             continue;
+
+        const module_config_t *items = vlc_plugin_get_config(p);
+        if (items == NULL)
+            continue;
         found = true;
 
-        if (!plugin_show(p, advanced))
+        if (!plugin_show(items, p->conf.size, advanced))
         {   /* Ignore plugins with only advanced config options if requested */
             i_only_advanced++;
             continue;
@@ -605,7 +610,7 @@ static void Usage (vlc_object_t *p_this, char const *psz_search)
         /* Print module options */
         for (size_t j = 0; j < p->conf.size; j++)
         {
-            const module_config_t *item = p->conf.items + j;
+            const module_config_t *item = items + j;
 
             if (item->b_removed)
                 continue; /* Skip removed options */
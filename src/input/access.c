@@ -208,6 +208,12 @@ static block_t *AStreamReadBlock(stream_t *s, bool *restrict eof)
                      block->i_buffer, &total);
         stats_Update(input_priv(input)->counters.p_input_bitrate, total, NULL);
         stats_Update(input_priv(input)->counters.p_read_packets, 1, NULL);
+        /* Data lost by the access itself (e.g. datagrams dropped by the
+         * kernel or truncated), as it happens */
+        if (block->i_flags & BLOCK_FLAG_CORRUPTED)
+            stats_Update(input_priv(input)->counters.p_demux_corrupted, 1, NULL);
+        if (block->i_flags & BLOCK_FLAG_DISCONTINUITY)
+            stats_Update(input_priv(input)->counters.p_demux_discontinuity, 1, NULL);
         vlc_mutex_unlock(&input_priv(input)->counters.counters_lock);
     }
 
@@ -0,0 +1,633 @@
+/*****************************************************************************
+ * seekindex.c: persistent seek index cache
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include <vlc_common.h>
+#include <vlc_block.h>
+#include <vlc_configuration.h>
+#include <vlc_fs.h>
+#include <vlc_md5.h>
+#include <vlc_memstream.h>
+#include <vlc_stream.h>
+#include <vlc_seekindex.h>
+
+/* The file starts with the magic and format version, followed by the demuxer
+ * name and version, and the stream key. Entries are sorted and stored as
+ * variable length deltas from the previous one of the same track. */
+#define SEEKINDEX_MAGIC   "VLCSEEKI"
+#define SEEKINDEX_FORMAT  1
+#define SEEKINDEX_DIR     "seekindex"
+#define SEEKINDEX_HEAD    65536 /* bytes hashed to identify a stream */
+/* The least recently saved indexes are removed beyond those limits */
+#define SEEKINDEX_MAX_FILES 1000
+#define SEEKINDEX_MAX_SIZE  (16 << 20)
+
+struct vlc_seekindex_t
+{
+    vlc_object_t *obj;
+    char         *path;
+    char         *name;
+    uint32_t      version;
+    uint8_t       key[16];
+    bool          readonly;
+
+    vlc_seekindex_entry_t *entries;
+    size_t        count;
+    size_t        max;
+    size_t        saved; /* entries already in the stored index */
+    bool          sorted;
+};
+
+static int EntryCmp(const void *a, const void *b)
+{
+    const vlc_seekindex_entry_t *ea = a, *eb = b;
+
+    if (ea->i_track != eb->i_track)
+        return (ea->i_track < eb->i_track) ? -1 : 1;
+    if (ea->i_time != eb->i_time)
+        return (ea->i_time < eb->i_time) ? -1 : 1;
+    if (ea->i_pos != eb->i_pos)
+        return (ea->i_pos < eb->i_pos) ? -1 : 1;
+    return 0;
+}
+
+static void Sort(vlc_seekindex_t *idx)
+{
+    if (idx->sorted)
+        return;
+
+    qsort(idx->entries, idx->count, sizeof (*idx->entries), EntryCmp);
+
+    /* Drop duplicates (seek points found again) */
+    size_t n = 0;
+    for (size_t i = 0; i < idx->count; i++)
+        if (n == 0 || EntryCmp(&idx->entries[n - 1], &idx->entries[i]))
+            idx->entries[n++] = idx->entries[i];
+    idx->count = n;
+    idx->sorted = true;
+}
+
+/*** Serialization ***/
+
+static void PutVarint(struct vlc_memstream *ms, uint64_t v)
+{
+    while (v >= 0x80)
+    {
+        vlc_memstream_putc(ms, 0x80 | (v & 0x7F));
+        v >>= 7;
+    }
+    vlc_memstream_putc(ms, v);
+}
+
+static void PutSigned(struct vlc_memstream *ms, int64_t v)
+{
+    PutVarint(ms, ((uint64_t)v << 1) ^ (uint64_t)(v >> 63));
+}
+
+static int GetVarint(const uint8_t **pp, const uint8_t *end, uint64_t *pv)
+{
+    uint64_t v = 0;
+
+    for (unsigned shift = 0; shift < 64; shift += 7)
+    {
+        if (*pp >= end)
+            return -1;
+
+        uint8_t c = *((*pp)++);
+        v |= (uint64_t)(c & 0x7F) << shift;
+        if (!(c & 0x80))
+        {
+            *pv = v;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static int GetSigned(const uint8_t **pp, const uint8_t *end, int64_t *pv)
+{
+    uint64_t v;
+
+    if (GetVarint(pp, end, &v))
+        return -1;
+    *pv = (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+    return 0;
+}
+
+static int GetU32(const uint8_t **pp, const uint8_t *end, uint32_t *pv)
+{
+    uint64_t v;
+
+    if (GetVarint(pp, end, &v) || v > UINT32_MAX)
+        return -1;
+    *pv = v;
+    return 0;
+}
+
+static int Load(vlc_seekindex_t *idx)
+{
+    block_t *file = block_FilePath(idx->path, false);
+    if (file == NULL)
+        return VLC_EGENERIC;
+
+    const uint8_t *p = file->p_buffer;
+    const uint8_t *end = p + file->i_buffer;
+    size_t namelen = strlen(idx->name);
+    uint64_t count, v;
+    uint32_t u;
+
+    if (file->i_buffer < strlen(SEEKINDEX_MAGIC)
+     || memcmp(p, SEEKINDEX_MAGIC, strlen(SEEKINDEX_MAGIC)))
+        goto error;
+    p += strlen(SEEKINDEX_MAGIC);
+
+    if (GetU32(&p, end, &u) || u != SEEKINDEX_FORMAT
+     || GetU32(&p, end, &u) || u != idx->version
+     || GetVarint(&p, end, &v) || v != namelen
+     || (size_t)(end - p) < namelen + sizeof (idx->key)
+     || memcmp(p, idx->name, namelen)
+     || memcmp(p + namelen, idx->key, sizeof (idx->key)))
+        goto error;
+    p += namelen + sizeof (idx->key);
+
+    /* Each entry takes at least 5 bytes */
+    if (GetVarint(&p, end, &count) || count > (uint64_t)(end - p) / 5)
+        goto error;
+
+    idx->entries = malloc(count * sizeof (*idx->entries));
+    if (unlikely(idx->entries == NULL && count > 0))
+        goto error;
+    idx->max = count;
+
+    vlc_seekindex_entry_t prev = { 0, 0, 0, 0, 0 };
+    for (size_t i = 0; i < count; i++)
+    {
+        vlc_seekindex_entry_t *e = &idx->entries[i];
+        int64_t dtime, dpos;
+
+        if (GetU32(&p, end, &u))
+            goto error;
+        if (u > 0)
+        {   /* next track */
+            prev.i_track += u;
+            prev.i_time = 0;
+            prev.i_pos = 0;
+        }
+        if (GetSigned(&p, end, &dtime) || GetSigned(&p, end, &dpos)
+         || GetU32(&p, end, &e->i_flags) || GetU32(&p, end, &e->i_size))
+            goto error;
+
+        e->i_track = prev.i_track;
+        e->i_time = prev.i_time + dtime;
+        e->i_pos = prev.i_pos + dpos;
+        prev = *e;
+    }
+
+    idx->count = idx->saved = count;
+    idx->sorted = true;
+    block_Release(file);
+    msg_Dbg(idx->obj, "loaded %zu seek index entries from %s", idx->count,
+            idx->path);
+    return VLC_SUCCESS;
+
+error:
+    msg_Warn(idx->obj, "invalid seek index %s", idx->path);
+    free(idx->entries);
+    idx->entries = NULL;
+    idx->max = 0;
+    block_Release(file);
+    return VLC_EGENERIC;
+}
+
+/* Creates the parent directories of the index file */
+static void CreateDirs(const char *path)
+{
+    char dir[strlen(path) + 1];
+    strcpy(dir, path);
+
+    for (char *p = dir + 1; (p = strchr(p, DIR_SEP_CHAR)) != NULL; p++)
+    {
+        *p = '\0';
+        vlc_mkdir(dir, 0700);
+        *p = DIR_SEP_CHAR;
+    }
+}
+
+struct index_file
+{
+    char   *path;
+    time_t  mtime;
+    off_t   size;
+};
+
+static int IndexFileCmp(const void *a, const void *b)
+{
+    const struct index_file *fa = a, *fb = b;
+
+    if (fa->mtime != fb->mtime)
+        return (fa->mtime < fb->mtime) ? -1 : 1;
+    return strcmp(fa->path, fb->path);
+}
+
+/* Removes the oldest indexes while there are too many of them, so that the
+ * indexes of deleted or modified files do not pile up */
+static void Prune(vlc_seekindex_t *idx)
+{
+    const char *sep = strrchr(idx->path, DIR_SEP_CHAR);
+    assert(sep != NULL);
+
+    char dirpath[sep - idx->path + 1];
+    memcpy(dirpath, idx->path, sep - idx->path);
+    dirpath[sep - idx->path] = '\0';
+
+    DIR *dir = vlc_opendir(dirpath);
+    if (dir == NULL)
+        return;
+
+    struct index_file *files = NULL;
+    size_t count = 0, max = 0;
+    uint64_t total = 0;
+    const char *name;
+
+    while ((name = vlc_readdir(dir)) != NULL)
+    {
+        struct stat st;
+        char *path;
+
+        if (name[0] == '.')
+            continue;
+        if (asprintf(&path, "%s"DIR_SEP"%s", dirpath, name) == -1)
+            break;
+        if (vlc_stat(path, &st) || !S_ISREG(st.st_mode))
+        {
+            free(path);
+            continue;
+        }
+
+        if (count >= max)
+        {
+            struct index_file *tab = realloc(files, (max + 64)
+                                                    * sizeof (*files));
+            if (unlikely(tab == NULL))
+            {
+                free(path);
+                break;
+            }
+            files = tab;
+            max += 64;
+        }
+        files[count].path = path;
+        files[count].mtime = st.st_mtime;
+        files[count].size = st.st_size;
+        total += st.st_size;
+        count++;
+    }
+    closedir(dir);
+
+    if (count > 0)
+        qsort(files, count, sizeof (*files), IndexFileCmp);
+
+    size_t left = count;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (left > SEEKINDEX_MAX_FILES || total > SEEKINDEX_MAX_SIZE)
+        {
+            if (strcmp(files[i].path, idx->path)
+             && vlc_unlink(files[i].path) == 0)
+            {
+                msg_Dbg(idx->obj, "removed old seek index %s", files[i].path);
+                left--;
+                total -= files[i].size;
+            }
+        }
+        free(files[i].path);
+    }
+    free(files);
+}
+
+int vlc_seekindex_Save(vlc_seekindex_t *idx)
+{
+    if (idx->readonly)
+        return VLC_SUCCESS;
+
+    Sort(idx);
+    if (idx->count <= idx->saved)
+        return VLC_SUCCESS; /* nothing new */
+
+    struct vlc_memstream ms;
+    if (vlc_memstream_open(&ms))
+        return VLC_ENOMEM;
+
+    vlc_memstream_write(&ms, SEEKINDEX_MAGIC, strlen(SEEKINDEX_MAGIC));
+    PutVarint(&ms, SEEKINDEX_FORMAT);
+    PutVarint(&ms, idx->version);
+    PutVarint(&ms, strlen(idx->name));
+    vlc_memstream_puts(&ms, idx->name);
+    vlc_memstream_write(&ms, idx->key, sizeof (idx->key));
+    PutVarint(&ms, idx->count);
+
+    vlc_seekindex_entry_t prev = { 0, 0, 0, 0, 0 };
+    for (size_t i = 0; i < idx->count; i++)
+    {
+        const vlc_seekindex_entry_t *e = &idx->entries[i];
+
+        PutVarint(&ms, e->i_track - prev.i_track);
+        if (e->i_track != prev.i_track)
+        {
+            prev.i_time = 0;
+            prev.i_pos = 0;
+        }
+        PutSigned(&ms, e->i_time - prev.i_time);
+        PutSigned(&ms, e->i_pos - prev.i_pos);
+        PutVarint(&ms, e->i_flags);
+        PutVarint(&ms, e->i_size);
+        prev = *e;
+    }
+
+    if (vlc_memstream_close(&ms))
+        return VLC_ENOMEM;
+
+    int ret = VLC_EGENERIC;
+    char *tmpname;
+    if (asprintf(&tmpname, "%s.XXXXXX", idx->path) == -1)
+    {
+        free(ms.ptr);
+        return VLC_ENOMEM;
+    }
+
+    CreateDirs(idx->path);
+
+    /* Unique temporary file, as the same index may be saved concurrently */
+    int fd = vlc_mkstemp(tmpname);
+    if (fd == -1)
+    {
+        msg_Warn(idx->obj, "cannot create %s: %s", tmpname,
+                 vlc_strerror_c(errno));
+        goto out;
+    }
+
+    FILE *file = fdopen(fd, "wb");
+    if (file == NULL)
+    {
+        msg_Warn(idx->obj, "cannot create %s: %s", tmpname,
+                 vlc_strerror_c(errno));
+        vlc_close(fd);
+        vlc_unlink(tmpname);
+        goto out;
+    }
+
+    if (fwrite(ms.ptr, 1, ms.length, file) != ms.length || fflush(file))
+    {
+        msg_Warn(idx->obj, "cannot write %s: %s", tmpname,
+                 vlc_strerror_c(errno));
+        fclose(file);
+        vlc_unlink(tmpname);
+        goto out;
+    }
+
+#if !defined( _WIN32 ) && !defined( __OS2__ )
+    vlc_rename(tmpname, idx->path); /* atomically replace the old index */
+    fclose(file);
+#else
+    vlc_unlink(idx->path);
+    fclose(file);
+    vlc_rename(tmpname, idx->path);
+#endif
+    msg_Dbg(idx->obj, "saved %zu seek index entries (%zu bytes) to %s",
+            idx->count, ms.length, idx->path);
+    idx->saved = idx->count;
+    ret = VLC_SUCCESS;
+    Prune(idx);
+out:
+    free(tmpname);
+    free(ms.ptr);
+    return ret;
+}
+
+/*** Stream identity ***/
+
+static int ComputeKey(vlc_object_t *obj, stream_t *s, uint8_t *key)
+{
+    uint64_t size;
+    bool can_seek;
+
+    if (vlc_stream_GetSize(s, &size) || size == 0
+     || vlc_stream_Control(s, STREAM_CAN_SEEK, &can_seek) || !can_seek)
+        return VLC_EGENERIC;
+
+    /* The modification time is only known for local files */
+    int64_t mtime = 0;
+    for (const stream_t *src = s; src != NULL; src = src->p_source)
+        if (src->psz_filepath != NULL)
+        {
+            struct stat st;
+
+            if (vlc_stat(src->psz_filepath, &st) == 0)
+                mtime = st.st_mtime;
+            break;
+        }
+
+    uint64_t pos = vlc_stream_Tell(s);
+    const uint8_t *peek;
+    ssize_t len;
+
+    if (vlc_stream_Seek(s, 0))
+        return VLC_EGENERIC;
+    len = vlc_stream_Peek(s, &peek, SEEKINDEX_HEAD);
+
+    struct md5_s md5;
+    uint8_t buf[8];
+
+    InitMD5(&md5);
+    SetQWLE(buf, size);
+    AddMD5(&md5, buf, sizeof (buf));
+    SetQWLE(buf, mtime);
+    AddMD5(&md5, buf, sizeof (buf));
+    if (len > 0)
+        AddMD5(&md5, peek, len);
+    EndMD5(&md5);
+    memcpy(key, md5.buf, 16);
+
+    if (vlc_stream_Seek(s, pos))
+    {
+        msg_Err(obj, "cannot restore stream position");
+        return VLC_EGENERIC;
+    }
+    return (len > 0) ? VLC_SUCCESS : VLC_EGENERIC;
+}
+
+#undef vlc_seekindex_New
+vlc_seekindex_t *vlc_seekindex_New(vlc_object_t *obj, stream_t *s,
+                                   const char *name, uint32_t version)
+{
+    if (!var_InheritBool(obj, "seek-index"))
+        return NULL;
+
+    vlc_seekindex_t *idx = malloc(sizeof (*idx));
+    if (unlikely(idx == NULL))
+        return NULL;
+
+    idx->obj = obj;
+    idx->path = NULL;
+    idx->name = strdup(name);
+    idx->version = version;
+    idx->readonly = s->b_preparsing;
+    idx->entries = NULL;
+    idx->count = idx->max = idx->saved = 0;
+    idx->sorted = true;
+
+    if (unlikely(idx->name == NULL)
+     || ComputeKey(obj, s, idx->key) != VLC_SUCCESS)
+        goto error;
+
+    char *cachedir = config_GetUserDir(VLC_CACHE_DIR);
+    if (cachedir == NULL)
+        goto error;
+
+    char hex[33];
+    for (unsigned i = 0; i < 16; i++)
+        sprintf(&hex[2 * i], "%02"PRIx8, idx->key[i]);
+
+    if (asprintf(&idx->path, "%s"DIR_SEP SEEKINDEX_DIR DIR_SEP"%s.%s",
+                 cachedir, hex, name) == -1)
+        idx->path = NULL;
+    free(cachedir);
+    if (idx->path == NULL)
+        goto error;
+
+    Load(idx);
+    return idx;
+
+error:
+    free(idx->path);
+    free(idx->name);
+    free(idx);
+    return NULL;
+}
+
+void vlc_seekindex_Delete(vlc_seekindex_t *idx)
+{
+    vlc_seekindex_Save(idx);
+    free(idx->entries);
+    free(idx->path);
+    free(idx->name);
+    free(idx);
+}
+
+int vlc_seekindex_Add(vlc_seekindex_t *idx, const vlc_seekindex_entry_t *e)
+{
+    if (idx->count >= idx->max)
+    {
+        size_t max = idx->max ? 2 * idx->max : 64;
+        vlc_seekindex_entry_t *tab = NULL;
+
+        if (likely(max <= SIZE_MAX / sizeof (*tab)))
+            tab = realloc(idx->entries, max * sizeof (*tab));
+        if (unlikely(tab == NULL))
+            return VLC_ENOMEM;
+        idx->entries = tab;
+        idx->max = max;
+    }
+
+    if (idx->count > 0 && EntryCmp(&idx->entries[idx->count - 1], e) >= 0)
+        idx->sorted = false;
+    idx->entries[idx->count++] = *e;
+    return VLC_SUCCESS;
+}
+
+/* Returns the first entry of the track */
+static size_t FindTrack(const vlc_seekindex_t *idx, uint32_t track,
+                        size_t *restrict endp)
+{
+    size_t lo = 0, hi = idx->count;
+
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if (idx->entries[mid].i_track < track)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    size_t end = lo;
+    hi = idx->count;
+    while (end < hi)
+    {
+        size_t mid = end + (hi - end) / 2;
+
+        if (idx->entries[mid].i_track <= track)
+            end = mid + 1;
+        else
+            hi = mid;
+    }
+    *endp = end;
+    return lo;
+}
+
+size_t vlc_seekindex_Get(vlc_seekindex_t *idx, uint32_t track,
+                         const vlc_seekindex_entry_t **entries)
+{
+    size_t end;
+
+    Sort(idx);
+    size_t start = FindTrack(idx, track, &end);
+    *entries = idx->entries + start;
+    return end - start;
+}
+
+bool vlc_seekindex_Lookup(vlc_seekindex_t *idx, uint32_t track, int64_t time,
+                          const vlc_seekindex_entry_t **lower,
+                          const vlc_seekindex_entry_t **upper)
+{
+    size_t start, end;
+
+    Sort(idx);
+    start = FindTrack(idx, track, &end);
+
+    /* first entry after the time */
+    size_t lo = start, hi = end;
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if (idx->entries[mid].i_time <= time)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    *lower = (lo > start) ? &idx->entries[lo - 1] : NULL;
+    *upper = (lo < end) ? &idx->entries[lo] : NULL;
+    return *lower != NULL || *upper != NULL;
+}
@@ -228,6 +228,13 @@ static const char *const ppsz_stereo_mode_texts[] = { N_("Unset"),
     "This allows playing audio at lower or higher speed without " \
     "affecting the audio pitch" )
 
+#define AUDIO_FILTER_THREAD_TEXT N_( \
+    "Filter audio on a separate thread" )
+#define AUDIO_FILTER_THREAD_LONGTEXT N_( \
+    "This runs the audio filters, the resampler and the audio output " \
+    "in parallel with the audio decoder, so that heavy filters do not " \
+    "delay decoding." )
+
 
 static const char *const ppsz_replay_gain_mode[] = {
     "none", "track", "album" };
@@ -643,6 +650,11 @@ static const char *const ppsz_prefres[] = {
 #define INPUT_FAST_SEEK_LONGTEXT N_( \
     "Favor speed over precision while seeking" )
 
+#define INPUT_SEEK_INDEX_TEXT N_("Seek index cache")
+#define INPUT_SEEK_INDEX_LONGTEXT N_( \
+    "Store the seek points found by the demuxers in the cache directory, " \
+    "so that seeking in the same file is faster next time." )
+
 #define INPUT_RATE_TEXT N_("Playback speed")
 #define INPUT_RATE_LONGTEXT N_( \
     "This defines the playback speed (nominal speed is 1.0)." )
@@ -1115,6 +1127,19 @@ static const char *const ppsz_prefres[] = {
 #define PREPARSE_TIMEOUT_LONGTEXT N_( \
     "Maximum time allowed to preparse a file" )
 
+#define PREPARSE_THREADS_TEXT N_( "Preparsing threads" )
+#define PREPARSE_THREADS_LONGTEXT N_( \
+    "Maximum number of files preparsed at the same time." )
+
+#define FETCH_ART_THREADS_TEXT N_( "Art fetching threads" )
+#define FETCH_ART_THREADS_LONGTEXT N_( \
+    "Maximum number of files for which meta data and art are fetched at " \
+    "the same time." )
+
+#define FETCH_ART_TIMEOUT_TEXT N_( "Art fetching timeout" )
+#define FETCH_ART_TIMEOUT_LONGTEXT N_( \
+    "Maximum time allowed to fetch the meta data and art of a file" )
+
 #define METADATA_NETWORK_TEXT N_( "Allow metadata network access" )
 
 #define SD_TEXT N_( "Services discovery modules")
@@ -1492,6 +1517,8 @@ vlc_module_begin ()
 
     add_bool( "audio-time-stretch", true,
               AUDIO_TIME_STRETCH_TEXT, AUDIO_TIME_STRETCH_LONGTEXT, false )
+    add_bool( "audio-filter-thread", false,
+              AUDIO_FILTER_THREAD_TEXT, AUDIO_FILTER_THREAD_LONGTEXT, true )
 
     set_subcategory( SUBCAT_AUDIO_AOUT )
     add_module( "aout", "audio output", NULL, AOUT_TEXT, AOUT_LONGTEXT,
@@ -1730,6 +1757,8 @@ vlc_module_begin ()
     add_bool( "input-fast-seek", false,
               INPUT_FAST_SEEK_TEXT, INPUT_FAST_SEEK_LONGTEXT, false )
         change_safe ()
+    add_bool( "seek-index", true,
+              INPUT_SEEK_INDEX_TEXT, INPUT_SEEK_INDEX_LONGTEXT, true )
     add_float( "rate", 1.,
                INPUT_RATE_TEXT, INPUT_RATE_LONGTEXT, false )
 
@@ -2058,6 +2087,17 @@ vlc_module_begin ()
     add_integer( "preparse-timeout", 5000, PREPARSE_TIMEOUT_TEXT,
                  PREPARSE_TIMEOUT_LONGTEXT, false )
 
+    add_integer_with_range( "preparse-threads", 2, 1, 32,
+                            PREPARSE_THREADS_TEXT, PREPARSE_THREADS_LONGTEXT,
+                            true )
+
+    add_integer_with_range( "fetch-art-threads", 2, 1, 32,
+                            FETCH_ART_THREADS_TEXT, FETCH_ART_THREADS_LONGTEXT,
+                            true )
+
+    add_integer( "fetch-art-timeout", 10000, FETCH_ART_TIMEOUT_TEXT,
+                 FETCH_ART_TIMEOUT_LONGTEXT, true )
+
     add_obsolete_integer( "album-art" )
     add_bool( "metadata-network-access", false, METADATA_NETWORK_TEXT,
                  METADATA_NETWORK_TEXT, false )
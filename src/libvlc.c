@@ -663,3 +663,24 @@ void libvlc_MetadataCancel(libvlc_int_t *libvlc, void *id)
 
     playlist_preparser_Cancel(priv->parser, id);
 }
+
+/**
+ * Gets the number of input items preparsed and art fetched so far, and of
+ * input items waiting or being processed.
+ */
+void libvlc_MetadataStats(libvlc_int_t *libvlc, uint64_t *parsed,
+                          unsigned *parse_pending, uint64_t *fetched,
+                          unsigned *fetch_pending)
+{
+    libvlc_priv_t *priv = libvlc_priv(libvlc);
+
+    if (unlikely(priv->parser == NULL))
+    {
+        *parsed = *fetched = 0;
+        *parse_pending = *fetch_pending = 0;
+        return;
+    }
+
+    playlist_preparser_GetStats(priv->parser, parsed, parse_pending,
+                                fetched, fetch_pending);
+}
@@ -0,0 +1,470 @@
+/*****************************************************************************
+ * background_worker.c: pool of background worker threads
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#ifdef HAVE_SEARCH_H
+# include <search.h>
+#endif
+
+#include <vlc_common.h>
+#include <vlc_interrupt.h>
+
+#include "libvlc.h"
+#include "background_worker.h"
+
+struct task
+{
+    void *entity;
+    void *id;
+    int options;
+    mtime_t timeout;
+    enum background_worker_priority priority;
+    bool running;
+    struct
+    {   /**< same task pushed while running, to run again afterwards */
+        bool pending;
+        int options;
+        mtime_t timeout;
+        enum background_worker_priority priority;
+    } again;
+    struct task *prev, *next;
+};
+
+struct worker_thread
+{
+    struct task *task; /**< running task, or NULL */
+    vlc_interrupt_t *ctx; /**< interruption context of the running task */
+    mtime_t deadline; /**< deadline of the running task, or 0 */
+    bool killed;
+};
+
+struct background_worker
+{
+    void *owner;
+    struct background_worker_config conf;
+
+    vlc_mutex_t lock;
+    vlc_cond_t exited;
+    struct
+    {
+        struct task *first, *last;
+    } queues[BACKGROUND_WORKER_PRIORITIES];
+    void *tasks; /**< tree of the queued and running tasks */
+    struct worker_thread **threads;
+    unsigned live;
+    bool closing;
+
+    vlc_timer_t timer;
+    bool has_timer;
+    mtime_t timer_deadline;
+
+    uint64_t completed;
+    unsigned pending;
+};
+
+static int TaskCmp(const void *a, const void *b)
+{
+    const struct task *ta = a, *tb = b;
+    uintptr_t ea = (uintptr_t)ta->entity, eb = (uintptr_t)tb->entity;
+    uintptr_t ia = (uintptr_t)ta->id, ib = (uintptr_t)tb->id;
+
+    if (ea != eb)
+        return ea < eb ? -1 : 1;
+    if (ia != ib)
+        return ia < ib ? -1 : 1;
+    return 0;
+}
+
+static void Enqueue(struct background_worker *worker, struct task *task,
+                    enum background_worker_priority priority)
+{
+    struct task **last = &worker->queues[priority].last;
+
+    task->priority = priority;
+    task->prev = *last;
+    task->next = NULL;
+    if (*last != NULL)
+        (*last)->next = task;
+    else
+        worker->queues[priority].first = task;
+    *last = task;
+}
+
+static void Dequeue(struct background_worker *worker, struct task *task)
+{
+    if (task->prev != NULL)
+        task->prev->next = task->next;
+    else
+        worker->queues[task->priority].first = task->next;
+    if (task->next != NULL)
+        task->next->prev = task->prev;
+    else
+        worker->queues[task->priority].last = task->prev;
+}
+
+/* Removes a task that is not queued anymore, nor running */
+static void Drop(struct background_worker *worker, struct task *task)
+{
+    tdelete(task, &worker->tasks, TaskCmp);
+    worker->conf.pf_release(task->entity);
+    worker->pending--;
+    free(task);
+}
+
+static void Kill(struct worker_thread *thread)
+{
+    thread->killed = true;
+    thread->deadline = 0;
+    if (thread->ctx != NULL)
+        vlc_interrupt_kill(thread->ctx);
+}
+
+static void TimerExpired(void *data)
+{
+    struct background_worker *worker = data;
+    mtime_t now = mdate(), next = INT64_MAX;
+
+    vlc_mutex_lock(&worker->lock);
+    for (unsigned i = 0; i < worker->conf.max_threads; i++)
+    {
+        struct worker_thread *thread = worker->threads[i];
+
+        if (thread == NULL || thread->deadline == 0)
+            continue;
+        if (thread->deadline <= now)
+            Kill(thread);
+        else if (thread->deadline < next)
+            next = thread->deadline;
+    }
+
+    if (next != INT64_MAX)
+    {
+        worker->timer_deadline = next;
+        vlc_timer_schedule(worker->timer, true, next, 0);
+    }
+    else
+        worker->timer_deadline = 0;
+    vlc_mutex_unlock(&worker->lock);
+}
+
+static void ArmTimer(struct background_worker *worker, mtime_t deadline)
+{
+    if (!worker->has_timer)
+    {
+        if (vlc_timer_create(&worker->timer, TimerExpired, worker))
+            return; /* the task will not time out */
+        worker->has_timer = true;
+    }
+
+    if (worker->timer_deadline == 0 || deadline < worker->timer_deadline)
+    {
+        worker->timer_deadline = deadline;
+        vlc_timer_schedule(worker->timer, true, deadline, 0);
+    }
+}
+
+static void *Thread(void *data)
+{
+    struct background_worker *worker = data;
+    struct worker_thread self = { NULL, NULL, 0, false };
+    unsigned slot = 0;
+
+    vlc_mutex_lock(&worker->lock);
+    while (worker->threads[slot] != NULL)
+    {
+        slot++;
+        assert(slot < worker->conf.max_threads);
+    }
+    worker->threads[slot] = &self;
+
+    for (;;)
+    {
+        struct task *task = NULL;
+
+        for (unsigned i = 0; i < BACKGROUND_WORKER_PRIORITIES; i++)
+            if ((task = worker->queues[i].first) != NULL)
+                break;
+        if (task == NULL)
+            break;
+
+        Dequeue(worker, task);
+        task->running = true;
+
+        int options = task->options;
+
+        self.task = task;
+        self.ctx = vlc_interrupt_create();
+        self.killed = false;
+        self.deadline = 0;
+        if (task->timeout > 0)
+        {
+            self.deadline = mdate() + task->timeout;
+            ArmTimer(worker, self.deadline);
+        }
+        vlc_mutex_unlock(&worker->lock);
+
+        if (self.ctx != NULL)
+            vlc_interrupt_set(self.ctx);
+
+        bool again = worker->conf.pf_run(worker->owner, task->entity,
+                                         &options);
+
+        if (self.ctx != NULL)
+            vlc_interrupt_set(NULL);
+
+        vlc_mutex_lock(&worker->lock);
+        vlc_interrupt_t *ctx = self.ctx;
+
+        task->running = false;
+        if (!again && !self.killed)
+            worker->completed++;
+
+        if (worker->closing)
+            Drop(worker, task);
+        else if (task->again.pending)
+        {   /* Pushed again while running: run with the new options too */
+            task->options = task->again.options;
+            if (again && !self.killed)
+                task->options |= options;
+            task->timeout = task->again.timeout;
+            task->again.pending = false;
+            Enqueue(worker, task, task->again.priority);
+        }
+        else if (again && !self.killed)
+        {
+            task->options = options;
+            Enqueue(worker, task, BACKGROUND_WORKER_PRIORITY_LOW);
+        }
+        else
+            Drop(worker, task);
+        self.task = NULL;
+        self.ctx = NULL;
+        self.deadline = 0;
+        vlc_mutex_unlock(&worker->lock);
+
+        if (ctx != NULL)
+            vlc_interrupt_destroy(ctx);
+
+        vlc_mutex_lock(&worker->lock);
+    }
+
+    worker->threads[slot] = NULL;
+    worker->live--;
+    vlc_cond_signal(&worker->exited);
+    vlc_mutex_unlock(&worker->lock);
+    return NULL;
+}
+
+struct background_worker *background_worker_New(void *owner,
+                                    const struct background_worker_config *conf)
+{
+    assert(conf->max_threads > 0);
+
+    struct background_worker *worker = malloc(sizeof (*worker));
+    if (unlikely(worker == NULL))
+        return NULL;
+
+    worker->threads = calloc(conf->max_threads, sizeof (*worker->threads));
+    if (unlikely(worker->threads == NULL))
+    {
+        free(worker);
+        return NULL;
+    }
+
+    worker->owner = owner;
+    worker->conf = *conf;
+    vlc_mutex_init(&worker->lock);
+    vlc_cond_init(&worker->exited);
+    for (unsigned i = 0; i < BACKGROUND_WORKER_PRIORITIES; i++)
+        worker->queues[i].first = worker->queues[i].last = NULL;
+    worker->tasks = NULL;
+    worker->live = 0;
+    worker->closing = false;
+    worker->has_timer = false;
+    worker->timer_deadline = 0;
+    worker->completed = 0;
+    worker->pending = 0;
+    return worker;
+}
+
+int background_worker_Push(struct background_worker *worker, void *entity,
+                           void *id, int options, int timeout,
+                           enum background_worker_priority priority)
+{
+    assert(priority < BACKGROUND_WORKER_PRIORITIES);
+
+    struct task *task = malloc(sizeof (*task));
+    if (unlikely(task == NULL))
+        return VLC_ENOMEM;
+
+    task->entity = entity;
+    task->id = id;
+    task->options = options;
+    task->timeout = timeout < 0 ? worker->conf.default_timeout
+                                : timeout * INT64_C(1000);
+    task->running = false;
+    task->again.pending = false;
+
+    vlc_mutex_lock(&worker->lock);
+    if (unlikely(worker->closing))
+    {
+        vlc_mutex_unlock(&worker->lock);
+        free(task);
+        return VLC_EGENERIC;
+    }
+
+    struct task **pp = tsearch(task, &worker->tasks, TaskCmp);
+    if (unlikely(pp == NULL))
+    {
+        vlc_mutex_unlock(&worker->lock);
+        free(task);
+        return VLC_ENOMEM;
+    }
+
+    if (*pp != task)
+    {   /* Same task already queued or running */
+        struct task *dup = *pp;
+
+        if (dup->running)
+        {   /* The options may differ: run it again once done */
+            if (dup->again.pending)
+            {
+                dup->again.options |= options;
+                if (priority < dup->again.priority)
+                    dup->again.priority = priority;
+            }
+            else
+            {
+                dup->again.options = options;
+                dup->again.priority = priority;
+            }
+            dup->again.timeout = task->timeout;
+            dup->again.pending = true;
+        }
+        else
+        {
+            dup->options |= options;
+            if (priority < dup->priority)
+            {
+                Dequeue(worker, dup);
+                Enqueue(worker, dup, priority);
+            }
+        }
+        vlc_mutex_unlock(&worker->lock);
+        free(task);
+        return VLC_SUCCESS;
+    }
+
+    worker->conf.pf_hold(entity);
+    Enqueue(worker, task, priority);
+    worker->pending++;
+
+    if (worker->live < worker->conf.max_threads)
+    {
+        if (vlc_clone_detach(NULL, Thread, worker, VLC_THREAD_PRIORITY_LOW))
+        {
+            if (worker->live == 0)
+            {   /* Nobody would ever run the task */
+                Dequeue(worker, task);
+                Drop(worker, task);
+                vlc_mutex_unlock(&worker->lock);
+                return VLC_EGENERIC;
+            }
+        }
+        else
+            worker->live++;
+    }
+    vlc_mutex_unlock(&worker->lock);
+    return VLC_SUCCESS;
+}
+
+static void CancelLocked(struct background_worker *worker, void *id)
+{
+    for (unsigned i = 0; i < BACKGROUND_WORKER_PRIORITIES; i++)
+    {
+        struct task *task = worker->queues[i].first;
+
+        while (task != NULL)
+        {
+            struct task *next = task->next;
+
+            if (id == NULL || task->id == id)
+            {
+                Dequeue(worker, task);
+                Drop(worker, task);
+            }
+            task = next;
+        }
+    }
+
+    for (unsigned i = 0; i < worker->conf.max_threads; i++)
+    {
+        struct worker_thread *thread = worker->threads[i];
+
+        if (thread != NULL && thread->task != NULL
+         && (id == NULL || thread->task->id == id))
+        {
+            thread->task->again.pending = false;
+            Kill(thread);
+        }
+    }
+}
+
+void background_worker_Cancel(struct background_worker *worker, void *id)
+{
+    vlc_mutex_lock(&worker->lock);
+    CancelLocked(worker, id);
+    vlc_mutex_unlock(&worker->lock);
+}
+
+void background_worker_GetStats(struct background_worker *worker,
+                                uint64_t *completed, unsigned *pending)
+{
+    vlc_mutex_lock(&worker->lock);
+    *completed = worker->completed;
+    *pending = worker->pending;
+    vlc_mutex_unlock(&worker->lock);
+}
+
+void background_worker_Delete(struct background_worker *worker)
+{
+    vlc_mutex_lock(&worker->lock);
+    worker->closing = true;
+    CancelLocked(worker, NULL);
+    while (worker->live > 0)
+        vlc_cond_wait(&worker->exited, &worker->lock);
+    vlc_mutex_unlock(&worker->lock);
+
+    assert(worker->tasks == NULL);
+    assert(worker->pending == 0);
+
+    if (worker->has_timer)
+        vlc_timer_destroy(worker->timer);
+    vlc_cond_destroy(&worker->exited);
+    vlc_mutex_destroy(&worker->lock);
+    free(worker->threads);
+    free(worker);
+}
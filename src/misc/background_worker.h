@@ -0,0 +1,104 @@
+/*****************************************************************************
+ * background_worker.h: pool of background worker threads
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef LIBVLC_BACKGROUND_WORKER_H
+#define LIBVLC_BACKGROUND_WORKER_H 1
+
+/**
+ * Background worker pool.
+ *
+ * Runs queued tasks on up to a given number of low priority threads. The
+ * threads are spawned on demand and exit when the queue is empty.
+ *
+ * Each task runs with its own interruption context (see vlc_interrupt.h),
+ * which is killed when the task times out or is cancelled.
+ */
+struct background_worker;
+
+enum background_worker_priority
+{
+    BACKGROUND_WORKER_PRIORITY_HIGH,
+    BACKGROUND_WORKER_PRIORITY_NORMAL,
+    BACKGROUND_WORKER_PRIORITY_LOW,
+};
+#define BACKGROUND_WORKER_PRIORITIES 3
+
+struct background_worker_config
+{
+    /** Maximum number of threads (at least one) */
+    unsigned max_threads;
+    /** Timeout of the tasks pushed with a negative timeout, 0 for none */
+    mtime_t default_timeout;
+
+    /** Retains a task entity */
+    void (*pf_hold)(void *entity);
+    /** Releases a task entity */
+    void (*pf_release)(void *entity);
+    /**
+     * Runs a task.
+     *
+     * \param owner the owner given to background_worker_New()
+     * \param options task options, can be modified to run the task again
+     * \return true to queue the task again with low priority
+     */
+    bool (*pf_run)(void *owner, void *entity, int *options);
+};
+
+/**
+ * Creates a worker pool.
+ */
+struct background_worker *background_worker_New(void *owner,
+                                    const struct background_worker_config *);
+
+/**
+ * Queues a task.
+ *
+ * A task with the same entity and identifier as a queued one is merged with
+ * it: the options are ORed and the priority is raised, if needed. If the
+ * task is running, it is queued again with the new options once done.
+ *
+ * \param id identifier to cancel the task with, or NULL
+ * \param timeout timeout in milliseconds, 0 for none, negative for the
+ * default timeout
+ */
+int background_worker_Push(struct background_worker *, void *entity,
+                           void *id, int options, int timeout,
+                           enum background_worker_priority);
+
+/**
+ * Cancels the queued and running tasks with the given identifier.
+ *
+ * \param id identifier, or NULL to cancel all tasks
+ */
+void background_worker_Cancel(struct background_worker *, void *id);
+
+/**
+ * Gets the number of completed tasks (neither cancelled nor timed out) and
+ * of queued or running tasks.
+ */
+void background_worker_GetStats(struct background_worker *,
+                                uint64_t *completed, unsigned *pending);
+
+/**
+ * Cancels all tasks, waits for the threads to exit and destroys the pool.
+ */
+void background_worker_Delete(struct background_worker *);
+
+#endif
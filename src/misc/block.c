@@ -33,6 +33,7 @@
 
 #include <vlc_common.h>
 #include <vlc_block.h>
+#include <vlc_atomic.h>
 #include <vlc_fs.h>
 
 #ifndef NDEBUG
@@ -117,25 +118,327 @@ static void BlockMetaCopy( block_t *restrict out, const block_t *in )
 /** Initial reserved header and footer size. */
 #define BLOCK_PADDING      32
 
-block_t *block_Alloc (size_t size)
+/*
+ * Block recycling
+ *
+ * Blocks of common sizes (TS packets, network datagrams, large reads) are
+ * recycled rather than returned to the heap. Each thread keeps a small cache
+ * of free blocks per size class, so that the common case needs neither
+ * locking nor a heap allocation. Each size class also has a shared depot:
+ * blocks allocated by one thread and released by another (input thread to
+ * decoder, for instance) go through it, in batches.
+ */
+#define BLOCK_POOL_CLASSES 3
+#define BLOCK_POOL_ALLOC(size) \
+    (sizeof (block_pooled_t) + BLOCK_ALIGN + (2 * BLOCK_PADDING) + (size))
+
+typedef struct block_pooled_t
+{
+    block_t     self;
+    unsigned    pool; /**< size class (the block size may have changed) */
+} block_pooled_t;
+
+typedef struct block_pool_t
+{
+    size_t      min_size; /**< smallest pooled payload size */
+    size_t      size; /**< largest pooled payload size */
+    unsigned    cache_max; /**< free blocks per thread cache */
+    unsigned    depot_max; /**< free blocks in the shared depot */
+
+    vlc_mutex_t lock;
+    block_t    *depot;
+    unsigned    depot_count;
+} block_pool_t;
+
+static block_pool_t block_pools[BLOCK_POOL_CLASSES] =
+{
+    {     0,   256, 64, 256, VLC_STATIC_MUTEX, NULL, 0 },
+    {   512,  2048, 32, 128, VLC_STATIC_MUTEX, NULL, 0 },
+    { 16384, 65536,  2,  16, VLC_STATIC_MUTEX, NULL, 0 },
+};
+
+typedef struct
+{
+    block_t *blocks[BLOCK_POOL_CLASSES];
+    unsigned count[BLOCK_POOL_CLASSES];
+    block_pool_stats_t stats; /**< not yet accounted for globally */
+    unsigned ops;
+} block_cache_t;
+
+/** Number of operations after which a thread reports its statistics. */
+#define BLOCK_CACHE_STATS_PERIOD 256
+
+static vlc_mutex_t block_stats_lock = VLC_STATIC_MUTEX;
+static block_pool_stats_t block_stats;
+
+static vlc_mutex_t block_cache_lock = VLC_STATIC_MUTEX;
+static atomic_int block_cache_state = ATOMIC_VAR_INIT(0);
+static vlc_threadvar_t block_cache_var;
+
+static void block_cache_ReportStats (block_cache_t *cache)
+{
+    vlc_mutex_lock (&block_stats_lock);
+    block_stats.allocs += cache->stats.allocs;
+    block_stats.hits += cache->stats.hits;
+    block_stats.releases += cache->stats.releases;
+    block_stats.discards += cache->stats.discards;
+    vlc_mutex_unlock (&block_stats_lock);
+
+    memset (&cache->stats, 0, sizeof (cache->stats));
+    cache->ops = 0;
+}
+
+static void block_cache_Tick (block_cache_t *cache)
+{
+    if (++cache->ops >= BLOCK_CACHE_STATS_PERIOD)
+        block_cache_ReportStats (cache);
+}
+
+/**
+ * Moves up to count blocks from a thread cache to the shared depot.
+ * Blocks that do not fit in the depot are freed.
+ */
+static void block_cache_Flush (block_cache_t *cache, unsigned i,
+                               unsigned count)
+{
+    block_pool_t *pool = &block_pools[i];
+    block_t *head = cache->blocks[i];
+    block_t **pp = &cache->blocks[i];
+
+    if (count > cache->count[i])
+        count = cache->count[i];
+    if (count == 0)
+        return;
+
+    for (unsigned n = 0; n < count; n++)
+        pp = &(*pp)->p_next;
+    cache->blocks[i] = *pp;
+    cache->count[i] -= count;
+    *pp = NULL;
+
+    vlc_mutex_lock (&pool->lock);
+    while (head != NULL && pool->depot_count < pool->depot_max)
+    {
+        block_t *b = head;
+
+        head = b->p_next;
+        b->p_next = pool->depot;
+        pool->depot = b;
+        pool->depot_count++;
+    }
+    vlc_mutex_unlock (&pool->lock);
+
+    while (head != NULL)
+    {
+        block_t *b = head;
+
+        head = b->p_next;
+        free (b);
+        cache->stats.discards++;
+    }
+}
+
+/**
+ * Moves up to half a thread cache worth of blocks from the shared depot.
+ */
+static void block_cache_Refill (block_cache_t *cache, unsigned i)
+{
+    block_pool_t *pool = &block_pools[i];
+    unsigned count = (pool->cache_max + 1) / 2;
+
+    vlc_mutex_lock (&pool->lock);
+    while (count > 0 && pool->depot != NULL)
+    {
+        block_t *b = pool->depot;
+
+        pool->depot = b->p_next;
+        pool->depot_count--;
+        b->p_next = cache->blocks[i];
+        cache->blocks[i] = b;
+        cache->count[i]++;
+        count--;
+    }
+    vlc_mutex_unlock (&pool->lock);
+}
+
+static void block_cache_Destroy (void *data)
+{
+    block_cache_t *cache = data;
+
+    for (unsigned i = 0; i < BLOCK_POOL_CLASSES; i++)
+        block_cache_Flush (cache, i, cache->count[i]);
+    block_cache_ReportStats (cache);
+    free (cache);
+}
+
+static int block_cache_Init (void)
+{
+    int state;
+
+    vlc_mutex_lock (&block_cache_lock);
+    state = atomic_load_explicit (&block_cache_state, memory_order_relaxed);
+    if (state == 0)
+    {
+        state = vlc_threadvar_create (&block_cache_var, block_cache_Destroy)
+                ? -1 : 1;
+        atomic_store_explicit (&block_cache_state, state,
+                               memory_order_release);
+    }
+    vlc_mutex_unlock (&block_cache_lock);
+    return state;
+}
+
+/**
+ * Gets the block cache of the calling thread, creating it if needed.
+ * @return the cache, or NULL if recycling is not available.
+ */
+static block_cache_t *block_cache_Get (void)
 {
-    /* 2 * BLOCK_PADDING: pre + post padding */
-    const size_t alloc = sizeof (block_t) + BLOCK_ALIGN + (2 * BLOCK_PADDING)
-                       + size;
-    if (unlikely(alloc <= size))
+    int state = atomic_load_explicit (&block_cache_state,
+                                      memory_order_acquire);
+    if (unlikely(state == 0))
+        state = block_cache_Init ();
+    if (unlikely(state < 0))
         return NULL;
 
-    block_t *b = malloc (alloc);
-    if (unlikely(b == NULL))
+    block_cache_t *cache = vlc_threadvar_get (block_cache_var);
+    if (unlikely(cache == NULL))
+    {
+        cache = calloc (1, sizeof (*cache));
+        if (unlikely(cache == NULL))
+            return NULL;
+        if (unlikely(vlc_threadvar_set (block_cache_var, cache)))
+        {
+            free (cache);
+            return NULL;
+        }
+    }
+    return cache;
+}
+
+static void block_pool_Release (block_t *block)
+{
+    const unsigned i = ((block_pooled_t *)block)->pool;
+
+    assert (i < BLOCK_POOL_CLASSES);
+    block_Invalidate (block);
+
+    block_cache_t *cache = block_cache_Get ();
+    if (unlikely(cache == NULL))
+    {
+        free (block);
+        return;
+    }
+
+    const block_pool_t *pool = &block_pools[i];
+
+    if (cache->count[i] >= pool->cache_max)
+        block_cache_Flush (cache, i, (pool->cache_max + 1) / 2);
+    block->p_next = cache->blocks[i];
+    cache->blocks[i] = block;
+    cache->count[i]++;
+    cache->stats.releases++;
+    block_cache_Tick (cache);
+}
+
+/**
+ * Gets a recycled block, or allocates a new one, for a pooled size.
+ * @param buf start of the block buffer [OUT]
+ * @param len size of the block buffer [OUT]
+ * @return the uninitialized block, or NULL if the size is not pooled or
+ * recycling is not available.
+ */
+static block_t *block_pool_Get (size_t size, void **restrict buf,
+                                size_t *restrict len)
+{
+    unsigned i = 0;
+
+    while (size > block_pools[i].size)
+        if (++i >= BLOCK_POOL_CLASSES)
+            return NULL;
+    if (size < block_pools[i].min_size)
+        return NULL; /* too much memory would be wasted */
+
+    block_cache_t *cache = block_cache_Get ();
+    if (unlikely(cache == NULL))
         return NULL;
 
-    block_Init (b, b + 1, alloc - sizeof (*b));
+    if (cache->blocks[i] == NULL)
+        block_cache_Refill (cache, i);
+
+    const size_t alloc = BLOCK_POOL_ALLOC(block_pools[i].size);
+    block_pooled_t *pb;
+    block_t *b = cache->blocks[i];
+
+    if (b != NULL)
+    {
+        cache->blocks[i] = b->p_next;
+        cache->count[i]--;
+        cache->stats.hits++;
+        pb = (block_pooled_t *)b;
+    }
+    else
+    {
+        pb = malloc (alloc);
+        if (unlikely(pb == NULL))
+            return NULL;
+        pb->pool = i;
+    }
+    assert (pb->pool == i);
+    cache->stats.allocs++;
+    block_cache_Tick (cache);
+
+    *buf = pb + 1;
+    *len = alloc - sizeof (*pb);
+    return &pb->self;
+}
+
+void block_pool_GetStats (block_pool_stats_t *stats)
+{
+    int state = atomic_load_explicit (&block_cache_state,
+                                      memory_order_acquire);
+    if (state > 0)
+    {   /* Include the pending figures of the calling thread */
+        block_cache_t *cache = vlc_threadvar_get (block_cache_var);
+        if (cache != NULL)
+            block_cache_ReportStats (cache);
+    }
+
+    vlc_mutex_lock (&block_stats_lock);
+    *stats = block_stats;
+    vlc_mutex_unlock (&block_stats_lock);
+}
+
+block_t *block_Alloc (size_t size)
+{
+    block_free_t release = block_pool_Release;
+    void *buf;
+    size_t len;
+    block_t *b = block_pool_Get (size, &buf, &len);
+
+    if (b == NULL)
+    {
+        /* 2 * BLOCK_PADDING: pre + post padding */
+        const size_t alloc = sizeof (block_t) + BLOCK_ALIGN
+                           + (2 * BLOCK_PADDING) + size;
+        if (unlikely(alloc <= size))
+            return NULL;
+
+        b = malloc (alloc);
+        if (unlikely(b == NULL))
+            return NULL;
+        buf = b + 1;
+        len = alloc - sizeof (*b);
+        release = block_generic_Release;
+    }
+
+    block_Init (b, buf, len);
     static_assert ((BLOCK_PADDING % BLOCK_ALIGN) == 0,
                    "BLOCK_PADDING must be a multiple of BLOCK_ALIGN");
     b->p_buffer += BLOCK_PADDING + BLOCK_ALIGN - 1;
     b->p_buffer = (void *)(((uintptr_t)b->p_buffer) & ~(BLOCK_ALIGN - 1));
     b->i_buffer = size;
-    b->pf_release = block_generic_Release;
+    b->pf_release = release;
     return b;
 }
 
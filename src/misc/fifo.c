@@ -26,10 +26,12 @@
 #endif
 
 #include <assert.h>
+#include <stdalign.h>
 #include <stdlib.h>
 
 #include <vlc_common.h>
 #include <vlc_block.h>
+#include <vlc_atomic.h>
 #include "libvlc.h"
 
 /**
@@ -233,3 +235,216 @@ size_t block_FifoCount (block_fifo_t *fifo)
     vlc_mutex_unlock (&fifo->lock);
     return depth;
 }
+
+/**
+ * Internal state for lock-free block queues
+ *
+ * This is an intrusive multiple producers single consumer queue, linking
+ * blocks through block_t.p_next, as designed by Dmitry Vyukov. The stub
+ * block is in the queue whenever it would otherwise be empty.
+ *
+ * Producers account blocks before queuing them, and the consumer after
+ * dequeuing them, so that counts never go below the actual values.
+ */
+struct vlc_lffifo_t
+{
+    /* Producers side */
+    atomic_uintptr_t    tail;
+    atomic_size_t       queued_depth;
+    atomic_size_t       queued_size;
+    atomic_bool         waiting; /**< Whether the consumer is sleeping */
+
+    /* Consumer side, on its own cache line */
+    alignas (64) block_t *head;
+    atomic_size_t       dequeued_depth;
+    atomic_size_t       dequeued_size;
+    block_t             stub;
+
+    vlc_mutex_t         lock; /**< Protects sleeping only */
+    vlc_cond_t          wait;
+};
+
+static inline atomic_uintptr_t *vlc_lffifo_Link(block_t *block)
+{
+    static_assert(sizeof (atomic_uintptr_t) == sizeof (block_t *),
+                  "Incompatible atomic pointer size");
+    return (atomic_uintptr_t *)&block->p_next;
+}
+
+static void vlc_lffifo_Push(vlc_lffifo_t *fifo, block_t *first, block_t *last)
+{
+    atomic_store_explicit(vlc_lffifo_Link(last), 0, memory_order_relaxed);
+
+    /* Sequentially consistent, to pair with the consumer going to sleep */
+    block_t *prev = (block_t *)atomic_exchange(&fifo->tail, (uintptr_t)last);
+    /* Until this, the consumer cannot see first nor anything after it. */
+    atomic_store_explicit(vlc_lffifo_Link(prev), (uintptr_t)first,
+                          memory_order_release);
+}
+
+static block_t *vlc_lffifo_Next(block_t *block)
+{
+    return (block_t *)atomic_load_explicit(vlc_lffifo_Link(block),
+                                           memory_order_acquire);
+}
+
+vlc_lffifo_t *vlc_lffifo_New(void)
+{
+    vlc_lffifo_t *fifo = vlc_memalign(64, sizeof (*fifo));
+    if (unlikely(fifo == NULL))
+        return NULL;
+
+    fifo->stub.p_next = NULL;
+    atomic_init(&fifo->tail, (uintptr_t)&fifo->stub);
+    atomic_init(&fifo->queued_depth, 0);
+    atomic_init(&fifo->queued_size, 0);
+    atomic_init(&fifo->waiting, false);
+    fifo->head = &fifo->stub;
+    atomic_init(&fifo->dequeued_depth, 0);
+    atomic_init(&fifo->dequeued_size, 0);
+    vlc_mutex_init(&fifo->lock);
+    vlc_cond_init(&fifo->wait);
+    return fifo;
+}
+
+void vlc_lffifo_Release(vlc_lffifo_t *fifo)
+{
+    vlc_lffifo_Empty(fifo);
+    vlc_cond_destroy(&fifo->wait);
+    vlc_mutex_destroy(&fifo->lock);
+    vlc_free(fifo);
+}
+
+void vlc_lffifo_Queue(vlc_lffifo_t *fifo, block_t *block)
+{
+    block_t *last = block;
+    size_t depth = 1, size = block->i_buffer;
+
+    while (last->p_next != NULL)
+    {
+        last = last->p_next;
+        depth++;
+        size += last->i_buffer;
+    }
+
+    atomic_fetch_add_explicit(&fifo->queued_depth, depth,
+                              memory_order_relaxed);
+    atomic_fetch_add_explicit(&fifo->queued_size, size,
+                              memory_order_relaxed);
+    vlc_lffifo_Push(fifo, block, last);
+
+    /* Either this sees the consumer going to sleep, or it sees the link. */
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&fifo->waiting, memory_order_relaxed))
+    {
+        vlc_mutex_lock(&fifo->lock);
+        vlc_cond_signal(&fifo->wait);
+        vlc_mutex_unlock(&fifo->lock);
+    }
+}
+
+block_t *vlc_lffifo_Dequeue(vlc_lffifo_t *fifo)
+{
+    block_t *block = fifo->head;
+    block_t *next = vlc_lffifo_Next(block);
+
+    if (block == &fifo->stub)
+    {
+        if (next == NULL)
+            return NULL; /* Empty */
+        fifo->head = block = next;
+        next = vlc_lffifo_Next(block);
+    }
+
+    if (next == NULL)
+    {
+        if (block != (block_t *)atomic_load_explicit(&fifo->tail,
+                                                     memory_order_acquire))
+            return NULL; /* A producer has yet to link the next block */
+
+        /* Put the stub back, so that the last block can be taken out */
+        vlc_lffifo_Push(fifo, &fifo->stub, &fifo->stub);
+        next = vlc_lffifo_Next(block);
+        if (next == NULL)
+            return NULL;
+    }
+
+    fifo->head = next;
+    block->p_next = NULL;
+
+    /* Only the consumer writes those, no need for read-modify-write */
+    atomic_store_explicit(&fifo->dequeued_depth,
+        atomic_load_explicit(&fifo->dequeued_depth, memory_order_relaxed) + 1,
+        memory_order_relaxed);
+    atomic_store_explicit(&fifo->dequeued_size,
+        atomic_load_explicit(&fifo->dequeued_size, memory_order_relaxed)
+        + block->i_buffer, memory_order_relaxed);
+    return block;
+}
+
+block_t *vlc_lffifo_DequeueAll(vlc_lffifo_t *fifo)
+{
+    block_t *first = NULL, **pp = &first, *block;
+
+    while ((block = vlc_lffifo_Dequeue(fifo)) != NULL)
+    {
+        *pp = block;
+        pp = &block->p_next;
+    }
+    return first;
+}
+
+static void vlc_lffifo_Cleanup(void *data)
+{
+    vlc_lffifo_t *fifo = data;
+
+    atomic_store_explicit(&fifo->waiting, false, memory_order_relaxed);
+    vlc_mutex_unlock(&fifo->lock);
+}
+
+block_t *vlc_lffifo_Get(vlc_lffifo_t *fifo)
+{
+    block_t *block;
+
+    vlc_testcancel();
+
+    block = vlc_lffifo_Dequeue(fifo);
+    if (likely(block != NULL))
+        return block;
+
+    vlc_mutex_lock(&fifo->lock);
+    vlc_cleanup_push(vlc_lffifo_Cleanup, fifo);
+    while ((block = vlc_lffifo_Dequeue(fifo)) == NULL)
+    {
+        /* Either a producer sees this, or this sees the producer link. */
+        atomic_store_explicit(&fifo->waiting, true, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+
+        block = vlc_lffifo_Dequeue(fifo);
+        if (block != NULL)
+            break;
+        vlc_cond_wait(&fifo->wait, &fifo->lock);
+    }
+    vlc_cleanup_pop();
+    vlc_lffifo_Cleanup(fifo);
+    return block;
+}
+
+size_t vlc_lffifo_GetCount(vlc_lffifo_t *fifo)
+{
+    size_t dequeued = atomic_load(&fifo->dequeued_depth);
+
+    return atomic_load(&fifo->queued_depth) - dequeued;
+}
+
+size_t vlc_lffifo_GetBytes(vlc_lffifo_t *fifo)
+{
+    size_t dequeued = atomic_load(&fifo->dequeued_size);
+
+    return atomic_load(&fifo->queued_size) - dequeued;
+}
+
+void vlc_lffifo_Empty(vlc_lffifo_t *fifo)
+{
+    block_ChainRelease(vlc_lffifo_DequeueAll(fifo));
+}
@@ -166,6 +166,9 @@ typedef struct module_bank
     size_t        size;
     vlc_plugin_t **plugins;
     vlc_plugin_t *cache;
+
+    size_t        dirs_count;
+    struct vlc_cache_dir *dirs;
 } module_bank_t;
 
 /**
@@ -231,6 +234,21 @@ static void AllocatePluginDir (module_bank_t *bank, unsigned maxdepth,
         return;
     maxdepth--;
 
+    if (bank->mode & CACHE_WRITE_FILE)
+    {   /* Remember the directory, to detect additions and removals */
+        struct stat st;
+
+        if (vlc_stat (absdir, &st) == 0)
+        {
+            bank->dirs = xrealloc(bank->dirs,
+                            (bank->dirs_count + 1) * sizeof (*bank->dirs));
+            bank->dirs[bank->dirs_count].path =
+                xstrdup((reldir != NULL) ? reldir : "");
+            bank->dirs[bank->dirs_count].mtime = vlc_cache_mtime(&st);
+            bank->dirs_count++;
+        }
+    }
+
     DIR *dh = vlc_opendir (absdir);
     if (dh == NULL)
         return;
@@ -298,6 +316,38 @@ static void AllocatePluginDir (module_bank_t *bank, unsigned maxdepth,
     closedir (dh);
 }
 
+/**
+ * Registers all the plug-ins from the cache, if none was modified.
+ *
+ * This is used instead of browsing the directories when the cache lists all
+ * the plug-ins files, i.e. when no files were added nor removed.
+ * \return true if the cached plug-ins were registered, false if the
+ *         directories must be browsed
+ */
+static bool AllocatePluginCache(module_bank_t *bank)
+{
+    for (vlc_plugin_t *plugin = bank->cache;
+         plugin != NULL;
+         plugin = plugin->next)
+    {
+        struct stat st;
+
+        if (vlc_stat(plugin->abspath, &st)
+         || plugin->mtime != (int64_t)st.st_mtime
+         || plugin->size != (uint64_t)st.st_size)
+            return false;
+    }
+
+    while (bank->cache != NULL)
+    {
+        vlc_plugin_t *plugin = bank->cache;
+
+        bank->cache = plugin->next;
+        module_StoreBank(plugin);
+    }
+    return true;
+}
+
 /**
  * Scans for plug-ins within a file system hierarchy.
  * \param path base directory to browse
@@ -311,13 +361,17 @@ static void AllocatePluginPath(vlc_object_t *obj, const char *path,
         .base = path,
         .mode = mode,
     };
+    bool unchanged = false;
 
     if (mode & CACHE_READ_FILE)
-        bank.cache = vlc_cache_load(obj, path, &modules.caches);
+        bank.cache = vlc_cache_load(obj, path, &modules.caches,
+                            (mode & CACHE_SCAN_DIR) ? &unchanged : NULL);
     else
         msg_Dbg(bank.obj, "ignoring plugins cache file");
 
-    if (mode & CACHE_SCAN_DIR)
+    if ((mode & CACHE_SCAN_DIR) && unchanged && AllocatePluginCache(&bank))
+        msg_Dbg(obj, "plugins cache of `%s' is up to date", bank.base);
+    else if (mode & CACHE_SCAN_DIR)
     {
         msg_Dbg(obj, "recursively browsing `%s'", bank.base);
 
@@ -338,8 +392,12 @@ static void AllocatePluginPath(vlc_object_t *obj, const char *path,
     }
 
     if (mode & CACHE_WRITE_FILE)
-        CacheSave(obj, path, bank.plugins, bank.size);
+        CacheSave(obj, path, bank.plugins, bank.size, bank.dirs,
+                  bank.dirs_count);
 
+    for (size_t i = 0; i < bank.dirs_count; i++)
+        free(bank.dirs[i].path);
+    free(bank.dirs);
     free(bank.plugins);
 }
 
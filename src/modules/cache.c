@@ -57,7 +57,7 @@
 #ifdef HAVE_DYNAMIC_PLUGINS
 /* Sub-version number
  * (only used to avoid breakage in dev version when cache structure changes) */
-#define CACHE_SUBVERSION_NUM 34
+#define CACHE_SUBVERSION_NUM 35
 
 /* Cache filename */
 #define CACHE_NAME "plugins.dat"
@@ -65,6 +65,18 @@
 #define CACHE_STRING "cache "PACKAGE_NAME" "PACKAGE_VERSION
 
 
+/**
+ * Gets the modification time of a file, in nanoseconds if available.
+ */
+int64_t vlc_cache_mtime(const struct stat *st)
+{
+#ifdef HAVE_STRUCT_STAT_ST_MTIM
+    return st->st_mtim.tv_sec * INT64_C(1000000000) + st->st_mtim.tv_nsec;
+#else
+    return st->st_mtime * INT64_C(1000000000);
+#endif
+}
+
 static int vlc_cache_load_immediate(void *out, block_t *in, size_t size)
 {
     if (in->i_buffer < size)
@@ -244,48 +256,125 @@ error:
     return -1; /* FIXME: leaks */
 }
 
-static int vlc_cache_load_plugin_config(vlc_plugin_t *plugin, block_t *file)
+/**
+ * Deserializes the configuration items of a cached plug-in.
+ *
+ * The items are only parsed when first used: until then, the options table
+ * from the cache file is enough to look them up by name.
+ */
+static int vlc_cache_load_plugin_items(vlc_plugin_t *plugin)
 {
-    uint16_t lines;
+    const size_t lines = plugin->conf.size;
+    module_config_t *items = calloc(lines, sizeof (*items));
+    if (unlikely(items == NULL))
+        return -1;
 
-    /* Calculate the structure length */
-    LOAD_IMMEDIATE (lines);
+    block_t block, *file = &block;
 
-    /* Allocate memory */
-    if (lines)
+    block_Init(file, (uint8_t *)plugin->conf.data, plugin->conf.data_size);
+
+    for (size_t i = 0; i < lines; i++)
     {
-        plugin->conf.items = calloc(sizeof (module_config_t), lines);
-        if (unlikely(plugin->conf.items == NULL))
-        {
-            plugin->conf.size = 0;
-            return -1;
-        }
+        module_config_t *item = items + i;
+
+        if (vlc_cache_load_config(item, file))
+            goto error;
+        item->owner = plugin;
     }
-    else
-        plugin->conf.items = NULL;
 
-    plugin->conf.size = lines;
+    /* Only the terminating nul byte shall remain */
+    if (file->i_buffer != 1)
+        goto error;
 
-    /* Do the duplication job */
-    for (size_t i = 0; i < lines; i++)
+    /* The options table must match the items */
+    for (size_t i = 0; i < plugin->conf.count; i++)
     {
-        module_config_t *item = plugin->conf.items + i;
+        const struct vlc_cache_option *opt = plugin->conf.options + i;
+        const module_config_t *item = items + opt->index;
 
-        if (vlc_cache_load_config(item, file))
-            return -1;
+        if (item->psz_name != (const char *)plugin->conf.data + opt->name
+         || item->i_type != opt->type || item->i_short != opt->shortcut)
+            goto error;
+    }
 
-        if (CONFIG_ITEM(item->i_type))
-        {
-            plugin->conf.count++;
-            if (item->i_type == CONFIG_ITEM_BOOL)
-                plugin->conf.booleans++;
-        }
-        item->owner = plugin;
+    plugin->conf.items = items;
+    return 0;
+error:
+    config_Free(items, lines);
+    return -1;
+}
+
+/**
+ * Gets the configuration items of a plug-in, deserializing them if needed.
+ *
+ * \note This function is thread-safe.
+ *
+ * \return the table of plug-in configuration items (conf.size entries),
+ *         or NULL if it is empty or the plugins cache is corrupted
+ */
+module_config_t *vlc_plugin_get_config(vlc_plugin_t *plugin)
+{
+    static vlc_mutex_t lock = VLC_STATIC_MUTEX;
+
+    if (atomic_load_explicit(&plugin->conf.loaded, memory_order_acquire))
+        return plugin->conf.items; /* fast path: already loaded */
+
+    vlc_mutex_lock(&lock);
+    if (!atomic_load_explicit(&plugin->conf.loaded, memory_order_relaxed))
+    {
+        if (vlc_cache_load_plugin_items(plugin))
+            fprintf(stderr, "LibVLC: corrupted plugins cache entry for %s\n",
+                    plugin->abspath);
+        atomic_store_explicit(&plugin->conf.loaded, true,
+                              memory_order_release);
+    }
+    vlc_mutex_unlock(&lock);
+    return plugin->conf.items;
+}
+
+static int vlc_cache_load_plugin_config(vlc_plugin_t *plugin, block_t *file)
+{
+    uint16_t lines, count, booleans;
+    uint32_t size;
+
+    LOAD_IMMEDIATE (lines);
+    LOAD_IMMEDIATE (count);
+    LOAD_IMMEDIATE (booleans);
+    if (count > lines || booleans > count)
+        goto error;
+
+    /* Serialized items, with a nul terminator for the options names */
+    LOAD_IMMEDIATE (size);
+    LOAD_ARRAY (plugin->conf.data, size);
+    if (size == 0 ? (lines > 0) : (plugin->conf.data[size - 1] != '\0'))
+        goto error;
+
+    LOAD_ALIGNOF (struct vlc_cache_option);
+    LOAD_ARRAY (plugin->conf.options, count);
+
+    size_t bools = 0;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const struct vlc_cache_option *opt = plugin->conf.options + i;
+
+        if (opt->name >= size || opt->index >= lines
+         || !CONFIG_ITEM(opt->type))
+            goto error;
+        if (opt->type == CONFIG_ITEM_BOOL)
+            bools++;
     }
+    if (bools != booleans)
+        goto error;
 
+    plugin->conf.size = lines;
+    plugin->conf.count = count;
+    plugin->conf.booleans = booleans;
+    plugin->conf.data_size = size;
+    atomic_init(&plugin->conf.loaded, lines == 0);
     return 0;
 error:
-    return -1; /* FIXME: leaks */
+    return -1;
 }
 
 static int vlc_cache_load_module(vlc_plugin_t *plugin, block_t *file)
@@ -359,6 +448,40 @@ error:
     return NULL;
 }
 
+/**
+ * Checks that a base directory only holds entries known to a cache.
+ *
+ * Writing the cache file modifies the base directory after it was browsed:
+ * a different time does not tell whether plug-ins were added then. This
+ * ignores the cache file itself, and any entry other than a cached directory
+ * or plug-in file counts as a change.
+ */
+static bool vlc_cache_dir_known(const char *dir, const char *const *subdirs,
+                                size_t n, const vlc_plugin_t *plugins)
+{
+    DIR *dh = vlc_opendir(dir);
+    if (dh == NULL)
+        return false;
+
+    bool known = true;
+    const char *file;
+
+    while (known && (file = vlc_readdir(dh)) != NULL)
+    {
+        if (!strcmp(file, ".") || !strcmp(file, "..")
+         || !strcmp(file, CACHE_NAME))
+            continue;
+
+        known = false;
+        for (size_t i = 0; i < n && !known; i++)
+            known = subdirs[i] != NULL && !strcmp(subdirs[i], file);
+        for (const vlc_plugin_t *p = plugins; p != NULL && !known; p = p->next)
+            known = !strcmp(p->path, file);
+    }
+    closedir(dh);
+    return known;
+}
+
 /**
  * Loads a plugins cache file.
  *
@@ -366,13 +489,22 @@ error:
  * will in turn be queried by AllocateAllPlugins() to see if it needs to
  * actually load the dynamically loadable module.
  * This allows us to only fully load plugins when they are actually used.
+ *
+ * The cache file is mapped read-only in memory and plug-ins configuration
+ * items are only deserialized when first used (see vlc_plugin_get_config()).
+ *
+ * \param unchanged [OUT] whether the plug-ins directories were left unchanged
+ *                  since the cache was written, so that they need not be
+ *                  browsed again (or NULL if they are not browsed anyway)
  */
 vlc_plugin_t *vlc_cache_load(vlc_object_t *p_this, const char *dir,
-                             block_t **backingp)
+                             block_t **backingp, bool *unchanged)
 {
     char *psz_filename;
 
     assert( dir != NULL );
+    if (unchanged != NULL)
+        *unchanged = false;
 
     if( asprintf( &psz_filename, "%s"DIR_SEP CACHE_NAME, dir ) == -1 )
         return 0;
@@ -439,6 +571,60 @@ vlc_plugin_t *vlc_cache_load(vlc_object_t *p_this, const char *dir,
     }
 
     vlc_plugin_t *cache = NULL;
+    const char **subdirs = NULL;
+    uint32_t dirs;
+
+    /* Check the browsed directories (for additions and removals) */
+    LOAD_IMMEDIATE(dirs);
+
+    /* Each directory takes at least a string length and a time */
+    if (dirs > file->i_buffer / (sizeof (uint16_t) + sizeof (int64_t)))
+        goto error;
+
+    bool same = dirs > 0 && unchanged != NULL;
+    bool base_changed = false;
+
+    if (same)
+    {
+        subdirs = malloc(dirs * sizeof (*subdirs));
+        if (unlikely(subdirs == NULL))
+            same = false;
+    }
+
+    for (uint32_t i = 0; i < dirs; i++)
+    {
+        const char *relpath;
+        int64_t mtime;
+        struct stat st;
+
+        LOAD_STRING(relpath);
+        LOAD_IMMEDIATE(mtime);
+
+        if (!same)
+            continue;
+
+        subdirs[i] = relpath;
+        if (relpath == NULL)
+        {   /* The base directory is checked against its entries, below */
+            if (vlc_stat(dir, &st))
+                same = false;
+            else if (vlc_cache_mtime(&st) != mtime)
+                base_changed = true;
+            continue;
+        }
+
+        char *abspath;
+
+        if (asprintf(&abspath, "%s" DIR_SEP "%s", dir, relpath) == -1)
+        {
+            same = false;
+            continue;
+        }
+
+        if (vlc_stat(abspath, &st) || vlc_cache_mtime(&st) != mtime)
+            same = false;
+        free(abspath);
+    }
 
     while (file->i_buffer > 0)
     {
@@ -458,11 +644,18 @@ vlc_plugin_t *vlc_cache_load(vlc_object_t *p_this, const char *dir,
         cache = plugin;
     }
 
+    if (same && base_changed)
+        same = vlc_cache_dir_known(dir, subdirs, dirs, cache);
+    free(subdirs);
+
     file->p_next = *backingp;
     *backingp = file;
+    if (unchanged != NULL)
+        *unchanged = same;
     return cache;
 
 error:
+    free(subdirs);
     msg_Warn( p_this, "plugins cache not loaded (corrupted)" );
 
     /* TODO: cleanup */
@@ -512,7 +705,8 @@ static int CacheSaveAlign(FILE *file, size_t align)
     if (CacheSaveAlign(file, alignof (t))) \
         goto error
 
-static int CacheSaveConfig (FILE *file, const module_config_t *cfg)
+static int CacheSaveConfig (FILE *file, const module_config_t *cfg,
+                            long *name)
 {
     SAVE_IMMEDIATE (cfg->i_type);
     SAVE_IMMEDIATE (cfg->i_short);
@@ -522,6 +716,7 @@ static int CacheSaveConfig (FILE *file, const module_config_t *cfg)
     SAVE_FLAG (cfg->b_safe);
     SAVE_FLAG (cfg->b_removed);
     SAVE_STRING (cfg->psz_type);
+    *name = ftell (file) + sizeof (uint16_t);
     SAVE_STRING (cfg->psz_name);
     SAVE_STRING (cfg->psz_text);
     SAVE_STRING (cfg->psz_longtext);
@@ -560,18 +755,71 @@ error:
     return -1;
 }
 
-static int CacheSaveModuleConfig(FILE *file, const vlc_plugin_t *plugin)
+static int CacheSaveModuleConfig(FILE *file, vlc_plugin_t *plugin)
 {
+    const module_config_t *items = vlc_plugin_get_config(plugin);
     uint16_t lines = plugin->conf.size;
+    uint16_t count = plugin->conf.count;
+    uint16_t booleans = plugin->conf.booleans;
+    uint32_t size = 0;
+
+    if (lines > 0 && items == NULL)
+        return -1;
+
+    struct vlc_cache_option *opts = malloc(count * sizeof (*opts) + 1);
+    if (unlikely(opts == NULL))
+        return -1;
 
     SAVE_IMMEDIATE (lines);
+    SAVE_IMMEDIATE (count);
+    SAVE_IMMEDIATE (booleans);
+
+    /* Serialized items, then the options table to look them up by name */
+    long size_offset = ftell(file);
+    SAVE_IMMEDIATE (size);
+
+    long base = ftell(file);
+    size_t n = 0;
 
     for (size_t i = 0; i < lines; i++)
-        if (CacheSaveConfig(file, plugin->conf.items + i))
+    {
+        const module_config_t *item = items + i;
+        long name;
+
+        if (CacheSaveConfig(file, item, &name))
            goto error;
 
+        if (CONFIG_ITEM(item->i_type))
+        {
+            assert(n < count);
+            opts[n].name = name - base;
+            opts[n].index = i;
+            opts[n].type = item->i_type;
+            opts[n].shortcut = item->i_short;
+            n++;
+        }
+    }
+    assert(n == count);
+
+    if (fputc('\0', file) == EOF)
+        goto error;
+
+    /* Fill in the size of the serialized items */
+    size = ftell(file) - base;
+    if (fseek(file, size_offset, SEEK_SET))
+        goto error;
+    SAVE_IMMEDIATE (size);
+    if (fseek(file, base + size, SEEK_SET))
+        goto error;
+
+    SAVE_ALIGNOF (struct vlc_cache_option);
+    if (fwrite(opts, sizeof (*opts), count, file) != count)
+        goto error;
+
+    free(opts);
     return 0;
 error:
+    free(opts);
     return -1;
 }
 
@@ -594,7 +842,8 @@ error:
     return -1;
 }
 
-static int CacheSaveBank(FILE *file, vlc_plugin_t *const *cache, size_t n)
+static int CacheSaveBank(FILE *file, vlc_plugin_t *const *cache, size_t n,
+                         const struct vlc_cache_dir *dirs, size_t ndirs)
 {
     uint32_t i_file_size = 0;
 
@@ -617,9 +866,20 @@ static int CacheSaveBank(FILE *file, vlc_plugin_t *const *cache, size_t n)
     if (fwrite (&i_file_size, sizeof (i_file_size), 1, file) != 1)
         goto error;
 
+    /* Browsed directories */
+    uint32_t dircount = ndirs;
+
+    SAVE_IMMEDIATE(dircount);
+
+    for (size_t i = 0; i < ndirs; i++)
+    {
+        SAVE_STRING(dirs[i].path[0] ? dirs[i].path : NULL);
+        SAVE_IMMEDIATE(dirs[i].mtime);
+    }
+
     for (size_t i = 0; i < n; i++)
     {
-        const vlc_plugin_t *plugin = cache[i];
+        vlc_plugin_t *plugin = cache[i];
         uint32_t count = plugin->modules_count;
 
         SAVE_IMMEDIATE(count);
@@ -654,7 +914,8 @@ error:
  * Saves a module cache to disk, and release cache data from memory.
  */
 void CacheSave(vlc_object_t *p_this, const char *dir,
-               vlc_plugin_t *const *entries, size_t n)
+               vlc_plugin_t *const *entries, size_t n,
+               const struct vlc_cache_dir *dirs, size_t ndirs)
 {
     char *filename = NULL, *tmpname = NULL;
 
@@ -674,7 +935,7 @@ void CacheSave(vlc_object_t *p_this, const char *dir,
         goto out;
     }
 
-    if (CacheSaveBank(file, entries, n))
+    if (CacheSaveBank(file, entries, n, dirs, ndirs))
     {
         msg_Warn (p_this, "cannot write %s: %s", tmpname,
                   vlc_strerror_c(errno));
@@ -685,8 +946,15 @@ void CacheSave(vlc_object_t *p_this, const char *dir,
     }
 
 #if !defined( _WIN32 ) && !defined( __OS2__ )
+    if (fclose (file))
+    {
+        msg_Warn (p_this, "cannot write %s: %s", tmpname,
+                  vlc_strerror_c(errno));
+        vlc_unlink (tmpname);
+        goto out;
+    }
+
     vlc_rename (tmpname, filename); /* atomically replace old cache */
-    fclose (file);
 #else
     vlc_unlink (filename);
     fclose (file);
@@ -105,6 +105,10 @@ vlc_plugin_t *vlc_plugin_create(void)
     plugin->conf.count = 0;
     plugin->conf.booleans = 0;
 #ifdef HAVE_DYNAMIC_PLUGINS
+    atomic_init(&plugin->conf.loaded, true);
+    plugin->conf.options = NULL;
+    plugin->conf.data = NULL;
+    plugin->conf.data_size = 0;
     plugin->abspath = NULL;
     atomic_init(&plugin->loaded, false);
     plugin->unloadable = true;
@@ -132,7 +136,8 @@ void vlc_plugin_destroy(vlc_plugin_t *plugin)
     if (plugin->module != NULL)
         vlc_module_destroy(plugin->module);
 
-    config_Free(plugin->conf.items, plugin->conf.size);
+    if (plugin->conf.items != NULL)
+        config_Free(plugin->conf.items, plugin->conf.size);
 #ifdef HAVE_DYNAMIC_PLUGINS
     free(plugin->abspath);
     free(plugin->path);
@@ -609,9 +614,11 @@ int vlc_plugin_resolve(vlc_plugin_t *plugin, vlc_plugin_cb entry)
     }
 
     /* Resolve configuration callbacks */
-    for (size_t i = 0; i < plugin->conf.size; i++)
+    module_config_t *items = vlc_plugin_get_config(plugin);
+
+    for (size_t i = 0; items != NULL && i < plugin->conf.size; i++)
     {
-        module_config_t *item = plugin->conf.items + i;
+        module_config_t *item = items + i;
         void *cb;
 
         if (item->list_cb_name == NULL)
@@ -420,7 +420,7 @@ bool module_exists (const char * psz_name)
  */
 module_config_t *module_config_get( const module_t *module, unsigned *restrict psize )
 {
-    const vlc_plugin_t *plugin = module->plugin;
+    vlc_plugin_t *plugin = module->plugin;
 
     if (plugin->module != module)
     {   /* For backward compatibility, pretend non-first modules have no
@@ -430,7 +430,8 @@ module_config_t *module_config_get( const module_t *module, unsigned *restrict p
     }
 
     unsigned i,j;
-    size_t size = plugin->conf.size;
+    const module_config_t *items = vlc_plugin_get_config( plugin );
+    size_t size = (items != NULL) ? plugin->conf.size : 0;
     module_config_t *config = malloc( size * sizeof( *config ) );
 
     assert( psize != NULL );
@@ -441,7 +442,7 @@ module_config_t *module_config_get( const module_t *module, unsigned *restrict p
 
     for( i = 0, j = 0; i < size; i++ )
     {
-        const module_config_t *item = plugin->conf.items + i;
+        const module_config_t *item = items + i;
         if( item->b_internal /* internal option */
          || item->b_removed /* removed option */ )
             continue;
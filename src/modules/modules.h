@@ -29,6 +29,18 @@
 /** The plugin handle type */
 typedef void *module_handle_t;
 
+/**
+ * Configuration item summary from the plugins cache: enough to index the
+ * items by name and to parse the command line before they are loaded.
+ */
+struct vlc_cache_option
+{
+    uint32_t name; /**< Offset of the name in the serialized items */
+    uint16_t index; /**< Index of the item in the plug-in table */
+    uint8_t type; /**< Item type */
+    char shortcut; /**< Short option name (or 0) */
+};
+
 /** VLC plugin */
 typedef struct vlc_plugin_t
 {
@@ -47,6 +59,13 @@ typedef struct vlc_plugin_t
         size_t size; /**< Size of items table */
         size_t count; /**< Number of configuration items */
         size_t booleans; /**< Number of booleal config items */
+#ifdef HAVE_DYNAMIC_PLUGINS
+        /* Items from the plugins cache are loaded on first use */
+        atomic_bool loaded; /**< Whether the items table is loaded */
+        const struct vlc_cache_option *options; /**< Summaries (count) */
+        const uint8_t *data; /**< Serialized items (in the cache file) */
+        size_t data_size; /**< Size of the serialized items */
+#endif
     } conf;
 
 #ifdef HAVE_DYNAMIC_PLUGINS
@@ -127,9 +146,30 @@ void *module_Lookup (module_handle_t, const char *);
 void module_Unload (module_handle_t);
 
 /* Plugins cache */
-vlc_plugin_t *vlc_cache_load(vlc_object_t *, const char *, block_t **);
+/** Scanned plug-ins directory */
+struct vlc_cache_dir
+{
+    char *path; /**< Relative path (empty for the base directory) */
+    int64_t mtime; /**< Last modification time (see vlc_cache_mtime()) */
+};
+
+struct stat;
+int64_t vlc_cache_mtime(const struct stat *);
+
+vlc_plugin_t *vlc_cache_load(vlc_object_t *, const char *, block_t **,
+                             bool *);
 vlc_plugin_t *vlc_cache_lookup(vlc_plugin_t **, const char *relpath);
 
-void CacheSave(vlc_object_t *, const char *, vlc_plugin_t *const *, size_t);
+void CacheSave(vlc_object_t *, const char *, vlc_plugin_t *const *, size_t,
+               const struct vlc_cache_dir *, size_t);
+
+#ifdef HAVE_DYNAMIC_PLUGINS
+module_config_t *vlc_plugin_get_config(vlc_plugin_t *);
+#else
+static inline module_config_t *vlc_plugin_get_config(vlc_plugin_t *plugin)
+{
+    return plugin->conf.items;
+}
+#endif
 
 #endif /* !LIBVLC_MODULES_H */
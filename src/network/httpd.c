@@ -40,6 +40,8 @@
 #include <vlc_url.h>
 #include <vlc_mime.h>
 #include <vlc_block.h>
+#include <vlc_fs.h>
+#include <vlc_atomic.h>
 #include "../libvlc.h"
 
 #include <string.h>
@@ -49,6 +51,10 @@
 #ifdef HAVE_POLL
 # include <poll.h>
 #endif
+#ifdef HAVE_EPOLL_CREATE1
+# include <sys/epoll.h>
+# include <sys/eventfd.h>
+#endif
 
 #if defined(_WIN32)
 #   include <winsock2.h>
@@ -63,10 +69,44 @@
 #define HTTPD_CL_BUFSIZE 10000
 #endif
 
+#ifdef HAVE_EPOLL_CREATE1
+/* Maximum number of client worker threads per host (bits of a mask) */
+# define HTTPD_WORKERS_MAX 16
+/* Maximum number of events handled per wakeup */
+# define HTTPD_EPOLL_EVENTS 64
+#endif
+
+/* Maximum number of stream buffers sent at once */
+#define HTTPD_STREAM_IOVECS 64
+
+typedef struct httpd_stream_buffer_t httpd_stream_buffer_t;
+
 static void httpd_ClientDestroy(httpd_client_t *cl);
-static void httpd_AppendData(httpd_stream_t *stream, uint8_t *p_data, int i_data);
 
-/* each host run in his own thread */
+/* each worker thread serves its own set of clients */
+typedef struct
+{
+    httpd_host_t *host;
+
+    vlc_thread_t thread;
+    vlc_mutex_t  lock;
+
+    int            i_client;
+    httpd_client_t **client;
+
+#ifdef HAVE_EPOLL_CREATE1
+    int         epfd;
+    int         wakefd; /* signaled when stream data comes for waiting clients */
+    mtime_t     i_next_pass; /* date of the next timeouts check */
+    mtime_t     i_next_wait; /* date of the next check of the waiting clients */
+
+    /* clients not polled for any socket event */
+    int            i_waiting;
+    httpd_client_t **waiting;
+#endif
+} httpd_worker_t;
+
+/* each host run in his own thread(s) */
 struct httpd_host_t
 {
     VLC_COMMON_MEMBERS
@@ -79,7 +119,6 @@ struct httpd_host_t
     unsigned     nfd;
     unsigned     port;
 
-    vlc_thread_t thread;
     vlc_mutex_t lock;
     vlc_cond_t  wait;
 
@@ -90,8 +129,11 @@ struct httpd_host_t
     int         i_url;
     httpd_url_t **url;
 
-    int            i_client;
-    httpd_client_t **client;
+    /* the first worker also accepts the new connections
+     * (lock order: worker then host) */
+    unsigned        i_worker;
+    httpd_worker_t *worker;
+    unsigned        i_next_worker;
 
     /* TLS data */
     vlc_tls_creds_t *p_tls;
@@ -171,6 +213,15 @@ struct httpd_client_t
 
     /* TLS data */
     vlc_tls_t *p_tls;
+
+    /* stream data, sent straight from the stream buffers */
+    httpd_stream_t        *stream;
+    httpd_stream_buffer_t *p_sbuf; /* buffer of the next data to send */
+
+#ifdef HAVE_EPOLL_CREATE1
+    uint32_t i_events; /* events registered with the worker epoll */
+    unsigned i_worker; /* index of the worker serving the client */
+#endif
 };
 
 
@@ -592,6 +643,28 @@ void httpd_RedirectDelete(httpd_redirect_t *rdir)
 /*****************************************************************************
  * High Level Funtions: httpd_stream_t
  *****************************************************************************/
+/* Stream data, shared by all the clients */
+struct httpd_stream_buffer_t
+{
+    atomic_uint refs; /* stream + clients sending it */
+    httpd_stream_buffer_t *p_next; /* newer data, under the stream lock */
+    int64_t     i_pos; /* absolute position from beginning */
+    size_t      i_size;
+    uint8_t     p_data[];
+};
+
+static httpd_stream_buffer_t *httpd_StreamBufferHold(httpd_stream_buffer_t *buf)
+{
+    atomic_fetch_add(&buf->refs, 1);
+    return buf;
+}
+
+static void httpd_StreamBufferRelease(httpd_stream_buffer_t *buf)
+{
+    if (atomic_fetch_sub(&buf->refs, 1) == 1)
+        free(buf);
+}
+
 struct httpd_stream_t
 {
     vlc_mutex_t lock;
@@ -611,15 +684,22 @@ struct httpd_stream_t
     bool        b_has_keyframes;
     int64_t     i_last_keyframe_seen_pos;
 
-    /* circular buffer */
-    int         i_buffer_size;      /* buffer size, can't be reallocated smaller */
-    uint8_t     *p_buffer;          /* buffer */
+    /* chain of the last buffers, read by all clients */
+    size_t      i_buffer_size;      /* maximum size of the chain */
+    size_t      i_buffer;           /* current size of the chain */
+    httpd_stream_buffer_t *p_first;
+    httpd_stream_buffer_t *p_last;
     int64_t     i_buffer_pos;       /* absolute position from beginning */
     int64_t     i_buffer_last_pos;  /* a new connection will start with that */
 
     /* custom headers */
     size_t        i_http_headers;
     httpd_header * p_http_headers;
+
+#ifdef HAVE_EPOLL_CREATE1
+    /* workers with clients waiting for data (mask of worker indices) */
+    unsigned    i_waiters;
+#endif
 };
 
 static int httpd_StreamCallBack(httpd_callback_sys_t *p_sys,
@@ -632,47 +712,8 @@ static int httpd_StreamCallBack(httpd_callback_sys_t *p_sys,
         return VLC_SUCCESS;
 
     if (answer->i_body_offset > 0) {
-        int     i_pos;
-
-        if (answer->i_body_offset >= stream->i_buffer_pos)
-            return VLC_EGENERIC;    /* wait, no data available */
-
-        if (cl->i_keyframe_wait_to_pass >= 0) {
-            if (stream->i_last_keyframe_seen_pos <= cl->i_keyframe_wait_to_pass)
-                /* still waiting for the next keyframe */
-                return VLC_EGENERIC;
-
-            /* seek to the new keyframe */
-            answer->i_body_offset = stream->i_last_keyframe_seen_pos;
-            cl->i_keyframe_wait_to_pass = -1;
-        }
-
-        if (answer->i_body_offset + stream->i_buffer_size < stream->i_buffer_pos)
-            answer->i_body_offset = stream->i_buffer_last_pos; /* this client isn't fast enough */
-
-        i_pos   = answer->i_body_offset % stream->i_buffer_size;
-        int64_t i_write = stream->i_buffer_pos - answer->i_body_offset;
-
-        if (i_write > HTTPD_CL_BUFSIZE)
-            i_write = HTTPD_CL_BUFSIZE;
-        else if (i_write <= 0)
-            return VLC_EGENERIC;    /* wait, no data available */
-
-        /* Don't go past the end of the circular buffer */
-        i_write = __MIN(i_write, stream->i_buffer_size - i_pos);
-
-        /* using HTTPD_MSG_ANSWER -> data available */
-        answer->i_proto  = HTTPD_PROTO_HTTP;
-        answer->i_version= 0;
-        answer->i_type   = HTTPD_MSG_ANSWER;
-
-        answer->i_body = i_write;
-        answer->p_body = xmalloc(i_write);
-        memcpy(answer->p_body, &stream->p_buffer[i_pos], i_write);
-
-        answer->i_body_offset += i_write;
-
-        return VLC_SUCCESS;
+        /* data are sent by httpd_ClientSendStream() */
+        return VLC_EGENERIC;
     } else {
         answer->i_proto  = HTTPD_PROTO_HTTP;
         answer->i_version= 0;
@@ -698,6 +739,7 @@ static int httpd_StreamCallBack(httpd_callback_sys_t *p_sys,
 
         if (query->i_type != HTTPD_MSG_HEAD) {
             cl->b_stream_mode = true;
+            cl->stream = stream;
             vlc_mutex_lock(&stream->lock);
             /* Send the header */
             if (stream->i_header > 0) {
@@ -766,7 +808,9 @@ httpd_stream_t *httpd_StreamNew(httpd_host_t *host,
     stream->i_header = 0;
     stream->p_header = NULL;
     stream->i_buffer_size = 5000000;    /* 5 Mo per stream */
-    stream->p_buffer = xmalloc(stream->i_buffer_size);
+    stream->i_buffer = 0;
+    stream->p_first = NULL;
+    stream->p_last = NULL;
     /* We set to 1 to make life simpler
      * (this way i_body_offset can never be 0) */
     stream->i_buffer_pos = 1;
@@ -775,6 +819,9 @@ httpd_stream_t *httpd_StreamNew(httpd_host_t *host,
     stream->i_last_keyframe_seen_pos = 0;
     stream->i_http_headers = 0;
     stream->p_http_headers = NULL;
+#ifdef HAVE_EPOLL_CREATE1
+    stream->i_waiters = 0;
+#endif
 
     httpd_UrlCatch(stream->url, HTTPD_MSG_HEAD, httpd_StreamCallBack,
                     (httpd_callback_sys_t*)stream);
@@ -802,29 +849,21 @@ int httpd_StreamHeader(httpd_stream_t *stream, uint8_t *p_data, int i_data)
     return VLC_SUCCESS;
 }
 
-static void httpd_AppendData(httpd_stream_t *stream, uint8_t *p_data, int i_data)
-{
-    int i_pos = stream->i_buffer_pos % stream->i_buffer_size;
-    int i_count = i_data;
-    while (i_count > 0) {
-        int i_copy = __MIN(i_count, stream->i_buffer_size - i_pos);
-
-        /* Ok, we can't go past the end of our buffer */
-        memcpy(&stream->p_buffer[i_pos], p_data, i_copy);
-
-        i_pos = (i_pos + i_copy) % stream->i_buffer_size;
-        i_count -= i_copy;
-        p_data  += i_copy;
-    }
-
-    stream->i_buffer_pos += i_data;
-}
-
 int httpd_StreamSend(httpd_stream_t *stream, const block_t *p_block)
 {
-    if (!p_block || !p_block->p_buffer)
+    if (!p_block || !p_block->p_buffer || p_block->i_buffer == 0)
         return VLC_SUCCESS;
 
+    /* The data is copied once, then all clients send it from there */
+    httpd_stream_buffer_t *buf = malloc(sizeof (*buf) + p_block->i_buffer);
+    if (unlikely(buf == NULL))
+        return VLC_ENOMEM;
+
+    atomic_init(&buf->refs, 1);
+    buf->p_next = NULL;
+    buf->i_size = p_block->i_buffer;
+    memcpy(buf->p_data, p_block->p_buffer, p_block->i_buffer);
+
     vlc_mutex_lock(&stream->lock);
 
     /* save this pointer (to be used by new connection) */
@@ -835,9 +874,39 @@ int httpd_StreamSend(httpd_stream_t *stream, const block_t *p_block)
         stream->i_last_keyframe_seen_pos = stream->i_buffer_pos;
     }
 
-    httpd_AppendData(stream, p_block->p_buffer, p_block->i_buffer);
+    buf->i_pos = stream->i_buffer_pos;
+    if (stream->p_last != NULL)
+        stream->p_last->p_next = buf;
+    else
+        stream->p_first = buf;
+    stream->p_last = buf;
+    stream->i_buffer_pos += buf->i_size;
+    stream->i_buffer += buf->i_size;
+
+    /* Forget the oldest data, clients still sending it hold it */
+    while (stream->i_buffer > stream->i_buffer_size && stream->p_first != buf) {
+        httpd_stream_buffer_t *first = stream->p_first;
+
+        stream->p_first = first->p_next;
+        stream->i_buffer -= first->i_size;
+        httpd_StreamBufferRelease(first);
+    }
+
+#ifdef HAVE_EPOLL_CREATE1
+    unsigned waiters = stream->i_waiters;
 
+    stream->i_waiters = 0;
+#endif
     vlc_mutex_unlock(&stream->lock);
+
+#ifdef HAVE_EPOLL_CREATE1
+    /* Wake the workers of the clients waiting for this data up */
+    httpd_worker_t *worker = stream->url->host->worker;
+
+    for (; waiters != 0; waiters >>= 1, worker++)
+        if (waiters & 1)
+            eventfd_write(worker->wakefd, 1);
+#endif
     return VLC_SUCCESS;
 }
 
@@ -852,14 +921,20 @@ void httpd_StreamDelete(httpd_stream_t *stream)
     vlc_mutex_destroy(&stream->lock);
     free(stream->psz_mime);
     free(stream->p_header);
-    free(stream->p_buffer);
+    while (stream->p_first != NULL) {
+        httpd_stream_buffer_t *first = stream->p_first;
+
+        stream->p_first = first->p_next;
+        httpd_StreamBufferRelease(first);
+    }
     free(stream);
 }
 
 /*****************************************************************************
  * Low level
  *****************************************************************************/
-static void* httpd_HostThread(void *);
+static int httpd_WorkersStart(httpd_host_t *);
+static void httpd_WorkersStop(httpd_host_t *, unsigned);
 static httpd_host_t *httpd_HostCreate(vlc_object_t *, const char *,
                                        const char *, vlc_tls_creds_t *);
 
@@ -970,14 +1045,11 @@ static httpd_host_t *httpd_HostCreate(vlc_object_t *p_this,
     host->port     = port;
     host->i_url    = 0;
     host->url      = NULL;
-    host->i_client = 0;
-    host->client   = NULL;
     host->p_tls    = p_tls;
 
-    /* create the thread */
-    if (vlc_clone(&host->thread, httpd_HostThread, host,
-                   VLC_THREAD_PRIORITY_LOW)) {
-        msg_Err(p_this, "cannot spawn http host thread");
+    /* create the threads */
+    if (httpd_WorkersStart(host)) {
+        msg_Err(p_this, "cannot spawn http host threads");
         goto error;
     }
 
@@ -1024,20 +1096,13 @@ void httpd_HostDelete(httpd_host_t *host)
     }
     TAB_REMOVE(httpd.i_host, httpd.host, host);
 
-    vlc_cancel(host->thread);
-    vlc_join(host->thread, NULL);
+    httpd_WorkersStop(host, host->i_worker);
 
     msg_Dbg(host, "HTTP host removed");
 
     for (int i = 0; i < host->i_url; i++)
         msg_Err(host, "url still registered: %s", host->url[i]->psz_url);
 
-    for (int i = 0; i < host->i_client; i++) {
-        msg_Warn(host, "client still connected");
-        httpd_ClientDestroy(host->client[i]);
-    }
-    TAB_CLEAN(host->i_client, host->client);
-
     vlc_tls_Delete(host->p_tls);
     net_ListenClose(host->fds);
     vlc_cond_destroy(&host->wait);
@@ -1100,26 +1165,34 @@ void httpd_UrlDelete(httpd_url_t *url)
 
     vlc_mutex_lock(&host->lock);
     TAB_REMOVE(host->i_url, host->url, url);
+    vlc_mutex_unlock(&host->lock);
 
-    vlc_mutex_destroy(&url->lock);
-    free(url->psz_url);
-    free(url->psz_user);
-    free(url->psz_password);
+    /* Once the url is not registered anymore, no new clients can use it */
+    for (unsigned i = 0; i < host->i_worker; i++) {
+        httpd_worker_t *worker = &host->worker[i];
 
-    for (int i = 0; i < host->i_client; i++) {
-        httpd_client_t *client = host->client[i];
+        vlc_mutex_lock(&worker->lock);
+        for (int j = 0; j < worker->i_client; j++) {
+            httpd_client_t *client = worker->client[j];
 
-        if (client->url != url)
-            continue;
+            if (client->url != url)
+                continue;
 
-        /* TODO complete it */
-        msg_Warn(host, "force closing connections");
-        TAB_REMOVE(host->i_client, host->client, client);
-        httpd_ClientDestroy(client);
-        i--;
+            /* TODO complete it */
+            msg_Warn(host, "force closing connections");
+            /* the worker destroys the client */
+            client->url = NULL;
+            client->stream = NULL;
+            client->i_state = HTTPD_CLIENT_DEAD;
+        }
+        vlc_mutex_unlock(&worker->lock);
     }
+
+    vlc_mutex_destroy(&url->lock);
+    free(url->psz_url);
+    free(url->psz_user);
+    free(url->psz_password);
     free(url);
-    vlc_mutex_unlock(&host->lock);
 }
 
 static void httpd_MsgInit(httpd_message_t *msg)
@@ -1226,6 +1299,8 @@ static void httpd_ClientDestroy(httpd_client_t *cl)
     httpd_MsgClean(&cl->answer);
     httpd_MsgClean(&cl->query);
 
+    if (cl->p_sbuf != NULL)
+        httpd_StreamBufferRelease(cl->p_sbuf);
     free(cl->p_buffer);
     free(cl);
 }
@@ -1240,6 +1315,12 @@ static httpd_client_t *httpd_ClientNew(int fd, vlc_tls_t *p_tls, mtime_t now)
     cl->fd      = fd;
     cl->url     = NULL;
     cl->p_tls = p_tls;
+    cl->stream  = NULL;
+    cl->p_sbuf  = NULL;
+#ifdef HAVE_EPOLL_CREATE1
+    cl->i_events = 0;
+    cl->i_worker = 0;
+#endif
 
     httpd_ClientInit(cl, now);
     if (p_tls)
@@ -1276,6 +1357,28 @@ ssize_t httpd_NetSend (httpd_client_t *cl, const uint8_t *p, size_t i_len)
     return val;
 }
 
+static
+ssize_t httpd_NetSendv (httpd_client_t *cl, const struct iovec *iov,
+                        unsigned count)
+{
+    vlc_tls_t *p_tls;
+    ssize_t val;
+
+    p_tls = cl->p_tls;
+    do
+        if (p_tls != NULL)
+            val = p_tls->writev (p_tls, iov, count);
+        else {
+            struct msghdr msg = {
+                .msg_iov = (struct iovec *)iov,
+                .msg_iovlen = count,
+            };
+            val = sendmsg (cl->fd, &msg, MSG_NOSIGNAL);
+        }
+    while (val == -1 && errno == EINTR);
+    return val;
+}
+
 
 static const struct
 {
@@ -1580,10 +1683,127 @@ static void httpd_ClientRecv(httpd_client_t *cl)
         cl->i_activity_timeout = 0;
 }
 
+/* Finds the next stream data to send to a client, if any */
+static bool httpd_ClientPullStream(httpd_client_t *cl)
+{
+    httpd_stream_t *stream = cl->stream;
+    httpd_stream_buffer_t *buf = cl->p_sbuf;
+    int64_t i_offset = cl->answer.i_body_offset;
+
+    vlc_mutex_lock(&stream->lock);
+    if (i_offset >= stream->i_buffer_pos)
+        goto wait;    /* wait, no data available */
+
+    if (cl->i_keyframe_wait_to_pass >= 0) {
+        if (stream->i_last_keyframe_seen_pos <= cl->i_keyframe_wait_to_pass)
+            /* still waiting for the next keyframe */
+            goto wait;
+
+        /* seek to the new keyframe */
+        i_offset = stream->i_last_keyframe_seen_pos;
+        cl->i_keyframe_wait_to_pass = -1;
+    }
+
+    /* Buffers are linked while in the stream only */
+    assert(stream->p_first != NULL);
+    if (buf != NULL && buf->i_pos < stream->p_first->i_pos)
+        buf = NULL;
+
+    if (i_offset < stream->p_first->i_pos) {
+        /* this client isn't fast enough, skip to the last keyframe */
+        if (stream->b_has_keyframes
+         && stream->i_last_keyframe_seen_pos >= stream->p_first->i_pos)
+            i_offset = stream->i_last_keyframe_seen_pos;
+        else
+            i_offset = stream->i_buffer_last_pos;
+    }
+
+    if (buf == NULL || buf->i_pos > i_offset)
+        buf = stream->p_first;
+    while (buf->i_pos + (int64_t)buf->i_size <= i_offset)
+        buf = buf->p_next;
+
+    if (buf != cl->p_sbuf) {
+        if (cl->p_sbuf != NULL)
+            httpd_StreamBufferRelease(cl->p_sbuf);
+        cl->p_sbuf = httpd_StreamBufferHold(buf);
+    }
+    vlc_mutex_unlock(&stream->lock);
+
+    cl->answer.i_body_offset = i_offset;
+    return true;
+wait:
+#ifdef HAVE_EPOLL_CREATE1
+    /* httpd_StreamSend() wakes the worker up */
+    stream->i_waiters |= 1u << cl->i_worker;
+#endif
+    vlc_mutex_unlock(&stream->lock);
+    return false;
+}
+
+/* Sends stream data to a client straight from the stream buffers */
+static void httpd_ClientSendStream(httpd_client_t *cl)
+{
+    httpd_stream_t *stream = cl->stream;
+    httpd_stream_buffer_t *bufs[HTTPD_STREAM_IOVECS];
+    struct iovec iov[HTTPD_STREAM_IOVECS];
+    size_t i_offset = cl->answer.i_body_offset - cl->p_sbuf->i_pos;
+    size_t i_total = 0;
+    unsigned count = 0;
+
+    /* Hold the buffers, the stream can forget them while sending */
+    vlc_mutex_lock(&stream->lock);
+    bool b_linked = cl->p_sbuf->i_pos >= stream->p_first->i_pos;
+
+    for (httpd_stream_buffer_t *buf = cl->p_sbuf;
+         buf != NULL && count < HTTPD_STREAM_IOVECS && i_total < HTTPD_CL_BUFSIZE;
+         buf = b_linked ? buf->p_next : NULL) {
+        bufs[count] = (count > 0) ? httpd_StreamBufferHold(buf) : buf;
+        iov[count].iov_base = buf->p_data + i_offset;
+        iov[count].iov_len = buf->i_size - i_offset;
+        i_total += iov[count].iov_len;
+        i_offset = 0;
+        count++;
+    }
+    vlc_mutex_unlock(&stream->lock);
+
+    ssize_t i_len = (i_total > 0) ? httpd_NetSendv(cl, iov, count) : 0;
+    if (i_len >= 0) {
+        int64_t i_end = cl->answer.i_body_offset + i_len;
+        unsigned i = 0;
+
+        /* keep the buffer of the next data to send */
+        while (i + 1 < count && bufs[i + 1]->i_pos <= i_end)
+            i++;
+        if (i > 0) {
+            httpd_StreamBufferRelease(cl->p_sbuf);
+            cl->p_sbuf = httpd_StreamBufferHold(bufs[i]);
+        }
+        cl->answer.i_body_offset = i_end;
+
+        if ((size_t)i_len == i_total)
+            cl->i_state = HTTPD_CLIENT_WAITING;
+    }
+#if defined(_WIN32)
+    else if (WSAGetLastError() != WSAEWOULDBLOCK)
+#else
+    else if (errno != EAGAIN)
+#endif
+        cl->i_state = HTTPD_CLIENT_DEAD;
+
+    for (unsigned i = 1; i < count; i++)
+        httpd_StreamBufferRelease(bufs[i]);
+}
+
 static void httpd_ClientSend(httpd_client_t *cl)
 {
     int i_len;
 
+    if (cl->p_sbuf != NULL) {
+        httpd_ClientSendStream(cl);
+        return;
+    }
+
     if (cl->i_buffer < 0) {
         /* We need to create the header */
         int i_size = 0;
@@ -1621,7 +1841,8 @@ static void httpd_ClientSend(httpd_client_t *cl)
         cl->i_buffer += i_len;
 
         if (cl->i_buffer >= cl->i_buffer_size) {
-            if (cl->answer.i_body == 0  && cl->answer.i_body_offset > 0) {
+            if (cl->answer.i_body == 0  && cl->answer.i_body_offset > 0
+             && cl->stream == NULL) {
                 /* catch more body data */
                 int     i_msg = cl->query.i_type;
                 int64_t i_offset = cl->answer.i_body_offset;
@@ -1709,276 +1930,488 @@ auth_failed:
     return false;
 }
 
-static void httpdLoop(httpd_host_t *host)
+/* Tells whether a client connection is over */
+static bool httpd_ClientIsDone(const httpd_client_t *cl, mtime_t now)
 {
-    struct pollfd ufd[host->nfd + host->i_client];
-    unsigned nfd;
-    for (nfd = 0; nfd < host->nfd; nfd++) {
-        ufd[nfd].fd = host->fds[nfd];
-        ufd[nfd].events = POLLIN;
-        ufd[nfd].revents = 0;
-    }
+    return cl->i_ref < 0 || (cl->i_ref == 0 &&
+            (cl->i_state == HTTPD_CLIENT_DEAD ||
+              (cl->i_activity_timeout > 0 &&
+                cl->i_activity_date+cl->i_activity_timeout < now)));
+}
 
-    /* add all socket that should be read/write and close dead connection */
-    while (host->i_url <= 0) {
-        mutex_cleanup_push(&host->lock);
-        vlc_cond_wait(&host->wait, &host->lock);
-        vlc_cleanup_pop();
-    }
+/* Runs the client state machine and returns the events to poll for.
+ * The worker lock is held; the host lock is taken to dispatch queries. */
+static short httpd_ClientProcess(httpd_host_t *host, httpd_client_t *cl)
+{
+    int64_t i_offset;
+
+    switch (cl->i_state) {
+        case HTTPD_CLIENT_RECEIVE_DONE: {
+            httpd_message_t *answer = &cl->answer;
+            httpd_message_t *query  = &cl->query;
+
+            httpd_MsgInit(answer);
+
+            /* Handle what we received */
+            switch (query->i_type) {
+                case HTTPD_MSG_ANSWER:
+                    cl->url     = NULL;
+                    cl->i_state = HTTPD_CLIENT_DEAD;
+                    break;
+
+                case HTTPD_MSG_OPTIONS:
+                    answer->i_type   = HTTPD_MSG_ANSWER;
+                    answer->i_proto  = query->i_proto;
+                    answer->i_status = 200;
+                    answer->i_body = 0;
+                    answer->p_body = NULL;
+
+                    httpd_MsgAdd(answer, "Server", "VLC/%s", VERSION);
+                    httpd_MsgAdd(answer, "Content-Length", "0");
+
+                    switch(query->i_proto) {
+                    case HTTPD_PROTO_HTTP:
+                        answer->i_version = 1;
+                        httpd_MsgAdd(answer, "Allow", "GET,HEAD,POST,OPTIONS");
+                        break;
 
-    mtime_t now = mdate();
-    bool b_low_delay = false;
+                    case HTTPD_PROTO_RTSP:
+                        answer->i_version = 0;
 
-    int canc = vlc_savecancel();
-    for (int i_client = 0; i_client < host->i_client; i_client++) {
-        int64_t i_offset;
-        httpd_client_t *cl = host->client[i_client];
-        if (cl->i_ref < 0 || (cl->i_ref == 0 &&
-                    (cl->i_state == HTTPD_CLIENT_DEAD ||
-                      (cl->i_activity_timeout > 0 &&
-                        cl->i_activity_date+cl->i_activity_timeout < now)))) {
-            TAB_REMOVE(host->i_client, host->client, cl);
-            i_client--;
-            httpd_ClientDestroy(cl);
-            continue;
+                        const char *p = httpd_MsgGet(query, "Cseq");
+                        if (p)
+                            httpd_MsgAdd(answer, "Cseq", "%s", p);
+                        p = httpd_MsgGet(query, "Timestamp");
+                        if (p)
+                            httpd_MsgAdd(answer, "Timestamp", "%s", p);
+
+                        p = httpd_MsgGet(query, "Require");
+                        if (p) {
+                            answer->i_status = 551;
+                            httpd_MsgAdd(query, "Unsupported", "%s", p);
+                        }
+
+                        httpd_MsgAdd(answer, "Public", "DESCRIBE,SETUP,"
+                                "TEARDOWN,PLAY,PAUSE,GET_PARAMETER");
+                        break;
+                    }
+
+                    cl->i_buffer = -1;  /* Force the creation of the answer in
+                                         * httpd_ClientSend */
+                    cl->i_state = HTTPD_CLIENT_SENDING;
+                    break;
+
+                case HTTPD_MSG_NONE:
+                    if (query->i_proto == HTTPD_PROTO_NONE) {
+                        cl->url = NULL;
+                        cl->i_state = HTTPD_CLIENT_DEAD;
+                    } else {
+                        /* unimplemented */
+                        answer->i_proto  = query->i_proto ;
+                        answer->i_type   = HTTPD_MSG_ANSWER;
+                        answer->i_version= 0;
+                        answer->i_status = 501;
+
+                        char *p;
+                        answer->i_body = httpd_HtmlError (&p, 501, NULL);
+                        answer->p_body = (uint8_t *)p;
+                        httpd_MsgAdd(answer, "Content-Length", "%d", answer->i_body);
+
+                        cl->i_buffer = -1;  /* Force the creation of the answer in httpd_ClientSend */
+                        cl->i_state = HTTPD_CLIENT_SENDING;
+                    }
+                    break;
+
+                default: {
+                    int i_msg = query->i_type;
+                    bool b_auth_failed = false;
+
+                    /* Search the url and trigger callbacks */
+                    vlc_mutex_lock(&host->lock);
+                    for (int i = 0; i < host->i_url; i++) {
+                        httpd_url_t *url = host->url[i];
+
+                        if (strcmp(url->psz_url, query->psz_url))
+                            continue;
+                        if (!url->catch[i_msg].cb)
+                            continue;
+
+                        if (answer) {
+                            b_auth_failed = !httpdAuthOk(url->psz_user,
+                               url->psz_password,
+                               httpd_MsgGet(query, "Authorization")); /* BASIC id */
+                            if (b_auth_failed)
+                               break;
+                        }
+
+                        if (url->catch[i_msg].cb(url->catch[i_msg].p_sys, cl, answer, query))
+                            continue;
+
+                        if (answer->i_proto == HTTPD_PROTO_NONE)
+                            cl->i_buffer = cl->i_buffer_size; /* Raw answer from a CGI */
+                        else
+                            cl->i_buffer = -1;
+
+                        /* only one url can answer */
+                        answer = NULL;
+                        if (!cl->url)
+                            cl->url = url;
+                    }
+                    vlc_mutex_unlock(&host->lock);
+
+                    if (answer) {
+                        answer->i_proto  = query->i_proto;
+                        answer->i_type   = HTTPD_MSG_ANSWER;
+                        answer->i_version= 0;
+
+                       if (b_auth_failed) {
+                            httpd_MsgAdd(answer, "WWW-Authenticate",
+                                    "Basic realm=\"VLC stream\"");
+                            answer->i_status = 401;
+                        } else
+                            answer->i_status = 404; /* no url registered */
+
+                        char *p;
+                        answer->i_body = httpd_HtmlError (&p, answer->i_status,
+                                query->psz_url);
+                        answer->p_body = (uint8_t *)p;
+
+                        cl->i_buffer = -1;  /* Force the creation of the answer in httpd_ClientSend */
+                        httpd_MsgAdd(answer, "Content-Length", "%d", answer->i_body);
+                        httpd_MsgAdd(answer, "Content-Type", "%s", "text/html");
+                    }
+
+                    cl->i_state = HTTPD_CLIENT_SENDING;
+                }
+            }
+            break;
         }
 
-        struct pollfd *pufd = ufd + nfd;
-        assert (pufd < ufd + (sizeof (ufd) / sizeof (ufd[0])));
+        case HTTPD_CLIENT_SEND_DONE:
+            if (!cl->b_stream_mode || cl->answer.i_body_offset == 0) {
+                const char *psz_connection = httpd_MsgGet(&cl->answer, "Connection");
+                const char *psz_query = httpd_MsgGet(&cl->query, "Connection");
+                bool b_connection = false;
+                bool b_keepalive = false;
+                bool b_query = false;
+
+                cl->url = NULL;
+                if (psz_connection) {
+                    b_connection = (strcasecmp(psz_connection, "Close") == 0);
+                    b_keepalive = (strcasecmp(psz_connection, "Keep-Alive") == 0);
+                }
 
-        pufd->fd = cl->fd;
-        pufd->events = pufd->revents = 0;
+                if (psz_query)
+                    b_query = (strcasecmp(psz_query, "Close") == 0);
 
-        switch (cl->i_state) {
-            case HTTPD_CLIENT_RECEIVING:
-            case HTTPD_CLIENT_TLS_HS_IN:
-                pufd->events = POLLIN;
-                break;
+                if (((cl->query.i_proto == HTTPD_PROTO_HTTP) &&
+                            ((cl->query.i_version == 0 && b_keepalive) ||
+                              (cl->query.i_version == 1 && !b_connection))) ||
+                        ((cl->query.i_proto == HTTPD_PROTO_RTSP) &&
+                          !b_query && !b_connection)) {
+                    httpd_MsgClean(&cl->query);
+                    httpd_MsgInit(&cl->query);
+
+                    cl->i_buffer = 0;
+                    cl->i_buffer_size = 1000;
+                    free(cl->p_buffer);
+                    cl->p_buffer = xmalloc(cl->i_buffer_size);
+                    cl->i_state = HTTPD_CLIENT_RECEIVING;
+                } else
+                    cl->i_state = HTTPD_CLIENT_DEAD;
+                httpd_MsgClean(&cl->answer);
+            } else {
+                i_offset = cl->answer.i_body_offset;
+                httpd_MsgClean(&cl->answer);
 
-            case HTTPD_CLIENT_SENDING:
-            case HTTPD_CLIENT_TLS_HS_OUT:
-                pufd->events = POLLOUT;
+                cl->answer.i_body_offset = i_offset;
+                free(cl->p_buffer);
+                cl->p_buffer = NULL;
+                cl->i_buffer = 0;
+                cl->i_buffer_size = 0;
+
+                cl->i_state = HTTPD_CLIENT_WAITING;
+            }
+            break;
+
+        case HTTPD_CLIENT_WAITING:
+            if (cl->stream != NULL) {
+                if (httpd_ClientPullStream(cl))
+                    cl->i_state = HTTPD_CLIENT_SENDING;
                 break;
+            }
 
-            case HTTPD_CLIENT_RECEIVE_DONE: {
-                httpd_message_t *answer = &cl->answer;
-                httpd_message_t *query  = &cl->query;
+            i_offset = cl->answer.i_body_offset;
+            int i_msg = cl->query.i_type;
 
-                httpd_MsgInit(answer);
+            httpd_MsgInit(&cl->answer);
+            cl->answer.i_body_offset = i_offset;
 
-                /* Handle what we received */
-                switch (query->i_type) {
-                    case HTTPD_MSG_ANSWER:
-                        cl->url     = NULL;
-                        cl->i_state = HTTPD_CLIENT_DEAD;
-                        break;
+            cl->url->catch[i_msg].cb(cl->url->catch[i_msg].p_sys, cl,
+                    &cl->answer, &cl->query);
+            if (cl->answer.i_type != HTTPD_MSG_NONE) {
+                /* we have new data, so re-enter send mode */
+                cl->i_buffer      = 0;
+                cl->p_buffer      = cl->answer.p_body;
+                cl->i_buffer_size = cl->answer.i_body;
+                cl->answer.p_body = NULL;
+                cl->answer.i_body = 0;
+                cl->i_state = HTTPD_CLIENT_SENDING;
+            }
+            break;
+    }
 
-                    case HTTPD_MSG_OPTIONS:
-                        answer->i_type   = HTTPD_MSG_ANSWER;
-                        answer->i_proto  = query->i_proto;
-                        answer->i_status = 200;
-                        answer->i_body = 0;
-                        answer->p_body = NULL;
+    switch (cl->i_state) {
+        case HTTPD_CLIENT_RECEIVING:
+        case HTTPD_CLIENT_TLS_HS_IN:
+            return POLLIN;
 
-                        httpd_MsgAdd(answer, "Server", "VLC/%s", VERSION);
-                        httpd_MsgAdd(answer, "Content-Length", "0");
+        case HTTPD_CLIENT_SENDING:
+        case HTTPD_CLIENT_TLS_HS_OUT:
+            return POLLOUT;
+    }
+    return 0;
+}
 
-                        switch(query->i_proto) {
-                        case HTTPD_PROTO_HTTP:
-                            answer->i_version = 1;
-                            httpd_MsgAdd(answer, "Allow", "GET,HEAD,POST,OPTIONS");
-                            break;
+/* Handles a poll event of a client */
+static void httpd_ClientIO(httpd_host_t *host, httpd_client_t *cl, mtime_t now)
+{
+    cl->i_activity_date = now;
 
-                        case HTTPD_PROTO_RTSP:
-                            answer->i_version = 0;
+    switch (cl->i_state) {
+        case HTTPD_CLIENT_RECEIVING: httpd_ClientRecv(cl); break;
+        case HTTPD_CLIENT_SENDING:   httpd_ClientSend(cl); break;
+        case HTTPD_CLIENT_TLS_HS_IN:
+        case HTTPD_CLIENT_TLS_HS_OUT:
+            httpd_ClientTlsHandshake(host, cl);
+            break;
+    }
+}
 
-                            const char *p = httpd_MsgGet(query, "Cseq");
-                            if (p)
-                                httpd_MsgAdd(answer, "Cseq", "%s", p);
-                            p = httpd_MsgGet(query, "Timestamp");
-                            if (p)
-                                httpd_MsgAdd(answer, "Timestamp", "%s", p);
+/* Accepts a new connection on a listening socket */
+static httpd_client_t *httpd_ClientAccept(httpd_host_t *host, int fd,
+                                          mtime_t now)
+{
+    fd = vlc_accept (fd, NULL, NULL, true);
+    if (fd == -1)
+        return NULL;
+    setsockopt (fd, SOL_SOCKET, SO_REUSEADDR,
+            &(int){ 1 }, sizeof(int));
 
-                            p = httpd_MsgGet(query, "Require");
-                            if (p) {
-                                answer->i_status = 551;
-                                httpd_MsgAdd(query, "Unsupported", "%s", p);
-                            }
+    vlc_tls_t *p_tls;
 
-                            httpd_MsgAdd(answer, "Public", "DESCRIBE,SETUP,"
-                                    "TEARDOWN,PLAY,PAUSE,GET_PARAMETER");
-                            break;
-                        }
+    if (host->p_tls != NULL)
+    {
+        const char *alpn[] = { "http/1.1", NULL };
 
-                        cl->i_buffer = -1;  /* Force the creation of the answer in
-                                             * httpd_ClientSend */
-                        cl->i_state = HTTPD_CLIENT_SENDING;
-                        break;
+        p_tls = vlc_tls_ServerSessionCreate(host->p_tls, fd, alpn);
+    }
+    else
+        p_tls = NULL;
 
-                    case HTTPD_MSG_NONE:
-                        if (query->i_proto == HTTPD_PROTO_NONE) {
-                            cl->url = NULL;
-                            cl->i_state = HTTPD_CLIENT_DEAD;
-                        } else {
-                            /* unimplemented */
-                            answer->i_proto  = query->i_proto ;
-                            answer->i_type   = HTTPD_MSG_ANSWER;
-                            answer->i_version= 0;
-                            answer->i_status = 501;
-
-                            char *p;
-                            answer->i_body = httpd_HtmlError (&p, 501, NULL);
-                            answer->p_body = (uint8_t *)p;
-                            httpd_MsgAdd(answer, "Content-Length", "%d", answer->i_body);
-
-                            cl->i_buffer = -1;  /* Force the creation of the answer in httpd_ClientSend */
-                            cl->i_state = HTTPD_CLIENT_SENDING;
-                        }
-                        break;
+    httpd_client_t *cl = httpd_ClientNew(fd, p_tls, now);
+    if (unlikely(cl == NULL)) {
+        if (p_tls != NULL)
+            vlc_tls_Close(p_tls);
+        else
+            net_Close(fd);
+    }
+    return cl;
+}
 
-                    default: {
-                        int i_msg = query->i_type;
-                        bool b_auth_failed = false;
-
-                        /* Search the url and trigger callbacks */
-                        for (int i = 0; i < host->i_url; i++) {
-                            httpd_url_t *url = host->url[i];
-
-                            if (strcmp(url->psz_url, query->psz_url))
-                                continue;
-                            if (!url->catch[i_msg].cb)
-                                continue;
-
-                            if (answer) {
-                                b_auth_failed = !httpdAuthOk(url->psz_user,
-                                   url->psz_password,
-                                   httpd_MsgGet(query, "Authorization")); /* BASIC id */
-                                if (b_auth_failed)
-                                   break;
-                            }
-
-                            if (url->catch[i_msg].cb(url->catch[i_msg].p_sys, cl, answer, query))
-                                continue;
-
-                            if (answer->i_proto == HTTPD_PROTO_NONE)
-                                cl->i_buffer = cl->i_buffer_size; /* Raw answer from a CGI */
-                            else
-                                cl->i_buffer = -1;
-
-                            /* only one url can answer */
-                            answer = NULL;
-                            if (!cl->url)
-                                cl->url = url;
-                        }
+#ifdef HAVE_EPOLL_CREATE1
+/* Runs the state machine of a client, destroys it if it is over, and
+ * updates the events it is watched for. Returns false if destroyed. */
+static bool httpd_ClientUpdate(httpd_worker_t *worker, httpd_client_t *cl,
+                               mtime_t now)
+{
+    uint32_t events = 0;
 
-                        if (answer) {
-                            answer->i_proto  = query->i_proto;
-                            answer->i_type   = HTTPD_MSG_ANSWER;
-                            answer->i_version= 0;
-
-                           if (b_auth_failed) {
-                                httpd_MsgAdd(answer, "WWW-Authenticate",
-                                        "Basic realm=\"VLC stream\"");
-                                answer->i_status = 401;
-                            } else
-                                answer->i_status = 404; /* no url registered */
-
-                            char *p;
-                            answer->i_body = httpd_HtmlError (&p, answer->i_status,
-                                    query->psz_url);
-                            answer->p_body = (uint8_t *)p;
-
-                            cl->i_buffer = -1;  /* Force the creation of the answer in httpd_ClientSend */
-                            httpd_MsgAdd(answer, "Content-Length", "%d", answer->i_body);
-                            httpd_MsgAdd(answer, "Content-Type", "%s", "text/html");
-                        }
+    if (!httpd_ClientIsDone(cl, now))
+        events = httpd_ClientProcess(worker->host, cl);
 
-                        cl->i_state = HTTPD_CLIENT_SENDING;
-                    }
-                }
+    if (httpd_ClientIsDone(cl, now)) {
+        epoll_ctl(worker->epfd, EPOLL_CTL_DEL, cl->fd, NULL);
+        TAB_REMOVE(worker->i_client, worker->client, cl);
+        if (cl->i_events == 0)
+            TAB_REMOVE(worker->i_waiting, worker->waiting, cl);
+        httpd_ClientDestroy(cl);
+        return false;
+    }
+
+    if (events != cl->i_events) {
+        struct epoll_event ev = { .events = events, .data.ptr = cl };
+
+        epoll_ctl(worker->epfd, EPOLL_CTL_MOD, cl->fd, &ev);
+        if (events == 0)
+            TAB_APPEND(worker->i_waiting, worker->waiting, cl);
+        else if (cl->i_events == 0)
+            TAB_REMOVE(worker->i_waiting, worker->waiting, cl);
+        cl->i_events = events;
+    }
+
+    /* Stream clients are woken up by new data, others poll their callback */
+    if (events == 0 && cl->stream == NULL
+     && worker->i_next_wait > now + 20000)
+        worker->i_next_wait = now + 20000;
+    return true;
+}
+
+/* Accepts the pending connections, and spreads them over the workers */
+static void httpd_HostAccept(httpd_host_t *host, mtime_t now)
+{
+    for (unsigned i = 0; i < host->nfd; i++)
+        for (unsigned n = 0; n < HTTPD_EPOLL_EVENTS; n++) {
+            httpd_client_t *cl = httpd_ClientAccept(host, host->fds[i], now);
+            if (cl == NULL)
                 break;
+
+            unsigned i_worker = host->i_next_worker++ % host->i_worker;
+            httpd_worker_t *worker = &host->worker[i_worker];
+            struct epoll_event ev = { .data.ptr = cl };
+
+            cl->i_worker = i_worker;
+            cl->i_events = ev.events = httpd_ClientProcess(host, cl);
+
+            vlc_mutex_lock(&worker->lock);
+            if (epoll_ctl(worker->epfd, EPOLL_CTL_ADD, cl->fd, &ev) == 0) {
+                TAB_APPEND(worker->i_client, worker->client, cl);
+                if (cl->i_events == 0)
+                    TAB_APPEND(worker->i_waiting, worker->waiting, cl);
+                cl = NULL;
             }
+            vlc_mutex_unlock(&worker->lock);
 
-            case HTTPD_CLIENT_SEND_DONE:
-                if (!cl->b_stream_mode || cl->answer.i_body_offset == 0) {
-                    const char *psz_connection = httpd_MsgGet(&cl->answer, "Connection");
-                    const char *psz_query = httpd_MsgGet(&cl->query, "Connection");
-                    bool b_connection = false;
-                    bool b_keepalive = false;
-                    bool b_query = false;
-
-                    cl->url = NULL;
-                    if (psz_connection) {
-                        b_connection = (strcasecmp(psz_connection, "Close") == 0);
-                        b_keepalive = (strcasecmp(psz_connection, "Keep-Alive") == 0);
-                    }
+            if (unlikely(cl != NULL))
+                httpd_ClientDestroy(cl);
+        }
+}
 
-                    if (psz_query)
-                        b_query = (strcasecmp(psz_query, "Close") == 0);
-
-                    if (((cl->query.i_proto == HTTPD_PROTO_HTTP) &&
-                                ((cl->query.i_version == 0 && b_keepalive) ||
-                                  (cl->query.i_version == 1 && !b_connection))) ||
-                            ((cl->query.i_proto == HTTPD_PROTO_RTSP) &&
-                              !b_query && !b_connection)) {
-                        httpd_MsgClean(&cl->query);
-                        httpd_MsgInit(&cl->query);
-
-                        cl->i_buffer = 0;
-                        cl->i_buffer_size = 1000;
-                        free(cl->p_buffer);
-                        cl->p_buffer = xmalloc(cl->i_buffer_size);
-                        cl->i_state = HTTPD_CLIENT_RECEIVING;
-                    } else
-                        cl->i_state = HTTPD_CLIENT_DEAD;
-                    httpd_MsgClean(&cl->answer);
-                } else {
-                    i_offset = cl->answer.i_body_offset;
-                    httpd_MsgClean(&cl->answer);
+static void httpdLoop(httpd_worker_t *worker)
+{
+    httpd_host_t *host = worker->host;
+    struct epoll_event ev[HTTPD_EPOLL_EVENTS];
 
-                    cl->answer.i_body_offset = i_offset;
-                    free(cl->p_buffer);
-                    cl->p_buffer = NULL;
-                    cl->i_buffer = 0;
-                    cl->i_buffer_size = 0;
+    int canc = vlc_savecancel();
+    vlc_mutex_lock(&worker->lock);
 
-                    cl->i_state = HTTPD_CLIENT_WAITING;
-                }
-                break;
+    /* Only the clients with events are handled on each wakeup. Check all
+     * clients for timeouts every second. */
+    mtime_t now = mdate();
+    if (now >= worker->i_next_pass) {
+        worker->i_next_wait = INT64_MAX;
+        for (int i_client = 0; i_client < worker->i_client; i_client++)
+            if (!httpd_ClientUpdate(worker, worker->client[i_client], now))
+                i_client--;
+        worker->i_next_pass = now + CLOCK_FREQ;
+    }
 
-            case HTTPD_CLIENT_WAITING:
-                i_offset = cl->answer.i_body_offset;
-                int i_msg = cl->query.i_type;
+    mtime_t deadline = __MIN(worker->i_next_pass, worker->i_next_wait);
+    int timeout = (deadline - now + 999) / 1000;
+    vlc_mutex_unlock(&worker->lock);
+    vlc_restorecancel(canc);
 
-                httpd_MsgInit(&cl->answer);
-                cl->answer.i_body_offset = i_offset;
+    int ret = epoll_wait(worker->epfd, ev, HTTPD_EPOLL_EVENTS, timeout);
+    if (ret == -1) {
+        if (errno != EINTR) {
+            /* Kernel on low memory or a bug: pace */
+            msg_Err(host, "polling error: %s", vlc_strerror_c(errno));
+            msleep(100000);
+        }
+        return;
+    }
 
-                cl->url->catch[i_msg].cb(cl->url->catch[i_msg].p_sys, cl,
-                        &cl->answer, &cl->query);
-                if (cl->answer.i_type != HTTPD_MSG_NONE) {
-                    /* we have new data, so re-enter send mode */
-                    cl->i_buffer      = 0;
-                    cl->p_buffer      = cl->answer.p_body;
-                    cl->i_buffer_size = cl->answer.i_body;
-                    cl->answer.p_body = NULL;
-                    cl->answer.i_body = 0;
-                    cl->i_state = HTTPD_CLIENT_SENDING;
-                }
+    canc = vlc_savecancel();
+    vlc_mutex_lock(&worker->lock);
+
+    now = mdate();
+    bool b_accept = false, b_wake = now >= worker->i_next_wait;
+
+    for (int i = 0; i < ret; i++) {
+        httpd_client_t *cl = ev[i].data.ptr;
+
+        if (cl == NULL) { /* listening socket */
+            b_accept = true;
+            continue;
+        }
+        if (ev[i].data.ptr == worker) { /* stream data for waiting clients */
+            eventfd_t val;
+
+            eventfd_read(worker->wakefd, &val);
+            b_wake = true;
+            continue;
         }
 
+        if (cl->i_events == 0)
+            /* Error or hang-up while not polling for anything */
+            cl->i_state = HTTPD_CLIENT_DEAD;
+        else
+            httpd_ClientIO(host, cl, now);
+        httpd_ClientUpdate(worker, cl, now);
+    }
+
+    if (b_wake) {
+        /* Going backward, as only the current client can leave the list */
+        worker->i_next_wait = INT64_MAX;
+        for (int i = worker->i_waiting - 1; i >= 0; i--)
+            httpd_ClientUpdate(worker, worker->waiting[i], now);
+    }
+    vlc_mutex_unlock(&worker->lock);
+
+    /* Not under the worker lock, new clients go to any worker */
+    if (b_accept)
+        httpd_HostAccept(host, now);
+    vlc_restorecancel(canc);
+}
+#else
+static void httpdLoop(httpd_worker_t *worker)
+{
+    httpd_host_t *host = worker->host;
+
+    vlc_mutex_lock(&worker->lock);
+
+    struct pollfd ufd[host->nfd + worker->i_client];
+    unsigned nfd;
+    for (nfd = 0; nfd < host->nfd; nfd++) {
+        ufd[nfd].fd = host->fds[nfd];
+        ufd[nfd].events = POLLIN;
+        ufd[nfd].revents = 0;
+    }
+
+    /* add all socket that should be read/write and close dead connection */
+    mtime_t now = mdate();
+    bool b_low_delay = false;
+
+    int canc = vlc_savecancel();
+    for (int i_client = 0; i_client < worker->i_client; i_client++) {
+        httpd_client_t *cl = worker->client[i_client];
+        if (httpd_ClientIsDone(cl, now)) {
+            TAB_REMOVE(worker->i_client, worker->client, cl);
+            i_client--;
+            httpd_ClientDestroy(cl);
+            continue;
+        }
+
+        struct pollfd *pufd = ufd + nfd;
+        assert (pufd < ufd + (sizeof (ufd) / sizeof (ufd[0])));
+
+        pufd->fd = cl->fd;
+        pufd->events = httpd_ClientProcess(host, cl);
+        pufd->revents = 0;
+
         if (pufd->events != 0)
             nfd++;
         else
             b_low_delay = true;
     }
-    vlc_mutex_unlock(&host->lock);
+    vlc_mutex_unlock(&worker->lock);
     vlc_restorecancel(canc);
 
     /* we will wait 20ms (not too big) if HTTPD_CLIENT_WAITING */
     int ret = poll(ufd, nfd, b_low_delay ? 20 : -1);
 
     canc = vlc_savecancel();
-    vlc_mutex_lock(&host->lock);
+    vlc_mutex_lock(&worker->lock);
     switch(ret) {
         case -1:
             if (errno != EINTR) {
@@ -1987,6 +2420,7 @@ static void httpdLoop(httpd_host_t *host)
                 msleep(100000);
             }
         case 0:
+            vlc_mutex_unlock(&worker->lock);
             vlc_restorecancel(canc);
             return;
     }
@@ -1995,8 +2429,8 @@ static void httpdLoop(httpd_host_t *host)
     now = mdate();
     nfd = host->nfd;
 
-    for (int i_client = 0; i_client < host->i_client; i_client++) {
-        httpd_client_t *cl = host->client[i_client];
+    for (int i_client = 0; i_client < worker->i_client; i_client++) {
+        httpd_client_t *cl = worker->client[i_client];
         const struct pollfd *pufd = &ufd[nfd];
 
         assert(pufd < &ufd[sizeof(ufd) / sizeof(ufd[0])]);
@@ -2007,63 +2441,136 @@ static void httpdLoop(httpd_host_t *host)
         if (pufd->revents == 0)
             continue; // no event received
 
-        cl->i_activity_date = now;
-
-        switch (cl->i_state) {
-            case HTTPD_CLIENT_RECEIVING: httpd_ClientRecv(cl); break;
-            case HTTPD_CLIENT_SENDING:   httpd_ClientSend(cl); break;
-            case HTTPD_CLIENT_TLS_HS_IN:
-            case HTTPD_CLIENT_TLS_HS_OUT:
-                httpd_ClientTlsHandshake(host, cl);
-                break;
-        }
+        httpd_ClientIO(host, cl, now);
     }
 
     /* Handle server sockets (accept new connections) */
     for (nfd = 0; nfd < host->nfd; nfd++) {
-        httpd_client_t *cl;
-        int fd = ufd[nfd].fd;
-
-        assert (fd == host->fds[nfd]);
+        assert (ufd[nfd].fd == host->fds[nfd]);
 
         if (ufd[nfd].revents == 0)
             continue;
 
-        /* */
-        fd = vlc_accept (fd, NULL, NULL, true);
-        if (fd == -1)
-            continue;
-        setsockopt (fd, SOL_SOCKET, SO_REUSEADDR,
-                &(int){ 1 }, sizeof(int));
-
-        vlc_tls_t *p_tls;
+        httpd_client_t *cl = httpd_ClientAccept(host, ufd[nfd].fd, now);
+        if (cl != NULL)
+            TAB_APPEND(worker->i_client, worker->client, cl);
+    }
 
-        if (host->p_tls != NULL)
-        {
-            const char *alpn[] = { "http/1.1", NULL };
+    vlc_mutex_unlock(&worker->lock);
+    vlc_restorecancel(canc);
+}
+#endif
 
-            p_tls = vlc_tls_ServerSessionCreate(host->p_tls, fd, alpn);
-        }
-        else
-            p_tls = NULL;
+static void* httpd_WorkerThread(void *data)
+{
+    httpd_worker_t *worker = data;
+    httpd_host_t *host = worker->host;
 
-        cl = httpd_ClientNew(fd, p_tls, now);
+    for (;;) {
+        /* do not serve anything until an url is registered */
+        vlc_mutex_lock(&host->lock);
+        mutex_cleanup_push(&host->lock);
+        while (host->i_url <= 0)
+            vlc_cond_wait(&host->wait, &host->lock);
+        vlc_cleanup_pop();
+        vlc_mutex_unlock(&host->lock);
 
-        TAB_APPEND(host->i_client, host->client, cl);
+        httpdLoop(worker);
     }
+    vlc_assert_unreachable();
+}
 
-    vlc_restorecancel(canc);
+static void httpd_WorkersStop(httpd_host_t *host, unsigned count)
+{
+    for (unsigned i = 0; i < count; i++)
+        vlc_cancel(host->worker[i].thread);
+
+    for (unsigned i = 0; i < count; i++) {
+        httpd_worker_t *worker = &host->worker[i];
+
+        vlc_join(worker->thread, NULL);
+        for (int j = 0; j < worker->i_client; j++) {
+            msg_Warn(host, "client still connected");
+            httpd_ClientDestroy(worker->client[j]);
+        }
+        TAB_CLEAN(worker->i_client, worker->client);
+#ifdef HAVE_EPOLL_CREATE1
+        TAB_CLEAN(worker->i_waiting, worker->waiting);
+        vlc_close(worker->wakefd);
+        vlc_close(worker->epfd);
+#endif
+        vlc_mutex_destroy(&worker->lock);
+    }
+    free(host->worker);
 }
 
-static void* httpd_HostThread(void *data)
+static int httpd_WorkersStart(httpd_host_t *host)
 {
-    httpd_host_t *host = data;
+#ifdef HAVE_EPOLL_CREATE1
+    host->i_worker = __MIN(vlc_GetCPUCount(), HTTPD_WORKERS_MAX);
+#else
+    host->i_worker = 1;
+#endif
+    host->i_next_worker = 0;
+    host->worker = malloc(host->i_worker * sizeof (*host->worker));
+    if (unlikely(host->worker == NULL))
+        return VLC_ENOMEM;
 
-    vlc_mutex_lock(&host->lock);
-    while (host->i_ref > 0)
-        httpdLoop(host);
-    vlc_mutex_unlock(&host->lock);
-    return NULL;
+    for (unsigned i = 0; i < host->i_worker; i++) {
+        httpd_worker_t *worker = &host->worker[i];
+
+        worker->host = host;
+        worker->i_client = 0;
+        worker->client = NULL;
+#ifdef HAVE_EPOLL_CREATE1
+        worker->i_next_pass = 0;
+        worker->i_next_wait = INT64_MAX;
+        worker->i_waiting = 0;
+        worker->waiting = NULL;
+        worker->epfd = epoll_create1(EPOLL_CLOEXEC);
+        if (worker->epfd == -1) {
+            httpd_WorkersStop(host, i);
+            return VLC_EGENERIC;
+        }
+
+        struct epoll_event wev = { .events = EPOLLIN, .data.ptr = worker };
+
+        worker->wakefd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (worker->wakefd == -1
+         || epoll_ctl(worker->epfd, EPOLL_CTL_ADD, worker->wakefd, &wev)) {
+            if (worker->wakefd != -1)
+                vlc_close(worker->wakefd);
+            vlc_close(worker->epfd);
+            httpd_WorkersStop(host, i);
+            return VLC_EGENERIC;
+        }
+
+        /* the first worker accepts all connections */
+        for (unsigned j = 0; j < host->nfd && i == 0; j++) {
+            struct epoll_event ev = { .events = EPOLLIN, .data.ptr = NULL };
+
+            if (epoll_ctl(worker->epfd, EPOLL_CTL_ADD, host->fds[j], &ev)) {
+                vlc_close(worker->wakefd);
+                vlc_close(worker->epfd);
+                httpd_WorkersStop(host, i);
+                return VLC_EGENERIC;
+            }
+        }
+#endif
+        vlc_mutex_init(&worker->lock);
+
+        if (vlc_clone(&worker->thread, httpd_WorkerThread, worker,
+                      VLC_THREAD_PRIORITY_LOW)) {
+            vlc_mutex_destroy(&worker->lock);
+#ifdef HAVE_EPOLL_CREATE1
+            vlc_close(worker->wakefd);
+            vlc_close(worker->epfd);
+#endif
+            httpd_WorkersStop(host, i);
+            return VLC_EGENERIC;
+        }
+    }
+    return VLC_SUCCESS;
 }
 
 int httpd_StreamSetHTTPHeaders(httpd_stream_t * p_stream, httpd_header * p_headers, size_t i_headers)
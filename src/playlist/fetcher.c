@@ -40,6 +40,7 @@
 #include "art.h"
 #include "fetcher.h"
 #include "input/input_interface.h"
+#include "misc/background_worker.h"
 
 /*****************************************************************************
  * Structures/definitions
@@ -49,7 +50,9 @@ typedef enum
     PASS1_LOCAL = 0,
     PASS2_NETWORK
 } fetcher_pass_t;
-#define PASS_COUNT 2
+
+/* Private request option: the local pass failed */
+#define FETCHER_OPTION_PASS2 0x100
 
 typedef struct
 {
@@ -61,31 +64,27 @@ typedef struct
 
 } playlist_album_t;
 
-typedef struct fetcher_entry_t fetcher_entry_t;
-
-struct fetcher_entry_t
-{
-    input_item_t    *p_item;
-    input_item_meta_request_option_t i_options;
-    fetcher_entry_t *p_next;
-};
-
 struct playlist_fetcher_t
 {
     vlc_object_t   *object;
-    vlc_mutex_t     lock;
-    vlc_cond_t      wait;
-    bool            b_live;
-    vlc_interrupt_t *interrupt;
-
-    fetcher_entry_t *p_waiting_head[PASS_COUNT];
-    fetcher_entry_t *p_waiting_tail[PASS_COUNT];
+    struct background_worker *worker;
 
+    vlc_mutex_t     lock; /* protects albums */
     DECL_ARRAY(playlist_album_t) albums;
     meta_fetcher_scope_t e_scope;
 };
 
-static void *Thread( void * );
+static bool Run( void *, void *, int * );
+
+static void Hold( void *item )
+{
+    vlc_gc_incref( (input_item_t *)item );
+}
+
+static void Release( void *item )
+{
+    vlc_gc_decref( (input_item_t *)item );
+}
 
 
 /*****************************************************************************
@@ -97,25 +96,31 @@ playlist_fetcher_t *playlist_fetcher_New( vlc_object_t *parent )
     if( !p_fetcher )
         return NULL;
 
-    p_fetcher->interrupt = vlc_interrupt_create();
-    if( unlikely(p_fetcher->interrupt == NULL) )
+    struct background_worker_config conf = {
+        .max_threads = var_InheritInteger( parent, "fetch-art-threads" ),
+        .default_timeout =
+            var_InheritInteger( parent, "fetch-art-timeout" ) * 1000,
+        .pf_hold = Hold,
+        .pf_release = Release,
+        .pf_run = Run,
+    };
+    if( conf.max_threads < 1 )
+        conf.max_threads = 1;
+
+    p_fetcher->worker = background_worker_New( p_fetcher, &conf );
+    if( unlikely(p_fetcher->worker == NULL) )
     {
         free( p_fetcher );
         return NULL;
     }
     p_fetcher->object = parent;
     vlc_mutex_init( &p_fetcher->lock );
-    vlc_cond_init( &p_fetcher->wait );
-    p_fetcher->b_live = false;
 
     if( var_InheritBool( parent, "metadata-network-access" ) )
         p_fetcher->e_scope = FETCHER_SCOPE_ANY;
     else
         p_fetcher->e_scope = FETCHER_SCOPE_LOCAL;
 
-    memset( p_fetcher->p_waiting_head, 0, PASS_COUNT * sizeof(fetcher_entry_t *) );
-    memset( p_fetcher->p_waiting_tail, 0, PASS_COUNT * sizeof(fetcher_entry_t *) );
-
     ARRAY_INIT( p_fetcher->albums );
 
     return p_fetcher;
@@ -124,63 +129,30 @@ playlist_fetcher_t *playlist_fetcher_New( vlc_object_t *parent )
 void playlist_fetcher_Push( playlist_fetcher_t *p_fetcher, input_item_t *p_item,
                             input_item_meta_request_option_t i_options )
 {
-    fetcher_entry_t *p_entry = malloc( sizeof(fetcher_entry_t) );
-    if ( !p_entry ) return;
-
-    vlc_gc_incref( p_item );
-    p_entry->p_item = p_item;
-    p_entry->p_next = NULL;
-    p_entry->i_options = i_options;
-    vlc_mutex_lock( &p_fetcher->lock );
-    /* Append last */
-    if ( p_fetcher->p_waiting_head[PASS1_LOCAL] )
-        p_fetcher->p_waiting_tail[PASS1_LOCAL]->p_next = p_entry;
-    else
-        p_fetcher->p_waiting_head[PASS1_LOCAL] = p_entry;
-    p_fetcher->p_waiting_tail[PASS1_LOCAL] = p_entry;
+    enum background_worker_priority priority =
+        ( i_options & META_REQUEST_OPTION_PRIORITY )
+            ? BACKGROUND_WORKER_PRIORITY_HIGH
+            : BACKGROUND_WORKER_PRIORITY_NORMAL;
+
+    if( background_worker_Push( p_fetcher->worker, p_item, NULL, i_options,
+                                -1, priority ) )
+        msg_Err( p_fetcher->object,
+                 "cannot spawn secondary preparse thread" );
+}
 
-    if( !p_fetcher->b_live )
-    {
-        assert( p_fetcher->p_waiting_head[PASS1_LOCAL] );
-        if( vlc_clone_detach( NULL, Thread, p_fetcher,
-                              VLC_THREAD_PRIORITY_LOW ) )
-            msg_Err( p_fetcher->object,
-                     "cannot spawn secondary preparse thread" );
-        else
-            p_fetcher->b_live = true;
-    }
-    vlc_mutex_unlock( &p_fetcher->lock );
+void playlist_fetcher_GetStats( playlist_fetcher_t *p_fetcher,
+                                uint64_t *fetched, unsigned *pending )
+{
+    background_worker_GetStats( p_fetcher->worker, fetched, pending );
 }
 
 void playlist_fetcher_Delete( playlist_fetcher_t *p_fetcher )
 {
-    fetcher_entry_t *p_next;
-
-    vlc_interrupt_kill(p_fetcher->interrupt);
-
-    vlc_mutex_lock( &p_fetcher->lock );
-    /* Remove any left-over item, the fetcher will exit */
-    for ( int i_queue=0; i_queue<PASS_COUNT; i_queue++ )
-    {
-        while( p_fetcher->p_waiting_head[i_queue] )
-        {
-            p_next = p_fetcher->p_waiting_head[i_queue]->p_next;
-            vlc_gc_decref( p_fetcher->p_waiting_head[i_queue]->p_item );
-            free( p_fetcher->p_waiting_head[i_queue] );
-            p_fetcher->p_waiting_head[i_queue] = p_next;
-        }
-        p_fetcher->p_waiting_head[i_queue] = NULL;
-    }
-
-    while( p_fetcher->b_live )
-        vlc_cond_wait( &p_fetcher->wait, &p_fetcher->lock );
-    vlc_mutex_unlock( &p_fetcher->lock );
+    /* Interrupts the running fetches and drops the queued ones */
+    background_worker_Delete( p_fetcher->worker );
 
-    vlc_cond_destroy( &p_fetcher->wait );
     vlc_mutex_destroy( &p_fetcher->lock );
 
-    vlc_interrupt_destroy( p_fetcher->interrupt );
-
     playlist_album_t album;
     FOREACH_ARRAY( album, p_fetcher->albums )
         free( album.psz_album );
@@ -196,6 +168,22 @@ void playlist_fetcher_Delete( playlist_fetcher_t *p_fetcher )
 /*****************************************************************************
  * Privates functions
  *****************************************************************************/
+/* Must be called with the lock held */
+static playlist_album_t *FindAlbum( playlist_fetcher_t *p_fetcher,
+                                    const char *psz_artist,
+                                    const char *psz_album )
+{
+    for( int i = 0; i < p_fetcher->albums.i_size; i++ )
+    {
+        playlist_album_t *p_album = &p_fetcher->albums.p_elems[i];
+
+        if( !strcmp( p_album->psz_artist, psz_artist ) &&
+            !strcmp( p_album->psz_album, psz_album ) )
+            return p_album;
+    }
+    return NULL;
+}
+
 /**
  * This function locates the art associated to an input item.
  * Return codes:
@@ -203,11 +191,11 @@ void playlist_fetcher_Delete( playlist_fetcher_t *p_fetcher )
  *   1 : Art found, need to download
  *  -X : Error/not found
  */
-static int FindArt( playlist_fetcher_t *p_fetcher, input_item_t *p_item )
+static int FindArt( playlist_fetcher_t *p_fetcher, input_item_t *p_item,
+                    meta_fetcher_scope_t e_scope )
 {
     int i_ret;
 
-    playlist_album_t *p_album = NULL;
     char *psz_artist = input_item_GetArtist( p_item );
     char *psz_album = input_item_GetAlbum( p_item );
     char *psz_title = input_item_GetTitle( p_item );
@@ -222,36 +210,41 @@ static int FindArt( playlist_fetcher_t *p_fetcher, input_item_t *p_item )
     /* If we already checked this album in this session, skip */
     if( psz_artist && psz_album )
     {
-        FOREACH_ARRAY( playlist_album_t album, p_fetcher->albums )
-            if( !strcmp( album.psz_artist, psz_artist ) &&
-                !strcmp( album.psz_album, psz_album ) )
+        vlc_mutex_lock( &p_fetcher->lock );
+        playlist_album_t *p_album = FindAlbum( p_fetcher, psz_artist,
+                                               psz_album );
+        if( p_album != NULL )
+        {
+            msg_Dbg( p_fetcher->object,
+                     " %s - %s has already been searched",
+                     psz_artist, psz_album );
+            /* TODO-fenrir if we cache art filename too, we can go faster */
+            if( p_album->b_found )
             {
-                msg_Dbg( p_fetcher->object,
-                         " %s - %s has already been searched",
-                         psz_artist, psz_album );
-                /* TODO-fenrir if we cache art filename too, we can go faster */
+                char *psz_arturl = p_album->psz_arturl ?
+                                   strdup( p_album->psz_arturl ) : NULL;
+                vlc_mutex_unlock( &p_fetcher->lock );
                 free( psz_artist );
                 free( psz_album );
-                if( album.b_found )
-                {
-                    if( !strncmp( album.psz_arturl, "file://", 7 ) )
-                        input_item_SetArtURL( p_item, album.psz_arturl );
-                    else /* Actually get URL from cache */
-                        playlist_FindArtInCache( p_item );
-                    return 0;
-                }
-                else if ( album.e_scope >= p_fetcher->e_scope )
-                {
-                    return VLC_EGENERIC;
-                }
-                msg_Dbg( p_fetcher->object,
-                         " will search at higher scope, if possible" );
-                p_album = &p_fetcher->albums.p_elems[fe_idx];
-
-                psz_artist = psz_album = NULL;
-                break;
+
+                if( psz_arturl && !strncmp( psz_arturl, "file://", 7 ) )
+                    input_item_SetArtURL( p_item, psz_arturl );
+                else /* Actually get URL from cache */
+                    playlist_FindArtInCache( p_item );
+                free( psz_arturl );
+                return 0;
             }
-        FOREACH_END();
+            else if ( p_album->e_scope >= e_scope )
+            {
+                vlc_mutex_unlock( &p_fetcher->lock );
+                free( psz_artist );
+                free( psz_album );
+                return VLC_EGENERIC;
+            }
+            msg_Dbg( p_fetcher->object,
+                     " will search at higher scope, if possible" );
+        }
+        vlc_mutex_unlock( &p_fetcher->lock );
     }
 
     free( psz_artist );
@@ -307,7 +300,7 @@ static int FindArt( playlist_fetcher_t *p_fetcher, input_item_t *p_item )
         module_t *p_module;
 
         p_finder->p_item = p_item;
-        p_finder->e_scope = p_fetcher->e_scope;
+        p_finder->e_scope = e_scope;
 
         p_module = module_need( p_finder, "art finder", NULL, false );
         if( p_module )
@@ -325,9 +318,12 @@ static int FindArt( playlist_fetcher_t *p_fetcher, input_item_t *p_item )
     /* Record this album */
     if( psz_artist && psz_album )
     {
+        vlc_mutex_lock( &p_fetcher->lock );
+        playlist_album_t *p_album = FindAlbum( p_fetcher, psz_artist,
+                                               psz_album );
         if ( p_album )
         {
-            p_album->e_scope = p_fetcher->e_scope;
+            p_album->e_scope = e_scope;
             free( p_album->psz_arturl );
             p_album->psz_arturl = input_item_GetArtURL( p_item );
             p_album->b_found = (i_ret == VLC_EGENERIC ? false : true );
@@ -341,9 +337,10 @@ static int FindArt( playlist_fetcher_t *p_fetcher, input_item_t *p_item )
             a.psz_album = psz_album;
             a.psz_arturl = input_item_GetArtURL( p_item );
             a.b_found = (i_ret == VLC_EGENERIC ? false : true );
-            a.e_scope = p_fetcher->e_scope;
+            a.e_scope = e_scope;
             ARRAY_APPEND( p_fetcher->albums, a );
         }
+        vlc_mutex_unlock( &p_fetcher->lock );
     }
     else
     {
@@ -427,14 +424,15 @@ error:
  * connections, and gather information upon the playing media.
  * (even artwork).
  */
-static void FetchMeta( playlist_fetcher_t *p_fetcher, input_item_t *p_item )
+static void FetchMeta( playlist_fetcher_t *p_fetcher, input_item_t *p_item,
+                       meta_fetcher_scope_t e_scope )
 {
     meta_fetcher_t *p_finder =
         vlc_custom_create( p_fetcher->object, sizeof( *p_finder ), "art finder" );
     if ( !p_finder )
         return;
 
-    p_finder->e_scope = p_fetcher->e_scope;
+    p_finder->e_scope = e_scope;
     p_finder->p_item = p_item;
 
     module_t *p_module = module_need( p_finder, "meta fetcher", NULL, false );
@@ -444,132 +442,87 @@ static void FetchMeta( playlist_fetcher_t *p_fetcher, input_item_t *p_item )
     vlc_object_release( p_finder );
 }
 
-static void *Thread( void *p_data )
+static bool Run( void *owner, void *entity, int *options )
 {
-    playlist_fetcher_t *p_fetcher = p_data;
+    playlist_fetcher_t *p_fetcher = owner;
+    input_item_t *p_item = entity;
     vlc_object_t *obj = p_fetcher->object;
-    fetcher_pass_t e_pass = PASS1_LOCAL;
+    fetcher_pass_t e_pass = ( *options & FETCHER_OPTION_PASS2 )
+                          ? PASS2_NETWORK : PASS1_LOCAL;
+    meta_fetcher_scope_t e_scope = p_fetcher->e_scope;
+
+    /* scope override */
+    switch ( *options & META_REQUEST_OPTION_SCOPE_ANY ) {
+    case META_REQUEST_OPTION_SCOPE_ANY:
+        e_scope = FETCHER_SCOPE_ANY;
+        break;
+    case META_REQUEST_OPTION_SCOPE_LOCAL:
+        e_scope = FETCHER_SCOPE_LOCAL;
+        break;
+    case META_REQUEST_OPTION_SCOPE_NETWORK:
+        e_scope = FETCHER_SCOPE_NETWORK;
+        break;
+    case META_REQUEST_OPTION_NONE:
+    default:
+        break;
+    }
+    /* Triggers "meta fetcher", eventually fetch meta on the network.
+     * They are identical to "meta reader" expect that may actually
+     * takes time. That's why they are running here.
+     * The result of this fetch is not cached. */
 
-    vlc_interrupt_set(p_fetcher->interrupt);
+    int i_ret = -1;
 
-    for( ;; )
+    if( e_pass == PASS1_LOCAL && ( e_scope & FETCHER_SCOPE_LOCAL ) )
     {
-        fetcher_entry_t *p_entry = NULL;
-
-        vlc_mutex_lock( &p_fetcher->lock );
-        for ( int i=0; i<PASS_COUNT; i++ )
-        {
-            if ( p_fetcher->p_waiting_head[i] )
-            {
-                e_pass = i;
-                break;
-            }
-        }
-
-        if( p_fetcher->p_waiting_head[e_pass] )
-        {
-            p_entry = p_fetcher->p_waiting_head[e_pass];
-            p_fetcher->p_waiting_head[e_pass] = p_entry->p_next;
-            if ( p_entry->p_next == NULL )
-                p_fetcher->p_waiting_tail[e_pass] = NULL;
-            p_entry->p_next = NULL;
-        }
-        else
+        /* only fetch from local */
+        e_scope = FETCHER_SCOPE_LOCAL;
+    }
+    else if( e_pass == PASS2_NETWORK && ( e_scope & FETCHER_SCOPE_NETWORK ) )
+    {
+        /* only fetch from network */
+        e_scope = FETCHER_SCOPE_NETWORK;
+    }
+    else
+        e_scope = 0;
+    if ( e_scope & FETCHER_SCOPE_ANY )
+    {
+        FetchMeta( p_fetcher, p_item, e_scope );
+        i_ret = FindArt( p_fetcher, p_item, e_scope );
+        switch( i_ret )
         {
-            vlc_interrupt_set( NULL );
-            p_fetcher->b_live = false;
-            vlc_cond_signal( &p_fetcher->wait );
-        }
-        vlc_mutex_unlock( &p_fetcher->lock );
-
-        if( !p_entry )
-            break;
-
-        meta_fetcher_scope_t e_prev_scope = p_fetcher->e_scope;
-
-        /* scope override */
-        switch ( p_entry->i_options ) {
-        case META_REQUEST_OPTION_SCOPE_ANY:
-            p_fetcher->e_scope = FETCHER_SCOPE_ANY;
-            break;
-        case META_REQUEST_OPTION_SCOPE_LOCAL:
-            p_fetcher->e_scope = FETCHER_SCOPE_LOCAL;
-            break;
-        case META_REQUEST_OPTION_SCOPE_NETWORK:
-            p_fetcher->e_scope = FETCHER_SCOPE_NETWORK;
+        case 1: /* Found, need to dl */
+            i_ret = DownloadArt( p_fetcher, p_item );
             break;
-        case META_REQUEST_OPTION_NONE:
-        default:
+        case 0: /* Is in cache */
+            i_ret = VLC_SUCCESS;
+            //ft
+        default:// error
             break;
         }
-        /* Triggers "meta fetcher", eventually fetch meta on the network.
-         * They are identical to "meta reader" expect that may actually
-         * takes time. That's why they are running here.
-         * The result of this fetch is not cached. */
-
-        int i_ret = -1;
+    }
 
-        if( e_pass == PASS1_LOCAL && ( p_fetcher->e_scope & FETCHER_SCOPE_LOCAL ) )
-        {
-            /* only fetch from local */
-            p_fetcher->e_scope = FETCHER_SCOPE_LOCAL;
-        }
-        else if( e_pass == PASS2_NETWORK && ( p_fetcher->e_scope & FETCHER_SCOPE_NETWORK ) )
-        {
-            /* only fetch from network */
-            p_fetcher->e_scope = FETCHER_SCOPE_NETWORK;
-        }
-        else
-            p_fetcher->e_scope = 0;
-        if ( p_fetcher->e_scope & FETCHER_SCOPE_ANY )
-        {
-            FetchMeta( p_fetcher, p_entry->p_item );
-            i_ret = FindArt( p_fetcher, p_entry->p_item );
-            switch( i_ret )
-            {
-            case 1: /* Found, need to dl */
-                i_ret = DownloadArt( p_fetcher, p_entry->p_item );
-                break;
-            case 0: /* Is in cache */
-                i_ret = VLC_SUCCESS;
-                //ft
-            default:// error
-                break;
-            }
-        }
+    /* */
+    if ( i_ret != VLC_SUCCESS && (e_pass != PASS2_NETWORK) )
+    {
+        /* Run again once the local pass is done for the other items */
+        *options |= FETCHER_OPTION_PASS2;
+        return true;
+    }
 
-        p_fetcher->e_scope = e_prev_scope;
-        /* */
-        if ( i_ret != VLC_SUCCESS && (e_pass != PASS2_NETWORK) )
-        {
-            /* Move our entry to next pass queue */
-            vlc_mutex_lock( &p_fetcher->lock );
-            if ( p_fetcher->p_waiting_head[e_pass + 1] )
-                p_fetcher->p_waiting_tail[e_pass + 1]->p_next = p_entry;
-            else
-                p_fetcher->p_waiting_head[e_pass + 1] = p_entry;
-            p_fetcher->p_waiting_tail[e_pass + 1] = p_entry;
-            vlc_mutex_unlock( &p_fetcher->lock );
-        }
-        else
-        {
-            /* */
-            char *psz_name = input_item_GetName( p_entry->p_item );
-            if( i_ret == VLC_SUCCESS ) /* Art is now in cache */
-            {
-                msg_Dbg( obj, "found art for %s in cache", psz_name );
-                input_item_SetArtFetched( p_entry->p_item, true );
-                var_SetAddress( obj, "item-change", p_entry->p_item );
-            }
-            else
-            {
-                msg_Dbg( obj, "art not found for %s", psz_name );
-                input_item_SetArtNotFound( p_entry->p_item, true );
-            }
-            free( psz_name );
-            vlc_gc_decref( p_entry->p_item );
-            free( p_entry );
-        }
+    /* */
+    char *psz_name = input_item_GetName( p_item );
+    if( i_ret == VLC_SUCCESS ) /* Art is now in cache */
+    {
+        msg_Dbg( obj, "found art for %s in cache", psz_name );
+        input_item_SetArtFetched( p_item, true );
+        var_SetAddress( obj, "item-change", p_item );
     }
-    return NULL;
+    else
+    {
+        msg_Dbg( obj, "art not found for %s", psz_name );
+        input_item_SetArtNotFound( p_item, true );
+    }
+    free( psz_name );
+    return false;
 }
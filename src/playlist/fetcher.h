@@ -36,7 +36,10 @@
 typedef struct playlist_fetcher_t playlist_fetcher_t;
 
 /**
- * This function creates the fetcher object and thread.
+ * This function creates the fetcher object.
+ *
+ * Up to "fetch-art-threads" items are processed at the same time, by threads
+ * spawned on demand.
  */
 playlist_fetcher_t *playlist_fetcher_New( vlc_object_t * );
 
@@ -50,7 +53,14 @@ void playlist_fetcher_Push( playlist_fetcher_t *, input_item_t *,
                             input_item_meta_request_option_t );
 
 /**
- * This function destroys the fetcher object and thread.
+ * This function gets the number of items processed, and of items still queued
+ * or being processed.
+ */
+void playlist_fetcher_GetStats( playlist_fetcher_t *, uint64_t *fetched,
+                                unsigned *pending );
+
+/**
+ * This function destroys the fetcher object and threads.
  *
  * All pending input items will be released.
  */
@@ -212,6 +212,10 @@ static void input_item_changed( const vlc_event_t * p_event,
 {
     playlist_t *p_playlist = user_data;
 
+    if( p_event->type == vlc_InputItemMetaChanged
+     || p_event->type == vlc_InputItemNameChanged )
+        playlist_SearchIndexUpdate( p_playlist, p_event->p_obj );
+
     var_SetAddress( p_playlist, "item-change", p_event->p_obj );
 }
 
@@ -288,6 +292,7 @@ playlist_item_t *playlist_ItemNewFromInput( playlist_t *p_playlist,
 
     p->i_last_playlist_id = p_item->i_id;
     vlc_gc_incref( p_item->p_input );
+    playlist_SearchIndexAdd( p_playlist, p_item );
 
     vlc_event_manager_t *p_em = &p_item->p_input->event_manager;
 
@@ -341,6 +346,7 @@ void playlist_ItemRelease( playlist_t *p_playlist, playlist_item_t *p_item )
     vlc_event_detach( p_em, vlc_InputItemErrorWhenReadingChanged,
                       input_item_changed, p_playlist );
 
+    playlist_SearchIndexRemove( p_playlist, p_item );
     vlc_gc_decref( p_item->p_input );
 
     tdelete( p_item, &p->input_tree, playlist_ItemCmpInput );
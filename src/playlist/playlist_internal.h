@@ -41,6 +41,7 @@
 #include "preparser.h"
 
 typedef struct vlc_sd_internal_t vlc_sd_internal_t;
+typedef struct playlist_search_index_t playlist_search_index_t;
 
 void playlist_ServicesDiscoveryKillAll( playlist_t *p_playlist );
 
@@ -52,6 +53,7 @@ typedef struct playlist_private_t
     void *input_tree; /**< Search tree for input item
                            to playlist item mapping */
     void *id_tree; /**< Search tree for item ID to item mapping */
+    playlist_search_index_t *p_search_index; /**< Live search index */
 
     vlc_sd_internal_t   **pp_sds;
     int                   i_sds;   /**< Number of service discovery modules */
@@ -132,6 +134,13 @@ playlist_item_t *playlist_ItemFindFromInputAndRoot( playlist_t *p_playlist,
 
 void playlist_ItemRelease( playlist_t *, playlist_item_t * );
 
+/* Live search index */
+playlist_search_index_t *playlist_SearchIndexNew( void );
+void playlist_SearchIndexDelete( playlist_search_index_t * );
+void playlist_SearchIndexAdd( playlist_t *, playlist_item_t * );
+void playlist_SearchIndexRemove( playlist_t *, playlist_item_t * );
+void playlist_SearchIndexUpdate( playlist_t *, input_item_t * );
+
 void ResetCurrentlyPlaying( playlist_t *p_playlist, playlist_item_t *p_cur );
 void ResyncCurrentIndex( playlist_t *p_playlist, playlist_item_t *p_cur );
 
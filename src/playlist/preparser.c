@@ -28,46 +28,46 @@
 #include <assert.h>
 
 #include <vlc_common.h>
+#include <vlc_interrupt.h>
 
 #include "fetcher.h"
 #include "preparser.h"
 #include "input/input_interface.h"
+#include "misc/background_worker.h"
 
 /*****************************************************************************
  * Structures/definitions
  *****************************************************************************/
-typedef struct preparser_entry_t preparser_entry_t;
-
-struct preparser_entry_t
-{
-    input_item_t    *p_item;
-    input_item_meta_request_option_t i_options;
-    void            *id;
-    mtime_t          timeout;
-};
-
 struct playlist_preparser_t
 {
     vlc_object_t        *object;
     playlist_fetcher_t  *p_fetcher;
-    mtime_t              default_timeout;
+    struct background_worker *worker;
+};
 
-    void                *input_id;
+/* State of the input thread preparsing an item */
+typedef struct
+{
+    vlc_mutex_t     lock;
+    vlc_cond_t      wait;
     enum {
         INPUT_RUNNING,
         INPUT_STOPPED,
         INPUT_CANCELED,
-    } input_state;
+    } state;
+} preparser_task_t;
 
-    vlc_mutex_t     lock;
-    vlc_cond_t      wait;
-    vlc_cond_t      thread_wait;
-    bool            b_live;
-    preparser_entry_t  **pp_waiting;
-    size_t          i_waiting;
-};
+static bool Run( void *, void *, int * );
+
+static void Hold( void *item )
+{
+    vlc_gc_incref( (input_item_t *)item );
+}
 
-static void *Thread( void * );
+static void Release( void *item )
+{
+    vlc_gc_decref( (input_item_t *)item );
+}
 
 /*****************************************************************************
  * Public functions
@@ -78,21 +78,28 @@ playlist_preparser_t *playlist_preparser_New( vlc_object_t *parent )
     if( !p_preparser )
         return NULL;
 
-    p_preparser->input_id = NULL;
-    p_preparser->input_state = INPUT_RUNNING;
+    struct background_worker_config conf = {
+        .max_threads = var_InheritInteger( parent, "preparse-threads" ),
+        .default_timeout = var_InheritInteger( parent, "preparse-timeout" ) * 1000,
+        .pf_hold = Hold,
+        .pf_release = Release,
+        .pf_run = Run,
+    };
+    if( conf.max_threads < 1 )
+        conf.max_threads = 1;
+
+    p_preparser->worker = background_worker_New( p_preparser, &conf );
+    if( unlikely(p_preparser->worker == NULL) )
+    {
+        free( p_preparser );
+        return NULL;
+    }
+
     p_preparser->object = parent;
-    p_preparser->default_timeout = var_InheritInteger( parent, "preparse-timeout" );
     p_preparser->p_fetcher = playlist_fetcher_New( parent );
     if( unlikely(p_preparser->p_fetcher == NULL) )
         msg_Err( parent, "cannot create fetcher" );
 
-    vlc_mutex_init( &p_preparser->lock );
-    vlc_cond_init( &p_preparser->wait );
-    vlc_cond_init( &p_preparser->thread_wait );
-    p_preparser->b_live = false;
-    p_preparser->i_waiting = 0;
-    p_preparser->pp_waiting = NULL;
-
     return p_preparser;
 }
 
@@ -100,28 +107,14 @@ void playlist_preparser_Push( playlist_preparser_t *p_preparser, input_item_t *p
                               input_item_meta_request_option_t i_options,
                               int timeout, void *id )
 {
-    preparser_entry_t *p_entry = malloc( sizeof(preparser_entry_t) );
-
-    if ( !p_entry )
-        return;
-    p_entry->p_item = p_item;
-    p_entry->i_options = i_options;
-    p_entry->id = id;
-    p_entry->timeout = (timeout < 0 ? p_preparser->default_timeout : timeout) * 1000;
-    vlc_gc_incref( p_entry->p_item );
-
-    vlc_mutex_lock( &p_preparser->lock );
-    INSERT_ELEM( p_preparser->pp_waiting, p_preparser->i_waiting,
-                 p_preparser->i_waiting, p_entry );
-    if( !p_preparser->b_live )
-    {
-        if( vlc_clone_detach( NULL, Thread, p_preparser,
-                              VLC_THREAD_PRIORITY_LOW ) )
-            msg_Warn( p_preparser->object, "cannot spawn pre-parser thread" );
-        else
-            p_preparser->b_live = true;
-    }
-    vlc_mutex_unlock( &p_preparser->lock );
+    enum background_worker_priority priority =
+        ( i_options & META_REQUEST_OPTION_PRIORITY )
+            ? BACKGROUND_WORKER_PRIORITY_HIGH
+            : BACKGROUND_WORKER_PRIORITY_NORMAL;
+
+    if( background_worker_Push( p_preparser->worker, p_item, id, i_options,
+                                timeout, priority ) )
+        msg_Warn( p_preparser->object, "cannot spawn pre-parser thread" );
 }
 
 void playlist_preparser_fetcher_Push( playlist_preparser_t *p_preparser,
@@ -134,52 +127,29 @@ void playlist_preparser_fetcher_Push( playlist_preparser_t *p_preparser,
 void playlist_preparser_Cancel( playlist_preparser_t *p_preparser, void *id )
 {
     assert( id != NULL );
-    vlc_mutex_lock( &p_preparser->lock );
+    background_worker_Cancel( p_preparser->worker, id );
+}
 
-    /* Remove entries that match with the id */
-    for( int i = p_preparser->i_waiting - 1; i >= 0; --i )
-    {
-        preparser_entry_t *p_entry = p_preparser->pp_waiting[i];
-        if( p_entry->id == id )
-        {
-            vlc_gc_decref( p_entry->p_item );
-            free( p_entry );
-            REMOVE_ELEM( p_preparser->pp_waiting, p_preparser->i_waiting, i );
-        }
-    }
+void playlist_preparser_GetStats( playlist_preparser_t *p_preparser,
+                                  uint64_t *parsed, unsigned *parse_pending,
+                                  uint64_t *fetched, unsigned *fetch_pending )
+{
+    background_worker_GetStats( p_preparser->worker, parsed, parse_pending );
 
-    /* Stop the input_thread reading the item (if any) */
-    if( p_preparser->input_id == id )
+    if( p_preparser->p_fetcher != NULL )
+        playlist_fetcher_GetStats( p_preparser->p_fetcher, fetched,
+                                   fetch_pending );
+    else
     {
-        p_preparser->input_state = INPUT_CANCELED;
-        vlc_cond_signal( &p_preparser->thread_wait );
+        *fetched = 0;
+        *fetch_pending = 0;
     }
-    vlc_mutex_unlock( &p_preparser->lock );
 }
 
 void playlist_preparser_Delete( playlist_preparser_t *p_preparser )
 {
-    vlc_mutex_lock( &p_preparser->lock );
-    /* Remove pending item to speed up preparser thread exit */
-    while( p_preparser->i_waiting > 0 )
-    {
-        preparser_entry_t *p_entry = p_preparser->pp_waiting[0];
-        vlc_gc_decref( p_entry->p_item );
-        free( p_entry );
-        REMOVE_ELEM( p_preparser->pp_waiting, p_preparser->i_waiting, 0 );
-    }
-
-    p_preparser->input_state = INPUT_CANCELED;
-    vlc_cond_signal( &p_preparser->thread_wait );
-
-    while( p_preparser->b_live )
-        vlc_cond_wait( &p_preparser->wait, &p_preparser->lock );
-    vlc_mutex_unlock( &p_preparser->lock );
-
-    /* Destroy the item preparser */
-    vlc_cond_destroy( &p_preparser->thread_wait );
-    vlc_cond_destroy( &p_preparser->wait );
-    vlc_mutex_destroy( &p_preparser->lock );
+    /* Stops the preparsing threads, which feed the fetcher */
+    background_worker_Delete( p_preparser->worker );
 
     if( p_preparser->p_fetcher != NULL )
         playlist_fetcher_Delete( p_preparser->p_fetcher );
@@ -193,31 +163,41 @@ void playlist_preparser_Delete( playlist_preparser_t *p_preparser )
 static int InputEvent( vlc_object_t *obj, const char *varname,
                        vlc_value_t old, vlc_value_t cur, void *data )
 {
-    playlist_preparser_t *preparser = data;
+    preparser_task_t *task = data;
     int event = cur.i_int;
 
     if( event == INPUT_EVENT_DEAD )
     {
-        vlc_mutex_lock( &preparser->lock );
+        vlc_mutex_lock( &task->lock );
 
-        preparser->input_state = INPUT_STOPPED;
-        vlc_cond_signal( &preparser->thread_wait );
+        task->state = INPUT_STOPPED;
+        vlc_cond_signal( &task->wait );
 
-        vlc_mutex_unlock( &preparser->lock );
+        vlc_mutex_unlock( &task->lock );
     }
 
     (void) obj; (void) varname; (void) old;
     return VLC_SUCCESS;
 }
 
+/* Called on timeout or cancellation */
+static void InputInterrupt( void *data )
+{
+    preparser_task_t *task = data;
+
+    vlc_mutex_lock( &task->lock );
+    if( task->state == INPUT_RUNNING )
+        task->state = INPUT_CANCELED;
+    vlc_cond_signal( &task->wait );
+    vlc_mutex_unlock( &task->lock );
+}
+
 /**
  * This function preparses an item when needed.
  */
-static void Preparse( playlist_preparser_t *preparser,
-                      preparser_entry_t *p_entry )
+static void Preparse( playlist_preparser_t *preparser, input_item_t *p_item,
+                      input_item_meta_request_option_t i_options )
 {
-    input_item_t *p_item = p_entry->p_item;
-
     vlc_mutex_lock( &p_item->lock );
     int i_type = p_item->i_type;
     bool b_net = p_item->b_net;
@@ -229,7 +209,7 @@ static void Preparse( playlist_preparser_t *preparser,
     case ITEM_TYPE_DIRECTORY:
     case ITEM_TYPE_PLAYLIST:
     case ITEM_TYPE_NODE:
-        if( !b_net || p_entry->i_options & META_REQUEST_OPTION_SCOPE_NETWORK )
+        if( !b_net || i_options & META_REQUEST_OPTION_SCOPE_NETWORK )
             b_preparse = true;
         break;
     }
@@ -237,7 +217,9 @@ static void Preparse( playlist_preparser_t *preparser,
     /* Do not preparse if it is already done (like by playing it) */
     if( b_preparse && !input_item_IsPreparsed( p_item ) )
     {
+        preparser_task_t task;
         int status;
+
         input_thread_t *input = input_CreatePreparser( preparser->object, p_item );
         if( input == NULL )
         {
@@ -245,41 +227,37 @@ static void Preparse( playlist_preparser_t *preparser,
             return;
         }
 
-        var_AddCallback( input, "intf-event", InputEvent, preparser );
+        vlc_mutex_init( &task.lock );
+        vlc_cond_init( &task.wait );
+        task.state = INPUT_RUNNING;
+
+        var_AddCallback( input, "intf-event", InputEvent, &task );
         if( input_Start( input ) == VLC_SUCCESS )
         {
-            vlc_mutex_lock( &preparser->lock );
-
-            if( p_entry->timeout > 0 )
-            {
-                mtime_t deadline = mdate() + p_entry->timeout;
-                while( preparser->input_state == INPUT_RUNNING )
-                {
-                    if( vlc_cond_timedwait( &preparser->thread_wait,
-                                            &preparser->lock, deadline ) )
-                        preparser->input_state = INPUT_CANCELED; /* timeout */
-                }
-            }
-            else
-            {
-                while( preparser->input_state == INPUT_RUNNING )
-                    vlc_cond_wait( &preparser->thread_wait, &preparser->lock );
-            }
-            assert( preparser->input_state == INPUT_STOPPED
-                 || preparser->input_state == INPUT_CANCELED );
-            status = preparser->input_state == INPUT_STOPPED ?
+            vlc_interrupt_register( InputInterrupt, &task );
+
+            vlc_mutex_lock( &task.lock );
+            while( task.state == INPUT_RUNNING )
+                vlc_cond_wait( &task.wait, &task.lock );
+            assert( task.state == INPUT_STOPPED
+                 || task.state == INPUT_CANCELED );
+            status = task.state == INPUT_STOPPED ?
                      ITEM_PREPARSE_DONE : ITEM_PREPARSE_TIMEOUT;
+            vlc_mutex_unlock( &task.lock );
 
-            vlc_mutex_unlock( &preparser->lock );
+            vlc_interrupt_unregister();
         }
         else
             status = ITEM_PREPARSE_FAILED;
 
-        var_DelCallback( input, "intf-event", InputEvent, preparser );
+        var_DelCallback( input, "intf-event", InputEvent, &task );
         if( status == ITEM_PREPARSE_TIMEOUT )
             input_Stop( input );
         input_Close( input );
 
+        vlc_cond_destroy( &task.wait );
+        vlc_mutex_destroy( &task.lock );
+
         var_SetAddress( preparser->object, "item-change", p_item );
         input_item_SetPreparsed( p_item, true );
         input_item_SignalPreparseEnded( p_item, status );
@@ -291,7 +269,8 @@ static void Preparse( playlist_preparser_t *preparser,
 /**
  * This function ask the fetcher object to fetch the art when needed
  */
-static void Art( playlist_preparser_t *p_preparser, input_item_t *p_item )
+static void Art( playlist_preparser_t *p_preparser, input_item_t *p_item,
+                 input_item_meta_request_option_t i_options )
 {
     vlc_object_t *obj = p_preparser->object;
     playlist_fetcher_t *p_fetcher = p_preparser->p_fetcher;
@@ -326,46 +305,19 @@ static void Art( playlist_preparser_t *p_preparser, input_item_t *p_item )
     vlc_mutex_unlock( &p_item->lock );
 
     if( b_fetch && p_fetcher )
-        playlist_fetcher_Push( p_fetcher, p_item, 0 );
+        playlist_fetcher_Push( p_fetcher, p_item,
+                               i_options & META_REQUEST_OPTION_PRIORITY );
 }
 
 /**
  * This function does the preparsing and issues the art fetching requests
  */
-static void *Thread( void *data )
+static bool Run( void *owner, void *entity, int *options )
 {
-    playlist_preparser_t *p_preparser = data;
-
-    for( ;; )
-    {
-        preparser_entry_t *p_entry;
+    playlist_preparser_t *p_preparser = owner;
+    input_item_t *p_item = entity;
 
-        vlc_mutex_lock( &p_preparser->lock );
-        /* */
-        p_preparser->input_state = INPUT_RUNNING;
-        if( p_preparser->i_waiting > 0 )
-        {
-            p_entry = p_preparser->pp_waiting[0];
-            p_preparser->input_id = p_entry->id;
-            REMOVE_ELEM( p_preparser->pp_waiting, p_preparser->i_waiting, 0 );
-        }
-        else
-        {
-            p_preparser->b_live = false;
-            p_preparser->input_id = NULL;
-            vlc_cond_signal( &p_preparser->wait );
-            vlc_mutex_unlock( &p_preparser->lock );
-            break;
-        }
-        vlc_mutex_unlock( &p_preparser->lock );
-        assert( p_entry );
-
-        Preparse( p_preparser, p_entry );
-
-        Art( p_preparser, p_entry->p_item );
-        vlc_gc_decref( p_entry->p_item );
-        free( p_entry );
-    }
-    return NULL;
+    Preparse( p_preparser, p_item, *options );
+    Art( p_preparser, p_item, *options );
+    return false;
 }
-
@@ -36,7 +36,10 @@
 typedef struct playlist_preparser_t playlist_preparser_t;
 
 /**
- * This function creates the preparser object and thread.
+ * This function creates the preparser object.
+ *
+ * Up to "preparse-threads" items are preparsed at the same time, by threads
+ * spawned on demand.
  */
 playlist_preparser_t *playlist_preparser_New( vlc_object_t * );
 
@@ -53,6 +56,10 @@ playlist_preparser_t *playlist_preparser_New( vlc_object_t * );
  * indefinitely. If > 0, the timeout will be used (in milliseconds).
  * @param id unique id provided by the caller. This is can be used to cancel
  * the request with playlist_preparser_Cancel()
+ *
+ * Items requested with META_REQUEST_OPTION_PRIORITY are processed first. An
+ * item pushed again with the same id while it is still queued or being
+ * preparsed is not preparsed twice.
  */
 void playlist_preparser_Push( playlist_preparser_t *, input_item_t *,
                               input_item_meta_request_option_t,
@@ -69,7 +76,15 @@ void playlist_preparser_fetcher_Push( playlist_preparser_t *, input_item_t *,
 void playlist_preparser_Cancel( playlist_preparser_t *, void *id );
 
 /**
- * This function destroys the preparser object and thread.
+ * This function gets the number of preparsed and art fetched items, and of
+ * items still queued or being processed.
+ */
+void playlist_preparser_GetStats( playlist_preparser_t *,
+                                  uint64_t *parsed, unsigned *parse_pending,
+                                  uint64_t *fetched, unsigned *fetch_pending );
+
+/**
+ * This function destroys the preparser object and threads.
  *
  * All pending input items will be released.
  */
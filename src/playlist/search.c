@@ -24,6 +24,12 @@
 # include "config.h"
 #endif
 #include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wctype.h>
+#ifdef HAVE_SEARCH_H
+# include <search.h>
+#endif
 
 #include <vlc_common.h>
 #include <vlc_playlist.h>
@@ -31,9 +37,448 @@
 #include "playlist_internal.h"
 
 /***************************************************************************
- * Item search functions
+ * Search index
  ***************************************************************************/
 
+/* The index maps case-folded trigrams of the item title (or name), album
+ * and artist to the items containing them. It is built on the first search
+ * and kept in sync with the playlist items afterwards. The posting lists are
+ * append-only, so they may reference removed or outdated entries: every
+ * candidate is checked against its folded text anyway. */
+
+#define SEARCH_GRAM_BITS 12
+#define SEARCH_GRAMS (1 << SEARCH_GRAM_BITS)
+
+typedef struct search_entry_t
+{
+    playlist_item_t *p_item; /**< indexed item, NULL once removed */
+    char *psz_text; /**< folded fields, each nul-terminated, then a nul */
+    unsigned i_grams; /**< number of posting list references */
+    unsigned i_stamp; /**< last query matched by the entry */
+    bool b_stale; /**< text must be (re)computed */
+} search_entry_t;
+
+typedef DECL_ARRAY(search_entry_t *) search_list_t;
+
+struct playlist_search_index_t
+{
+    vlc_mutex_t lock;
+    bool b_built;
+    void *tree; /**< input item to entry mapping */
+    search_list_t entries; /**< all entries, including removed ones */
+    search_list_t stale; /**< entries to (re)index */
+    search_list_t *p_grams; /**< trigram posting lists */
+    size_t i_dead; /**< number of removed entries */
+    size_t i_postings; /**< number of posting list references */
+    size_t i_live_postings; /**< number of them that are up to date */
+
+    search_list_t matches; /**< entries matched by the last query */
+    char *psz_last; /**< last folded query */
+    unsigned i_generation; /**< bumped when entries are added or changed */
+    unsigned i_last_generation; /**< generation of the last query */
+    unsigned i_stamp;
+};
+
+static int SearchEntryCmp( const void *a, const void *b )
+{
+    const search_entry_t *ea = a, *eb = b;
+    uintptr_t ia = (uintptr_t)ea->p_item->p_input;
+    uintptr_t ib = (uintptr_t)eb->p_item->p_input;
+
+    if( ia == ib )
+        return 0;
+    return ia > ib ? +1 : -1;
+}
+
+static void SearchNoop( void *data )
+{
+    (void) data;
+}
+
+/**
+ * Case-folds an UTF-8 string the same way as vlc_strcasestr().
+ * \param buf output buffer of at least twice the string length plus one
+ * \return the end of the folded string in the buffer
+ */
+static char *SearchFold( char *buf, const char *str )
+{
+    for( ;; )
+    {
+        uint32_t cp;
+        size_t n = vlc_towc( str, &cp );
+
+        if( n == 0 || n == (size_t)-1 )
+            break;
+        str += n;
+
+        cp = towlower( cp );
+        if( cp < 0x80 )
+            *(buf++) = cp;
+        else if( cp < 0x800 )
+        {
+            *(buf++) = 0xC0 | (cp >> 6);
+            *(buf++) = 0x80 | (cp & 0x3F);
+        }
+        else if( cp < 0x10000 )
+        {
+            *(buf++) = 0xE0 | (cp >> 12);
+            *(buf++) = 0x80 | ((cp >> 6) & 0x3F);
+            *(buf++) = 0x80 | (cp & 0x3F);
+        }
+        else
+        {
+            *(buf++) = 0xF0 | (cp >> 18);
+            *(buf++) = 0x80 | ((cp >> 12) & 0x3F);
+            *(buf++) = 0x80 | ((cp >> 6) & 0x3F);
+            *(buf++) = 0x80 | (cp & 0x3F);
+        }
+    }
+    *buf = '\0';
+    return buf;
+}
+
+static char *SearchFoldDup( const char *str )
+{
+    char *buf = malloc( 2 * strlen( str ) + 1 );
+    if( likely(buf != NULL) )
+        SearchFold( buf, str );
+    return buf;
+}
+
+static unsigned SearchGram( const char *p )
+{
+    uint32_t gram = (uint8_t)p[0] | ((uint8_t)p[1] << 8)
+                  | ((uint32_t)(uint8_t)p[2] << 16);
+    return (gram * UINT32_C(2654435761)) >> (32 - SEARCH_GRAM_BITS);
+}
+
+/**
+ * Computes the folded text of an entry and adds it to the posting lists.
+ */
+static void SearchEntryIndex( playlist_search_index_t *p_index,
+                              search_entry_t *p_entry )
+{
+    input_item_t *p_input = p_entry->p_item->p_input;
+    const char *fields[3] = { NULL, NULL, NULL };
+    size_t i_size = 2;
+
+    free( p_entry->psz_text );
+    p_entry->psz_text = NULL;
+    p_index->i_live_postings -= p_entry->i_grams;
+    p_entry->i_grams = 0;
+
+    vlc_mutex_lock( &p_input->lock );
+    /* Use Title or fall back to psz_name */
+    if( p_input->p_meta )
+    {
+        fields[0] = vlc_meta_Get( p_input->p_meta, vlc_meta_Title );
+        fields[1] = vlc_meta_Get( p_input->p_meta, vlc_meta_Album );
+        fields[2] = vlc_meta_Get( p_input->p_meta, vlc_meta_Artist );
+    }
+    if( !fields[0] )
+        fields[0] = p_input->psz_name;
+
+    for( unsigned i = 0; i < 3; i++ )
+        if( fields[i] )
+            i_size += 2 * strlen( fields[i] ) + 1;
+
+    char *psz_text = malloc( i_size ), *p = psz_text;
+    if( likely(psz_text != NULL) )
+    {
+        for( unsigned i = 0; i < 3; i++ )
+            if( fields[i] && *fields[i] )
+                p = SearchFold( p, fields[i] ) + 1;
+        *p = '\0';
+    }
+    vlc_mutex_unlock( &p_input->lock );
+
+    p_entry->psz_text = psz_text;
+    if( unlikely(psz_text == NULL) )
+        return;
+
+    for( p = psz_text; *p; p += strlen( p ) + 1 )
+        for( const char *g = p; g[0] && g[1] && g[2]; g++ )
+        {
+            unsigned i_gram = SearchGram( g );
+            const search_list_t *p_list = &p_index->p_grams[i_gram];
+
+            if( p_list->i_size > 0
+             && p_list->p_elems[p_list->i_size - 1] == p_entry )
+                continue; /* already referenced by this pass */
+            ARRAY_APPEND( p_index->p_grams[i_gram], p_entry );
+            p_entry->i_grams++;
+        }
+
+    p_index->i_postings += p_entry->i_grams;
+    p_index->i_live_postings += p_entry->i_grams;
+}
+
+static void SearchEntryAdd( playlist_search_index_t *p_index,
+                            playlist_item_t *p_item )
+{
+    search_entry_t *p_entry = malloc( sizeof( *p_entry ) );
+    if( unlikely(p_entry == NULL) )
+        return;
+
+    p_entry->p_item = p_item;
+    p_entry->psz_text = NULL;
+    p_entry->i_grams = 0;
+    p_entry->i_stamp = 0;
+    p_entry->b_stale = true;
+
+    search_entry_t **pp = tsearch( p_entry, &p_index->tree, SearchEntryCmp );
+    if( unlikely(pp == NULL) )
+    {
+        free( p_entry );
+        return;
+    }
+    assert( *pp == p_entry );
+
+    ARRAY_APPEND( p_index->entries, p_entry );
+    ARRAY_APPEND( p_index->stale, p_entry );
+    p_index->i_generation++;
+}
+
+static void SearchIndexBuild( playlist_search_index_t *p_index,
+                              playlist_item_t *p_node )
+{
+    for( int i = 0; i < p_node->i_children; i++ )
+    {
+        playlist_item_t *p_item = p_node->pp_children[i];
+
+        SearchEntryAdd( p_index, p_item );
+        if( p_item->i_children >= 0 )
+            SearchIndexBuild( p_index, p_item );
+    }
+}
+
+/**
+ * Drops all entries. The index will be built again on the next search.
+ */
+static void SearchIndexReset( playlist_search_index_t *p_index )
+{
+    tdestroy( p_index->tree, SearchNoop );
+    p_index->tree = NULL;
+
+    for( int i = 0; i < p_index->entries.i_size; i++ )
+    {
+        free( p_index->entries.p_elems[i]->psz_text );
+        free( p_index->entries.p_elems[i] );
+    }
+    ARRAY_RESET( p_index->entries );
+    ARRAY_RESET( p_index->stale );
+    ARRAY_RESET( p_index->matches );
+
+    if( p_index->p_grams != NULL )
+        for( unsigned i = 0; i < SEARCH_GRAMS; i++ )
+            ARRAY_RESET( p_index->p_grams[i] );
+    free( p_index->p_grams );
+    p_index->p_grams = NULL;
+
+    free( p_index->psz_last );
+    p_index->psz_last = NULL;
+    p_index->b_built = false;
+    p_index->i_dead = 0;
+    p_index->i_postings = 0;
+    p_index->i_live_postings = 0;
+    p_index->i_generation++;
+}
+
+playlist_search_index_t *playlist_SearchIndexNew( void )
+{
+    playlist_search_index_t *p_index = malloc( sizeof( *p_index ) );
+    if( unlikely(p_index == NULL) )
+        return NULL;
+
+    vlc_mutex_init( &p_index->lock );
+    p_index->b_built = false;
+    p_index->tree = NULL;
+    ARRAY_INIT( p_index->entries );
+    ARRAY_INIT( p_index->stale );
+    ARRAY_INIT( p_index->matches );
+    p_index->p_grams = NULL;
+    p_index->i_dead = 0;
+    p_index->i_postings = 0;
+    p_index->i_live_postings = 0;
+    p_index->psz_last = NULL;
+    p_index->i_generation = 0;
+    p_index->i_last_generation = 0;
+    p_index->i_stamp = 0;
+    return p_index;
+}
+
+void playlist_SearchIndexDelete( playlist_search_index_t *p_index )
+{
+    SearchIndexReset( p_index );
+    vlc_mutex_destroy( &p_index->lock );
+    free( p_index );
+}
+
+/**
+ * Indexes a new playlist item, if the index is in use.
+ */
+void playlist_SearchIndexAdd( playlist_t *p_playlist, playlist_item_t *p_item )
+{
+    playlist_search_index_t *p_index = pl_priv(p_playlist)->p_search_index;
+
+    PL_ASSERT_LOCKED;
+    vlc_mutex_lock( &p_index->lock );
+    if( p_index->b_built )
+        SearchEntryAdd( p_index, p_item );
+    vlc_mutex_unlock( &p_index->lock );
+}
+
+/**
+ * Removes a playlist item from the index.
+ */
+void playlist_SearchIndexRemove( playlist_t *p_playlist,
+                                 playlist_item_t *p_item )
+{
+    playlist_search_index_t *p_index = pl_priv(p_playlist)->p_search_index;
+    search_entry_t key = { .p_item = p_item };
+
+    PL_ASSERT_LOCKED;
+    vlc_mutex_lock( &p_index->lock );
+    search_entry_t **pp = tfind( &key, &p_index->tree, SearchEntryCmp );
+    if( pp != NULL )
+    {
+        search_entry_t *p_entry = *pp;
+
+        tdelete( p_entry, &p_index->tree, SearchEntryCmp );
+        p_entry->p_item = NULL;
+        free( p_entry->psz_text );
+        p_entry->psz_text = NULL;
+        p_index->i_live_postings -= p_entry->i_grams;
+        p_entry->i_grams = 0;
+
+        /* Do not keep a mostly dead index around */
+        if( ++p_index->i_dead > (size_t)p_index->entries.i_size / 2 )
+            SearchIndexReset( p_index );
+    }
+    vlc_mutex_unlock( &p_index->lock );
+}
+
+/**
+ * Flags the entry of an input item for reindexing.
+ *
+ * This is called from the input item events, without the playlist lock.
+ */
+void playlist_SearchIndexUpdate( playlist_t *p_playlist, input_item_t *p_input )
+{
+    playlist_search_index_t *p_index = pl_priv(p_playlist)->p_search_index;
+    playlist_item_t item = { .p_input = p_input };
+    search_entry_t key = { .p_item = &item };
+
+    vlc_mutex_lock( &p_index->lock );
+    search_entry_t **pp = tfind( &key, &p_index->tree, SearchEntryCmp );
+    if( pp != NULL && !(*pp)->b_stale )
+    {
+        (*pp)->b_stale = true;
+        ARRAY_APPEND( p_index->stale, *pp );
+        p_index->i_generation++;
+    }
+    vlc_mutex_unlock( &p_index->lock );
+}
+
+static void SearchIndexRefresh( playlist_search_index_t *p_index,
+                                playlist_item_t *p_root )
+{
+    /* Too many outdated references, start over */
+    if( p_index->i_postings > 2 * p_index->i_live_postings + SEARCH_GRAMS )
+        SearchIndexReset( p_index );
+
+    if( !p_index->b_built )
+    {
+        p_index->p_grams = malloc( SEARCH_GRAMS * sizeof( *p_index->p_grams ) );
+        if( unlikely(p_index->p_grams == NULL) )
+            return;
+        for( unsigned i = 0; i < SEARCH_GRAMS; i++ )
+            ARRAY_INIT( p_index->p_grams[i] );
+        p_index->b_built = true;
+        SearchIndexBuild( p_index, p_root );
+    }
+
+    for( int i = 0; i < p_index->stale.i_size; i++ )
+    {
+        search_entry_t *p_entry = p_index->stale.p_elems[i];
+
+        p_entry->b_stale = false;
+        if( p_entry->p_item != NULL )
+            SearchEntryIndex( p_index, p_entry );
+    }
+    ARRAY_RESET( p_index->stale );
+}
+
+static bool SearchEntryMatch( const search_entry_t *p_entry,
+                              const char *psz_query )
+{
+    if( p_entry->p_item == NULL || p_entry->psz_text == NULL )
+        return false;
+
+    for( const char *p = p_entry->psz_text; *p; p += strlen( p ) + 1 )
+        if( strstr( p, psz_query ) != NULL )
+            return true;
+    return false;
+}
+
+/**
+ * Finds the entries matching a folded query.
+ *
+ * If the query refines the previous one and no entry was added or changed
+ * since, only the previous matches are checked. Otherwise, the candidates
+ * come from the shortest posting list among the query trigrams.
+ */
+static void SearchIndexQuery( playlist_search_index_t *p_index,
+                              char *psz_query )
+{
+    search_list_t candidates;
+    bool b_owned = false;
+
+    if( p_index->psz_last != NULL
+     && p_index->i_last_generation == p_index->i_generation
+     && strstr( psz_query, p_index->psz_last ) != NULL )
+    {
+        candidates = p_index->matches;
+        b_owned = true;
+    }
+    else if( strlen( psz_query ) >= 3 )
+    {
+        candidates = p_index->p_grams[SearchGram( psz_query )];
+        for( const char *g = psz_query + 1; g[2]; g++ )
+        {
+            const search_list_t *p_list = &p_index->p_grams[SearchGram( g )];
+
+            if( p_list->i_size < candidates.i_size )
+                candidates = *p_list;
+        }
+    }
+    else
+        candidates = p_index->entries;
+
+    search_list_t matches;
+    unsigned i_stamp = ++p_index->i_stamp;
+
+    ARRAY_INIT( matches );
+    for( int i = 0; i < candidates.i_size; i++ )
+    {
+        search_entry_t *p_entry = candidates.p_elems[i];
+
+        if( p_entry->i_stamp != i_stamp
+         && SearchEntryMatch( p_entry, psz_query ) )
+        {
+            p_entry->i_stamp = i_stamp;
+            ARRAY_APPEND( matches, p_entry );
+        }
+    }
+
+    if( b_owned )
+        ARRAY_RESET( candidates );
+    p_index->matches = matches;
+    free( p_index->psz_last );
+    p_index->psz_last = psz_query;
+    p_index->i_last_generation = p_index->i_generation;
+}
+
 /***************************************************************************
  * Live search handling
  ***************************************************************************/
@@ -53,62 +498,81 @@ static void playlist_LiveSearchClean( playlist_item_t *p_root )
     }
 }
 
+/**
+ * Disable all items in the playlist
+ * @param p_root: the current root item
+ * @param b_recursive: whether to disable the descendants of the children
+ */
+static void playlist_LiveSearchHide( playlist_item_t *p_root,
+                                     bool b_recursive )
+{
+    for( int i = 0; i < p_root->i_children; i++ )
+    {
+        playlist_item_t *p_item = p_root->pp_children[i];
+        if( b_recursive && p_item->i_children >= 0 )
+            playlist_LiveSearchHide( p_item, true );
+        p_item->i_flags |= PLAYLIST_DBL_FLAG;
+    }
+}
 
 /**
  * Enable/Disable items in the playlist according to the search argument
+ * @param p_playlist: the playlist
  * @param p_root: the current root item
  * @param psz_string: the string to search
- * @return true if an item match
+ * @param b_recursive: whether to search the descendants of the children
  */
-static bool playlist_LiveSearchUpdateInternal( playlist_item_t *p_root,
-                                               const char *psz_string, bool b_recursive )
+static void playlist_LiveSearchUpdateInternal( playlist_t *p_playlist,
+                                               playlist_item_t *p_root,
+                                               const char *psz_string,
+                                               bool b_recursive )
 {
-    int i;
-    bool b_match = false;
-    for( i = 0 ; i < p_root->i_children ; i ++ )
+    playlist_search_index_t *p_index = pl_priv(p_playlist)->p_search_index;
+
+    playlist_LiveSearchHide( p_root, b_recursive );
+
+    char *psz_query = SearchFoldDup( psz_string );
+    if( unlikely(psz_query == NULL) )
+        return;
+
+    vlc_mutex_lock( &p_index->lock );
+    SearchIndexRefresh( p_index, p_playlist->p_root );
+    if( unlikely(!p_index->b_built) )
     {
-        bool b_enable = false;
-        playlist_item_t *p_item = p_root->pp_children[i];
-        // Go recurssively if their is some children
-        if( b_recursive && p_item->i_children >= 0 &&
-            playlist_LiveSearchUpdateInternal( p_item, psz_string, true ) )
-        {
-            b_enable = true;
-        }
+        vlc_mutex_unlock( &p_index->lock );
+        free( psz_query );
+        return;
+    }
+    SearchIndexQuery( p_index, psz_query );
+
+    /* Enable the matching items, and their parents down to the root */
+    for( int i = 0; i < p_index->matches.i_size; i++ )
+    {
+        playlist_item_t *p_item = p_index->matches.p_elems[i]->p_item;
+        playlist_item_t *p_parent = p_item->p_parent;
 
-        if( !b_enable )
+        if( !b_recursive )
         {
-            vlc_mutex_lock( &p_item->p_input->lock );
-            // Do we have some meta ?
-            if( p_item->p_input->p_meta )
-            {
-                // Use Title or fall back to psz_name
-                const char *psz_title = vlc_meta_Get( p_item->p_input->p_meta, vlc_meta_Title );
-                if( !psz_title )
-                    psz_title = p_item->p_input->psz_name;
-                const char *psz_album = vlc_meta_Get( p_item->p_input->p_meta, vlc_meta_Album );
-                const char *psz_artist = vlc_meta_Get( p_item->p_input->p_meta, vlc_meta_Artist );
-                b_enable = ( psz_title && vlc_strcasestr( psz_title, psz_string ) ) ||
-                           ( psz_album && vlc_strcasestr( psz_album, psz_string ) ) ||
-                           ( psz_artist && vlc_strcasestr( psz_artist, psz_string ) );
-            }
-            else
-                b_enable = p_item->p_input->psz_name && vlc_strcasestr( p_item->p_input->psz_name, psz_string );
-            vlc_mutex_unlock( &p_item->p_input->lock );
+            if( p_parent == p_root )
+                p_item->i_flags &= ~PLAYLIST_DBL_FLAG;
+            continue;
         }
 
-        if( b_enable )
-            p_item->i_flags &= ~PLAYLIST_DBL_FLAG;
-        else
-            p_item->i_flags |= PLAYLIST_DBL_FLAG;
+        while( p_parent != NULL && p_parent != p_root )
+            p_parent = p_parent->p_parent;
+        if( p_parent == NULL )
+            continue; /* not below the root */
 
-        b_match |= b_enable;
-   }
-   return b_match;
+        for( ; p_item != p_root; p_item = p_item->p_parent )
+        {
+            if( !(p_item->i_flags & PLAYLIST_DBL_FLAG) )
+                break; /* already enabled with its parents */
+            p_item->i_flags &= ~PLAYLIST_DBL_FLAG;
+        }
+    }
+    vlc_mutex_unlock( &p_index->lock );
 }
 
-
-
 /**
  * Launch the recursive search in the playlist
  * @param p_playlist: the playlist
@@ -122,7 +586,8 @@ int playlist_LiveSearchUpdate( playlist_t *p_playlist, playlist_item_t *p_root,
     PL_ASSERT_LOCKED;
     pl_priv(p_playlist)->b_reset_currently_playing = true;
     if( *psz_string )
-        playlist_LiveSearchUpdateInternal( p_root, psz_string, b_recursive );
+        playlist_LiveSearchUpdateInternal( p_playlist, p_root, psz_string,
+                                           b_recursive );
     else
         playlist_LiveSearchClean( p_root );
     vlc_cond_signal( &pl_priv(p_playlist)->signal );
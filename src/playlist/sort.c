@@ -26,84 +26,281 @@
 # include "config.h"
 #endif
 
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include <vlc_common.h>
 #include <vlc_rand.h>
 #define  VLC_INTERNAL_PLAYLIST_SORT_FUNCTIONS
 #include "vlc_playlist.h"
 #include "playlist_internal.h"
 
+/* Items are not compared directly: the metadata each sorting mode needs is
+ * fetched and case-folded once per item into a sort key, then the keys are
+ * sorted, and the node children are permuted accordingly. */
+
+/* String fields of the sort keys */
+enum
+{
+    KEY_ALBUM,
+    KEY_ARTIST,
+    KEY_DESCRIPTION,
+    KEY_GENRE,
+    KEY_URI,
+    KEY_STRINGS
+};
+
+/* Integer fields of the sort keys */
+enum
+{
+    KEY_DATE,
+    KEY_TRACK_NUMBER,
+    KEY_RATING,
+    KEY_DISC_NUMBER,
+    KEY_NUMBERS
+};
+
+#define KEY_TITLE    (1 << 0)
+#define KEY_DURATION (1 << 1)
+#define KEY_STRING( i ) (1 << (2 + (i)))
+#define KEY_NUMBER( i ) (1 << (2 + KEY_STRINGS + (i)))
+
+static const vlc_meta_type_t key_string_metas[KEY_URI] = {
+    vlc_meta_Album, vlc_meta_Artist, vlc_meta_Description, vlc_meta_Genre,
+};
+
+static const vlc_meta_type_t key_number_metas[KEY_NUMBERS] = {
+    vlc_meta_Date, vlc_meta_TrackNumber, vlc_meta_Rating, vlc_meta_DiscNumber,
+};
+
+typedef struct
+{
+    const playlist_item_t *p_item;
+    bool b_node;
+    char *psz_title; /**< folded title or name, or NULL */
+    int i_title; /**< integer value of the title */
+    char *psz_strings[KEY_STRINGS]; /**< folded strings, or NULL if unset */
+    int i_numbers[KEY_NUMBERS];
+    uint8_t i_has_numbers; /**< mask of the set integer fields */
+    mtime_t i_duration;
+} sort_key_t;
+
+/**
+ * Fields needed by a sorting mode
+ */
+static unsigned sort_key_fields( unsigned i_mode )
+{
+    switch( i_mode )
+    {
+        case SORT_ID:
+            return 0;
+        case SORT_TITLE:
+        case SORT_TITLE_NODES_FIRST:
+        case SORT_TITLE_NUMERIC:
+            return KEY_TITLE;
+        case SORT_ARTIST:
+            return KEY_TITLE | KEY_STRING( KEY_ARTIST )
+                 | KEY_NUMBER( KEY_DATE ) | KEY_STRING( KEY_ALBUM )
+                 | KEY_NUMBER( KEY_TRACK_NUMBER );
+        case SORT_DATE:
+            return KEY_TITLE | KEY_NUMBER( KEY_DATE )
+                 | KEY_STRING( KEY_ALBUM ) | KEY_NUMBER( KEY_TRACK_NUMBER );
+        case SORT_ALBUM:
+            return KEY_TITLE | KEY_STRING( KEY_ALBUM )
+                 | KEY_NUMBER( KEY_TRACK_NUMBER );
+        case SORT_GENRE:
+            return KEY_TITLE | KEY_STRING( KEY_GENRE );
+        case SORT_DESCRIPTION:
+            return KEY_TITLE | KEY_STRING( KEY_DESCRIPTION );
+        case SORT_DURATION:
+            return KEY_DURATION;
+        case SORT_TRACK_NUMBER:
+            return KEY_TITLE | KEY_NUMBER( KEY_TRACK_NUMBER );
+        case SORT_DISC_NUMBER:
+            return KEY_TITLE | KEY_NUMBER( KEY_DISC_NUMBER );
+        case SORT_RATING:
+            return KEY_TITLE | KEY_NUMBER( KEY_RATING );
+        case SORT_URI:
+            return KEY_STRING( KEY_URI );
+    }
+    return 0;
+}
+
+/**
+ * Duplicates a string folded like strcasecmp() does, so that strcmp() on
+ * folded strings orders them like strcasecmp() on the original ones.
+ */
+static char *sort_key_fold( const char *psz )
+{
+    if( psz == NULL )
+        return NULL;
+
+    char *psz_folded = strdup( psz );
+    if( likely(psz_folded != NULL) )
+        for( char *p = psz_folded; *p; p++ )
+            *p = tolower( (unsigned char)*p );
+    return psz_folded;
+}
+
+static void sort_key_init( sort_key_t *p_key, const playlist_item_t *p_item,
+                           unsigned i_fields )
+{
+    input_item_t *p_input = p_item->p_input;
+
+    memset( p_key, 0, sizeof( *p_key ) );
+    p_key->p_item = p_item;
+    p_key->b_node = p_item->i_children >= 0;
+    if( i_fields == 0 )
+        return;
+
+    vlc_mutex_lock( &p_input->lock );
+    if( i_fields & KEY_TITLE )
+    {
+        const char *psz_title = NULL;
+
+        if( p_input->p_meta != NULL )
+            psz_title = vlc_meta_Get( p_input->p_meta, vlc_meta_Title );
+        if( EMPTY_STR( psz_title ) )
+            psz_title = p_input->psz_name;
+        p_key->psz_title = sort_key_fold( psz_title );
+        if( psz_title != NULL )
+            p_key->i_title = atoi( psz_title );
+    }
+
+    for( unsigned i = 0; i < KEY_STRINGS; i++ )
+    {
+        if( !(i_fields & KEY_STRING( i )) )
+            continue;
+        if( i == KEY_URI )
+            p_key->psz_strings[i] = sort_key_fold( p_input->psz_uri );
+        else if( p_input->p_meta != NULL )
+            p_key->psz_strings[i] = sort_key_fold(
+                vlc_meta_Get( p_input->p_meta, key_string_metas[i] ) );
+    }
+
+    for( unsigned i = 0; i < KEY_NUMBERS; i++ )
+    {
+        const char *psz;
+
+        if( !(i_fields & KEY_NUMBER( i )) || p_input->p_meta == NULL )
+            continue;
+        psz = vlc_meta_Get( p_input->p_meta, key_number_metas[i] );
+        if( psz != NULL )
+        {
+            p_key->i_numbers[i] = atoi( psz );
+            p_key->i_has_numbers |= 1 << i;
+        }
+    }
+
+    p_key->i_duration = p_input->i_duration;
+    vlc_mutex_unlock( &p_input->lock );
+}
+
+static void sort_key_clean( sort_key_t *p_key )
+{
+    free( p_key->psz_title );
+    for( unsigned i = 0; i < KEY_STRINGS; i++ )
+        free( p_key->psz_strings[i] );
+}
 
 /* General comparison functions */
 /**
- * Compare two items using their title or name
- * @param first: the first item
- * @param second: the second item
+ * Compare two strings, the unset ones last
  * @return -1, 0 or 1 like strcmp
  */
-static inline int meta_strcasecmp_title( const playlist_item_t *first,
-                              const playlist_item_t *second )
+static inline int key_strcmp( const char *psz_first, const char *psz_second )
 {
-    int i_ret;
-    char *psz_first = input_item_GetTitleFbName( first->p_input );
-    char *psz_second = input_item_GetTitleFbName( second->p_input );
-
     if( psz_first && psz_second )
-        i_ret = strcasecmp( psz_first, psz_second );
+        return strcmp( psz_first, psz_second );
     else if( !psz_first && psz_second )
-        i_ret = 1;
+        return 1;
     else if( psz_first && !psz_second )
-        i_ret = -1;
+        return -1;
     else
-        i_ret = 0;
-    free( psz_first );
-    free( psz_second );
-
-    return i_ret;
+        return 0;
 }
 
 /**
- * Compare two intems according to the given meta type
+ * Compare two items using their title or name
  * @param first: the first item
  * @param second: the second item
- * @param meta: the meta type to use to sort the items
- * @param b_integer: true if the meta are integers
  * @return -1, 0 or 1 like strcmp
  */
-static inline int meta_sort( const playlist_item_t *first,
-                             const playlist_item_t *second,
-                             vlc_meta_type_t meta, bool b_integer )
+static inline int meta_strcasecmp_title( const sort_key_t *first,
+                                         const sort_key_t *second )
 {
-    int i_ret;
-    char *psz_first = input_item_GetMeta( first->p_input, meta );
-    char *psz_second = input_item_GetMeta( second->p_input, meta );
+    return key_strcmp( first->psz_title, second->psz_title );
+}
 
+/**
+ * Compare the precedence of nodes and items
+ * @return -1 or 1 if only one of them is a node, 0 otherwise
+ */
+static inline int meta_sort_nodes( const sort_key_t *first,
+                                   const sort_key_t *second )
+{
     /* Nodes go first */
-    if( first->i_children == -1 && second->i_children >= 0 )
-        i_ret = 1;
-    else if( first->i_children >= 0 && second->i_children == -1 )
-       i_ret = -1;
+    if( !first->b_node && second->b_node )
+        return 1;
+    else if( first->b_node && !second->b_node )
+        return -1;
+    return 0;
+}
+
+/**
+ * Compare two items according to the given string field
+ * @param first: the first item
+ * @param second: the second item
+ * @param i_field: the KEY_* string field to use to sort the items
+ * @return -1, 0 or 1 like strcmp
+ */
+static inline int meta_sort( const sort_key_t *first,
+                             const sort_key_t *second, unsigned i_field )
+{
+    const char *psz_first = first->psz_strings[i_field];
+    const char *psz_second = second->psz_strings[i_field];
+    int i_ret = meta_sort_nodes( first, second );
+
+    if( i_ret != 0 )
+        return i_ret;
     /* Both are nodes, sort by name */
-    else if( first->i_children >= 0 && second->i_children >= 0 )
-        i_ret = meta_strcasecmp_title( first, second );
-    /* Both are items */
-    else if( !psz_first && psz_second )
-        i_ret = 1;
-    else if( psz_first && !psz_second )
-        i_ret = -1;
+    if( first->b_node )
+        return meta_strcasecmp_title( first, second );
     /* No meta, sort by name */
-    else if( !psz_first && !psz_second )
-        i_ret = meta_strcasecmp_title( first, second );
-    else
-    {
-        if( b_integer )
-            i_ret = atoi( psz_first ) - atoi( psz_second );
-        else
-            i_ret = strcasecmp( psz_first, psz_second );
-    }
+    if( !psz_first && !psz_second )
+        return meta_strcasecmp_title( first, second );
+    return key_strcmp( psz_first, psz_second );
+}
 
-    free( psz_first );
-    free( psz_second );
-    return i_ret;
+/**
+ * Compare two items according to the given integer field
+ * @param first: the first item
+ * @param second: the second item
+ * @param i_field: the KEY_* integer field to use to sort the items
+ * @return -1, 0 or 1 like strcmp
+ */
+static inline int meta_sort_integer( const sort_key_t *first,
+                                     const sort_key_t *second,
+                                     unsigned i_field )
+{
+    bool b_first = first->i_has_numbers & (1 << i_field);
+    bool b_second = second->i_has_numbers & (1 << i_field);
+    int i_ret = meta_sort_nodes( first, second );
+
+    if( i_ret != 0 )
+        return i_ret;
+    /* Both are nodes, or no meta, sort by name */
+    if( first->b_node || (!b_first && !b_second) )
+        return meta_strcasecmp_title( first, second );
+    if( !b_first )
+        return 1;
+    if( !b_second )
+        return -1;
+
+    int i_first = first->i_numbers[i_field];
+    int i_second = second->i_numbers[i_field];
+    return (i_first > i_second) - (i_first < i_second);
 }
 
 /* Comparison functions */
@@ -124,20 +321,154 @@ static inline sortfn_t find_sorting_fn( unsigned i_mode, unsigned i_type )
     return sorting_fns[i_mode][i_type];
 }
 
+/* Nodes with fewer children are sorted on the calling thread only */
+#define SORT_PARALLEL_MIN 4096
+
+typedef struct
+{
+    sort_key_t *p_keys;
+    size_t i_keys;
+    sortfn_t p_sortfn;
+} sort_chunk_t;
+
+static void *sort_chunk_thread( void *data )
+{
+    sort_chunk_t *p_chunk = data;
+
+    qsort( p_chunk->p_keys, p_chunk->i_keys, sizeof( *p_chunk->p_keys ),
+           p_chunk->p_sortfn );
+    return NULL;
+}
+
+/**
+ * Merge two consecutive sorted runs of keys
+ */
+static void sort_merge( sort_key_t *p_dst, const sort_key_t *p_left,
+                        size_t i_left, const sort_key_t *p_right,
+                        size_t i_right, sortfn_t p_sortfn )
+{
+    while( i_left > 0 && i_right > 0 )
+    {
+        if( p_sortfn( p_right, p_left ) < 0 )
+        {
+            *(p_dst++) = *(p_right++);
+            i_right--;
+        }
+        else
+        {
+            *(p_dst++) = *(p_left++);
+            i_left--;
+        }
+    }
+    memcpy( p_dst, p_left, i_left * sizeof( *p_left ) );
+    memcpy( p_dst + i_left, p_right, i_right * sizeof( *p_right ) );
+}
+
+/**
+ * Sort keys, splitting large arrays in chunks sorted by several threads,
+ * then merged.
+ */
+static void sort_keys( sort_key_t *p_keys, size_t i_keys, sortfn_t p_sortfn )
+{
+    unsigned i_threads = vlc_GetCPUCount();
+
+    if( i_threads > i_keys / SORT_PARALLEL_MIN )
+        i_threads = i_keys / SORT_PARALLEL_MIN;
+    if( i_threads > 16 )
+        i_threads = 16;
+
+    sort_key_t *p_tmp = NULL;
+    if( i_threads > 1 )
+        p_tmp = malloc( i_keys * sizeof( *p_tmp ) );
+    if( p_tmp == NULL )
+    {
+        qsort( p_keys, i_keys, sizeof( *p_keys ), p_sortfn );
+        return;
+    }
+
+    sort_chunk_t chunks[16];
+    vlc_thread_t threads[16];
+    bool b_started[16];
+
+    for( unsigned i = 0; i < i_threads; i++ )
+    {
+        size_t i_start = i_keys * i / i_threads;
+        size_t i_end = i_keys * (i + 1) / i_threads;
+
+        chunks[i].p_keys = p_keys + i_start;
+        chunks[i].i_keys = i_end - i_start;
+        chunks[i].p_sortfn = p_sortfn;
+        /* The calling thread sorts the first chunk */
+        b_started[i] = i > 0 && vlc_clone( &threads[i], sort_chunk_thread,
+                                           &chunks[i],
+                                           VLC_THREAD_PRIORITY_LOW ) == 0;
+    }
+    for( unsigned i = 0; i < i_threads; i++ )
+    {
+        if( b_started[i] )
+            vlc_join( threads[i], NULL );
+        else
+            sort_chunk_thread( &chunks[i] );
+    }
+
+    /* Merge the chunks pairwise, back and forth between the buffers */
+    sort_key_t *p_src = p_keys, *p_dst = p_tmp;
+    for( unsigned i_step = 1; i_step < i_threads; i_step *= 2 )
+    {
+        for( unsigned i = 0; i < i_threads; i += 2 * i_step )
+        {
+            size_t i_start = i_keys * i / i_threads;
+            size_t i_mid = i_keys * __MIN(i + i_step, i_threads) / i_threads;
+            size_t i_end = i_keys * __MIN(i + 2 * i_step, i_threads)
+                         / i_threads;
+
+            sort_merge( p_dst + i_start, p_src + i_start, i_mid - i_start,
+                        p_src + i_mid, i_end - i_mid, p_sortfn );
+        }
+
+        sort_key_t *p_swap = p_src;
+        p_src = p_dst;
+        p_dst = p_swap;
+    }
+
+    if( p_src != p_keys )
+        memcpy( p_keys, p_src, i_keys * sizeof( *p_keys ) );
+    free( p_tmp );
+}
+
 /**
  * Sort an array of items recursively
  * @param i_items: number of items
  * @param pp_items: the array of items
+ * @param i_mode: a SORT_* constant indicating the field to sort on
  * @param p_sortfn: the sorting function
  * @return nothing
  */
 static inline
 void playlist_ItemArraySort( unsigned i_items, playlist_item_t **pp_items,
-                             sortfn_t p_sortfn )
+                             unsigned i_mode, sortfn_t p_sortfn )
 {
+    if( i_items < 2 )
+        return;
+
     if( p_sortfn )
     {
-        qsort( pp_items, i_items, sizeof( pp_items[0] ), p_sortfn );
+        sort_key_t *p_keys = malloc( i_items * sizeof( *p_keys ) );
+        if( unlikely(p_keys == NULL) )
+            return;
+
+        unsigned i_fields = sort_key_fields( i_mode );
+        for( unsigned i = 0; i < i_items; i++ )
+            sort_key_init( &p_keys[i], pp_items[i], i_fields );
+
+        sort_keys( p_keys, i_items, p_sortfn );
+
+        for( unsigned i = 0; i < i_items; i++ )
+        {
+            pp_items[i] = (playlist_item_t *)p_keys[i].p_item;
+            sort_key_clean( &p_keys[i] );
+        }
+        free( p_keys );
     }
     else /* Randomise */
     {
@@ -161,19 +492,22 @@ void playlist_ItemArraySort( unsigned i_items, playlist_item_t **pp_items,
  * This function must be entered with the playlist lock !
  * @param p_playlist the playlist
  * @param p_node the node to sort
+ * @param i_mode: a SORT_* constant indicating the field to sort on
  * @param p_sortfn the sorting function
  * @return VLC_SUCCESS on success
  */
 static int recursiveNodeSort( playlist_t *p_playlist, playlist_item_t *p_node,
-                              sortfn_t p_sortfn )
+                              unsigned i_mode, sortfn_t p_sortfn )
 {
     int i;
-    playlist_ItemArraySort(p_node->i_children,p_node->pp_children,p_sortfn);
+    playlist_ItemArraySort(p_node->i_children,p_node->pp_children,i_mode,
+                           p_sortfn);
     for( i = 0 ; i< p_node->i_children; i++ )
     {
         if( p_node->pp_children[i]->i_children != -1 )
         {
-            recursiveNodeSort( p_playlist, p_node->pp_children[i], p_sortfn );
+            recursiveNodeSort( p_playlist, p_node->pp_children[i], i_mode,
+                               p_sortfn );
         }
     }
     return VLC_SUCCESS;
@@ -199,36 +533,38 @@ int playlist_RecursiveNodeSort( playlist_t *p_playlist, playlist_item_t *p_node,
     pl_priv(p_playlist)->b_reset_currently_playing = true;
 
     /* Do the real job recursively */
-    return recursiveNodeSort(p_playlist,p_node,find_sorting_fn(i_mode,i_type));
+    return recursiveNodeSort(p_playlist,p_node,i_mode,
+                             find_sorting_fn(i_mode,i_type));
 }
 
 
 /* This is the stuff the sorting functions are made of. The proto_##
  * functions are wrapped in cmp_a_## and cmp_d_## functions that do
- * void * to const playlist_item_t * casting and dereferencing and
- * cmp_d_## inverts the result, too. proto_## are static inline,
- * cmp_[ad]_## are merely static as they're the target of pointers.
+ * void * to const sort_key_t * casting and cmp_d_## inverts the result,
+ * too. proto_## are static inline, cmp_[ad]_## are merely static as
+ * they're the target of pointers.
  *
  * In any case, each SORT_## constant (except SORT_RANDOM) must have
- * a matching SORTFN( )-declared function here.
+ * a matching SORTFN( )-declared function here, and the fields it uses
+ * must be listed by sort_key_fields().
  */
 
 #define SORTFN( SORT, first, second ) static inline int proto_##SORT \
-	( const playlist_item_t *first, const playlist_item_t *second )
+	( const sort_key_t *first, const sort_key_t *second )
 
 SORTFN( SORT_ALBUM, first, second )
 {
-    int i_ret = meta_sort( first, second, vlc_meta_Album, false );
+    int i_ret = meta_sort( first, second, KEY_ALBUM );
     /* Items came from the same album: compare the track numbers */
     if( i_ret == 0 )
-        i_ret = meta_sort( first, second, vlc_meta_TrackNumber, true );
+        i_ret = meta_sort_integer( first, second, KEY_TRACK_NUMBER );
 
     return i_ret;
 }
 
 SORTFN( SORT_DATE, first, second )
 {
-    int i_ret = meta_sort( first, second, vlc_meta_Date, true );
+    int i_ret = meta_sort_integer( first, second, KEY_DATE );
     /* Items came from the same date: compare the albums */
     if( i_ret == 0 )
         i_ret = proto_SORT_ALBUM( first, second );
@@ -238,7 +574,7 @@ SORTFN( SORT_DATE, first, second )
 
 SORTFN( SORT_ARTIST, first, second )
 {
-    int i_ret = meta_sort( first, second, vlc_meta_Artist, false );
+    int i_ret = meta_sort( first, second, KEY_ARTIST );
     /* Items came from the same artist: compare the dates */
     if( i_ret == 0 )
         i_ret = proto_SORT_DATE( first, second );
@@ -248,13 +584,13 @@ SORTFN( SORT_ARTIST, first, second )
 
 SORTFN( SORT_DESCRIPTION, first, second )
 {
-    return meta_sort( first, second, vlc_meta_Description, false );
+    return meta_sort( first, second, KEY_DESCRIPTION );
 }
 
 SORTFN( SORT_DURATION, first, second )
 {
-    mtime_t time1 = input_item_GetDuration( first->p_input );
-    mtime_t time2 = input_item_GetDuration( second->p_input );
+    mtime_t time1 = first->i_duration;
+    mtime_t time2 = second->i_duration;
     int i_ret = time1 > time2 ? 1 :
                     ( time1 == time2 ? 0 : -1 );
     return i_ret;
@@ -262,17 +598,17 @@ SORTFN( SORT_DURATION, first, second )
 
 SORTFN( SORT_GENRE, first, second )
 {
-    return meta_sort( first, second, vlc_meta_Genre, false );
+    return meta_sort( first, second, KEY_GENRE );
 }
 
 SORTFN( SORT_ID, first, second )
 {
-    return first->i_id - second->i_id;
+    return first->p_item->i_id - second->p_item->i_id;
 }
 
 SORTFN( SORT_RATING, first, second )
 {
-    return meta_sort( first, second, vlc_meta_Rating, true );
+    return meta_sort_integer( first, second, KEY_RATING );
 }
 
 SORTFN( SORT_TITLE, first, second )
@@ -283,10 +619,10 @@ SORTFN( SORT_TITLE, first, second )
 SORTFN( SORT_TITLE_NODES_FIRST, first, second )
 {
     /* If first is a node but not second */
-    if( first->i_children == -1 && second->i_children >= 0 )
+    if( !first->b_node && second->b_node )
         return -1;
     /* If second is a node but not first */
-    else if( first->i_children >= 0 && second->i_children == -1 )
+    else if( first->b_node && !second->b_node )
         return 1;
     /* Both are nodes or both are not nodes */
     else
@@ -296,51 +632,34 @@ SORTFN( SORT_TITLE_NODES_FIRST, first, second )
 SORTFN( SORT_TITLE_NUMERIC, first, second )
 {
     int i_ret;
-    char *psz_first = input_item_GetTitleFbName( first->p_input );
-    char *psz_second = input_item_GetTitleFbName( second->p_input );
 
-    if( psz_first && psz_second )
-        i_ret = atoi( psz_first ) - atoi( psz_second );
-    else if( !psz_first && psz_second )
+    if( first->psz_title && second->psz_title )
+        i_ret = (first->i_title > second->i_title)
+              - (first->i_title < second->i_title);
+    else if( !first->psz_title && second->psz_title )
         i_ret = 1;
-    else if( psz_first && !psz_second )
+    else if( first->psz_title && !second->psz_title )
         i_ret = -1;
     else
         i_ret = 0;
 
-    free( psz_first );
-    free( psz_second );
     return i_ret;
 }
 
 SORTFN( SORT_TRACK_NUMBER, first, second )
 {
-    return meta_sort( first, second, vlc_meta_TrackNumber, true );
+    return meta_sort_integer( first, second, KEY_TRACK_NUMBER );
 }
 
 SORTFN( SORT_DISC_NUMBER, first, second )
 {
-  return meta_sort( first, second, vlc_meta_DiscNumber, true );
+    return meta_sort_integer( first, second, KEY_DISC_NUMBER );
 }
 
 SORTFN( SORT_URI, first, second )
 {
-    int i_ret;
-    char *psz_first = input_item_GetURI( first->p_input );
-    char *psz_second = input_item_GetURI( second->p_input );
-
-    if( psz_first && psz_second )
-        i_ret = strcasecmp( psz_first, psz_second );
-    else if( !psz_first && psz_second )
-        i_ret = 1;
-    else if( psz_first && !psz_second )
-        i_ret = -1;
-    else
-        i_ret = 0;
-
-    free( psz_first );
-    free( psz_second );
-    return i_ret;
+    return key_strcmp( first->psz_strings[KEY_URI],
+                       second->psz_strings[KEY_URI] );
 }
 
 #undef  SORTFN
@@ -355,11 +674,9 @@ SORTFN( SORT_URI, first, second )
 
 #define DEF( s ) \
 	static int cmp_a_##s(const void *l,const void *r) \
-	{ return proto_##s(*(const playlist_item_t *const *)l, \
-                           *(const playlist_item_t *const *)r); } \
+	{ return proto_##s((const sort_key_t *)l, (const sort_key_t *)r); } \
 	static int cmp_d_##s(const void *l,const void *r) \
-	{ return -1*proto_##s(*(const playlist_item_t * const *)l, \
-                              *(const playlist_item_t * const *)r); }
+	{ return -1*proto_##s((const sort_key_t *)l, (const sort_key_t *)r); }
 
 	VLC_DEFINE_SORT_FUNCTIONS
 
@@ -0,0 +1,207 @@
+/*****************************************************************************
+ * block_pool.c: Test and benchmark for block recycling
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#undef NDEBUG
+#include <assert.h>
+
+#include <vlc_common.h>
+#include <vlc_block.h>
+
+#define BENCH_BLOCKS 16
+#define BENCH_LOOPS  100000
+
+static void test_block_Layout(size_t size)
+{
+    block_t *block = block_Alloc(size);
+
+    assert(block != NULL);
+    assert(block->i_buffer == size);
+    assert(((uintptr_t)block->p_buffer % 32) == 0);
+    assert(block->p_buffer >= block->p_start);
+    assert(block->p_buffer + block->i_buffer
+           <= block->p_start + block->i_size);
+    assert(block->p_next == NULL);
+    assert(block->i_flags == 0);
+    assert(block->i_pts == VLC_TS_INVALID && block->i_dts == VLC_TS_INVALID);
+    memset(block->p_buffer, 0xAA, size);
+    block_Release(block);
+}
+
+static void test_block_Recycling(void)
+{
+    block_pool_stats_t before, after;
+    block_t *blocks[BENCH_BLOCKS];
+
+    block_pool_GetStats(&before);
+    for (unsigned i = 0; i < BENCH_BLOCKS; i++)
+        blocks[i] = block_Alloc(188);
+    for (unsigned i = 0; i < BENCH_BLOCKS; i++)
+    {
+        blocks[i]->i_flags = BLOCK_FLAG_DISCONTINUITY;
+        block_Release(blocks[i]);
+    }
+    for (unsigned i = 0; i < BENCH_BLOCKS; i++)
+    {
+        blocks[i] = block_Alloc(188);
+        assert(blocks[i] != NULL);
+        assert(blocks[i]->i_flags == 0);
+    }
+    for (unsigned i = 0; i < BENCH_BLOCKS; i++)
+        block_Release(blocks[i]);
+    block_pool_GetStats(&after);
+
+    assert(after.allocs - before.allocs == 2 * BENCH_BLOCKS);
+    assert(after.releases - before.releases == 2 * BENCH_BLOCKS);
+    assert(after.hits - before.hits >= BENCH_BLOCKS);
+}
+
+static void *release_thread(void *data)
+{
+    block_t *chain = data;
+
+    block_ChainRelease(chain);
+    return NULL;
+}
+
+static void test_block_CrossThread(void)
+{
+    block_t *chain = NULL;
+    block_t **pp = &chain;
+    vlc_thread_t th;
+
+    for (unsigned i = 0; i < 1000; i++)
+    {
+        *pp = block_Alloc(1316);
+        assert(*pp != NULL);
+        pp = &(*pp)->p_next;
+    }
+
+    assert(vlc_clone(&th, release_thread, chain,
+                     VLC_THREAD_PRIORITY_LOW) == 0);
+    vlc_join(th, NULL);
+
+    /* Blocks released by the other thread are recycled through the depot */
+    block_pool_stats_t before, after;
+
+    block_pool_GetStats(&before);
+    for (unsigned i = 0; i < 100; i++)
+        block_Release(block_Alloc(1316));
+    block_pool_GetStats(&after);
+    assert(after.hits - before.hits == 100);
+}
+
+static void test_block_Resized(void)
+{
+    /* The size class does not depend on the block size when released */
+    block_t *block = block_Alloc(1316);
+    assert(block != NULL);
+    block->p_start = block->p_buffer + 16;
+    block->p_buffer = block->p_start;
+    block->i_size = block->i_buffer = 100;
+
+    block_pool_stats_t before, after;
+
+    block_pool_GetStats(&before);
+    block_Release(block);
+    block = block_Alloc(1316);
+    block_pool_GetStats(&after);
+    assert(after.hits - before.hits == 1);
+    assert(block != NULL && block->i_buffer == 1316);
+    assert(block->p_buffer + block->i_buffer
+           <= block->p_start + block->i_size);
+    block_Release(block);
+}
+
+static mtime_t bench_block(size_t size)
+{
+    block_t *blocks[BENCH_BLOCKS];
+    mtime_t start = mdate();
+
+    for (unsigned n = 0; n < BENCH_LOOPS; n++)
+    {
+        for (unsigned i = 0; i < BENCH_BLOCKS; i++)
+            blocks[i] = block_Alloc(size);
+        for (unsigned i = 0; i < BENCH_BLOCKS; i++)
+            block_Release(blocks[i]);
+    }
+    return mdate() - start;
+}
+
+static mtime_t bench_malloc(size_t size)
+{
+    void *bufs[BENCH_BLOCKS];
+    mtime_t start = mdate();
+
+    for (unsigned n = 0; n < BENCH_LOOPS; n++)
+    {
+        for (unsigned i = 0; i < BENCH_BLOCKS; i++)
+        {
+            bufs[i] = malloc(size + sizeof (block_t) + 96);
+            assert(bufs[i] != NULL);
+            *(volatile char *)bufs[i] = 0;
+        }
+        for (unsigned i = 0; i < BENCH_BLOCKS; i++)
+            free(bufs[i]);
+    }
+    return mdate() - start;
+}
+
+static void bench(const char *name, size_t size)
+{
+    mtime_t t_block = bench_block(size);
+    mtime_t t_malloc = bench_malloc(size);
+
+    printf("%-12s %6zu bytes: block_Alloc %6"PRId64" us, malloc %6"PRId64
+           " us\n", name, size, t_block, t_malloc);
+}
+
+int main(void)
+{
+    static const size_t sizes[] = {
+        0, 1, 188, 256, 300, 1316, 1500, 2048, 4096, 20000, 65536, 100000,
+    };
+
+    for (size_t i = 0; i < ARRAY_SIZE(sizes); i++)
+        test_block_Layout(sizes[i]);
+    test_block_Recycling();
+    test_block_CrossThread();
+    test_block_Resized();
+
+    bench("TS packet", 188);
+    bench("datagram", 1316);
+    bench("read", 65536);
+    bench("not pooled", 4096);
+
+    block_pool_stats_t stats;
+    block_pool_GetStats(&stats);
+    printf("%"PRIu64" allocations, %"PRIu64" recycled, %"PRIu64" releases, "
+           "%"PRIu64" discarded\n", stats.allocs, stats.hits, stats.releases,
+           stats.discards);
+    assert(stats.hits <= stats.allocs);
+    assert(stats.releases == stats.allocs);
+    return 0;
+}
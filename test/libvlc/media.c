@@ -175,6 +175,23 @@ static void test_input_metadata_timeout(libvlc_instance_t *vlc, int timeout,
     vlc_close(p_pipe[1]);
 }
 
+static void test_media_parse_stats(libvlc_instance_t *vlc, uint64_t i_min)
+{
+    log ("test_media_parse_stats\n");
+
+    libvlc_media_parse_stats_t stats;
+
+    /* The last requests may still be completing */
+    for (;;)
+    {
+        libvlc_media_parse_get_stats(vlc, &stats);
+        if (stats.i_parse_pending == 0)
+            break;
+        msleep(10000);
+    }
+    assert(stats.i_parsed >= i_min);
+}
+
 #define TEST_SUBITEMS_COUNT 6
 static struct
 {
@@ -374,6 +391,8 @@ int main(int i_argc, char *ppsz_argv[])
     test_input_metadata_timeout (vlc, 100, 0);
     test_input_metadata_timeout (vlc, 0, 100);
 
+    test_media_parse_stats (vlc, 5);
+
     libvlc_release (vlc);
 
     return 0;
@@ -0,0 +1,224 @@
+/*****************************************************************************
+ * pcm.c: PCM conversion and volume kernels test and benchmark
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef NDEBUG
+ #undef NDEBUG
+#endif
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <vlc_common.h>
+#include <vlc_aout.h>
+
+#include "../modules/audio_filter/converter/format.h"
+#include "../modules/audio_mixer/amplify.h"
+
+/* Samples checked against the C kernels, not a multiple of any vector size */
+#define SAMPLES 4099
+/* One second of 7.1 audio at 192 kHz */
+#define BENCH_SAMPLES (8 * 192000)
+
+static uint32_t seed = 1;
+static bool b_bench = false; /* print the timings, with -b */
+
+static uint32_t rnd(void)
+{
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 16) | (seed << 16);
+}
+
+static float rndf(void)
+{
+    return (int32_t)rnd() / 1789569706.f; /* about -1.2 to 1.2 */
+}
+
+/* Fills samples, including saturating values and halfway cases */
+static void fill(vlc_fourcc_t fourcc, void *buf, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        int k = (int)(rnd() % 2001) - 1000;
+
+        switch (fourcc)
+        {
+            case VLC_CODEC_U8:
+                ((uint8_t *)buf)[i] = rnd();
+                break;
+            case VLC_CODEC_S16N:
+                ((int16_t *)buf)[i] = (i % 13 == 0) ? (i & 1 ? INT16_MIN
+                                                             : INT16_MAX)
+                                                    : (int16_t)rnd();
+                break;
+            case VLC_CODEC_S32N:
+                ((int32_t *)buf)[i] = (i % 13 == 0) ? (i & 1 ? INT32_MIN
+                                                             : INT32_MAX)
+                                                    : (int32_t)rnd();
+                break;
+            case VLC_CODEC_FL32:
+            {
+                float *p = &((float *)buf)[i];
+                switch (i % 7)
+                {
+                    case 0: *p = (k + .5f) / 32768.f; break;
+                    case 1: *p = (k + .5f) / 2147483648.f; break;
+                    case 2: *p = (i & 8) ? 1.f : -1.f; break;
+                    case 3: *p = rndf() * ((i & 8) ? 1e10f : 1e-10f); break;
+                    default: *p = rndf(); break;
+                }
+                break;
+            }
+            case VLC_CODEC_FL64:
+            {
+                double *p = &((double *)buf)[i];
+                switch (i % 7)
+                {
+                    case 0: *p = (k + .5) / 32768.; break;
+                    case 1: *p = (k + .5) / 2147483648.; break;
+                    case 2: *p = (i & 8) ? 1. : -1.; break;
+                    case 3: *p = rndf() * ((i & 8) ? 1e10 : 1e-10); break;
+                    default: *p = rndf() + rndf() / 1e9; break;
+                }
+                break;
+            }
+            default:
+                assert(0);
+        }
+    }
+}
+
+static double bench(pcm_convert_t convert, void *dst, const void *src)
+{
+    mtime_t start = mdate();
+    convert(dst, src, BENCH_SAMPLES);
+    return (mdate() - start) / 1000.;
+}
+
+static void test_conversion(const struct pcm_conversion *cvt)
+{
+    size_t src_size = aout_BitsPerSample(cvt->src) / 8;
+    size_t dst_size = aout_BitsPerSample(cvt->dst) / 8;
+    size_t size = BENCH_SAMPLES * (src_size > dst_size ? src_size : dst_size);
+    uint8_t *src = malloc(size), *ref = malloc(size), *out = malloc(size);
+    assert(src != NULL && ref != NULL && out != NULL);
+
+    fill(cvt->src, src, BENCH_SAMPLES);
+    cvt->convert(ref, src, SAMPLES);
+
+    if (b_bench)
+        printf("%4.4s->%4.4s: C %.2f ms", (const char *)&cvt->src,
+               (const char *)&cvt->dst, bench(cvt->convert, out, src));
+
+#ifdef PCM_CONVERT_X86
+    const struct
+    {
+        const char *name;
+        pcm_convert_t convert;
+        bool supported;
+    } simd[] = {
+        { "SSE2", cvt->convert_sse2, vlc_CPU_SSE2() },
+        { "AVX2", cvt->convert_avx2, vlc_CPU_AVX2() },
+    };
+
+    for (size_t i = 0; i < ARRAY_SIZE(simd); i++)
+    {
+        if (simd[i].convert == NULL || !simd[i].supported)
+            continue;
+
+        /* Out of place, for every tail length */
+        for (size_t n = SAMPLES - 33; n <= SAMPLES; n++)
+        {
+            memset(out, 0x55, SAMPLES * dst_size);
+            simd[i].convert(out, src, n);
+            assert(memcmp(out, ref, n * dst_size) == 0);
+        }
+
+        /* In place */
+        if (dst_size <= src_size)
+        {
+            memcpy(out, src, SAMPLES * src_size);
+            simd[i].convert(out, out, SAMPLES);
+            assert(memcmp(out, ref, SAMPLES * dst_size) == 0);
+        }
+
+        if (b_bench)
+            printf(", %s %.2f ms", simd[i].name,
+                   bench(simd[i].convert, out, src));
+    }
+#endif
+    if (b_bench)
+        printf("\n");
+
+    free(out);
+    free(ref);
+    free(src);
+}
+
+#ifdef AMPLIFY_X86
+# define TEST_AMPLIFY(type, fourcc, c, simd, mult) \
+do { \
+    type *ref = malloc(SAMPLES * sizeof (type)); \
+    type *out = malloc(SAMPLES * sizeof (type)); \
+    assert(ref != NULL && out != NULL); \
+    fill(fourcc, ref, SAMPLES); \
+    memcpy(out, ref, SAMPLES * sizeof (type)); \
+    c(ref, SAMPLES, mult); \
+    simd(out, SAMPLES, mult); \
+    assert(memcmp(out, ref, SAMPLES * sizeof (type)) == 0); \
+    free(out); \
+    free(ref); \
+} while (0)
+
+static void test_amplify(void)
+{
+    static const float volumes[] = { 0.f, .25f, .7f, 1.f, 1.3f, 2.f, 100.f };
+
+    for (size_t i = 0; i < ARRAY_SIZE(volumes); i++)
+    {
+        float vol = volumes[i];
+
+        if (vlc_CPU_SSE2())
+            TEST_AMPLIFY(int16_t, VLC_CODEC_S16N, amplify_s16_c,
+                         amplify_s16_sse2, lroundf(vol * 0x1.p8f));
+        if (vlc_CPU_AVX2())
+        {
+            TEST_AMPLIFY(int16_t, VLC_CODEC_S16N, amplify_s16_c,
+                         amplify_s16_avx2, lroundf(vol * 0x1.p8f));
+            TEST_AMPLIFY(int32_t, VLC_CODEC_S32N, amplify_s32_c,
+                         amplify_s32_avx2, lroundf(vol * 0x1.p24f));
+        }
+    }
+}
+#endif
+
+int main(int argc, char *argv[])
+{
+    b_bench = argc > 1 && strcmp(argv[1], "-b") == 0;
+
+    for (size_t i = 0; i < ARRAY_SIZE(pcm_conversions); i++)
+        test_conversion(&pcm_conversions[i]);
+#ifdef AMPLIFY_X86
+    test_amplify();
+#endif
+    return 0;
+}
@@ -0,0 +1,305 @@
+/*****************************************************************************
+ * resampler.c: audio resamplers quality and throughput test
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef NDEBUG
+ #undef NDEBUG
+#endif
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vlc_common.h>
+#include <vlc_modules.h>
+#include <vlc_aout.h>
+#include <vlc_filter.h>
+#include "../../../lib/libvlc_internal.h"
+
+#include <vlc/vlc.h>
+
+#define BLOCK 1024 /* input frames per block */
+
+static vlc_object_t *obj;
+
+static filter_t *Create(const char *name, unsigned irate, unsigned orate,
+                        uint16_t chans)
+{
+    filter_t *filter = vlc_object_create(obj, sizeof (*filter));
+    assert(filter != NULL);
+
+    audio_sample_format_t fmt = {
+        .i_format = VLC_CODEC_FL32,
+        .i_rate = irate,
+        .i_physical_channels = chans,
+        .i_original_channels = chans,
+    };
+    aout_FormatPrepare(&fmt);
+
+    filter->fmt_in.audio = fmt;
+    filter->fmt_in.i_codec = fmt.i_format;
+    filter->fmt_out.audio = fmt;
+    filter->fmt_out.audio.i_rate = orate;
+    filter->fmt_out.i_codec = fmt.i_format;
+    filter->p_module = module_need(filter, "audio resampler", name, true);
+    if (filter->p_module == NULL)
+    {
+        vlc_object_release(filter);
+        return NULL;
+    }
+    return filter;
+}
+
+static void Destroy(filter_t *filter)
+{
+    module_unneed(filter, filter->p_module);
+    vlc_object_release(filter);
+}
+
+/**
+ * Resamples a whole signal in blocks, returns the number of output frames.
+ * If rate_jitter is non-zero, the input rate changes with every block, as
+ * it does when the audio output synchronizes.
+ */
+static size_t Run(filter_t *filter, const float *in, size_t frames,
+                  float *out, size_t max, unsigned rate_jitter)
+{
+    const unsigned channels = aout_FormatNbChannels(&filter->fmt_in.audio);
+    const unsigned rate = filter->fmt_in.audio.i_rate;
+    size_t done = 0;
+
+    for (size_t i = 0; i < frames; i += BLOCK)
+    {
+        size_t count = __MIN(frames - i, BLOCK);
+        block_t *block = block_Alloc(count * channels * sizeof (float));
+        assert(block != NULL);
+
+        memcpy(block->p_buffer, in + i * channels,
+               count * channels * sizeof (float));
+        block->i_nb_samples = count;
+        block->i_pts = VLC_TS_0 + i * CLOCK_FREQ / rate;
+
+        if (rate_jitter)
+            filter->fmt_in.audio.i_rate = rate + (i / BLOCK) % rate_jitter
+                                               - rate_jitter / 2;
+        block = filter->pf_audio_filter(filter, block);
+        filter->fmt_in.audio.i_rate = rate;
+        if (block == NULL)
+            continue;
+
+        assert(done + block->i_nb_samples <= max);
+        memcpy(out + done * channels, block->p_buffer,
+               block->i_nb_samples * channels * sizeof (float));
+        done += block->i_nb_samples;
+        block_Release(block);
+    }
+
+    if (filter->pf_audio_drain != NULL)
+    {
+        block_t *block = filter->pf_audio_drain(filter);
+        if (block != NULL)
+        {
+            assert(done + block->i_nb_samples <= max);
+            memcpy(out + done * channels, block->p_buffer,
+                   block->i_nb_samples * channels * sizeof (float));
+            done += block->i_nb_samples;
+            block_Release(block);
+        }
+    }
+    return done;
+}
+
+static void Tone(float *buf, size_t frames, unsigned channels, double freq,
+                 unsigned rate)
+{
+    for (size_t i = 0; i < frames; i++)
+        for (unsigned c = 0; c < channels; c++)
+            buf[i * channels + c] = .5 * sin(2. * M_PI * freq * i / rate);
+}
+
+/**
+ * Fits a tone to the first channel, skipping the edges, and returns the
+ * power of the residue relative to the tone (THD+N) in dB.
+ */
+static double Distortion(const float *buf, size_t frames, unsigned channels,
+                         double freq, unsigned rate)
+{
+    const size_t skip = rate / 10;
+    double ss = 0., sc = 0., cc = 0., ys = 0., yc = 0.;
+
+    assert(frames > 3 * skip);
+    for (size_t i = skip; i < frames - skip; i++)
+    {
+        double s = sin(2. * M_PI * freq * i / rate);
+        double c = cos(2. * M_PI * freq * i / rate);
+        double y = buf[i * channels];
+
+        ss += s * s; sc += s * c; cc += c * c;
+        ys += y * s; yc += y * c;
+    }
+
+    double det = ss * cc - sc * sc;
+    double a = (ys * cc - yc * sc) / det, b = (yc * ss - ys * sc) / det;
+    double tone = 0., noise = 0.;
+
+    for (size_t i = skip; i < frames - skip; i++)
+    {
+        double fit = a * sin(2. * M_PI * freq * i / rate)
+                   + b * cos(2. * M_PI * freq * i / rate);
+        double y = buf[i * channels];
+
+        tone += fit * fit;
+        noise += (y - fit) * (y - fit);
+    }
+    return 10. * log10(noise / tone + 1e-30);
+}
+
+static double Power(const float *buf, size_t frames, unsigned channels)
+{
+    const size_t skip = frames / 10;
+    double sum = 0.;
+
+    for (size_t i = skip; i < frames - skip; i++)
+        sum += (double)buf[i * channels] * buf[i * channels];
+    return sum / (frames - 2 * skip);
+}
+
+struct result
+{
+    double thdn; /* worst THD+N up-sampling 44.1 kHz to 48 kHz */
+    double alias; /* 23 kHz tone level down-sampling 48 kHz to 44.1 kHz */
+    double speed; /* 7.1 real-time factor up-sampling 44.1 kHz to 48 kHz */
+};
+
+static bool Measure(const char *name, struct result *res)
+{
+    static const double freqs[] = { 1000., 10000., 18000. };
+    const size_t frames = 2 * 48000;
+    float *in = malloc(frames * 8 * sizeof (float));
+    float *out = malloc(2 * frames * 8 * sizeof (float));
+    assert(in != NULL && out != NULL);
+
+    filter_t *filter = Create(name, 44100, 48000, AOUT_CHANS_STEREO);
+    if (filter == NULL)
+    {
+        free(out);
+        free(in);
+        return false;
+    }
+
+    res->thdn = -INFINITY;
+    for (size_t i = 0; i < ARRAY_SIZE(freqs); i++)
+    {
+        Tone(in, 2 * 44100, 2, freqs[i], 44100);
+        size_t n = Run(filter, in, 2 * 44100, out, 2 * frames, 0);
+        double thdn = Distortion(out, n, 2, freqs[i], 48000);
+
+        if (thdn > res->thdn)
+            res->thdn = thdn;
+    }
+    Destroy(filter);
+
+    filter = Create(name, 48000, 44100, AOUT_CHANS_STEREO);
+    assert(filter != NULL);
+    Tone(in, frames, 2, 23000., 48000);
+    size_t n = Run(filter, in, frames, out, 2 * frames, 0);
+    res->alias = 10. * log10(Power(out, n, 2) / Power(in, frames, 2) + 1e-30);
+    Destroy(filter);
+
+    filter = Create(name, 44100, 48000, AOUT_CHANS_7_1);
+    assert(filter != NULL);
+    for (size_t i = 0; i < frames * 8; i++)
+        in[i] = sinf(i * .001f);
+    mtime_t start = mdate();
+    Run(filter, in, frames, out, 2 * frames, 0);
+    res->speed = (double)frames / 44100 * CLOCK_FREQ / (mdate() - start);
+    Destroy(filter);
+
+    free(out);
+    free(in);
+    return true;
+}
+
+static void TestRateChanges(void)
+{
+    const size_t frames = 4 * 44100;
+    float *in = malloc(frames * 2 * sizeof (float));
+    float *out = malloc(2 * frames * 2 * sizeof (float));
+    assert(in != NULL && out != NULL);
+
+    filter_t *filter = Create("polyphase", 44100, 48000, AOUT_CHANS_STEREO);
+    assert(filter != NULL);
+
+    /* Average input rate is 44100 Hz: output length must follow */
+    Tone(in, frames, 2, 1000., 44100);
+    size_t n = Run(filter, in, frames, out, 2 * frames, 101);
+    double expected = frames * 48000. / 44100.;
+    assert(fabs(n - expected) < 64.);
+
+    /* No clicks: neighbour samples stay close for a 1 kHz tone */
+    for (size_t i = 1; i < n; i++)
+        assert(fabsf(out[2 * i] - out[2 * (i - 1)]) < .08f);
+
+    Destroy(filter);
+    free(out);
+    free(in);
+}
+
+int main(void)
+{
+    static const char *const names[] = {
+        "polyphase", "ugly", "bandlimited", "src", "speex", "soxr",
+    };
+
+    setenv("VLC_PLUGIN_PATH", "../modules", 1);
+
+    libvlc_instance_t *vlc = libvlc_new(0, NULL);
+    assert(vlc != NULL);
+    obj = VLC_OBJECT(vlc->p_libvlc_int);
+
+    for (size_t i = 0; i < ARRAY_SIZE(names); i++)
+    {
+        struct result res;
+
+        if (!Measure(names[i], &res))
+        {
+            printf("%s: not available\n", names[i]);
+            assert(i > 0);
+            continue;
+        }
+        printf("%s: THD+N %.1f dB, alias %.1f dB, 7.1 speed %.0fx\n",
+               names[i], res.thdn, res.alias, res.speed);
+
+        if (i == 0)
+        {
+            assert(res.thdn < -70.);
+            assert(res.alias < -60.);
+        }
+    }
+
+    TestRateChanges();
+
+    libvlc_release(vlc);
+    return 0;
+}
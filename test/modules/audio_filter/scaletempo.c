@@ -0,0 +1,168 @@
+/*****************************************************************************
+ * scaletempo.c: scaletempo overlap search test and benchmark
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef NDEBUG
+ #undef NDEBUG
+#endif
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <vlc_common.h>
+
+#include "../modules/audio_filter/scaletempo.h"
+
+/* Default filter parameters with 7.1 audio at 48 kHz */
+#define RATE      48000
+#define CHANNELS  8
+#define OVERLAP   (30 * RATE / 1000 / 5)  /* frames */
+#define SEARCH    (14 * RATE / 1000)      /* frames */
+#define STRIDES   200
+
+#define SAMPLES   ((OVERLAP - 1) * CHANNELS)
+#define FRAMES    (RATE * 4)
+
+static uint32_t seed = 1;
+
+static float rndf(void)
+{
+    seed = seed * 1103515245 + 12345;
+    return (int32_t)((seed >> 16) | (seed << 16)) / 2147483648.f;
+}
+
+/* Music-like signal: a few tones per channel with a bit of noise */
+static void fill(float *buf)
+{
+    static const float freqs[] = { 110.f, 220.f, 330.f, 440.f, 587.f, 880.f };
+
+    for (unsigned c = 0; c < CHANNELS; c++)
+    {
+        float phase = 6.28318531f * c / CHANNELS;
+
+        for (unsigned i = 0; i < FRAMES; i++)
+        {
+            float v = .02f * rndf();
+            for (unsigned k = 0; k < 3; k++)
+            {
+                float f = freqs[(c + 2 * k) % ARRAY_SIZE(freqs)];
+                v += .3f * sinf(6.28318531f * f * i / RATE + phase * k);
+            }
+            buf[i * CHANNELS + c] = v;
+        }
+    }
+}
+
+/* Exact correlation at the given offset, to compare choices fairly */
+static double corr(const float *pre_corr, const float *search_start,
+                   unsigned off)
+{
+    const float *ps = search_start + off * CHANNELS;
+    double sum = 0.;
+
+    for (unsigned i = 0; i < SAMPLES; i++)
+        sum += (double)pre_corr[i] * ps[i];
+    return sum;
+}
+
+int main(void)
+{
+    float *buf = malloc(FRAMES * CHANNELS * sizeof (*buf));
+    float *window = malloc(SAMPLES * sizeof (*window));
+    float *pre_corr = malloc(SAMPLES * sizeof (*pre_corr));
+    assert(buf != NULL && window != NULL && pre_corr != NULL);
+
+    /* Same window as the filter */
+    for (unsigned i = 1; i < OVERLAP; i++)
+        for (unsigned j = 0; j < CHANNELS; j++)
+            window[(i - 1) * CHANNELS + j] = i * (OVERLAP - i);
+
+    fill(buf);
+
+    const struct
+    {
+        const char *name;
+        scaletempo_dot_t dot;
+        unsigned step;
+        bool supported;
+    } kernels[] = {
+        { "C", scaletempo_dot_c, 1, true },
+#ifdef SCALETEMPO_X86
+        { "SSE2", scaletempo_dot_sse2, 1, vlc_CPU_SSE2() },
+        { "AVX2", scaletempo_dot_avx2, 1, vlc_CPU_AVX2() },
+#endif
+        { "coarse", scaletempo_GetDot(), RATE / 12000, true },
+    };
+    unsigned ref[STRIDES];
+
+    for (size_t k = 0; k < ARRAY_SIZE(kernels); k++)
+    {
+        double loss = 0.;
+        mtime_t total = 0;
+
+        if (!kernels[k].supported)
+            continue;
+
+        for (unsigned s = 0; s < STRIDES; s++)
+        {
+            const float *overlap = buf + (s * 911 % (FRAMES / 2)) * CHANNELS;
+            const float *queue = buf + (s * 557 % (FRAMES / 2)) * CHANNELS;
+
+            for (unsigned i = 0; i < SAMPLES; i++)
+                pre_corr[i] = window[i] * overlap[CHANNELS + i];
+
+            mtime_t start = mdate();
+            unsigned off = scaletempo_search(kernels[k].dot, pre_corr,
+                                             queue + CHANNELS, SAMPLES,
+                                             CHANNELS, SEARCH,
+                                             kernels[k].step);
+            total += mdate() - start;
+            assert(off < SEARCH);
+
+            if (k == 0)
+            {
+                ref[s] = off;
+                continue;
+            }
+
+            double best = corr(pre_corr, queue + CHANNELS, ref[s]);
+            double got = corr(pre_corr, queue + CHANNELS, off);
+
+            if (kernels[k].step == 1)
+                /* Only rounding errors may change the choice */
+                assert(off == ref[s] || fabs(best - got) <= 1e-4 * fabs(best));
+            else
+                assert(best <= 0. || got >= .9 * best);
+            if (best > 0.)
+                loss += (best - got) / best;
+        }
+
+        printf("%s: %.1f us per stride, %.4f%% correlation loss\n",
+               kernels[k].name, (double)total / STRIDES,
+               100. * loss / STRIDES);
+    }
+
+    free(pre_corr);
+    free(window);
+    free(buf);
+    return 0;
+}
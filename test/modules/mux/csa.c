@@ -0,0 +1,149 @@
+/*****************************************************************************
+ * csa.c: test and benchmark for the batch CSA (de)scrambler
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef NDEBUG
+ #undef NDEBUG
+#endif
+#include <assert.h>
+#include <vlc_common.h>
+#include <vlc_block.h>
+
+#define TS_NO_CSA_CK_MSG
+#include "../modules/mux/mpeg/csa.c"
+
+#define PACKETS 300
+#define BENCH_PACKETS 25600
+
+static uint32_t seed = 1;
+
+static uint8_t rnd(void)
+{
+    seed = seed * 1103515245 + 12345;
+    return seed >> 16;
+}
+
+static void fill(uint8_t pkts[][188], unsigned count)
+{
+    for (unsigned i = 0; i < count; i++)
+    {
+        for (unsigned j = 0; j < 188; j++)
+            pkts[i][j] = rnd();
+
+        pkts[i][0] = 0x47;
+        pkts[i][3] &= 0x3f; /* clear */
+        if (i % 3 == 0)
+            pkts[i][3] &= ~0x20; /* no adaptation field */
+        else
+            pkts[i][4] %= (i % 5) ? 16 : 190; /* including invalid ones */
+    }
+}
+
+static void test(csa_t *c, int i_pkt_size, unsigned count)
+{
+    static uint8_t ref[PACKETS][188], pkts[PACKETS][188];
+    uint8_t *ptrs[PACKETS];
+
+    assert(count <= PACKETS);
+    fill(ref, count);
+    memcpy(pkts, ref, sizeof (pkts));
+    for (unsigned i = 0; i < count; i++)
+        ptrs[i] = pkts[i];
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        csa_UseKey(NULL, c, i & 1);
+        csa_Encrypt(c, ref[i], i_pkt_size);
+    }
+    /* the key in use applies to the whole batch */
+    uint8_t *keyed[2][PACKETS];
+    unsigned n[2] = { 0, 0 };
+
+    for (unsigned i = 0; i < count; i++)
+        keyed[i & 1][n[i & 1]++] = ptrs[i];
+    for (unsigned k = 0; k < 2; k++)
+    {
+        csa_UseKey(NULL, c, k);
+        csa_EncryptBatch(c, keyed[k], n[k], i_pkt_size);
+    }
+    assert(!memcmp(pkts, ref, count * 188));
+
+    /* odd and even packets mixed in one batch */
+    for (unsigned i = 0; i < count; i++)
+        csa_Decrypt(c, ref[i], i_pkt_size);
+    csa_DecryptBatch(c, ptrs, count, i_pkt_size);
+    assert(!memcmp(pkts, ref, count * 188));
+}
+
+static void bench(csa_t *c, bool batch)
+{
+    uint8_t (*pkts)[188] = malloc(BENCH_PACKETS * 188);
+    uint8_t **ptrs = malloc(BENCH_PACKETS * sizeof (*ptrs));
+
+    assert(pkts != NULL && ptrs != NULL);
+    for (unsigned i = 0; i < BENCH_PACKETS; i++)
+    {
+        memset(pkts[i], i, 188);
+        pkts[i][3] = 0x10; /* payload only */
+        ptrs[i] = pkts[i];
+    }
+
+    mtime_t start = mdate();
+    if (batch)
+    {
+        csa_EncryptBatch(c, ptrs, BENCH_PACKETS, 188);
+        csa_DecryptBatch(c, ptrs, BENCH_PACKETS, 188);
+    }
+    else
+        for (unsigned i = 0; i < BENCH_PACKETS; i++)
+        {
+            csa_Encrypt(c, ptrs[i], 188);
+            csa_Decrypt(c, ptrs[i], 188);
+        }
+    mtime_t duration = mdate() - start;
+
+    for (unsigned i = 0; i < BENCH_PACKETS; i++)
+        assert(pkts[i][5] == (uint8_t)i && pkts[i][187] == (uint8_t)i);
+    printf("%s: %"PRId64" us, %.1f Mbit/s\n",
+           batch ? "batch" : "packet per packet", duration,
+           2. * BENCH_PACKETS * 188 * 8 / (duration ? duration : 1));
+    free(ptrs);
+    free(pkts);
+}
+
+int main(void)
+{
+    csa_t *c = csa_New();
+    assert(c != NULL);
+    assert(csa_SetCW(NULL, c, (char *)"0x0123456789abcdef", true) == 0);
+    assert(csa_SetCW(NULL, c, (char *)"fedcba9876543210", false) == 0);
+
+    static const int sizes[] = { 188, 184, 100, 13, 12 };
+    static const unsigned counts[] = { 1, 2, 63, 64, 65, 129, 200, 256, 300 };
+
+    for (size_t i = 0; i < ARRAY_SIZE(sizes); i++)
+        for (size_t j = 0; j < ARRAY_SIZE(counts); j++)
+            test(c, sizes[i], counts[j]);
+
+    bench(c, false);
+    bench(c, true);
+
+    csa_Delete(c);
+    return 0;
+}
@@ -26,6 +26,7 @@
 #include <vlc_block.h>
 #include "../modules/packetizer/hxxx_nal.h"
 #include "../modules/packetizer/hxxx_nal.c"
+#include "../modules/packetizer/hxxx_common.c"
 
 static void test_iterators( const uint8_t *p_ab, size_t i_ab, /* AnnexB */
                             const uint8_t **pp_prefix, size_t *pi_prefix /* Prefixed */ )
@@ -208,9 +209,78 @@ static void test_annexb()
     test_iterators( NULL, 0, p_res, rgi_res );
 }
 
+static block_t *p_xxc1_nals;
+
+static block_t *test_xxc1_parser( decoder_t *p_dec, bool *pb_ts_used,
+                                  block_t *p_nal )
+{
+    VLC_UNUSED(p_dec); VLC_UNUSED(pb_ts_used);
+    block_ChainAppend( &p_xxc1_nals, p_nal );
+    return NULL;
+}
+
+/* Length prefixed access units to AnnexB NAL blocks, which may share the
+ * access unit buffer */
+static void test_xxc1( uint8_t i_prefix, const size_t *pi_nals, size_t i_nals )
+{
+    size_t i_total = 0;
+    for( size_t i = 0; i < i_nals; i++ )
+        i_total += i_prefix + pi_nals[i];
+
+    printf("XXC1 %u bytes prefixes, %zu nals\n", i_prefix, i_nals);
+
+    block_t *p_au = block_Alloc( i_total );
+    assert( p_au );
+    p_au->i_dts = 1000;
+    p_au->i_pts = 2000;
+
+    uint8_t *p = p_au->p_buffer;
+    for( size_t i = 0; i < i_nals; i++ )
+    {
+        for( uint8_t j = 0; j < i_prefix; j++ )
+            *p++ = pi_nals[i] >> (8 * (i_prefix - 1 - j));
+        memset( p, 0x40 + i, pi_nals[i] );
+        p += pi_nals[i];
+    }
+
+    p_xxc1_nals = NULL;
+    assert( PacketizeXXC1( NULL, i_prefix, &p_au, test_xxc1_parser ) == NULL );
+    assert( p_au == NULL );
+
+    /* Release the NAL units one by one, the others must stay intact */
+    for( size_t i = 0; i < i_nals; i++ )
+    {
+        size_t i_nal = i;
+        for( block_t *p_nal = p_xxc1_nals; p_nal; p_nal = p_nal->p_next )
+        {
+            assert( p_nal->i_dts == 1000 && p_nal->i_pts == 2000 );
+            assert( p_nal->i_buffer == 4 + pi_nals[i_nal] );
+            assert( !memcmp( p_nal->p_buffer, "\x00\x00\x00\x01", 4 ) );
+            for( size_t j = 4; j < p_nal->i_buffer; j++ )
+                assert( p_nal->p_buffer[j] == 0x40 + i_nal );
+            i_nal++;
+        }
+        assert( i_nal == i_nals );
+
+        block_t *p_nal = p_xxc1_nals;
+        p_xxc1_nals = p_nal->p_next;
+        p_nal->p_next = NULL;
+        block_Release( p_nal );
+    }
+    assert( p_xxc1_nals == NULL );
+}
+
 int main( void )
 {
     test_annexb();
 
+    const size_t rgi_nals1[] = { 5000, 20, 3000 };
+    const size_t rgi_nals2[] = { 4000 };
+    const size_t rgi_nals3[] = { 30, 2000, 10 };
+    test_xxc1( 4, rgi_nals1, 3 );
+    test_xxc1( 4, rgi_nals2, 1 );
+    test_xxc1( 4, rgi_nals3, 3 );
+    test_xxc1( 2, rgi_nals1, 3 );
+
     return 0;
 }
@@ -0,0 +1,277 @@
+/*****************************************************************************
+ * startcode.c: Annex B startcode scanning test and benchmark
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef NDEBUG
+ #undef NDEBUG
+#endif
+#include <assert.h>
+#include <stdio.h>
+#include <vlc_common.h>
+#include <vlc_block.h>
+#include <vlc_block_helper.h>
+#include "../modules/packetizer/startcode_helper.h"
+
+#define BENCH_SIZE (64 << 20)
+
+static uint32_t seed = 1;
+
+static unsigned rnd(void)
+{
+    seed = seed * 1103515245 + 12345;
+    return seed >> 16;
+}
+
+/* Random data with many zeros, and a startcode every few hundred bytes */
+static void fill(uint8_t *buf, size_t size, unsigned zeros)
+{
+    for (size_t i = 0; i < size; i++)
+        buf[i] = (rnd() % zeros) ? rnd() : 0;
+    for (size_t i = rnd() % 512; i + 3 <= size; i += 1 + rnd() % 512)
+        memcpy(&buf[i], "\x00\x00\x01", 3);
+}
+
+static const uint8_t *naive(const uint8_t *p, const uint8_t *end,
+                            const uint8_t *code, size_t len)
+{
+    for (; (size_t)(end - p) >= len; p++)
+        if (!memcmp(p, code, len))
+            return p;
+    return NULL;
+}
+
+static const struct
+{
+    const char *name;
+    block_startcode_helper_t find;
+} kernels[] = {
+    { "C", startcode_FindAnnexB_C },
+#if defined(CAN_COMPILE_SSE2) || defined(HAVE_SSE2_INTRINSICS)
+    { "SSE2", startcode_FindAnnexB_SSE2 },
+#endif
+#ifdef STARTCODE_AVX2
+    { "AVX2", startcode_FindAnnexB_AVX2 },
+#endif
+#ifdef STARTCODE_NEON
+    { "NEON", startcode_FindAnnexB_NEON },
+#endif
+};
+
+static bool supported(size_t k)
+{
+    if (!strcmp(kernels[k].name, "SSE2"))
+        return vlc_CPU_SSE2();
+    if (!strcmp(kernels[k].name, "AVX2"))
+        return vlc_CPU_AVX2();
+    return true;
+}
+
+static void test_kernels(void)
+{
+    uint8_t buf[1024];
+
+    for (unsigned n = 0; n < 20000; n++)
+    {
+        size_t size = rnd() % sizeof (buf);
+        size_t start = (size > 0) ? rnd() % (size + 1) : 0;
+
+        fill(buf, size, 2 + n % 8);
+        /* Startcode right at the end, which is a classic off-by-one */
+        if (size >= 3 && (n & 1))
+        {
+            memset(&buf[start], 0xFF, size - start);
+            if (size - start >= 3)
+                memcpy(&buf[size - 3], "\x00\x00\x01", 3);
+        }
+
+        const uint8_t *ref = naive(&buf[start], &buf[size],
+                                   (const uint8_t *)"\x00\x00\x01", 3);
+
+        for (size_t k = 0; k < ARRAY_SIZE(kernels); k++)
+            if (supported(k))
+                assert(kernels[k].find(&buf[start], &buf[size]) == ref);
+        assert(startcode_FindAnnexB(&buf[start], &buf[size]) == ref);
+    }
+}
+
+/* Splits data in a chain of blocks of random sizes */
+static void push_blocks(block_bytestream_t *bs, const uint8_t *buf,
+                        size_t size, size_t max_block)
+{
+    while (size > 0)
+    {
+        size_t len = 1 + rnd() % max_block;
+        if (len > size)
+            len = size;
+
+        block_t *block = block_Alloc(len);
+        assert(block != NULL);
+
+        memcpy(block->p_buffer, buf, len);
+        block_BytestreamPush(bs, block);
+        buf += len;
+        size -= len;
+    }
+}
+
+/* Finds every startcode in a chain, and checks the offsets against a flat
+ * search, including where the search stops when there is none left. */
+static void test_chain(const uint8_t *code, size_t len,
+                       block_startcode_helper_t helper, size_t max_block)
+{
+    uint8_t buf[4096];
+    block_bytestream_t bs;
+
+    for (unsigned n = 0; n < 2000; n++)
+    {
+        size_t size = 1 + rnd() % sizeof (buf);
+
+        fill(buf, size, 3);
+        for (unsigned i = 0; i < 8; i++)
+        {
+            size_t pos = rnd() % size;
+            memcpy(&buf[pos], code, __MIN(len, size - pos));
+        }
+
+        block_BytestreamInit(&bs);
+        push_blocks(&bs, buf, size, max_block);
+
+        /* Start from a non-zero read pointer */
+        size_t skip = rnd() % (size / 2 + 1);
+        assert(block_SkipBytes(&bs, skip) == VLC_SUCCESS);
+
+        size_t offset = 0, end = size - skip;
+        while (offset < end)
+        {
+            const uint8_t *ref = naive(&buf[skip + offset], &buf[size],
+                                       code, len);
+            size_t from = offset;
+            int ret = block_FindStartcodeFromOffset(&bs, &offset, code, len,
+                                                    helper);
+            if (ref != NULL)
+            {
+                assert(ret == VLC_SUCCESS);
+                assert(offset == (size_t)(ref - buf) - skip);
+                offset++;
+                continue;
+            }
+
+            /* Otherwise, it stops on the first truncated startcode, if any */
+            size_t expected = end;
+            for (size_t i = __MAX(from, end - __MIN(end, len - 1)); i < end; i++)
+                if (!memcmp(&buf[skip + i], code, end - i))
+                {
+                    expected = i;
+                    break;
+                }
+            assert(ret != VLC_SUCCESS);
+            assert(offset == expected);
+            break;
+        }
+        block_BytestreamRelease(&bs);
+    }
+}
+
+static void bench(void)
+{
+    uint8_t *buf = malloc(BENCH_SIZE);
+    assert(buf != NULL);
+
+    /* Entropy-coded data has few zeros and long NAL units */
+    for (size_t i = 0; i < BENCH_SIZE; i++)
+        buf[i] = (rnd() % 64) ? rnd() : 0;
+    for (size_t i = 0; i + 3 <= BENCH_SIZE; i++)
+        if (buf[i] == 0 && buf[i + 1] == 0 && buf[i + 2] <= 3)
+            buf[i + 2] = 3; /* emulation prevention */
+    for (size_t i = 0; i + 4 <= BENCH_SIZE; i += 4 + rnd() % (256 << 10))
+        memcpy(&buf[i], "\x00\x00\x00\x01", 4);
+
+    for (size_t k = 0; k < ARRAY_SIZE(kernels); k++)
+    {
+        if (!supported(k))
+            continue;
+
+        const uint8_t *p = buf, *end = buf + BENCH_SIZE;
+        unsigned count = 0;
+        mtime_t start = mdate();
+
+        while ((p = kernels[k].find(p, end)) != NULL)
+        {
+            p += 3;
+            count++;
+        }
+
+        mtime_t duration = mdate() - start;
+        printf("%s: %u startcodes, %.0f MB/s\n", kernels[k].name, count,
+               (double)BENCH_SIZE * CLOCK_FREQ / (duration + 1) / 1e6);
+    }
+
+    /* Same data as 188-byte TS payloads in a bytestream */
+    block_bytestream_t bs;
+    block_BytestreamInit(&bs);
+    for (size_t i = 0; i < BENCH_SIZE; i += 184)
+    {
+        block_t *block = block_Alloc(__MIN(184, BENCH_SIZE - i));
+        assert(block != NULL);
+        memcpy(block->p_buffer, &buf[i], block->i_buffer);
+        block_BytestreamPush(&bs, block);
+    }
+
+    size_t offset = 0;
+    unsigned count = 0;
+    mtime_t start = mdate();
+
+    while (block_FindStartcodeFromOffset(&bs, &offset,
+                                         (const uint8_t *)"\x00\x00\x01", 3,
+                                         startcode_FindAnnexB) == VLC_SUCCESS)
+    {
+        /* Consume the data like the packetizers do */
+        block_SkipBytes(&bs, offset);
+        block_BytestreamFlush(&bs);
+        offset = 3;
+        count++;
+    }
+
+    mtime_t duration = mdate() - start;
+    printf("bytestream: %u startcodes, %.0f MB/s\n", count,
+           (double)BENCH_SIZE * CLOCK_FREQ / (duration + 1) / 1e6);
+    block_BytestreamRelease(&bs);
+    free(buf);
+}
+
+int main(void)
+{
+    static const uint8_t annexb[] = { 0x00, 0x00, 0x01 };
+    static const uint8_t dirac[] = { 'B', 'B', 'C', 'D' };
+
+    test_kernels();
+
+    test_chain(annexb, sizeof (annexb), startcode_FindAnnexB, 1000);
+    test_chain(annexb, sizeof (annexb), startcode_FindAnnexB, 3);
+    test_chain(annexb, sizeof (annexb), NULL, 50);
+    test_chain(dirac, sizeof (dirac), NULL, 1000);
+    test_chain(dirac, sizeof (dirac), NULL, 2);
+
+    bench();
+    return 0;
+}
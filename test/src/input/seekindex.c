@@ -0,0 +1,212 @@
+/*****************************************************************************
+ * seekindex.c: seek index cache unit test
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#undef NDEBUG
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <utime.h>
+
+#include <vlc_common.h>
+#include <vlc_fs.h>
+#include <vlc_stream.h>
+#include <vlc_seekindex.h>
+#include "../../../lib/libvlc_internal.h"
+#include "../../libvlc/test.h"
+
+#include <vlc/vlc.h>
+
+#define TRACKS  3
+#define ENTRIES 1000
+#define STALE   1000
+
+static libvlc_instance_t *vlc;
+static vlc_object_t *parent;
+static uint8_t data[200000];
+
+static vlc_seekindex_t *Open(uint32_t version)
+{
+    stream_t *s = vlc_stream_MemoryNew(parent, data, sizeof (data), true);
+    assert(s != NULL);
+    assert(vlc_stream_Seek(s, 1234) == 0);
+
+    vlc_seekindex_t *idx = vlc_seekindex_New(parent, s, "test", version);
+    assert(vlc_stream_Tell(s) == 1234);
+    vlc_stream_Delete(s);
+    return idx;
+}
+
+static vlc_seekindex_entry_t Entry(uint32_t track, unsigned i)
+{
+    vlc_seekindex_entry_t e = {
+        .i_time = INT64_C(1000000) * i - 5000,
+        .i_pos = UINT64_C(1) << 33 | (uint64_t)i * 188 * 1000,
+        .i_track = 10 * track,
+        .i_flags = i & 1,
+        .i_size = track ? i : 0,
+    };
+    return e;
+}
+
+static void Check(vlc_seekindex_t *idx)
+{
+    for (uint32_t t = 0; t < TRACKS; t++)
+    {
+        const vlc_seekindex_entry_t *tab;
+
+        assert(vlc_seekindex_Get(idx, 10 * t, &tab) == ENTRIES);
+        for (unsigned i = 0; i < ENTRIES; i++)
+        {
+            vlc_seekindex_entry_t e = Entry(t, i);
+            assert(tab[i].i_time == e.i_time && tab[i].i_pos == e.i_pos
+                && tab[i].i_track == e.i_track && tab[i].i_flags == e.i_flags
+                && tab[i].i_size == e.i_size);
+        }
+    }
+    assert(vlc_seekindex_Get(idx, 5, &(const vlc_seekindex_entry_t *){NULL})
+           == 0);
+
+    const vlc_seekindex_entry_t *lo, *hi;
+
+    assert(vlc_seekindex_Lookup(idx, 10, INT64_C(42500000), &lo, &hi));
+    assert(lo->i_track == 10 && lo->i_time == INT64_C(42000000) - 5000);
+    assert(hi->i_track == 10 && hi->i_time == INT64_C(43000000) - 5000);
+    assert(vlc_seekindex_Lookup(idx, 20, -10000, &lo, &hi));
+    assert(lo == NULL && hi->i_time == -5000);
+    assert(vlc_seekindex_Lookup(idx, 0, INT64_MAX, &lo, &hi));
+    assert(lo->i_time == INT64_C(1000000) * (ENTRIES - 1) - 5000 && hi == NULL);
+    assert(!vlc_seekindex_Lookup(idx, 15, 0, &lo, &hi));
+}
+
+int main(void)
+{
+    char dir[] = "/tmp/vlc-seekindex-XXXXXX";
+
+    assert(mkdtemp(dir) != NULL);
+    setenv("XDG_CACHE_HOME", dir, 1);
+    test_init();
+
+    vlc = libvlc_new(0, NULL);
+    assert(vlc != NULL);
+    parent = VLC_OBJECT(vlc->p_libvlc_int);
+
+    for (size_t i = 0; i < sizeof (data); i++)
+        data[i] = i * 7 + (i >> 8);
+
+    /* Empty at first, then filled in reverse order and with duplicates */
+    vlc_seekindex_t *idx = Open(1);
+    assert(idx != NULL);
+    assert(vlc_seekindex_Get(idx, 0, &(const vlc_seekindex_entry_t *){NULL})
+           == 0);
+    for (unsigned i = ENTRIES; i-- > 0;)
+        for (uint32_t t = TRACKS; t-- > 0;)
+        {
+            vlc_seekindex_entry_t e = Entry(t, i);
+            assert(vlc_seekindex_Add(idx, &e) == VLC_SUCCESS);
+            if (i % 3 == 0)
+                assert(vlc_seekindex_Add(idx, &e) == VLC_SUCCESS);
+        }
+    Check(idx);
+    vlc_seekindex_Delete(idx);
+
+    /* Reloaded */
+    idx = Open(1);
+    assert(idx != NULL);
+    Check(idx);
+    vlc_seekindex_Delete(idx);
+
+    /* Other demuxer version */
+    idx = Open(2);
+    assert(idx != NULL);
+    assert(vlc_seekindex_Get(idx, 0, &(const vlc_seekindex_entry_t *){NULL})
+           == 0);
+    vlc_seekindex_Delete(idx);
+
+    /* Other content */
+    data[100] ^= 1;
+    idx = Open(1);
+    assert(idx != NULL);
+    assert(vlc_seekindex_Get(idx, 0, &(const vlc_seekindex_entry_t *){NULL})
+           == 0);
+    vlc_seekindex_Delete(idx);
+
+    /* Old indexes are evicted once there are too many */
+    for (unsigned i = 0; i < STALE; i++)
+    {
+        char *path;
+        assert(asprintf(&path, "%s/vlc/seekindex/stale%u", dir, i) != -1);
+        FILE *file = fopen(path, "wb");
+        assert(file != NULL);
+        fputc(0, file);
+        fclose(file);
+        assert(utime(path, &(struct utimbuf){ .actime = i, .modtime = i })
+               == 0);
+        free(path);
+    }
+    idx = Open(1);
+    assert(idx != NULL);
+    vlc_seekindex_entry_t e = Entry(0, 0);
+    assert(vlc_seekindex_Add(idx, &e) == VLC_SUCCESS);
+    vlc_seekindex_Delete(idx);
+
+    char *seekdir;
+    assert(asprintf(&seekdir, "%s/vlc/seekindex", dir) != -1);
+    DIR *d = vlc_opendir(seekdir);
+    assert(d != NULL);
+    unsigned stale = 0, total = 0;
+    for (const char *name; (name = vlc_readdir(d)) != NULL;)
+    {
+        if (name[0] == '.')
+            continue;
+        total++;
+        if (!strncmp(name, "stale", 5))
+        {
+            assert(strcmp(name, "stale0") && strcmp(name, "stale1"));
+            stale++;
+        }
+    }
+    closedir(d);
+    free(seekdir);
+    assert(total <= STALE && stale == total - 2);
+    data[100] ^= 1;
+
+    /* The current index survived */
+    idx = Open(1);
+    assert(idx != NULL);
+    Check(idx);
+    vlc_seekindex_Delete(idx);
+
+    /* Disabled */
+    var_Create(parent, "seek-index", VLC_VAR_BOOL);
+    var_SetBool(parent, "seek-index", false);
+    assert(Open(1) == NULL);
+
+    libvlc_release(vlc);
+
+    char *cmd;
+    assert(asprintf(&cmd, "rm -rf %s", dir) != -1);
+    assert(system(cmd) == 0);
+    free(cmd);
+    return 0;
+}
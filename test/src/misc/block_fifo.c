@@ -0,0 +1,179 @@
+/*****************************************************************************
+ * block_fifo.c: test and benchmark for the block queues
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "../../libvlc/test.h"
+#ifdef NDEBUG
+ #undef NDEBUG
+#endif
+#include <assert.h>
+#include <vlc_common.h>
+#include <vlc_block.h>
+
+#define BLOCKS_TOTAL 96000
+#define MAX_PRODUCERS 16
+
+struct producer
+{
+    block_fifo_t *fifo;
+    vlc_lffifo_t *lffifo;
+    block_t **blocks;
+    unsigned count;
+};
+
+static void *produce(void *data)
+{
+    struct producer *p = data;
+
+    for (unsigned i = 0; i < p->count; i++)
+    {
+        if (p->lffifo != NULL)
+            vlc_lffifo_Queue(p->lffifo, p->blocks[i]);
+        else
+            block_FifoPut(p->fifo, p->blocks[i]);
+    }
+    return NULL;
+}
+
+static mtime_t bench(unsigned producers, bool lockfree)
+{
+    struct producer prod[MAX_PRODUCERS];
+    vlc_thread_t th[MAX_PRODUCERS];
+    unsigned next[MAX_PRODUCERS] = { 0 };
+    const unsigned count = BLOCKS_TOTAL / producers;
+    block_fifo_t *fifo = NULL;
+    vlc_lffifo_t *lffifo = NULL;
+
+    if (lockfree)
+        assert((lffifo = vlc_lffifo_New()) != NULL);
+    else
+        assert((fifo = block_FifoNew()) != NULL);
+
+    for (unsigned p = 0; p < producers; p++)
+    {
+        prod[p].fifo = fifo;
+        prod[p].lffifo = lffifo;
+        prod[p].count = count;
+        prod[p].blocks = malloc(count * sizeof (block_t *));
+        assert(prod[p].blocks != NULL);
+        for (unsigned i = 0; i < count; i++)
+        {
+            block_t *b = block_Alloc(i % 4);
+            assert(b != NULL);
+            b->i_dts = p;
+            b->i_pts = i;
+            prod[p].blocks[i] = b;
+        }
+    }
+
+    mtime_t start = mdate();
+
+    for (unsigned p = 0; p < producers; p++)
+        assert(vlc_clone(&th[p], produce, &prod[p],
+                         VLC_THREAD_PRIORITY_LOW) == 0);
+
+    /* Blocks of each producer must come out in order */
+    for (unsigned n = 0; n < producers * count; n++)
+    {
+        block_t *b = lockfree ? vlc_lffifo_Get(lffifo) : block_FifoGet(fifo);
+
+        assert(b->p_next == NULL);
+        assert(b->i_dts >= 0 && b->i_dts < producers);
+        assert(b->i_pts == next[b->i_dts]);
+        next[b->i_dts]++;
+        block_Release(b);
+    }
+
+    mtime_t duration = mdate() - start;
+
+    for (unsigned p = 0; p < producers; p++)
+    {
+        vlc_join(th[p], NULL);
+        free(prod[p].blocks);
+    }
+
+    if (lockfree)
+    {
+        assert(vlc_lffifo_IsEmpty(lffifo));
+        assert(vlc_lffifo_GetBytes(lffifo) == 0);
+        vlc_lffifo_Release(lffifo);
+    }
+    else
+        block_FifoRelease(fifo);
+    return duration;
+}
+
+static void test_lffifo_Basics(void)
+{
+    vlc_lffifo_t *fifo = vlc_lffifo_New();
+    assert(fifo != NULL);
+    assert(vlc_lffifo_IsEmpty(fifo));
+    assert(vlc_lffifo_Dequeue(fifo) == NULL);
+    assert(vlc_lffifo_DequeueAll(fifo) == NULL);
+
+    /* Chains are queued as a whole */
+    block_t *chain = NULL;
+    for (unsigned i = 0; i < 3; i++)
+    {
+        block_t *b = block_Alloc(10);
+        assert(b != NULL);
+        b->i_pts = 3 - i;
+        b->p_next = chain;
+        chain = b;
+    }
+    vlc_lffifo_Queue(fifo, chain);
+    vlc_lffifo_Queue(fifo, block_Alloc(5));
+    assert(vlc_lffifo_GetCount(fifo) == 4);
+    assert(vlc_lffifo_GetBytes(fifo) == 35);
+
+    block_t *b = vlc_lffifo_Dequeue(fifo);
+    assert(b != NULL && b->i_pts == 1 && b->p_next == NULL);
+    block_Release(b);
+    assert(vlc_lffifo_GetCount(fifo) == 3);
+    assert(vlc_lffifo_GetBytes(fifo) == 25);
+
+    b = vlc_lffifo_DequeueAll(fifo);
+    assert(b != NULL && b->i_pts == 2);
+    assert(b->p_next != NULL && b->p_next->i_pts == 3);
+    assert(b->p_next->p_next != NULL && b->p_next->p_next->i_buffer == 5);
+    assert(b->p_next->p_next->p_next == NULL);
+    assert(vlc_lffifo_IsEmpty(fifo));
+    assert(vlc_lffifo_GetBytes(fifo) == 0);
+
+    /* Queue again after having been emptied */
+    vlc_lffifo_Queue(fifo, b);
+    assert(vlc_lffifo_GetCount(fifo) == 3);
+    vlc_lffifo_Release(fifo);
+}
+
+int main(void)
+{
+    test_init();
+    test_lffifo_Basics();
+
+    for (unsigned producers = 1; producers <= MAX_PRODUCERS; producers *= 2)
+    {
+        mtime_t locked = bench(producers, false);
+        mtime_t lockfree = bench(producers, true);
+
+        printf("%2u producer(s): block_fifo %6"PRId64" us, "
+               "lffifo %6"PRId64" us\n", producers, locked, lockfree);
+    }
+    return 0;
+}
@@ -0,0 +1,156 @@
+/*****************************************************************************
+ * cache.c: plugins cache test and startup time benchmark
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef NDEBUG
+ #undef NDEBUG
+#endif
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vlc_common.h>
+#include <vlc_modules.h>
+#include <vlc_configuration.h>
+#include "../../../lib/libvlc_internal.h"
+
+#include <vlc/vlc.h>
+
+static libvlc_instance_t *Create(const char *const *args, int count)
+{
+    const char *argv[8] = { "--ignore-config", "--quiet" };
+
+    assert(count <= 6);
+    for (int i = 0; i < count; i++)
+        argv[2 + i] = args[i];
+
+    libvlc_instance_t *vlc = libvlc_new(count + 2, argv);
+    assert(vlc != NULL);
+    return vlc;
+}
+
+static size_t CountModules(void)
+{
+    size_t count;
+
+    module_list_free(module_list_get(&count));
+    return count;
+}
+
+static void TestOptions(libvlc_instance_t *vlc)
+{
+    vlc_object_t *obj = VLC_OBJECT(vlc->p_libvlc_int);
+
+    /* Options of plug-ins loaded from the cache */
+    assert(config_GetType(obj, "scaletempo-stride") == VLC_VAR_INTEGER);
+    assert(config_GetInt(obj, "scaletempo-stride") == 30);
+    assert(config_GetType(obj, "scaletempo-overlap") == VLC_VAR_FLOAT);
+    assert(config_GetType(obj, "scaletempo-nonexistent") == 0);
+
+    module_t *module = module_find("scaletempo");
+    assert(module != NULL);
+
+    unsigned count;
+    module_config_t *items = module_config_get(module, &count);
+    bool found = false;
+
+    assert(items != NULL);
+    for (unsigned i = 0; i < count; i++)
+        if (items[i].psz_name != NULL
+         && !strcmp(items[i].psz_name, "scaletempo-overlap"))
+        {
+            assert(items[i].orig.f == .20f);
+            found = true;
+        }
+    assert(found);
+    module_config_free(items);
+}
+
+static void TestCommandLine(void)
+{
+    static const char *const args[] = {
+        "--scaletempo-stride=20", "--scaletempo-coarse-search",
+    };
+    static const char *const noargs[] = { "--no-scaletempo-coarse-search" };
+
+    libvlc_instance_t *vlc = Create(args, ARRAY_SIZE(args));
+    vlc_object_t *obj = VLC_OBJECT(vlc->p_libvlc_int);
+
+    assert(var_InheritInteger(obj, "scaletempo-stride") == 20);
+    assert(var_InheritBool(obj, "scaletempo-coarse-search"));
+    libvlc_release(vlc);
+
+    vlc = Create(noargs, ARRAY_SIZE(noargs));
+    obj = VLC_OBJECT(vlc->p_libvlc_int);
+    assert(var_InheritInteger(obj, "scaletempo-stride") == 30);
+    assert(!var_InheritBool(obj, "scaletempo-coarse-search"));
+    libvlc_release(vlc);
+}
+
+/* Average time to create and destroy a LibVLC instance */
+static double Startup(const char *const *args, int count, unsigned runs)
+{
+    mtime_t start = mdate();
+
+    for (unsigned i = 0; i < runs; i++)
+        libvlc_release(Create(args, count));
+    return (double)(mdate() - start) / runs / 1000.;
+}
+
+static void Bench(void)
+{
+    static const char *const scan[] = { "--plugins-scan" };
+    static const char *const noscan[] = { "--no-plugins-scan" };
+    static const char *const nocache[] = { "--no-plugins-cache" };
+
+    printf("startup: %.2f ms with the plugins cache\n",
+           Startup(scan, ARRAY_SIZE(scan), 100));
+    printf("startup: %.2f ms with the plugins cache, without scanning\n",
+           Startup(noscan, ARRAY_SIZE(noscan), 100));
+    printf("startup: %.2f ms without the plugins cache\n",
+           Startup(nocache, ARRAY_SIZE(nocache), 2));
+}
+
+int main(void)
+{
+    static const char *const reset[] = { "--reset-plugins-cache" };
+
+    setenv("VLC_PLUGIN_PATH", "../modules", 1);
+
+    /* Write the cache, then read it back */
+    libvlc_instance_t *vlc = Create(reset, ARRAY_SIZE(reset));
+    size_t count = CountModules();
+    assert(count > 0);
+    TestOptions(vlc);
+    libvlc_release(vlc);
+
+    vlc = Create(NULL, 0);
+    assert(CountModules() == count);
+    TestOptions(vlc);
+    libvlc_release(vlc);
+
+    TestCommandLine();
+    Bench();
+    return 0;
+}